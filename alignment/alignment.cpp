@@ -20,6 +20,8 @@
 #include "utils/timeutil.h" //for getRealTime()
 #include "utils/progress.h" //for progress_display
 #include "alignmentsummary.h"
+#include "packedalignment.h"
+#include "mappedalignment.h"
 
 #include <Eigen/LU>
 #ifdef USE_BOOST
@@ -554,6 +556,9 @@ Alignment::Alignment(char *filename, char *sequence_type, InputType &intype, str
         } else if (intype == IN_MSF) {
             cout << "MSF format detected" << endl;
             readMSF(filename, sequence_type);
+        } else if (intype == IN_PACKED) {
+            cout << "Packed format detected" << endl;
+            readPacked(filename, sequence_type);
         } else {
             outError("Unknown sequence format, please use PHYLIP, FASTA, CLUSTAL, MSF, or NEXUS format");
         }
@@ -907,6 +912,10 @@ void Alignment::extractSequences(char *filename, char *sequence_type, StrVector
         } else if (intype == IN_MSF) {
             cout << "MSF format detected" << endl;
             doReadMSF(filename, sequence_type, sequences, nseq, nsite);
+        } else if (intype == IN_PACKED) {
+            cout << "Packed format detected" << endl;
+            string packed_seq_type;
+            doReadPacked(filename, sequence_type, sequences, nseq, nsite, packed_seq_type);
         } else {
             outError("Unknown sequence format, please use PHYLIP, FASTA, CLUSTAL, MSF format");
         }
@@ -1293,45 +1302,37 @@ void Alignment::regroupSitePattern(int groups, IntVector& site_group)
 	@param sequences vector of strings
 	@return the data type of the input sequences
 */
-SeqType Alignment::detectSequenceType(StrVector &sequences) {
+SeqType Alignment::detectSequenceType(size_t *char_counts) {
     size_t num_nuc   = 0;
     size_t num_ungap = 0;
     size_t num_bin   = 0;
     size_t num_alpha = 0;
     size_t num_digit = 0;
-    double detectStart = getRealTime();
-    size_t sequenceCount = sequences.size();
-#ifdef _OPENMP
-#pragma omp parallel for reduction(+:num_nuc,num_ungap,num_bin,num_alpha,num_digit)
-#endif
-    for (size_t seqNum = 0; seqNum < sequenceCount; ++seqNum) {
-        auto start = sequences.at(seqNum).data();
-        auto stop  = start + sequences.at(seqNum).size();
-        for (auto i = start; i!=stop; ++i) {
-            if ((*i) == 'A' || (*i) == 'C' || (*i) == 'G' || (*i) == 'T' || (*i) == 'U') {
-                ++num_nuc;
-                ++num_ungap;
-                continue;
-            }
-            if ((*i)=='?' || (*i)=='-' || (*i) == '.' ) {
-                continue;
-            }
-            if (*i != 'N' && *i != 'X' &&  (*i) != '~') {
-                num_ungap++;
-                if (isdigit(*i)) {
-                    num_digit++;
-                    if ((*i) == '0' || (*i) == '1') {
-                        num_bin++;
-                    }
+    for (int ch = 0; ch < NUM_CHAR; ch++) {
+        size_t count = char_counts[ch];
+        if (count == 0) {
+            continue;
+        }
+        if (ch == 'A' || ch == 'C' || ch == 'G' || ch == 'T' || ch == 'U') {
+            num_nuc += count;
+            num_ungap += count;
+            continue;
+        }
+        if (ch == '?' || ch == '-' || ch == '.' ) {
+            continue;
+        }
+        if (ch != 'N' && ch != 'X' && ch != '~') {
+            num_ungap += count;
+            if (isdigit(ch)) {
+                num_digit += count;
+                if (ch == '0' || ch == '1') {
+                    num_bin += count;
                 }
             }
-            if (isalpha(*i)) {
-                num_alpha++;
-            }
         }
-    }
-    if (verbose_mode >= VB_MED) {
-        cout << "Sequence Type detection took " << (getRealTime()-detectStart) << " seconds." << endl;
+        if (isalpha(ch)) {
+            num_alpha += count;
+        }
     }
     if (((double)num_nuc) / num_ungap > 0.9)
         return SEQ_DNA;
@@ -1669,16 +1670,43 @@ void Alignment::initCodon(char *gene_code_id) {
 //	cout << "num_states = " << num_states << endl;
 }
 
-int getMorphStates(StrVector &sequences) {
-	char maxstate = 0;
-	for (StrVector::iterator it = sequences.begin(); it != sequences.end(); it++)
-		for (string::iterator pos = it->begin(); pos != it->end(); pos++)
-			if ((*pos) > maxstate && isalnum(*pos)) maxstate = *pos;
+int getMorphStates(size_t *char_counts) {
+	int maxstate = 0;
+	for (int ch = 0; ch < NUM_CHAR; ch++)
+		if (char_counts[ch] > 0 && isalnum(ch)) maxstate = ch;
 	if (maxstate >= '0' && maxstate <= '9') return (maxstate - '0' + 1);
 	if (maxstate >= 'A' && maxstate <= 'V') return (maxstate - 'A' + 11);
 	return 0;
 }
 
+/**
+    count the occurrences of each character in all sequences
+ */
+void countSeqChars(StrVector &sequences, size_t *char_counts) {
+    memset(char_counts, 0, NUM_CHAR * sizeof(size_t));
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        size_t counts[NUM_CHAR];
+        memset(counts, 0, sizeof(counts));
+#ifdef _OPENMP
+#pragma omp for
+#endif
+        for (int64_t seq = 0; seq < (int64_t) sequences.size(); seq++) {
+            const char *start = sequences[seq].data();
+            const char *stop  = start + sequences[seq].size();
+            for (const char *i = start; i != stop; ++i)
+                counts[(unsigned char)(*i)]++;
+        }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        for (int ch = 0; ch < NUM_CHAR; ch++)
+            char_counts[ch] += counts[ch];
+    }
+}
+
 SeqType Alignment::getSeqType(const char *sequence_type) {
     SeqType user_seq_type = SEQ_UNKNOWN;
     if (strcmp(sequence_type, "BIN") == 0) {
@@ -1722,7 +1750,24 @@ string Alignment::getSeqTypeStr(SeqType sequence_type) {
     }
 }
 
-int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq, int nsite) {
+/**
+    characters of an alignment stored as one string per sequence
+ */
+struct SequenceSites {
+    StrVector &sequences;
+    char getChar(int seq, int site) const { return sequences[seq][site]; }
+};
+
+/**
+    characters of an alignment stored column by column
+ */
+struct ColumnSites {
+    const char *columns;
+    size_t nseq;
+    char getChar(int seq, int site) const { return columns[site * nseq + seq]; }
+};
+
+bool Alignment::initPatternBuilding(char *sequence_type, int nseq, int nsite, vector<size_t> &seq_lengths, size_t *char_counts) {
     int seq_id;
     ostringstream err_str;
     codon_table = NULL;
@@ -1754,14 +1799,14 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
     }
     /* now check that all sequences have the same length */
     for (seq_id = 0; seq_id < nseq; seq_id ++) {
-        if (sequences[seq_id].length() != nsite) {
+        if (seq_lengths[seq_id] != nsite) {
             err_str << "Sequence " << seq_names[seq_id] << " contains ";
-            if (sequences[seq_id].length() < nsite)
+            if (seq_lengths[seq_id] < nsite)
                 err_str << "not enough";
             else
                 err_str << "too many";
 
-            err_str << " characters (" << sequences[seq_id].length() << ")\n";
+            err_str << " characters (" << seq_lengths[seq_id] << ")\n";
         }
     }
 
@@ -1769,7 +1814,7 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
         throw err_str.str();
 
     /* now check data type */
-    seq_type = detectSequenceType(sequences);
+    seq_type = detectSequenceType(char_counts);
     switch (seq_type) {
     case SEQ_BINARY:
         num_states = 2;
@@ -1784,7 +1829,7 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
         cout << "Alignment most likely contains protein sequences" << endl;
         break;
     case SEQ_MORPH:
-        num_states = getMorphStates(sequences);
+        num_states = getMorphStates(char_counts);
         if (num_states < 2 || num_states > 32) throw "Invalid number of states.";
         cout << "Alignment most likely contains " << num_states << "-state morphological data" << endl;
         break;
@@ -1816,7 +1861,7 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
             nt2aa = true;
             cout << "Translating to amino-acid sequences with genetic code " << &sequence_type[5] << " ..." << endl;
         } else if (strcmp(sequence_type, "NUM") == 0 || strcmp(sequence_type, "MORPH") == 0) {
-            num_states = getMorphStates(sequences);
+            num_states = getMorphStates(char_counts);
             if (num_states < 2 || num_states > 32) throw "Invalid number of states";
             user_seq_type = SEQ_MORPH;
         } else if (strcmp(sequence_type, "TINA") == 0 || strcmp(sequence_type, "MULTI") == 0) {
@@ -1834,6 +1879,154 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
             outWarning("Your specified sequence type is different from the detected one");
         seq_type = user_seq_type;
     }
+    return nt2aa;
+}
+
+#define PARALLEL_PATTERN_MIN_SITES 10000
+
+/**
+    hash the patterns of a vector by their IDs, so that a table of IDs does not copy the patterns
+ */
+struct PatternIDHash {
+    const vector<Pattern> *patterns;
+    size_t operator()(int id) const {
+        const Pattern &pat = (*patterns)[id];
+        size_t sum = 0;
+        for (Pattern::const_iterator it = pat.begin(); it != pat.end(); it++)
+            sum = (*it) + (sum << 6) + (sum << 16) - sum;
+        return sum;
+    }
+};
+
+/**
+    compare the patterns of a vector by their IDs
+ */
+struct PatternIDEqual {
+    const vector<Pattern> *patterns;
+    bool operator()(int id1, int id2) const {
+        return static_cast<const vector<StateType>&>((*patterns)[id1]) == static_cast<const vector<StateType>&>((*patterns)[id2]);
+    }
+};
+template <class SiteReader>
+bool Alignment::buildPatternParallel(SiteReader &sites, int nseq, int nsite, int step, bool nt2aa,
+                                     char *char_to_state, char *AA_to_state, int &num_gaps_only,
+                                     progress_display &progress) {
+#ifdef _OPENMP
+    int thread_count = omp_get_max_threads();
+#else
+    int thread_count = 1;
+#endif
+    int num_sites = nsite / step;
+    if (thread_count < 2 || num_sites < PARALLEL_PATTERN_MIN_SITES || verbose_mode >= VB_DEBUG)
+        return false;
+    
+    vector<vector<Pattern> > thread_patterns(thread_count);
+    IntVector thread_num_gaps_only(thread_count, 0);
+    vector<char> thread_ok(thread_count, 1);
+    
+    // each thread hashes a range of sites into its own table, site_pattern temporarily stores the local pattern IDs
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static,1)
+    #endif
+    for (int thread = 0; thread < thread_count; ++thread) {
+        int site_start = (int64_t)num_sites * thread / thread_count;
+        int site_stop  = (int64_t)num_sites * (thread + 1) / thread_count;
+        vector<Pattern> &patterns = thread_patterns[thread];
+        PatternIDHash pattern_hash = {&patterns};
+        PatternIDEqual pattern_equal = {&patterns};
+        unordered_set<int, PatternIDHash, PatternIDEqual> local_index(1024, pattern_hash, pattern_equal);
+        Pattern pat;
+        pat.resize(nseq);
+        for (int site = site_start; site < site_stop && thread_ok[thread]; ++site) {
+            int pos = site * step;
+            bool gaps_only = true;
+            for (int seq = 0; seq < nseq; seq++) {
+                char state = char_to_state[(int)(sites.getChar(seq, pos))];
+                if (step == 3) {
+                    char state2 = char_to_state[(int)(sites.getChar(seq, pos+1))];
+                    char state3 = char_to_state[(int)(sites.getChar(seq, pos+2))];
+                    if (state < 4 && state2 < 4 && state3 < 4) {
+                        state = state*16 + state2*4 + state3;
+                        if (genetic_code[(int)state] == '*')
+                            state = STATE_INVALID;
+                        else if (nt2aa)
+                            state = AA_to_state[(int)genetic_code[(int)state]];
+                        else
+                            state = non_stop_codon[(int)state];
+                    } else if (state != STATE_UNKNOWN || state2 != STATE_UNKNOWN || state3 != STATE_UNKNOWN) {
+                        // invalid or partly ambiguous codon
+                        state = STATE_INVALID;
+                    }
+                }
+                if (state == STATE_INVALID) {
+                    thread_ok[thread] = 0;
+                    break;
+                }
+                if (state != STATE_UNKNOWN)
+                    gaps_only = false;
+                pat[seq] = state;
+            }
+            if (!thread_ok[thread])
+                break;
+            thread_num_gaps_only[thread] += gaps_only ? 1 : 0;
+            // add the pattern tentatively, remove it if it is already in the table
+            pat.frequency = 0;
+            patterns.push_back(pat);
+            int pat_id = *local_index.insert(patterns.size()-1).first;
+            if (pat_id != (int) patterns.size()-1)
+                patterns.pop_back();
+            patterns[pat_id].frequency++;
+            site_pattern[site] = pat_id;
+        }
+    }
+    for (int thread = 0; thread < thread_count; ++thread)
+        if (!thread_ok[thread])
+            return false;
+    
+    // merge the tables in the order of the site ranges, so that the patterns are ordered by their first site
+    vector<IntVector> local_to_global(thread_count);
+    num_gaps_only = 0;
+    for (int thread = 0; thread < thread_count; ++thread) {
+        vector<Pattern> &patterns = thread_patterns[thread];
+        local_to_global[thread].resize(patterns.size());
+        for (size_t i = 0; i < patterns.size(); i++) {
+            PatternIntMap::iterator pat_it = pattern_index.find(patterns[i]);
+            if (pat_it == pattern_index.end()) {
+                // take over the states of the local pattern without copying them
+                push_back(Pattern());
+                back().swap(patterns[i]);
+                back().frequency = patterns[i].frequency;
+                pattern_index[back()] = size()-1;
+                local_to_global[thread][i] = size()-1;
+            } else {
+                at(pat_it->second).frequency += patterns[i].frequency;
+                local_to_global[thread][i] = pat_it->second;
+            }
+        }
+        vector<Pattern>().swap(patterns);
+        num_gaps_only += thread_num_gaps_only[thread];
+        int site_start = (int64_t)num_sites * thread / thread_count;
+        int site_stop  = (int64_t)num_sites * (thread + 1) / thread_count;
+        progress += (double)(site_stop - site_start) * step;
+    }
+    
+    // convert the local pattern IDs of all sites
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static,1)
+    #endif
+    for (int thread = 0; thread < thread_count; ++thread) {
+        int site_start = (int64_t)num_sites * thread / thread_count;
+        int site_stop  = (int64_t)num_sites * (thread + 1) / thread_count;
+        IntVector &to_global = local_to_global[thread];
+        for (int site = site_start; site < site_stop; ++site)
+            site_pattern[site] = to_global[site_pattern[site]];
+    }
+    return true;
+}
+
+template <class SiteReader>
+int Alignment::buildPatternFromSites(SiteReader &sites, int nseq, int nsite, bool nt2aa) {
+    ostringstream err_str;
 
     //initStateSpace(seq_type);
     
@@ -1860,20 +2053,30 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
     int num_error = 0;
     
     progress_display progress(nsite, "Constructing alignment", "examined", "site");
-    for (site = 0; site < nsite; site+=step) {
+    if (buildPatternParallel(sites, nseq, nsite, step, nt2aa, char_to_state, AA_to_state, num_gaps_only, progress)) {
+        // all sites are processed
+        site = nsite;
+    } else {
+        // start again by one thread, which reports the invalid characters
+        clear();
+        pattern_index.clear();
+        num_gaps_only = 0;
+        site = 0;
+    }
+    for (; site < nsite; site+=step) {
         for (seq = 0; seq < nseq; seq++) {
-            //char state = convertState(sequences[seq][site], seq_type);
-            char state = char_to_state[(int)(sequences[seq][site])];
+            //char state = convertState(sites.getChar(seq, site), seq_type);
+            char state = char_to_state[(int)(sites.getChar(seq, site))];
             if (seq_type == SEQ_CODON || nt2aa) {
             	// special treatment for codon
-            	char state2 = char_to_state[(int)(sequences[seq][site+1])];
-            	char state3 = char_to_state[(int)(sequences[seq][site+2])];
+            	char state2 = char_to_state[(int)(sites.getChar(seq, site+1))];
+            	char state3 = char_to_state[(int)(sites.getChar(seq, site+2))];
             	if (state < 4 && state2 < 4 && state3 < 4) {
 //            		state = non_stop_codon[state*16 + state2*4 + state3];
             		state = state*16 + state2*4 + state3;
             		if (genetic_code[(int)state] == '*') {
                         err_str << "Sequence " << seq_names[seq] << " has stop codon " <<
-                        		sequences[seq][site] << sequences[seq][site+1] << sequences[seq][site+2] <<
+                        		sites.getChar(seq, site) << sites.getChar(seq, site+1) << sites.getChar(seq, site+2) <<
                         		" at site " << site+1 << endl;
                         num_error++;
                         state = STATE_UNKNOWN;
@@ -1888,7 +2091,7 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
             		if (state != STATE_UNKNOWN || state2 != STATE_UNKNOWN || state3 != STATE_UNKNOWN) {
             			ostringstream warn_str;
                         warn_str << "Sequence " << seq_names[seq] << " has ambiguous character " <<
-                        		sequences[seq][site] << sequences[seq][site+1] << sequences[seq][site+2] <<
+                        		sites.getChar(seq, site) << sites.getChar(seq, site+1) << sites.getChar(seq, site+2) <<
                         		" at site " << site+1;
                         outWarning(warn_str.str());
             		}
@@ -1897,9 +2100,9 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
             }
             if (state == STATE_INVALID) {
                 if (num_error < 100) {
-                    err_str << "Sequence " << seq_names[seq] << " has invalid character " << sequences[seq][site];
+                    err_str << "Sequence " << seq_names[seq] << " has invalid character " << sites.getChar(seq, site);
                     if (seq_type == SEQ_CODON)
-                        err_str << sequences[seq][site+1] << sequences[seq][site+2];
+                        err_str << sites.getChar(seq, site+1) << sites.getChar(seq, site+2);
                     err_str << " at site " << site+1 << endl;
                 } else if (num_error == 100)
                     err_str << "...many more..." << endl;
@@ -1926,6 +2129,43 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
     return 1;
 }
 
+int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq, int nsite) {
+    vector<size_t> seq_lengths(sequences.size());
+    for (size_t seq = 0; seq < sequences.size(); seq++)
+        seq_lengths[seq] = sequences[seq].length();
+    
+    size_t char_counts[NUM_CHAR];
+    double detectStart = getRealTime();
+    countSeqChars(sequences, char_counts);
+    if (verbose_mode >= VB_MED) {
+        cout << "Sequence Type detection took " << (getRealTime()-detectStart) << " seconds." << endl;
+    }
+    
+    bool nt2aa = initPatternBuilding(sequence_type, nseq, nsite, seq_lengths, char_counts);
+    SequenceSites sites = {sequences};
+    return buildPatternFromSites(sites, nseq, nsite, nt2aa);
+}
+
+int Alignment::readMapped(MappedAlignment &mapped, char *sequence_type, bool shorten_names) {
+    double start_time = getRealTime();
+    seq_names.swap(mapped.seq_names);
+    if (shorten_names)
+        shortenSeqNames();
+    int nseq = seq_names.size();
+    int nsite = mapped.seq_lengths[0];
+    bool nt2aa = initPatternBuilding(sequence_type, nseq, nsite, mapped.seq_lengths, mapped.char_counts);
+    
+    // copy the characters column by column, so that the characters of a site are contiguous
+    vector<char> columns;
+    mapped.getColumns(columns);
+    mapped.close();
+    if (verbose_mode >= VB_MED) {
+        cout << "Reading the memory-mapped alignment took " << (getRealTime()-start_time) << " seconds." << endl;
+    }
+    ColumnSites sites = {columns.data(), (size_t) nseq};
+    return buildPatternFromSites(sites, nseq, nsite, nt2aa);
+}
+
 void processSeq(string &sequence, string &line, int line_num) {
     for (string::iterator it = line.begin(); it != line.end(); it++) {
         if ((*it) <= ' ') continue;
@@ -2018,6 +2258,12 @@ void Alignment::doReadPhylip(char *filename, char *sequence_type, StrVector &seq
 }
 
 int Alignment::readPhylip(char *filename, char *sequence_type) {
+    // parse alignments with one sequence per line through a memory map in parallel (except for TINA/MULTI states)
+    bool tina_state = (sequence_type && (strcmp(sequence_type,"TINA") == 0 || strcmp(sequence_type,"MULTI") == 0));
+    MappedAlignment mapped;
+    if (!tina_state && mapped.open(filename) && mapped.indexPhylip())
+        return readMapped(mapped, sequence_type, false);
+    
     StrVector sequences;
     int nseq = 0, nsite = 0;
     
@@ -2086,6 +2332,10 @@ void Alignment::doReadPhylipSequential(char *filename, char *sequence_type, StrV
 }
 
 int Alignment::readPhylipSequential(char *filename, char *sequence_type) {
+    // parse alignments with one sequence per line through a memory map in parallel
+    MappedAlignment mapped;
+    if (mapped.open(filename) && mapped.indexPhylip())
+        return readMapped(mapped, sequence_type, false);
 
     StrVector sequences;
     int nseq = 0, nsite = 0;
@@ -2145,6 +2395,14 @@ void Alignment::doReadFasta(char *filename, char *sequence_type, StrVector &sequ
     in.close();
 
     // now try to cut down sequence name if possible
+    shortenSeqNames();
+    
+    nseq = seq_names.size();
+    nsite = sequences.front().length();
+    
+}
+
+void Alignment::shortenSeqNames() {
     int i, step = 0;
     StrVector new_seq_names, remain_seq_names;
     new_seq_names.resize(seq_names.size());
@@ -2186,13 +2444,14 @@ void Alignment::doReadFasta(char *filename, char *sequence_type, StrVector &sequ
     }
 
     seq_names = new_seq_names;
-    
-    nseq = seq_names.size();
-    nsite = sequences.front().length();
-    
 }
 
 int Alignment::readFasta(char *filename, char *sequence_type) {
+    // parse large uncompressed files through a memory map in parallel
+    MappedAlignment mapped;
+    if (mapped.open(filename) && mapped.indexFasta())
+        return readMapped(mapped, sequence_type, true);
+    
     StrVector sequences;
     int nseq = 0;
     int nsite = 0;
@@ -2389,6 +2648,73 @@ int Alignment::readMSF(char *filename, char *sequence_type) {
     return buildPattern(sequences, sequence_type, nseq, nsite);
 }
 
+void Alignment::doReadPacked(char *filename, char *sequence_type, StrVector &sequences, int &nseq, int &nsite, string &packed_seq_type) {
+    igzstream in;
+    // set the failbit and badbit
+    in.exceptions(ios::failbit | ios::badbit);
+    in.open(filename);
+    
+    PackedAlignmentHeader header;
+    header.read(in);
+    packed_seq_type = header.seq_type;
+    if (header.num_seqs < 3)
+        throw "There must be at least 3 sequences";
+    if (header.num_sites < 1)
+        throw "No alignment columns";
+    
+    // all symbols must have the same length (one character, or three characters for codons)
+    if (header.alphabet.size() == 0)
+        throw "Invalid packed alignment: empty alphabet";
+    size_t symbol_length = header.alphabet[0].length();
+    for (size_t i = 1; i < header.alphabet.size(); i++)
+        if (header.alphabet[i].length() != symbol_length)
+            throw "Invalid packed alignment: symbols of different lengths";
+    
+    nseq = header.num_seqs;
+    nsite = header.num_sites * symbol_length;
+    seq_names.resize(nseq);
+    sequences.resize(nseq);
+    
+    // read the fixed-length records: a padded name followed by the packed codes
+    string name(header.name_length, ' ');
+    string packed(header.getPackedLength(header.num_sites), '\0');
+    vector<short int> codes(header.num_sites);
+    for (int seq_id = 0; seq_id < nseq; seq_id++)
+    {
+        in.read(&name[0], header.name_length);
+        in.read(&packed[0], packed.length());
+        seq_names[seq_id] = name.substr(0, name.find_last_not_of(' ') + 1);
+        
+        unpackCodes(packed.c_str(), header.num_sites, header.bits_per_code, codes.data());
+        string &sequence = sequences[seq_id];
+        sequence.resize(nsite);
+        for (size_t site = 0, pos = 0; site < header.num_sites; site++, pos += symbol_length)
+        {
+            if (codes[site] >= header.alphabet.size())
+                throw "Invalid packed alignment: unknown code in a sequence";
+            sequence.replace(pos, symbol_length, header.alphabet[codes[site]]);
+        }
+    }
+    in.close();
+}
+
+int Alignment::readPacked(char *filename, char *sequence_type) {
+    StrVector sequences;
+    int nseq = 0;
+    int nsite = 0;
+    string packed_seq_type;
+    
+    doReadPacked(filename, sequence_type, sequences, nseq, nsite, packed_seq_type);
+    
+    // use the sequence type recorded in the file if users do not specify it
+    if (!sequence_type && packed_seq_type.length() > 0)
+    {
+        this->sequence_type = packed_seq_type;
+        return buildPattern(sequences, (char*) packed_seq_type.c_str(), nseq, nsite);
+    }
+    return buildPattern(sequences, sequence_type, nseq, nsite);
+}
+
 // TODO: Use outWarning to print warnings.
 int Alignment::readCountsFormat(char* filename, char* sequence_type) {
     int npop = 0;                // Number of populations.
@@ -3025,6 +3351,47 @@ void Alignment::printFasta(ostream &out, bool append, const char *aln_site_list,
     }
 }
 
+void Alignment::printPacked(ostream &out, bool append, const char *aln_site_list,
+                            int exclude_sites, const char *ref_seq_name) {
+    IntVector kept_sites;
+    int final_length = buildRetainingSites(aln_site_list, kept_sites, exclude_sites, ref_seq_name);
+    
+    // assign a code to each state appearing in the alignment
+    map<StateType, short int> state_codes;
+    for (iterator it = begin(); it != end(); it++)
+        for (Pattern::iterator state = it->begin(); state != it->end(); state++)
+            state_codes[*state] = 0;
+    StrVector alphabet;
+    for (map<StateType, short int>::iterator it = state_codes.begin(); it != state_codes.end(); it++)
+    {
+        it->second = alphabet.size();
+        alphabet.push_back(convertStateBackStr(it->first));
+    }
+    
+    string packed_seq_type = getSeqTypeStr(seq_type);
+    if (seq_type == SEQ_CODON && sequence_type.length() > 0)
+        packed_seq_type = sequence_type;
+    int max_len = getMaxSeqNameLength();
+    PackedAlignmentHeader header(getNSeq(), final_length, max_len, packed_seq_type, alphabet);
+    string header_str = header.toString();
+    out.write(header_str.c_str(), header_str.length());
+    
+    string packed(header.getPackedLength(final_length), '\0');
+    vector<short int> codes(final_length);
+    for (size_t seq_id = 0; seq_id < seq_names.size(); seq_id++) {
+        int site = 0;
+        for (size_t i = 0; i < site_pattern.size(); i++)
+            if (kept_sites[i])
+                codes[site++] = state_codes[at(site_pattern[i])[seq_id]];
+        packCodes(codes.data(), final_length, header.bits_per_code, &packed[0]);
+        
+        string name = seq_names[seq_id];
+        name.resize(max_len, ' ');
+        out.write(name.c_str(), max_len);
+        out.write(packed.c_str(), packed.length());
+    }
+}
+
 void Alignment::printNexus(ostream &out, bool append, const char *aln_site_list,
                             int exclude_sites, const char *ref_seq_name, bool print_taxid) {
     IntVector kept_sites;
@@ -3078,10 +3445,12 @@ void Alignment::printAlignment(InputType format, const char *file_name, bool app
         ofstream out;
         out.exceptions(ios::failbit | ios::badbit);
         
+        // the packed format is binary
+        ios_base::openmode open_mode = format == IN_PACKED ? ios_base::out | ios_base::binary : ios_base::out;
         if (append)
-            out.open(file_name, ios_base::out | ios_base::app);
+            out.open(file_name, open_mode | ios_base::app);
         else
-            out.open(file_name);
+            out.open(file_name, open_mode);
         
         printAlignment(format, out, file_name, append, aln_site_list, exclude_sites, ref_seq_name);
 
@@ -3110,6 +3479,10 @@ void Alignment::printAlignment(InputType format, ostream &out, const char* file_
             formatName = "nexus";
             printNexus(out, append, aln_site_list, exclude_sites, ref_seq_name);
             break;
+        case IN_PACKED:
+            formatName = "packed";
+            printPacked(out, append, aln_site_list, exclude_sites, ref_seq_name);
+            break;
         default:
             ASSERT(0 && "Unsupported alignment output format");
     }
@@ -3688,17 +4061,28 @@ void Alignment::createBootstrapAlignment(Alignment *aln, IntVector* pattern_freq
         int added_sites = 0;
         IntVector sample;
         random_resampling(nsite, sample);
+        // patterns of aln are distinct: only the first occurrence of each pattern
+        // needs to be copied and hashed, further sites just refer to it
+        IntVector new_ptn_id(aln->getNPattern(), -1);
         for (size_t site = 0; site < nsite; ++site) {
+            if (sample[site] == 0)
+                continue;
+            int ptn_id = aln->getPatternID(site);
             for (int rep = 0; rep < sample[site]; ++rep) {
-                int ptn_id = aln->getPatternID(site);
-                Pattern pat = aln->at(ptn_id);
-                int nptn = getNPattern();
-                addPattern(pat, added_sites);
-                if (!aln->site_state_freq.empty() && getNPattern() > nptn) {
-                    // a new pattern is added, copy state frequency vector
-                    double *state_freq = new double[num_states];
-                    memcpy(state_freq, aln->site_state_freq[ptn_id], num_states*sizeof(double));
-                    site_state_freq.push_back(state_freq);
+                if (new_ptn_id[ptn_id] >= 0) {
+                    at(new_ptn_id[ptn_id]).frequency++;
+                    site_pattern[added_sites] = new_ptn_id[ptn_id];
+                } else {
+                    Pattern pat = aln->at(ptn_id);
+                    int nptn = getNPattern();
+                    addPattern(pat, added_sites);
+                    new_ptn_id[ptn_id] = site_pattern[added_sites];
+                    if (!aln->site_state_freq.empty() && getNPattern() > nptn) {
+                        // a new pattern is added, copy state frequency vector
+                        double *state_freq = new double[num_states];
+                        memcpy(state_freq, aln->site_state_freq[ptn_id], num_states*sizeof(double));
+                        site_state_freq.push_back(state_freq);
+                    }
                 }
                 if (pattern_freq) ((*pattern_freq)[ptn_id])++;
                 added_sites++;
@@ -24,6 +24,9 @@ const double MIN_FREQUENCY_DIFF     = 0.00001;
 const int NUM_CHAR = 256;
 typedef bitset<NUM_CHAR> StateBitset;
 
+class MappedAlignment;
+class progress_display;
+
 /** class storing results of symmetry tests */
 class SymTestResult {
 public:
@@ -201,6 +204,51 @@ public:
 
     int buildPattern(StrVector &sequences, char *sequence_type, int nseq, int nsite);
     
+    /**
+            check the sequence names and lengths, and initialize the sequence type before building patterns
+            @param sequence_type type of the sequence specified by users, or NULL to use the detected type
+            @param seq_lengths number of characters of each sequence
+            @param char_counts number of occurrences of each character in all sequences
+            @return TRUE if DNA sequences are translated into amino-acid sequences (NT2AA)
+     */
+    bool initPatternBuilding(char *sequence_type, int nseq, int nsite, vector<size_t> &seq_lengths, size_t *char_counts);
+    
+    /**
+            build the patterns from the characters of the sequences
+            @param sites provides getChar(seq, site), the character of a sequence at a site
+            @param nt2aa TRUE if DNA sequences are translated into amino-acid sequences
+     */
+    template <class SiteReader>
+    int buildPatternFromSites(SiteReader &sites, int nseq, int nsite, bool nt2aa);
+    
+    /**
+            build the patterns by multiple threads, each hashes a range of sites into its own table,
+            then the tables are merged in the order of the sites (thus the patterns are the same as by one thread)
+            @param step 3 for codon and NT2AA, 1 otherwise
+            @param num_gaps_only (OUT) number of sites containing only gaps or ambiguous characters
+            @param progress advanced by the sites of each merged range
+            @return FALSE if a site has an invalid character, a stop codon or an ambiguous codon,
+            which is then reported by the sequential builder
+     */
+    template <class SiteReader>
+    bool buildPatternParallel(SiteReader &sites, int nseq, int nsite, int step, bool nt2aa,
+                              char *char_to_state, char *AA_to_state, int &num_gaps_only,
+                              progress_display &progress);
+    
+    /**
+            read an alignment parsed by a memory map, the characters are copied column by column in parallel
+            @param mapped a FASTA/PHYLIP file indexed by the memory-mapped parser
+            @param sequence_type type of the sequence, either "BIN", "DNA", "AA", or NULL
+            @param shorten_names TRUE to shorten the sequence names (FASTA)
+            @return 1 on success, 0 on failure
+     */
+    int readMapped(MappedAlignment &mapped, char *sequence_type, bool shorten_names);
+    
+    /**
+            cut down the sequence names (read from a FASTA file) at the first white space if they are still unique
+     */
+    void shortenSeqNames();
+    
     /**
             do-read the alignment in PHYLIP format (interleaved)
             @param filename file name
@@ -293,6 +341,23 @@ public:
      */
     int readMSF(char *filename, char *sequence_type);
 
+    /**
+            do-read the alignment in packed format.
+            @param filename file name
+            @param sequence_type type of the sequence, either "BIN", "DNA", "AA", or NULL
+            @param sequences, nseq, nsite
+            @param packed_seq_type (OUT) the sequence type recorded in the file
+     */
+    void doReadPacked(char *filename, char *sequence_type, StrVector &sequences, int &nseq, int &nsite, string &packed_seq_type);
+
+    /**
+            read the alignment in packed format (e.g., simulated by AliSim with -af packed)
+            @param filename file name
+            @param sequence_type type of the sequence, either "BIN", "DNA", "AA", or NULL
+            @return 1 on success, 0 on failure
+     */
+    int readPacked(char *filename, char *sequence_type);
+
     /**
             extract the alignment from a nexus data block, called by readNexus()
             @param data_block data block of nexus file
@@ -335,7 +400,11 @@ public:
     /****************************************************************************
             output alignment 
      ****************************************************************************/
-    SeqType detectSequenceType(StrVector &sequences);
+    /**
+            detect the sequence type
+            @param char_counts number of occurrences of each character in all sequences
+     */
+    SeqType detectSequenceType(size_t *char_counts);
 
     void computeUnknownState();
 
@@ -395,6 +464,12 @@ public:
 
     void printNexus(ostream &out, bool append = false, const char *aln_site_list = NULL,
                     int exclude_sites = 0, const char *ref_seq_name = NULL, bool print_taxid = false);
+
+    /**
+            print the alignment in packed format: a binary header and bit-packed states of each sequence
+     */
+    void printPacked(ostream &out, bool append = false, const char *aln_site_list = NULL,
+                     int exclude_sites = 0, const char *ref_seq_name = NULL);
     /**
             Print the number of gaps per site
             @param filename output file name
@@ -666,6 +741,17 @@ public:
      @param[out] support number of sites supporting 12|34, 13|24 and 14|23
      */
     virtual void computeQuartetSupports(IntVector &quartet, vector<int64_t> &support);
+
+    /**
+     pack the informative patterns into bit planes, so that computeQuartetSupports()
+     compares 64 patterns at once; call it before computing supports of many quartets
+     */
+    virtual void buildQuartetSupportBits();
+
+    /**
+     free the bit planes of buildQuartetSupportBits()
+     */
+    virtual void clearQuartetSupportBits();
     
     /****************************************************************************
             Distance functions
@@ -1038,6 +1124,19 @@ protected:
      */
     double* cache_ntfreq = NULL;
 
+    /**
+            bit planes of informative patterns for computeQuartetSupports(): for each sequence
+            one plane of valid states and quartet_state_bits planes of state bits,
+            followed by quartet_freq_bits planes of pattern frequency bits
+     */
+    vector<uint64_t> quartet_bits;
+
+    /**
+            number of 64-bit words per bit plane, of bits per state and of bits per pattern frequency
+     */
+    size_t quartet_words = 0;
+    int quartet_state_bits = 0, quartet_freq_bits = 0;
+
 private:
     /**
         Generate a reference genome from input_sequences
@@ -0,0 +1,330 @@
+#include "mappedalignment.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if !defined(WIN32) && !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// number of sites copied together by a thread in getColumns()
+#define MAPPED_SITE_BLOCK 1024
+
+MappedAlignment::MappedAlignment()
+{
+    data = NULL;
+    size = 0;
+    memset(char_counts, 0, sizeof(char_counts));
+}
+
+MappedAlignment::~MappedAlignment()
+{
+    close();
+}
+
+void MappedAlignment::close()
+{
+#if !defined(WIN32) && !defined(_WIN32)
+    if (data)
+        munmap(data, size);
+#endif
+    data = NULL;
+    size = 0;
+}
+
+bool MappedAlignment::open(const char *filename)
+{
+#if defined(WIN32) || defined(_WIN32)
+    return false;
+#else
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size < 2)
+    {
+        ::close(fd);
+        return false;
+    }
+    void *addr = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+    data = (char*) addr;
+    size = file_stat.st_size;
+
+    // gzip-compressed files are read by the line-by-line parsers
+    return !((unsigned char) data[0] == 0x1f && (unsigned char) data[1] == 0x8b);
+#endif
+}
+
+void MappedAlignment::findLines(size_t from, char ch, vector<size_t> &line_starts)
+{
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    vector<vector<size_t> > thread_line_starts(num_threads);
+    size_t chunk_size = (size - from + num_threads - 1) / num_threads;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads)
+#endif
+    for (int thread_id = 0; thread_id < num_threads; thread_id++)
+    {
+        size_t pos = from + thread_id * chunk_size;
+        size_t chunk_end = min(size, pos + chunk_size);
+        if (pos >= chunk_end)
+            continue;
+
+        // move to the first line starting in this chunk
+        if (pos > from && data[pos - 1] != '\n')
+        {
+            const char *new_line = (const char*) memchr(data + pos, '\n', size - pos);
+            pos = new_line ? new_line - data + 1 : size;
+        }
+        while (pos < chunk_end)
+        {
+            if (ch ? data[pos] == ch : (data[pos] != '\n' && data[pos] != '\r'))
+                thread_line_starts[thread_id].push_back(pos);
+            const char *new_line = (const char*) memchr(data + pos, '\n', size - pos);
+            pos = new_line ? new_line - data + 1 : size;
+        }
+    }
+
+    line_starts.clear();
+    for (int thread_id = 0; thread_id < num_threads; thread_id++)
+        line_starts.insert(line_starts.end(), thread_line_starts[thread_id].begin(), thread_line_starts[thread_id].end());
+}
+
+size_t MappedAlignment::getLineEnd(size_t pos, size_t &next)
+{
+    const char *new_line = (const char*) memchr(data + pos, '\n', size - pos);
+    size_t end = new_line ? new_line - data : size;
+    next = new_line ? end + 1 : size;
+    while (end > pos && (unsigned char) data[end - 1] <= ' ')
+        end--;
+    return end;
+}
+
+bool MappedAlignment::countSeqChars(size_t start, size_t end, size_t *counts)
+{
+    for (size_t pos = start; pos < end; pos++)
+    {
+        unsigned char ch = data[pos];
+        // white spaces and brackets are handled by the line-by-line parsers
+        if (!(isalnum(ch) || ch == '-' || ch == '?' || ch == '.' || ch == '*' || ch == '~'))
+            return false;
+        counts[toupper(ch)]++;
+    }
+    return true;
+}
+
+bool MappedAlignment::indexFasta()
+{
+    // the first non-empty line must define a sequence name
+    size_t first = 0;
+    while (first < size && (unsigned char) data[first] <= ' ')
+        first++;
+    if (first == size || data[first] != '>' || (first > 0 && data[first - 1] != '\n'))
+        return false;
+
+    vector<size_t> starts;
+    findLines(first, '>', starts);
+    size_t num_records = starts.size();
+    seq_names.resize(num_records);
+    seq_lengths.resize(num_records);
+    records.resize(num_records);
+    vector<char> records_ok(num_records, 1);
+    memset(char_counts, 0, sizeof(char_counts));
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        size_t counts[256];
+        memset(counts, 0, sizeof(counts));
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 64)
+#endif
+        for (int64_t i = 0; i < (int64_t) num_records; i++)
+        {
+            size_t record_end = i + 1 < (int64_t) num_records ? starts[i + 1] : size;
+            size_t pos;
+            size_t name_end = getLineEnd(starts[i], pos);
+            seq_names[i] = string(data + starts[i] + 1, name_end - starts[i] - 1);
+            trimString(seq_names[i]);
+
+            // all lines but the last one must have the same width, and no empty line is allowed inside a sequence
+            Record &record = records[i];
+            record.seq_start = pos;
+            record.line_width = 0;
+            record.line_stride = 0;
+            size_t length = 0, num_lines = 0, last_width = 0;
+            bool ended = false;
+            while (pos < record_end)
+            {
+                size_t next;
+                size_t line_end = getLineEnd(pos, next);
+                size_t width = line_end - pos;
+                if (width == 0)
+                {
+                    ended = num_lines > 0;
+                    pos = next;
+                    continue;
+                }
+                if (ended || !countSeqChars(pos, line_end, counts))
+                {
+                    records_ok[i] = 0;
+                    break;
+                }
+                if (num_lines == 0)
+                {
+                    record.seq_start = pos;
+                    record.line_width = width;
+                }
+                else
+                {
+                    if (num_lines == 1)
+                        record.line_stride = pos - record.seq_start;
+                    if (last_width != record.line_width || width > record.line_width || pos != record.seq_start + num_lines * record.line_stride)
+                    {
+                        records_ok[i] = 0;
+                        break;
+                    }
+                }
+                last_width = width;
+                length += width;
+                num_lines++;
+                pos = next;
+            }
+            seq_lengths[i] = length;
+            if (length == 0)
+                records_ok[i] = 0;
+        }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        for (int ch = 0; ch < 256; ch++)
+            char_counts[ch] += counts[ch];
+    }
+
+    for (size_t i = 0; i < num_records; i++)
+        if (!records_ok[i])
+            return false;
+    return num_records > 0;
+}
+
+bool MappedAlignment::indexPhylip()
+{
+    // read the number of sequences and sites from the first non-empty line
+    size_t pos = 0, next, line_end;
+    for (; pos < size; pos = next)
+    {
+        line_end = getLineEnd(pos, next);
+        if (line_end > pos)
+            break;
+    }
+    if (pos >= size)
+        return false;
+    istringstream header(string(data + pos, line_end - pos));
+    int nseq, nsite;
+    if (!(header >> nseq >> nsite) || nseq < 3 || nsite < 1)
+        return false;
+
+    // each sequence must be on a single line
+    vector<size_t> starts;
+    findLines(next, 0, starts);
+    if (starts.size() != (size_t) nseq)
+        return false;
+    seq_names.resize(nseq);
+    seq_lengths.resize(nseq);
+    records.resize(nseq);
+    vector<char> records_ok(nseq, 1);
+    memset(char_counts, 0, sizeof(char_counts));
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        size_t counts[256];
+        memset(counts, 0, sizeof(counts));
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 64)
+#endif
+        for (int i = 0; i < nseq; i++)
+        {
+            size_t line_next;
+            size_t seq_end = getLineEnd(starts[i], line_next);
+
+            // the name ends at the first white space
+            size_t name_end = starts[i];
+            while (name_end < seq_end && data[name_end] != ' ' && data[name_end] != '\t')
+                name_end++;
+            size_t seq_start = name_end;
+            while (seq_start < seq_end && (unsigned char) data[seq_start] <= ' ')
+                seq_start++;
+            seq_names[i] = string(data + starts[i], name_end - starts[i]);
+            seq_lengths[i] = seq_end - seq_start;
+            records[i].seq_start = seq_start;
+            records[i].line_width = seq_lengths[i];
+            records[i].line_stride = 0;
+            if (name_end == seq_end || seq_lengths[i] != (size_t) nsite || !countSeqChars(seq_start, seq_end, counts))
+                records_ok[i] = 0;
+        }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        for (int ch = 0; ch < 256; ch++)
+            char_counts[ch] += counts[ch];
+    }
+
+    for (int i = 0; i < nseq; i++)
+        if (!records_ok[i])
+            return false;
+    return true;
+}
+
+void MappedAlignment::getColumns(vector<char> &columns)
+{
+    size_t nseq = records.size();
+    size_t nsite = seq_lengths[0];
+    columns.resize(nseq * nsite);
+
+    char to_upper[256];
+    for (int ch = 0; ch < 256; ch++)
+        to_upper[ch] = toupper(ch);
+
+    // each thread copies a block of sites of all sequences, thus writes a contiguous part of the columns
+    int64_t num_blocks = (nsite + MAPPED_SITE_BLOCK - 1) / MAPPED_SITE_BLOCK;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t block = 0; block < num_blocks; block++)
+    {
+        size_t site_start = block * MAPPED_SITE_BLOCK;
+        size_t site_end = min(nsite, site_start + MAPPED_SITE_BLOCK);
+        for (size_t seq = 0; seq < nseq; seq++)
+        {
+            Record &record = records[seq];
+            size_t line = site_start / record.line_width;
+            size_t col = site_start % record.line_width;
+            const char *in = data + record.seq_start + line * record.line_stride + col;
+            char *out = &columns[site_start * nseq + seq];
+            for (size_t site = site_start; site < site_end; site++, out += nseq)
+            {
+                *out = to_upper[(unsigned char) *in];
+                if (++col == record.line_width)
+                {
+                    col = 0;
+                    line++;
+                    in = data + record.seq_start + line * record.line_stride;
+                }
+                else
+                    in++;
+            }
+        }
+    }
+}
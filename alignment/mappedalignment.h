@@ -0,0 +1,101 @@
+#ifndef MAPPEDALIGNMENT_H
+#define MAPPEDALIGNMENT_H
+
+#include "utils/tools.h"
+
+/**
+    Parser of large uncompressed FASTA/PHYLIP alignments through a memory map.
+    The records are found and checked in parallel, then the sequences are copied column by column
+    (the characters of a site are contiguous) without reading the file line by line.
+    Only the common layouts are supported: FASTA records whose sequence lines have the same width,
+    and PHYLIP files with one sequence per line. Other files are left to the line-by-line parsers,
+    which report the errors.
+*/
+class MappedAlignment {
+public:
+    /** sequence names */
+    StrVector seq_names;
+
+    /** number of characters of each sequence */
+    vector<size_t> seq_lengths;
+
+    /** number of occurrences of each (upper-case) character in all sequences */
+    size_t char_counts[256];
+
+    /**
+        constructor
+     */
+    MappedAlignment();
+
+    /**
+        destructor, unmap the file
+     */
+    ~MappedAlignment();
+
+    /**
+        map a file into memory
+        @return FALSE if the file cannot be mapped, e.g., it is compressed or the OS does not support mmap
+     */
+    bool open(const char *filename);
+
+    /**
+        unmap the file
+     */
+    void close();
+
+    /**
+        find and check the FASTA records
+        @return FALSE if the layout is not supported
+     */
+    bool indexFasta();
+
+    /**
+        find and check the sequences of a PHYLIP file
+        @return FALSE if the layout is not supported, e.g., an interleaved alignment
+     */
+    bool indexPhylip();
+
+    /**
+        copy the (upper-case) characters of all sequences in column-major order
+        @param columns (OUT) character of sequence seq at site site is columns[site * #sequences + seq]
+     */
+    void getColumns(vector<char> &columns);
+
+private:
+    /**
+        position of the sequence of a record in the file.
+        The sequence is split into lines of line_width characters, which start every line_stride bytes.
+     */
+    struct Record {
+        size_t seq_start;
+        size_t line_width;
+        size_t line_stride;
+    };
+
+    /** the mapped file */
+    char *data;
+    size_t size;
+
+    vector<Record> records;
+
+    /**
+        find the starts of the lines beginning with a character (any non-empty line if ch is 0) in parallel
+        @param from position to start searching
+        @param line_starts (OUT) positions of the lines in increasing order
+     */
+    void findLines(size_t from, char ch, vector<size_t> &line_starts);
+
+    /**
+        get the end of the line starting at pos, excluding trailing white spaces
+        @param next (OUT) start of the next line
+     */
+    size_t getLineEnd(size_t pos, size_t &next);
+
+    /**
+        check and count the characters of a sequence line
+        @return FALSE if the line contains a character not supported by the mapped parser
+     */
+    bool countSeqChars(size_t start, size_t end, size_t *counts);
+};
+
+#endif
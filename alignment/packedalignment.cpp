@@ -0,0 +1,147 @@
+#include "packedalignment.h"
+
+/**
+    append an unsigned integer in little-endian
+ */
+static void appendUInt(string &str, uint64_t value, int num_bytes)
+{
+    for (int i = 0; i < num_bytes; i++, value >>= 8)
+        str.push_back((char)(value & 0xFF));
+}
+
+/**
+    read an unsigned integer in little-endian
+ */
+static uint64_t readUInt(istream &in, int num_bytes)
+{
+    unsigned char bytes[8];
+    in.read((char*)bytes, num_bytes);
+    uint64_t value = 0;
+    for (int i = num_bytes - 1; i >= 0; i--)
+        value = (value << 8) | bytes[i];
+    return value;
+}
+
+/**
+    read a string prefixed by its length
+ */
+static string readString(istream &in)
+{
+    uint32_t length = readUInt(in, 4);
+    if (length > 1024)
+        throw "Invalid packed alignment: a string in the header is too long";
+    string str(length, ' ');
+    if (length > 0)
+        in.read(&str[0], length);
+    return str;
+}
+
+PackedAlignmentHeader::PackedAlignmentHeader()
+{
+    num_seqs = 0;
+    num_sites = 0;
+    name_length = 0;
+    bits_per_code = 0;
+}
+
+PackedAlignmentHeader::PackedAlignmentHeader(uint32_t num_seqs, uint64_t num_sites, uint32_t name_length, string seq_type, StrVector &alphabet)
+{
+    this->num_seqs = num_seqs;
+    this->num_sites = num_sites;
+    this->name_length = name_length;
+    this->seq_type = seq_type;
+    this->alphabet = alphabet;
+    bits_per_code = getNumBitsPerCode(alphabet.size());
+}
+
+uint32_t PackedAlignmentHeader::getNumBitsPerCode(size_t num_codes)
+{
+    uint32_t bits = 1;
+    while (((size_t) 1 << bits) < num_codes)
+        bits++;
+    return bits;
+}
+
+uint64_t PackedAlignmentHeader::getPackedLength(uint64_t num_codes) const
+{
+    return (num_codes * bits_per_code + 7) / 8;
+}
+
+uint64_t PackedAlignmentHeader::getRecordLength() const
+{
+    return name_length + getPackedLength(num_sites);
+}
+
+string PackedAlignmentHeader::toString() const
+{
+    string str(PACKED_ALN_MAGIC, PACKED_ALN_MAGIC_LENGTH);
+    appendUInt(str, PACKED_ALN_VERSION, 4);
+    appendUInt(str, num_seqs, 4);
+    appendUInt(str, num_sites, 8);
+    appendUInt(str, name_length, 4);
+    appendUInt(str, bits_per_code, 4);
+    appendUInt(str, seq_type.length(), 4);
+    str += seq_type;
+    appendUInt(str, alphabet.size(), 4);
+    for (size_t i = 0; i < alphabet.size(); i++)
+    {
+        appendUInt(str, alphabet[i].length(), 4);
+        str += alphabet[i];
+    }
+    return str;
+}
+
+void PackedAlignmentHeader::read(istream &in)
+{
+    char magic[PACKED_ALN_MAGIC_LENGTH];
+    in.read(magic, PACKED_ALN_MAGIC_LENGTH);
+    if (memcmp(magic, PACKED_ALN_MAGIC, PACKED_ALN_MAGIC_LENGTH) != 0)
+        throw "Invalid packed alignment: wrong magic number";
+    if (readUInt(in, 4) != PACKED_ALN_VERSION)
+        throw "Unsupported version of packed alignment";
+    num_seqs = readUInt(in, 4);
+    num_sites = readUInt(in, 8);
+    name_length = readUInt(in, 4);
+    bits_per_code = readUInt(in, 4);
+    seq_type = readString(in);
+    uint32_t num_codes = readUInt(in, 4);
+    if (bits_per_code < 1 || bits_per_code > 15 || num_codes > ((uint32_t) 1 << bits_per_code))
+        throw "Invalid packed alignment: wrong number of bits per code";
+    alphabet.resize(num_codes);
+    for (uint32_t i = 0; i < num_codes; i++)
+        alphabet[i] = readString(in);
+}
+
+void packCodes(const short int *codes, size_t num_codes, uint32_t bits_per_code, char *out)
+{
+    // callers must only pass codes of the alphabet, the mask just keeps a wrong code from corrupting its neighbours
+    uint32_t mask = (1 << bits_per_code) - 1;
+    uint32_t buffer = 0;
+    uint32_t num_bits = 0;
+    for (size_t i = 0; i < num_codes; i++)
+    {
+        ASSERT(codes[i] >= 0 && ((uint32_t) codes[i]) <= mask);
+        buffer |= (((uint32_t) codes[i]) & mask) << num_bits;
+        num_bits += bits_per_code;
+        for (; num_bits >= 8; num_bits -= 8, buffer >>= 8)
+            *(out++) = (char)(buffer & 0xFF);
+    }
+    // output the last incomplete byte
+    if (num_bits > 0)
+        *out = (char)(buffer & 0xFF);
+}
+
+void unpackCodes(const char *packed, size_t num_codes, uint32_t bits_per_code, short int *codes)
+{
+    uint32_t mask = (1 << bits_per_code) - 1;
+    uint32_t buffer = 0;
+    uint32_t num_bits = 0;
+    for (size_t i = 0; i < num_codes; i++)
+    {
+        for (; num_bits < bits_per_code; num_bits += 8)
+            buffer |= ((uint32_t)(unsigned char)*(packed++)) << num_bits;
+        codes[i] = buffer & mask;
+        buffer >>= bits_per_code;
+        num_bits -= bits_per_code;
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef PACKEDALIGNMENT_H
+#define PACKEDALIGNMENT_H
+
+#include "utils/tools.h"
+
+/** magic bytes at the beginning of a packed alignment file */
+#define PACKED_ALN_MAGIC "\x89IQPACK\n"
+#define PACKED_ALN_MAGIC_LENGTH 8
+#define PACKED_ALN_VERSION 1
+
+/**
+    header of a packed alignment file.
+    The header is followed by num_seqs fixed-length records, each consists of a taxon name (padded to name_length bytes)
+    and the codes of num_sites sites, packed into bits_per_code bits each (the first code takes the lowest bits of the first byte).
+    A code is the index of a symbol (a character, or three characters for codons) in the alphabet.
+    All integers are stored in little-endian.
+*/
+class PackedAlignmentHeader {
+public:
+    /** number of sequences */
+    uint32_t num_seqs;
+
+    /** number of sites (codons for codon data) of each sequence */
+    uint64_t num_sites;
+
+    /** length of the taxon name of each record */
+    uint32_t name_length;
+
+    /** number of bits of each code */
+    uint32_t bits_per_code;
+
+    /** sequence type, e.g., DNA, AA, CODON */
+    string seq_type;
+
+    /** symbols of the codes */
+    StrVector alphabet;
+
+    /**
+        constructor
+     */
+    PackedAlignmentHeader();
+
+    /**
+        constructor
+        @param alphabet symbols of the codes, bits_per_code is determined from the size of the alphabet
+     */
+    PackedAlignmentHeader(uint32_t num_seqs, uint64_t num_sites, uint32_t name_length, string seq_type, StrVector &alphabet);
+
+    /**
+        @return the number of bits to store a code of an alphabet with num_codes symbols
+     */
+    static uint32_t getNumBitsPerCode(size_t num_codes);
+
+    /**
+        @return the number of bytes to store num_codes packed codes
+     */
+    uint64_t getPackedLength(uint64_t num_codes) const;
+
+    /**
+        @return the length of a record (taxon name and packed sequence)
+     */
+    uint64_t getRecordLength() const;
+
+    /**
+        @return the serialized header
+     */
+    string toString() const;
+
+    /**
+        read the header from a stream
+        @throw an error message if the stream is not a packed alignment
+     */
+    void read(istream &in);
+};
+
+/**
+    pack codes into bytes
+    @param codes codes, each must be smaller than 2^bits_per_code
+    @param out output array with at least ceil(num_codes * bits_per_code / 8) bytes
+ */
+void packCodes(const short int *codes, size_t num_codes, uint32_t bits_per_code, char *out);
+
+/**
+    unpack codes from bytes
+    @param packed packed codes
+    @param codes output array with at least num_codes elements
+ */
+void unpackCodes(const char *packed, size_t num_codes, uint32_t bits_per_code, short int *codes);
+
+#endif
@@ -6,7 +6,6 @@ Sequence::Sequence() {
     num_threads_done_simulation = 0;
     num_threads_reach_barrier = 0;
     num_gaps = 0;
-    depth = 0;
     insertion_pos = NULL;
     parent = NULL;
 }
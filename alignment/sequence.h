@@ -44,11 +44,6 @@ public:
         number of gaps in the sequence
      */
     int num_gaps;
-    
-    /**
-        depth of the current node
-     */
-    int depth;
 
     /**
         constructor
@@ -258,6 +258,16 @@ public:
      @param[out] support number of sites supporting 12|34, 13|24 and 14|23
      */
     virtual void computeQuartetSupports(IntVector &quartet, vector<int64_t> &support);
+
+    /**
+     pack the informative patterns of all partitions into bit planes
+     */
+    virtual void buildQuartetSupportBits();
+
+    /**
+     free the bit planes of buildQuartetSupportBits()
+     */
+    virtual void clearQuartetSupportBits();
     
 	/**
 		@return unconstrained log-likelihood (without a tree)
@@ -582,6 +582,28 @@ void generateMultipleAlignmentsFromSingleTree(AliSimulator *super_alisimulator,
     if (super_alisimulator->params->alisim_single_output && super_alisimulator->params->alisim_dataset_num == 1)
             super_alisimulator->params->alisim_single_output = false;
     
+    // the packed format is only supported if sequences are written out directly after being simulated
+    if (super_alisimulator->params->aln_output_format == IN_PACKED)
+    {
+        if (super_alisimulator->tree->isSuperTree()
+            || super_alisimulator->params->alisim_insertion_ratio + super_alisimulator->params->alisim_deletion_ratio > 0
+            || (super_alisimulator->tree->getModelFactory() && super_alisimulator->tree->getModelFactory()->getASC() != ASC_NONE)
+            || super_alisimulator->params->alisim_fundi_taxon_set.size() > 0
+            || super_alisimulator->params->alisim_single_output)
+        {
+            outWarning("The packed output format is not supported with partitions, Indels, +ASC, FunDi, or a single output file. AliSim will output the alignment in PHYLIP format.");
+            Params::getInstance().aln_output_format = IN_PHYLIP;
+            super_alisimulator->params->aln_output_format = IN_PHYLIP;
+        }
+        // records of the packed format are written at fixed positions, which requires AliSim-OpenMP-IM with multiple threads
+        else if (super_alisimulator->params->alisim_openmp_alg == EM && super_alisimulator->params->num_threads != 1)
+        {
+            outWarning("The packed output format is not supported by AliSim-OpenMP-EM algorithm. AliSim will use AliSim-OpenMP-IM algorithm instead.");
+            Params::getInstance().alisim_openmp_alg = IM;
+            super_alisimulator->params->alisim_openmp_alg = IM;
+        }
+    }
+    
     // don't allow --no-merge and --single-output
     if (super_alisimulator->params->alisim_openmp_alg == EM && super_alisimulator->params->alisim_single_output && super_alisimulator->params->no_merge)
     {
@@ -598,6 +620,16 @@ void generateMultipleAlignmentsFromSingleTree(AliSimulator *super_alisimulator,
     }
 #endif
     
+    // simulate the alignments concurrently if the user wants to do so
+    if (super_alisimulator->params->alisim_parallel_alignments && super_alisimulator->params->alisim_dataset_num > 1
+        && generateMultipleAlignmentsInParallel(super_alisimulator, ancestral_sequence, input_msa))
+    {
+        // output full tree (with internal node names) if outputting internal sequences
+        if (super_alisimulator->params->alisim_write_internal_sequences)
+            outputTreeWithInternalNames(super_alisimulator);
+        return;
+    }
+    
     // the output format of the simulated alignment
     InputType actual_output_format = super_alisimulator->params->aln_output_format;
     vector<SeqType> seqtypes;
@@ -627,6 +659,10 @@ void generateMultipleAlignmentsFromSingleTree(AliSimulator *super_alisimulator,
         // record the alignment_id to generate different random seed when simulating different alignment
         super_alisimulator->params->alignment_id = i;
         
+        // with the counter-based RNG, the other draws also do not depend on the MPI process simulating the alignment
+        if (super_alisimulator->params->alisim_counter_rng)
+            initAlignmentRandomStream(super_alisimulator->params->ran_seed, i);
+        
         // output the simulated aln at the current execution localtion
         string output_filepath = super_alisimulator->params->alisim_output_filename;
         
@@ -754,6 +790,12 @@ void generateMultipleAlignmentsFromSingleTree(AliSimulator *super_alisimulator,
         if (super_alisimulator->params->alisim_insertion_ratio + super_alisimulator->params->alisim_deletion_ratio > 0)
             remove((super_alisimulator->params->alisim_output_filename + "_" + super_alisimulator->params->tmp_data_filename + "_" + convertIntToString(MPIHelper::getInstance().getProcessID())).c_str());
         
+        if (thread_randstream)
+        {
+            finish_random(thread_randstream);
+            thread_randstream = NULL;
+        }
+        
         // if users want to output Maple format -> convert PHY into MAPLE and delete PHY
         if (actual_output_format == IN_MAPLE)
         {
@@ -803,6 +845,132 @@ void generateMultipleAlignmentsFromSingleTree(AliSimulator *super_alisimulator,
         outputTreeWithInternalNames(super_alisimulator);
 }
 
+/**
+*  get the tree (with branch lengths) and the model parameters of a simulator, to check whether two simulators are identical
+*/
+string getTreeAndModelParams(AliSimulator *alisimulator)
+{
+    ostringstream out;
+    alisimulator->tree->printTree(out);
+    out << alisimulator->tree->getModelNameParams(true);
+    return out.str();
+}
+
+/**
+*  draw the random numbers of the current thread from a stream of an alignment
+*/
+void initAlignmentRandomStream(int ran_seed, int alignment_id)
+{
+    // the seed is kept apart from the seeds of the per-site streams (ran_seed + alignment_id)
+    int dataset_seed = (int) (((unsigned int) ran_seed + 1000003U * (unsigned int) (alignment_id + 1)) & 0x7FFFFFFF);
+    init_random(dataset_seed, false, &thread_randstream);
+}
+
+// silence cout while in scope, also when leaving the scope by an exception
+class CoutSilencer {
+public:
+    CoutSilencer() { cout.setstate(ios_base::failbit); }
+    ~CoutSilencer() { cout.clear(); }
+};
+
+/**
+*  simulate multiple alignments concurrently, each by a single thread with its own simulator and random stream
+*/
+bool generateMultipleAlignmentsInParallel(AliSimulator *super_alisimulator, vector<short int> &ancestral_sequence, map<string,string> input_msa)
+{
+    Params *params = super_alisimulator->params;
+    
+    // only support simulations that write each alignment out immediately from a single tree and model
+    if (super_alisimulator->tree->isSuperTree()
+        || params->alisim_insertion_ratio + params->alisim_deletion_ratio > 0
+        || (super_alisimulator->tree->getModelFactory() && super_alisimulator->tree->getModelFactory()->getASC() != ASC_NONE)
+        || params->alisim_fundi_taxon_set.size() > 0
+        || params->alisim_single_output
+        || params->aln_output_format == IN_MAPLE
+        || params->alisim_inference_mode
+        || params->delete_output)
+    {
+        outWarning("Ignore --parallel-alignments option since it is not supported with partitions, Indels, +ASC, FunDi, inference mode, Maple format, or a single output file.");
+        return false;
+    }
+    
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    
+    // initialize the tree, the model, and the parameters once per thread; the first thread reuses the super simulator
+    vector<Params> thread_params(num_threads, *params);
+    vector<AliSimulator*> simulators(num_threads, super_alisimulator);
+    string tree_and_model_params = getTreeAndModelParams(super_alisimulator);
+    bool identical_simulators = true;
+    {
+        // silence the warnings that were already shown when loading the super simulator
+        CoutSilencer silencer;
+        for (int thread_id = 1; thread_id < num_threads && identical_simulators; thread_id++)
+        {
+            simulators[thread_id] = new AliSimulator(&thread_params[thread_id]);
+            // randomly generated branch lengths or model parameters may differ among the reloaded trees and models
+            identical_simulators = getTreeAndModelParams(simulators[thread_id]) == tree_and_model_params;
+        }
+    }
+    if (!identical_simulators)
+        outWarning("Ignore --parallel-alignments option since the branch lengths or the model parameters are randomly generated.");
+    
+    if (identical_simulators)
+    {
+        // datasets are distributed over MPI ranks statically, then over threads dynamically
+        IntVector dataset_ids;
+        int proc_ID = MPIHelper::getInstance().getProcessID();
+        int nprocs  = MPIHelper::getInstance().getNumProcesses();
+        for (int i = 0; i < params->alisim_dataset_num; i++)
+            if (i%nprocs == proc_ID)
+                dataset_ids.push_back(i);
+        
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic)
+        #endif
+        for (int k = 0; k < dataset_ids.size(); k++)
+        {
+            int thread_id = 0;
+            #ifdef _OPENMP
+            thread_id = omp_get_thread_num();
+            #endif
+            AliSimulator *alisimulator = simulators[thread_id];
+            int i = dataset_ids[k];
+            
+            // record the alignment_id to generate different random seed when simulating different alignment
+            alisimulator->params->alignment_id = i;
+            
+            // draw from a stream of this alignment instead of the global one, so that it does not depend on the thread simulating it
+            initAlignmentRandomStream(params->ran_seed, i);
+            
+            string output_filepath = params->alisim_output_filename + "_" + convertIntToString(i + 1);
+            generatePartitionAlignmentFromSingleSimulator(alisimulator, ancestral_sequence, input_msa, output_filepath);
+            
+            finish_random(thread_randstream);
+            thread_randstream = NULL;
+        }
+        
+        // report model's parameters
+        reportSubstitutionProcess(cout, *params, *(super_alisimulator->tree));
+        // show omega/kappa/kappa2 when using codon models
+        if (super_alisimulator->tree->aln->seq_type == SEQ_CODON)
+            super_alisimulator->tree->getModel()->writeInfo(cout);
+    }
+    
+    // delete the simulators of other threads
+    for (int thread_id = 1; thread_id < num_threads; thread_id++)
+        if (simulators[thread_id] != super_alisimulator)
+        {
+            if (simulators[thread_id]->tree) delete simulators[thread_id]->tree;
+            if (simulators[thread_id]->first_insertion) delete simulators[thread_id]->first_insertion;
+            delete simulators[thread_id];
+        }
+    
+    return identical_simulators;
+}
+
 /**
     copy sequences of leaves from a partition tree to super_tree
 */
@@ -54,6 +54,18 @@ void retrieveAncestralSequenceFromInputFile(AliSimulator *super_alisimulator, ve
 */
 void generateMultipleAlignmentsFromSingleTree(AliSimulator *super_alisimulator, map<string,string> input_msa);
 
+/**
+*  draw the random numbers of the current thread from a stream of an alignment, so that they do not depend on
+*  the thread or the MPI process simulating it; the stream is freed by finish_random(thread_randstream)
+*/
+void initAlignmentRandomStream(int ran_seed, int alignment_id);
+
+/**
+*  simulate multiple alignments concurrently, each by a single thread with its own simulator and random stream
+*  @return false if it is not supported for the current simulation (nothing is simulated)
+*/
+bool generateMultipleAlignmentsInParallel(AliSimulator *super_alisimulator, vector<short int> &ancestral_sequence, map<string,string> input_msa);
+
 /**
 *  generate a partition alignment from a single simulator
 */
@@ -1240,6 +1240,17 @@ void calcDistribution(Params &params) {
     }
 }
 
+void printRFDistCSVHeader(ostream &out, string filename) {
+    out << "# Robinson-Foulds distances" << endl
+    << "# This file can be read in MS Excel or in R with command:" << endl
+    << "#    dat=read.csv('" <<  filename << "',comment.char='#')" << endl
+    << "# Columns are comma-separated with following meanings:" << endl
+    << "#    ID1:     Tree 1 ID" << endl
+    << "#    ID2:     Tree 2 ID" << endl
+    << "#    Dist:    Robinson-Foulds distance" << endl
+    << "ID1,ID2,Dist" << endl;
+}
+
 void printRFDist(string filename, double *rfdist, int n, int m, int rf_dist_mode, bool print_msg = true) {
     int i, j;
 
@@ -1248,14 +1259,7 @@ void printRFDist(string filename, double *rfdist, int n, int m, int rf_dist_mode
         out.exceptions(ios::failbit | ios::badbit);
         out.open(filename);
         if (Params::getInstance().output_format == FORMAT_CSV) {
-            out << "# Robinson-Foulds distances" << endl
-            << "# This file can be read in MS Excel or in R with command:" << endl
-            << "#    dat=read.csv('" <<  filename << "',comment.char='#')" << endl
-            << "# Columns are comma-separated with following meanings:" << endl
-            << "#    ID1:     Tree 1 ID" << endl
-            << "#    ID2:     Tree 2 ID" << endl
-            << "#    Dist:    Robinson-Foulds distance" << endl
-            << "ID1,ID2,Dist" << endl;
+            printRFDistCSVHeader(out, filename);
             if (rf_dist_mode == RF_ADJACENT_PAIR) {
                 for (i = 0; i < n; i++)
                     out << i+1 << ',' << i+2 << ',' << rfdist[i] << endl;
@@ -1292,6 +1296,66 @@ void printRFDist(string filename, double *rfdist, int n, int m, int rf_dist_mode
     }
 }
 
+/**
+ * print the rows of the RF distances of a tile of trees computed by SplitIDIndex::computeRFDist()
+ */
+void printRFDistRows(ostream &out, IntVector &dist, int first_tree, int num_trees, int n, bool csv) {
+    for (int k = 0; k < num_trees; k++) {
+        int i = first_tree + k;
+        if (!csv)
+            out << "Tree" << i << "      ";
+        for (int j = 0; j < n; j++) {
+            if (csv)
+                out << i+1 << ',' << j+1 << ',' << dist[(size_t)k*n + j] << endl;
+            else
+                out << " " << dist[(size_t)k*n + j];
+        }
+        if (!csv)
+            out << endl;
+    }
+}
+
+/**
+ * compute all-pairs RF distances with SplitIDIndex in parallel over tiles of RF_TILE trees,
+ * the rows of a tile are printed as soon as the tiles before it are printed
+ */
+void printAllRFDist(string filename, MTreeSet &trees, double weight_threshold) {
+    cout << "Computing Robinson-Foulds distance..." << endl;
+    SplitIDIndex index(trees, weight_threshold);
+    int n = index.getNTrees();
+    int ntiles = (n + RF_TILE - 1) / RF_TILE;
+    try {
+        ofstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(filename);
+        bool csv = (Params::getInstance().output_format == FORMAT_CSV);
+        if (csv)
+            printRFDistCSVHeader(out, filename);
+        else
+            out << n << " " << n << endl;
+        // exceptions cannot leave the parallel loop, a write error is thrown when they are enabled again
+        out.exceptions(ios::goodbit);
+#ifdef _OPENMP
+#pragma omp parallel for ordered schedule(dynamic)
+#endif
+        for (int tile = 0; tile < ntiles; tile++) {
+            int first_tree = tile * RF_TILE;
+            int num_trees = min(RF_TILE, n - first_tree);
+            IntVector dist;
+            index.computeRFDist(first_tree, num_trees, dist);
+#ifdef _OPENMP
+#pragma omp ordered
+#endif
+            printRFDistRows(out, dist, first_tree, num_trees, n, csv);
+        }
+        out.exceptions(ios::failbit | ios::badbit);
+        out.close();
+        cout << "Robinson-Foulds distances printed to " << filename << endl;
+    } catch (ios::failure) {
+        outError(ERR_WRITE_OUTPUT, filename);
+    }
+}
+
 void computeRFDistExtended(const char *trees1, const char *trees2, const char *filename) {
     cout << "Reading input trees 1 file " << trees1 << endl;
     int ntrees = 0, ntrees2 = 0;
@@ -1403,6 +1467,10 @@ void computeRFDist(Params &params) {
     }
 
     MTreeSet trees(params.user_file, params.is_rooted, params.tree_burnin, params.tree_max_count);
+    if (params.rf_dist_mode == RF_ALL_PAIR && trees.equal_taxon_set) {
+        printAllRFDist(filename, trees, params.split_weight_threshold);
+        return;
+    }
     int n = trees.size(), m = trees.size();
     double *rfdist;
     double *incomp_splits = NULL;
@@ -63,11 +63,6 @@
 #include "utils/MPIHelper.h"
 #include "timetree.h"
 
-#ifdef USE_BOOSTER
-extern "C" {
-#include "booster/booster.h"
-}
-#endif
 
 #ifdef IQTREE_TERRAPHAST
     #include "terracetphast/terracetphast.h"
@@ -956,7 +951,8 @@ void printOutfilesInfo(Params &params, IQTree &tree) {
                 << endl;
 
     if (params.print_ancestral_sequence) {
-        cout << "  Ancestral state:               " << params.out_prefix << ".state" << endl;
+        cout << "  Ancestral state:               " << params.out_prefix << ".state"
+             << (params.do_compression ? ".gz" : "") << endl;
 //        cout << "  Ancestral sequences:           " << params.out_prefix << ".aseq" << endl;
     }
 
@@ -3656,7 +3652,6 @@ void runStandardBootstrap(Params &params, Alignment *alignment, IQTree *tree) {
     } else
         cout << endl;
 
-#ifdef USE_BOOSTER
     if (params.transfer_bootstrap) {
         // transfer bootstrap expectation (TBE)
         cout << "Performing transfer bootstrap expectation..." << endl;
@@ -3665,16 +3660,15 @@ void runStandardBootstrap(Params &params, Alignment *alignment, IQTree *tree) {
         string out_tree = (string)params.out_prefix + ".tbe.tree";
         string out_raw_tree = (string)params.out_prefix + ".tbe.rawtree";
         string stat_out = (string)params.out_prefix + ".tbe.stat";
-        main_booster(input_tree.c_str(), boot_trees.c_str(), out_tree.c_str(),
+        computeTransferBootstrap(input_tree.c_str(), boot_trees.c_str(), out_tree.c_str(),
                      (params.transfer_bootstrap==2) ? out_raw_tree.c_str() : NULL,
-                     stat_out.c_str(), (verbose_mode >= VB_MED) ? 0 : 1);
+                     stat_out.c_str());
         cout << "TBE tree written to " << out_tree << endl;
         if (params.transfer_bootstrap == 2)
             cout << "TBE raw tree written to " << out_raw_tree << endl;
         cout << "TBE statistic written to " << stat_out << endl;
         cout << endl;
     }
-#endif
     
     if (MPIHelper::getInstance().isMaster()) {
         cout << "Total CPU time for " << RESAMPLE_NAME << ": " << (getCPUTime() - start_time) << " seconds." << endl;
@@ -4711,6 +4705,14 @@ void assignBootstrapSupport(const char *input_trees, int burnin, int max_count,
             leaf->id = i;
         }
         scale /= sg.maxWeight();
+    } else if (params->stream_trees && !params->support_tag) {
+        // tags need the trees, so they are only supported without streaming
+        myrooted = rooted;
+        boot_trees.convertSplitsStreaming(input_trees, myrooted, burnin, max_count,
+                        tree_weight_file, taxname, sg, hash_ss, SW_COUNT, -1);
+        if (mytree.rooted != myrooted)
+            outError("Target tree and tree set have different rooting");
+        scale /= boot_trees.sumTreeWeights();
     } else {
         myrooted = rooted;
         boot_trees.init(input_trees, myrooted, burnin, max_count,
@@ -4773,6 +4775,61 @@ void assignBootstrapSupport(const char *input_trees, int burnin, int max_count,
     */
 }
 
+void computeTransferBootstrap(const char *target_tree, const char *input_trees, const char *out_tree,
+        const char *out_raw_tree, const char *stat_out) {
+    MTree mytree;
+    bool rooted = false;
+    mytree.init(target_tree, rooted);
+    rooted = false;
+    MTreeSet boot_trees(input_trees, rooted, 0, INT_MAX, NULL);
+
+    BranchVector branches;
+    IntVector sum_dist, depth;
+    DoubleVector transfer_index;
+    mytree.computeTransferDistances(boot_trees, branches, sum_dist, depth,
+                                    stat_out ? &transfer_index : NULL);
+    int ntrees = boot_trees.size();
+    int i;
+    DoubleVector avg_dist(branches.size(), 0.0);
+    if (ntrees > 0)
+        for (i = 0; i < branches.size(); i++)
+            avg_dist[i] = ((double)sum_dist[i]) / ntrees;
+
+    if (out_raw_tree) {
+        for (i = 0; i < branches.size(); i++) {
+            stringstream ss;
+            ss << i << "|" << fixed << setprecision(6) << avg_dist[i] << "|" << depth[i];
+            branches[i].second->name = ss.str();
+        }
+        mytree.printTree(out_raw_tree);
+    }
+    for (i = 0; i < branches.size(); i++) {
+        stringstream ss;
+        ss << fixed << setprecision(6) << 1.0 - avg_dist[i] / (depth[i] - 1.0);
+        branches[i].second->name = ss.str();
+    }
+    mytree.printTree(out_tree);
+
+    if (!stat_out)
+        return;
+    try {
+        ofstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(stat_out);
+        out << "EdgeId\tDepth\tMeanMinDist" << endl << fixed << setprecision(6);
+        for (i = 0; i < branches.size(); i++)
+            out << i << "\t" << depth[i] << "\t" << avg_dist[i] << endl;
+        vector<string> taxname(mytree.leafNum);
+        mytree.getTaxaName(taxname);
+        out << "Taxon\ttIndex" << endl;
+        for (i = 0; i < taxname.size(); i++)
+            out << taxname[i] << "\t" << transfer_index[i] << endl;
+        out.close();
+    } catch (ios::failure) {
+        outError(ERR_WRITE_OUTPUT, stat_out);
+    }
+}
+
 void computeConsensusTree(const char *input_trees, int burnin, int max_count,
         double cutoff, double weight_threshold, const char *output_tree,
         const char *out_prefix, const char *tree_weight_file, Params *params) {
@@ -4829,6 +4886,13 @@ void computeConsensusTree(const char *input_trees, int burnin, int max_count,
          leaf->id = i;
          }*/
         scale /= sg.maxWeight();
+    } else if (params->stream_trees) {
+        vector<string> taxname;
+        boot_trees.convertSplitsStreaming(input_trees, rooted, burnin, max_count,
+                tree_weight_file, taxname, sg, hash_ss, SW_COUNT, weight_threshold);
+        boot_trees.discardSplits(sg, hash_ss, cutoff);
+        scale /= boot_trees.sumTreeWeights();
+        cout << sg.size() << " splits found" << endl;
     } else {
         boot_trees.init(input_trees, rooted, burnin, max_count,
                 tree_weight_file);
@@ -4912,15 +4976,21 @@ void computeConsensusNetwork(const char *input_trees, int burnin, int max_count,
         double cutoff, int weight_summary, double weight_threshold, const char *output_tree,
         const char *out_prefix, const char* tree_weight_file) {
     bool rooted = false;
-
-    // read the bootstrap tree file
-    MTreeSet boot_trees(input_trees, rooted, burnin, max_count,
-            tree_weight_file);
-
+    MTreeSet boot_trees;
     SplitGraph sg;
     //SplitIntMap hash_ss;
 
-    boot_trees.convertSplits(sg, cutoff, weight_summary, weight_threshold);
+    if (Params::getInstance().stream_trees) {
+        vector<string> taxname;
+        SplitIntMap hash_ss;
+        boot_trees.convertSplitsStreaming(input_trees, rooted, burnin, max_count,
+                tree_weight_file, taxname, sg, hash_ss, weight_summary, weight_threshold);
+        boot_trees.discardSplits(sg, hash_ss, cutoff);
+    } else {
+        // read the bootstrap tree file
+        boot_trees.init(input_trees, rooted, burnin, max_count, tree_weight_file);
+        boot_trees.convertSplits(sg, cutoff, weight_summary, weight_threshold);
+    }
 
     string out_file;
 
@@ -69,6 +69,17 @@ void assignBootstrapSupport(const char *input_trees, int burnin, int max_count,
 	bool rooted, const char *output_tree, const char *out_prefix, MExtTree &mytree, 
 	const char* tree_weight_file, Params *params);
 
+/**
+ * compute transfer bootstrap expectation (TBE) of branches of a target tree from a set of trees
+ * @param target_tree file containing the target tree
+ * @param input_trees file containing NEWICK tree strings
+ * @param out_tree file to write the target tree with TBE values
+ * @param out_raw_tree if not NULL, file to write the target tree with "id|avgdist|depth" per branch
+ * @param stat_out if not NULL, file to write average distance per branch and transfer index per taxon
+ */
+void computeTransferBootstrap(const char *target_tree, const char *input_trees, const char *out_tree,
+	const char *out_raw_tree, const char *stat_out);
+
 /**
  * assign branch supports from params.user_tree trees file to params.second_tree
  * @param params program parameters
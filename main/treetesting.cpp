@@ -18,6 +18,7 @@
 #include "tree/iqtreemix.h"
 #include "gsl/mygsl.h"
 #include "utils/timeutil.h"
+#include "utils/gzstream.h"
 
 
 void printSiteLh(const char*filename, PhyloTree *tree, double *ptn_lh,
@@ -218,12 +219,18 @@ void printAncestralSequences(const char *out_prefix, PhyloTree *tree, AncestralS
     //    }
     
     string filename = (string)out_prefix + ".state";
+    if (tree->params->do_compression)
+        filename += ".gz";
     //    string filenameseq = (string)out_prefix + ".stateseq";
     
     try {
-        ofstream out;
+        unique_ptr<ostream> out_ptr;
+        if (tree->params->do_compression)
+            out_ptr.reset(new ogzstream(filename.c_str()));
+        else
+            out_ptr.reset(new ofstream(filename.c_str()));
+        ostream &out = *out_ptr;
         out.exceptions(ios::failbit | ios::badbit);
-        out.open(filename.c_str());
         out.setf(ios::fixed, ios::floatfield);
         out.precision(5);
         
@@ -246,7 +253,7 @@ void printAncestralSequences(const char *out_prefix, PhyloTree *tree, AncestralS
         
         out << "# Ancestral state reconstruction for all nodes in " << tree->params->out_prefix << ".treefile" << endl
         << "# This file can be read in MS Excel or in R with command:" << endl
-        << "#   tab=read.table('" <<  tree->params->out_prefix << ".state',header=TRUE)" << endl
+        << "#   tab=read.table('" <<  filename << "',header=TRUE)" << endl
         << "# Columns are tab-separated with following meaning:" << endl
         << "#   Node:  Node name in the tree" << endl;
         if (tree->isSuperTree()) {
@@ -310,7 +317,10 @@ void printAncestralSequences(const char *out_prefix, PhyloTree *tree, AncestralS
         
         tree->endMarginalAncestralState(orig_kernel_nonrev, marginal_ancestral_prob, marginal_ancestral_seq);
         
-        out.close();
+        if (tree->params->do_compression)
+            ((ogzstream*)out_ptr.get())->close();
+        else
+            ((ofstream*)out_ptr.get())->close();
         //        outseq.close();
         cout << "Ancestral state probabilities printed to " << filename << endl;
         //        cout << "Ancestral sequences printed to " << filenameseq << endl;
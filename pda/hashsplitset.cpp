@@ -71,3 +71,20 @@ void SplitIntMap::buildMap(SplitGraph &sg, bool use_index) {
             insertSplit(sg[i], sg[i]->getWeight());
     }
 }
+
+/** one step of the splitmix64 generator, independent of the global random stream */
+static uint64_t splitmix64(uint64_t &state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void initSplitFingerprintKeys(int ntaxa, vector<SplitFingerprint> &taxon_key) {
+    uint64_t state = 0x5EED5EED5EED5EEDULL;
+    taxon_key.resize(ntaxa);
+    for (int i = 0; i < ntaxa; i++) {
+        taxon_key[i].lo = splitmix64(state);
+        taxon_key[i].hi = splitmix64(state);
+    }
+}
@@ -43,6 +43,42 @@ struct hashfunc_Split {
 };
 #endif // USE_HASH_MAP
 
+/**
+	128-bit fingerprint of a split: XOR of the random keys of the taxa in the split.
+	Identifies a split without materializing its bit-vector
+*/
+struct SplitFingerprint {
+	uint64_t lo, hi;
+
+	SplitFingerprint() : lo(0), hi(0) {}
+
+	SplitFingerprint &operator^=(const SplitFingerprint &fp) {
+		lo ^= fp.lo;
+		hi ^= fp.hi;
+		return *this;
+	}
+
+	bool operator==(const SplitFingerprint &fp) const {
+		return lo == fp.lo && hi == fp.hi;
+	}
+};
+
+/**
+	hash function of SplitFingerprint, the fingerprint is already random
+*/
+struct hashfunc_SplitFingerprint {
+	size_t operator()(const SplitFingerprint &fp) const {
+		return (size_t)(fp.lo ^ (fp.hi >> 1));
+	}
+};
+
+/**
+	compute the fingerprint keys of taxa, deterministic for the same number of taxa
+	@param ntaxa number of taxa
+	@param taxon_key (OUT) random key of each taxon
+*/
+void initSplitFingerprintKeys(int ntaxa, vector<SplitFingerprint> &taxon_key);
+
 namespace std {
 	/**
 		Define equal_to of two splits, used for hash_set (or hash_map) template
@@ -532,7 +532,10 @@ void AliSimulator::generatePartitionAlignment(vector<short int> &ancestral_seque
     // if the ancestral sequence is not specified, randomly generate the sequence
     if (ancestral_sequence.size() == 0)
     {
-        generateRandomSequence(expected_num_sites, tree->MTree::root->sequence->sequence_chunks[0]);
+        // draw the root states from the counter-based RNG if needed
+        vector<double> random_numbers;
+        double *site_random_numbers = generateSiteRandomNumbers(CounterRNG::ROOT_STATE_STREAM, 0, expected_num_sites, random_numbers);
+        generateRandomSequence(expected_num_sites, tree->MTree::root->sequence->sequence_chunks[0], true, site_random_numbers);
         
         // check to regenerate the root sequence if the user has specified specific frequencies for root
         NeighborVec::iterator it;
@@ -540,7 +543,7 @@ void AliSimulator::generatePartitionAlignment(vector<short int> &ancestral_seque
         Node* dad = tree->root;
         FOR_NEIGHBOR(node, dad, it) {
             if ((*it)->attributes.find("freqs") != (*it)->attributes.end())
-                regenerateRootSequenceBranchSpecificModel((*it)->attributes["freqs"], expected_num_sites, tree->MTree::root->sequence->sequence_chunks[0]);
+                regenerateRootSequenceBranchSpecificModel((*it)->attributes["freqs"], expected_num_sites, tree->MTree::root->sequence->sequence_chunks[0], site_random_numbers);
         }
     }
     // otherwise, using the ancestral sequence + abundant sites
@@ -554,7 +557,8 @@ void AliSimulator::generatePartitionAlignment(vector<short int> &ancestral_seque
         if (num_abundant_sites > 0)
         {
             vector<short int> abundant_sites;
-            generateRandomSequence(num_abundant_sites, abundant_sites);
+            vector<double> random_numbers;
+            generateRandomSequence(num_abundant_sites, abundant_sites, true, generateSiteRandomNumbers(CounterRNG::ROOT_STATE_STREAM, ancestral_sequence.size(), num_abundant_sites, random_numbers));
             for (int site:abundant_sites)
                 tree->MTree::root->sequence->sequence_chunks[0].push_back(site);
         }
@@ -631,7 +635,7 @@ void AliSimulator::createVariantStateMask(vector<short int> &variant_state_mask,
 *  randomly generate the ancestral sequence for the root node
 *  by default (initial_freqs = true) freqs could be randomly generated if they are not specified
 */
-void AliSimulator::generateRandomSequence(int sequence_length, vector<short int> &sequence, bool initial_freqs)
+void AliSimulator::generateRandomSequence(int sequence_length, vector<short int> &sequence, bool initial_freqs, double *site_random_numbers)
 {
     // if the Frequency Type is FREQ_EQUAL -> randomly generate each site in the sequence follows the normal distribution
     if (tree->getModel()->getFreqType() == FREQ_EQUAL)
@@ -639,8 +643,14 @@ void AliSimulator::generateRandomSequence(int sequence_length, vector<short int>
         // initialize sequence
         sequence.resize(sequence_length);
         
-        for (int i = 0; i < sequence_length; i++)
-            sequence[i] =  random_int(max_num_states);
+        if (site_random_numbers)
+        {
+            for (int i = 0; i < sequence_length; i++)
+                sequence[i] = min((int)(site_random_numbers[i] * max_num_states), max_num_states - 1);
+        }
+        else
+            for (int i = 0; i < sequence_length; i++)
+                sequence[i] =  random_int(max_num_states);
     }
     else // otherwise, randomly generate each site in the sequence follows the base frequencies defined by the user
     {
@@ -660,7 +670,7 @@ void AliSimulator::generateRandomSequence(int sequence_length, vector<short int>
                 max_prob_pos = i;
         
         // randomly generate the sequence based on the state frequencies
-        generateRandomSequenceFromStateFreqs(sequence_length, sequence, state_freq, max_prob_pos);
+        generateRandomSequenceFromStateFreqs(sequence_length, sequence, state_freq, max_prob_pos, site_random_numbers);
         
         // delete state_freq
         delete []  state_freq;
@@ -730,55 +740,59 @@ void AliSimulator::simulateSeqsForTree(map<string,string> input_msa, string outp
     int thread_id = 0;
     bool write_sequences_to_tmp_data = false;
     bool store_seq_at_cache = true;
-    int max_depth = 0;
     
     // default_random_engine for generating a random number from a discrete distribution
     default_random_engine generator;
-    generator.seed(params->ran_seed + MPIHelper::getInstance().getProcessID() * 1000 + params->alignment_id);
+    generator.seed(params->ran_seed + params->alignment_id);
 
     
     // init variables
-    initVariables(sequence_length, output_filepath, state_mapping, model, default_segment_length, max_depth, write_sequences_to_tmp_data, store_seq_at_cache, generator);
+    initVariables(sequence_length, output_filepath, state_mapping, model, default_segment_length, write_sequences_to_tmp_data, store_seq_at_cache, generator);
+    
+    // init the header of the packed output, gaps could only be copied from the input sequences
+    if (params->aln_output_format == IN_PACKED && output_filepath.length() > 0)
+        initPackedOutput(state_mapping, input_msa.size() > 0);
     
     // execute one of the AliSim-OpenMP algorithms to simulate sequences
     if (params->alisim_openmp_alg == IM)
-        executeIM(thread_id, sequence_length, default_segment_length, model, input_msa, output_filepath, open_mode, write_sequences_to_tmp_data, store_seq_at_cache, max_depth, state_mapping);
+        executeIM(thread_id, sequence_length, default_segment_length, model, input_msa, output_filepath, open_mode, write_sequences_to_tmp_data, store_seq_at_cache, state_mapping);
     else
-        executeEM(thread_id, sequence_length, default_segment_length, model, input_msa, output_filepath, open_mode, write_sequences_to_tmp_data, store_seq_at_cache, max_depth, state_mapping);
+        executeEM(thread_id, sequence_length, default_segment_length, model, input_msa, output_filepath, open_mode, write_sequences_to_tmp_data, store_seq_at_cache, state_mapping);
     
     // process after simulating sequences
     postSimulateSeqs(sequence_length, output_filepath, write_sequences_to_tmp_data);
 }
 
-void AliSimulator::executeEM(int thread_id, int &sequence_length, int default_segment_length, ModelSubst *model, map<string,string> input_msa, string output_filepath, std::ios_base::openmode open_mode, bool write_sequences_to_tmp_data, bool store_seq_at_cache, int max_depth, vector<string> &state_mapping)
+void AliSimulator::executeEM(int thread_id, int &sequence_length, int default_segment_length, ModelSubst *model, map<string,string> input_msa, string output_filepath, std::ios_base::openmode open_mode, bool write_sequences_to_tmp_data, bool store_seq_at_cache, vector<string> &state_mapping)
 {
     ostream *single_output = NULL;
     ostream *out = NULL;
     int *rstream = NULL;
     vector<vector<short int>> sequence_cache;
     int actual_segment_length = sequence_length;
+    int segment_start = 0;
     
     // default_random_engine for generating a random number from a discrete distribution
     default_random_engine generator;
-    generator.seed(params->ran_seed + MPIHelper::getInstance().getProcessID() * 1000 + params->alignment_id);
+    generator.seed(params->ran_seed + params->alignment_id);
     
     // simulate Sequences
     #ifdef _OPENMP
-    #pragma omp parallel private(rstream, out, thread_id, sequence_cache, actual_segment_length) firstprivate(generator)
+    #pragma omp parallel private(rstream, out, thread_id, sequence_cache, actual_segment_length, segment_start) firstprivate(generator)
     {
         thread_id = omp_get_thread_num();
         // init random generators
-        int ran_seed = params->ran_seed + MPIHelper::getInstance().getProcessID() * 1000 + thread_id + params->alignment_id;
+        int ran_seed = params->ran_seed + thread_id + params->alignment_id;
         init_random(ran_seed, false, &rstream);
         generator.seed(ran_seed);
 
-        actual_segment_length = thread_id < num_simulating_threads - 1 ? default_segment_length : sequence_length - (num_simulating_threads - 1) * default_segment_length;
+        getSegment(thread_id, sequence_length, default_segment_length, segment_start, actual_segment_length);
     #endif
         // init sequence cache
         if (store_seq_at_cache)
         {
-            sequence_cache.resize(max_depth + 1);
-            for (int i = 1; i < max_depth + 1; i++)
+            sequence_cache.resize(scheduler.num_slots);
+            for (int i = 1; i < scheduler.num_slots; i++)
                 sequence_cache[i].resize(actual_segment_length);
 
             // cache sequence at root
@@ -790,7 +804,7 @@ void AliSimulator::executeEM(int thread_id, int &sequence_length, int default_se
         
         // initialize trans_matrix
         double *trans_matrix = new double[max_num_states * max_num_states];
-        simulateSeqs(thread_id, thread_id * default_segment_length, actual_segment_length, sequence_length, model, trans_matrix, sequence_cache, store_seq_at_cache, tree->MTree::root, tree->MTree::root, *out, state_mapping, input_msa, rstream, generator);
+        simulateSeqs(thread_id, segment_start, actual_segment_length, sequence_length, model, trans_matrix, sequence_cache, store_seq_at_cache, *out, state_mapping, input_msa, rstream, generator);
         
         // delete trans_matrix array
         delete[] trans_matrix;
@@ -836,7 +850,7 @@ void AliSimulator::mergeOutputFiles(ostream *&single_output, int thread_id, stri
             #endif
             {
                 string single_output_filepath = getOutputNameWithExt(params->aln_output_format, output_filepath);
-                openOutputStream(single_output, single_output_filepath, open_mode);
+                openOutputStream(single_output, single_output_filepath, open_mode, write_compressed_blocks);
                 
                 // output the first line
                 string first_line = "";
@@ -849,7 +863,13 @@ void AliSimulator::mergeOutputFiles(ostream *&single_output, int thread_id, stri
                     num_nodes -= ((tree->root->isLeaf() && tree->root->name == ROOT_NAME)?1:0);
                     
                     first_line = convertIntToString(num_nodes) + " " + convertIntToString(num_sites_per_state == 1 ? round(expected_num_sites * inverse_length_ratio) : (round(expected_num_sites * inverse_length_ratio) * num_sites_per_state)) + "\n";
-                    *single_output << first_line;
+                    if (write_compressed_blocks)
+                    {
+                        string block = first_line;
+                        writeCompressedBlock(single_output, block);
+                    }
+                    else
+                        *single_output << first_line;
                 }
                 if (!params->do_compression)
                     starting_pos = single_output->tellp();
@@ -865,6 +885,7 @@ void AliSimulator::mergeOutputFiles(ostream *&single_output, int thread_id, stri
             string line;
             uint64_t pos = 0;
             double inverse_num_threads = 1.0 / num_threads;
+            string block;
             
             // open all files
             for (int i = 0; i < input_streams.size(); i++)
@@ -940,18 +961,30 @@ void AliSimulator::mergeOutputFiles(ostream *&single_output, int thread_id, stri
                     // update pos for the current output line
                     pos += output_line_length;
                 
+                    // compress blocks of lines by all threads in parallel, only writing them is serialized
+                    if (write_compressed_blocks)
+                    {
+                        block += output;
+                        if (block.length() >= COMPRESSED_BLOCK_SIZE)
+                            writeCompressedBlock(single_output, block);
+                    }
                     // write the concatenated sequence into file
-                    #ifdef _OPENMP
-                    #pragma omp critical
-                    #endif
+                    else
                     {
-                        // jump to the correct position before writing if users want to keep the sequence order
-                        if (params->keep_seq_order)
-                            single_output->seekp(pos);
-                        (*single_output) << output;
+                        #ifdef _OPENMP
+                        #pragma omp critical
+                        #endif
+                        {
+                            // jump to the correct position before writing if users want to keep the sequence order
+                            if (params->keep_seq_order)
+                                single_output->seekp(pos);
+                            (*single_output) << output;
+                        }
                     }
                 }
             }
+            if (write_compressed_blocks)
+                writeCompressedBlock(single_output, block);
             
             // close all files
             for (int i = 0; i < input_streams.size(); i++)
@@ -962,7 +995,7 @@ void AliSimulator::mergeOutputFiles(ostream *&single_output, int thread_id, stri
             #pragma omp barrier
             #pragma omp single
             #endif
-            closeOutputStream(single_output);
+            closeOutputStream(single_output, write_compressed_blocks);
             
             // delete all intermidate files
             // add ".phy" or ".fa" to the output_filepath
@@ -982,30 +1015,31 @@ void AliSimulator::mergeOutputFiles(ostream *&single_output, int thread_id, stri
     }
 }
 
-void AliSimulator::executeIM(int thread_id, int &sequence_length, int default_segment_length, ModelSubst *model, map<string,string> input_msa, string output_filepath, std::ios_base::openmode open_mode, bool write_sequences_to_tmp_data, bool store_seq_at_cache, int max_depth, vector<string> &state_mapping)
+void AliSimulator::executeIM(int thread_id, int &sequence_length, int default_segment_length, ModelSubst *model, map<string,string> input_msa, string output_filepath, std::ios_base::openmode open_mode, bool write_sequences_to_tmp_data, bool store_seq_at_cache, vector<string> &state_mapping)
 {
     int actual_segment_length = sequence_length;
+    int segment_start = 0;
     ostream *out = NULL;
     int *rstream = NULL;
     vector<vector<short int>> sequence_cache;
     // default_random_engine for generating a random number from a discrete distribution
     default_random_engine generator;
-    generator.seed(params->ran_seed + MPIHelper::getInstance().getProcessID() * 1000 + params->alignment_id);
+    generator.seed(params->ran_seed + params->alignment_id);
     
     // init the output stream
     initOutputFile(out, thread_id, actual_segment_length, output_filepath, open_mode, write_sequences_to_tmp_data);
     
     // simulate Sequences
     #ifdef _OPENMP
-    #pragma omp parallel private(rstream, thread_id, sequence_cache, actual_segment_length) firstprivate(generator)
+    #pragma omp parallel private(rstream, thread_id, sequence_cache, actual_segment_length, segment_start) firstprivate(generator)
     {
         thread_id = omp_get_thread_num();
         // init random generators
-        int ran_seed = params->ran_seed + MPIHelper::getInstance().getProcessID() * 1000 + thread_id + params->alignment_id;
+        int ran_seed = params->ran_seed + thread_id + params->alignment_id;
         init_random(ran_seed, false, &rstream);
         generator.seed(ran_seed);
             
-        actual_segment_length = thread_id < num_simulating_threads - 1 ? default_segment_length : sequence_length - (num_simulating_threads - 1) * default_segment_length;
+        getSegment(thread_id, sequence_length, default_segment_length, segment_start, actual_segment_length);
     #endif
         // init sequence cache
         if (store_seq_at_cache)
@@ -1013,8 +1047,8 @@ void AliSimulator::executeIM(int thread_id, int &sequence_length, int default_se
             // don't need to init sequence_cache for the writing thread
             if (!(num_threads > 1 && thread_id == num_threads - 1))
             {
-                sequence_cache.resize(max_depth + 1);
-                for (int i = 1; i < max_depth + 1; i++)
+                sequence_cache.resize(scheduler.num_slots);
+                for (int i = 1; i < scheduler.num_slots; i++)
                     sequence_cache[i].resize(actual_segment_length);
                 
                 // cache sequence at root
@@ -1053,6 +1087,8 @@ void AliSimulator::executeIM(int thread_id, int &sequence_length, int default_se
             #pragma omp flush
             #endif
             writeAllSeqChunkFromCache(out);
+            if (write_compressed_blocks)
+                writeCompressedBlock(out, pending_block);
             
         }
         // simulating thread
@@ -1060,7 +1096,7 @@ void AliSimulator::executeIM(int thread_id, int &sequence_length, int default_se
         {
             // initialize trans_matrix
             double *trans_matrix = new double[max_num_states * max_num_states];
-            simulateSeqs(thread_id, thread_id * default_segment_length, actual_segment_length, sequence_length, model, trans_matrix, sequence_cache, store_seq_at_cache, tree->MTree::root, tree->MTree::root, *out, state_mapping, input_msa, rstream, generator);
+            simulateSeqs(thread_id, segment_start, actual_segment_length, sequence_length, model, trans_matrix, sequence_cache, store_seq_at_cache, *out, state_mapping, input_msa, rstream, generator);
             
             // delete trans_matrix array
             delete[] trans_matrix;
@@ -1085,7 +1121,7 @@ void AliSimulator::executeIM(int thread_id, int &sequence_length, int default_se
     
     // close the output stream
     if (output_filepath.length() > 0 || write_sequences_to_tmp_data)
-        closeOutputStream(out);
+        closeOutputStream(out, write_compressed_blocks);
 }
 
 void AliSimulator::writeSeqChunkFromCache(ostream *&out)
@@ -1099,8 +1135,13 @@ void AliSimulator::writeSeqChunkFromCache(ostream *&out)
                 #ifdef _OPENMP
                 #pragma omp flush
                 #endif
-                out->seekp(seq_str_cache[i].pos);
-                (*out) << seq_str_cache[i].chunk_str;
+                if (write_compressed_blocks)
+                    assembleSeqChunkIntoLine(out, seq_str_cache[i].pos, seq_str_cache[i].chunk_str);
+                else
+                {
+                    out->seekp(seq_str_cache[i].pos);
+                    (*out) << seq_str_cache[i].chunk_str;
+                }
                 
                 // update status of the selected slot
                 #ifdef _OPENMP
@@ -1124,8 +1165,13 @@ void AliSimulator::writeAllSeqChunkFromCache(ostream *&out)
             #ifdef _OPENMP
             #pragma omp flush
             #endif
-            out->seekp(seq_str_cache[i].pos);
-            (*out) << seq_str_cache[i].chunk_str;
+            if (write_compressed_blocks)
+                assembleSeqChunkIntoLine(out, seq_str_cache[i].pos, seq_str_cache[i].chunk_str);
+            else
+            {
+                out->seekp(seq_str_cache[i].pos);
+                (*out) << seq_str_cache[i].chunk_str;
+            }
             
             // update status of the selected slot
             #ifdef _OPENMP
@@ -1136,6 +1182,59 @@ void AliSimulator::writeAllSeqChunkFromCache(ostream *&out)
     }
 }
 
+string AliSimulator::compressBlock(const string &block)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // the same fast compression as ogzstream, with a gzip header (window bits + 16)
+    if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        outError("Failed to initialize the compression of the output");
+    
+    string compressed_block(deflateBound(&stream, block.length()), '\0');
+    stream.next_in = (Bytef*) block.data();
+    stream.avail_in = block.length();
+    stream.next_out = (Bytef*) &compressed_block[0];
+    stream.avail_out = compressed_block.length();
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+        outError("Failed to compress the output");
+    compressed_block.resize(stream.total_out);
+    deflateEnd(&stream);
+    return compressed_block;
+}
+
+void AliSimulator::assembleSeqChunkIntoLine(ostream *&out, int64_t pos, string &chunk_str)
+{
+    // each line has a fixed length, which gives the line and the offset of the chunk
+    int64_t line_id = (pos - (int64_t) starting_pos) / (int64_t) output_line_length;
+    int64_t offset = (pos - (int64_t) starting_pos) % (int64_t) output_line_length;
+    pair<string, int64_t> &line = pending_lines[line_id];
+    if (line.first.empty())
+        line.first.resize(output_line_length);
+    line.first.replace(offset, chunk_str.length(), chunk_str);
+    line.second += chunk_str.length();
+    
+    // append the completed line to the block, lines are output in the order they are completed
+    if (line.second >= output_line_length)
+    {
+        pending_block += line.first;
+        pending_lines.erase(line_id);
+        if (pending_block.length() >= COMPRESSED_BLOCK_SIZE)
+            writeCompressedBlock(out, pending_block);
+    }
+}
+
+void AliSimulator::writeCompressedBlock(ostream *&out, string &block)
+{
+    if (block.empty())
+        return;
+    string compressed_block = compressBlock(block);
+    block.clear();
+    #ifdef _OPENMP
+    #pragma omp critical
+    #endif
+    out->write(compressed_block.data(), compressed_block.length());
+}
+
 /**
     process after simulating sequences
 */
@@ -1193,7 +1292,7 @@ void AliSimulator::postSimulateSeqs(int sequence_length, string output_filepath,
 /**
     initialize variables
 */
-void AliSimulator::initVariables(int sequence_length, string output_filepath, vector<string> &state_mapping, ModelSubst *model, int &default_segment_length, int &max_depth, bool &write_sequences_to_tmp_data, bool &store_seq_at_cache, default_random_engine& generator)
+void AliSimulator::initVariables(int sequence_length, string output_filepath, vector<string> &state_mapping, ModelSubst *model, int &default_segment_length, bool &write_sequences_to_tmp_data, bool &store_seq_at_cache, default_random_engine& generator)
 {
     // check if we can store sequences at a fixed cache instead of at nodes
     store_seq_at_cache = params->alisim_insertion_ratio + params->alisim_deletion_ratio == 0 && (output_filepath.length() > 0 || write_sequences_to_tmp_data) && params->alisim_fundi_taxon_set.size() == 0;
@@ -1210,7 +1309,12 @@ void AliSimulator::initVariables(int sequence_length, string output_filepath, ve
     }
     #endif
     
-    default_segment_length = sequence_length / num_simulating_threads;
+    default_segment_length = getDefaultSegmentLength(sequence_length);
+    
+    // a gzip stream can neither be sought nor shared by threads -> compress independent blocks of the output instead
+    write_compressed_blocks = params->do_compression && num_threads > 1 && store_seq_at_cache;
+    pending_lines.clear();
+    pending_block.clear();
     
     // for Windows only, the line break is \r\n instead of only \n
     #if defined WIN32 || defined _WIN32 || defined __WIN32__ || defined WIN64
@@ -1280,8 +1384,15 @@ void AliSimulator::initVariables(int sequence_length, string output_filepath, ve
     if (params->alisim_insertion_ratio + params->alisim_deletion_ratio > 0)
         tree->root->sequence->num_gaps = count(tree->root->sequence->sequence_chunks[0].begin(), tree->root->sequence->sequence_chunks[0].end(), STATE_UNKNOWN);
     
+    // plan the traversal order and the sequence cache within the memory cap (sequences stored at nodes are not capped)
+    scheduler.plan(tree->root, store_seq_at_cache ? getMaxNumCachedSeqs(sequence_length) : INT_MAX);
+    if (scheduler.num_file_slots > 0)
+        outWarning("Not enough memory to cache sequences, up to " + convertIntToString(scheduler.num_file_slots) + " sequences are temporarily spilled to disk");
+    else if (scheduler.reordered && verbose_mode >= VB_MED)
+        cout << "Reordering the simulation to keep at most " << scheduler.num_slots << " sequences in memory" << endl;
+    
     // reset variables at nodes (essential when simulating multiple alignments)
-    resetTree(max_depth, store_seq_at_cache);
+    resetTree(store_seq_at_cache);
     
     // if using AliSim-OpenMP-EM algorithm, update whether we need to output temporary files in PHYLIP format
     force_output_PHYLIP = params->alisim_openmp_alg == EM && num_threads > 1 && !params->no_merge;
@@ -1317,7 +1428,7 @@ void AliSimulator::initOutputFile(ostream *&out, int thread_id, int actual_segme
             if (params->alisim_openmp_alg == EM && num_threads > 1)
                 openOutputStream(out, output_filepath, std::ios_base::out, true);
             else
-                openOutputStream(out, output_filepath, open_mode);
+                openOutputStream(out, output_filepath, open_mode, write_compressed_blocks);
         }
         
         // write the first line <#taxa> <length_of_sequence> (for PHYLIP output format)
@@ -1345,9 +1456,22 @@ void AliSimulator::initOutputFile(ostream *&out, int thread_id, int actual_segme
             else
             {
                 first_line = convertIntToString(num_nodes) + " " + convertIntToString(round(expected_num_sites * inverse_length_ratio) * num_sites_per_state) + "\n";
-                *out << first_line;
+                // the first line will be compressed with the first block of sequences
+                if (write_compressed_blocks)
+                    pending_block = first_line;
+                else
+                    *out << first_line;
             }
         }
+        // write the header of the packed format
+        else if (params->aln_output_format == IN_PACKED)
+        {
+            first_line = packed_header.toString();
+            if (write_compressed_blocks)
+                pending_block = first_line;
+            else
+                *out << first_line;
+        }
         
         // get the starting position for writing
         if (params->alisim_openmp_alg == IM)
@@ -1365,6 +1489,9 @@ void AliSimulator::initOutputFile(ostream *&out, int thread_id, int actual_segme
 */
 void AliSimulator::openOutputStream(ostream *&out, string output_filepath, std::ios_base::openmode open_mode, bool force_uncompression)
 {
+    // the packed format is binary
+    if (params->aln_output_format == IN_PACKED)
+        open_mode |= std::ios_base::binary;
     try {
         if (params->do_compression && !force_uncompression)
             out = new ogzstream(output_filepath.c_str(), open_mode);
@@ -1392,11 +1519,28 @@ void AliSimulator::closeOutputStream(ostream *&out, bool force_uncompression)
 *  simulate sequences for all nodes in the tree by DFS
 *
 */
-void AliSimulator::simulateSeqs(int thread_id, int segment_start, int &segment_length, int &sequence_length, ModelSubst *model, double *trans_matrix, vector<vector<short int>> &sequence_cache, bool store_seq_at_cache, Node *node, Node *dad, ostream &out, vector<string> &state_mapping, map<string,string> input_msa, int* rstream, default_random_engine& generator)
+void AliSimulator::simulateSeqs(int thread_id, int segment_start, int &segment_length, int &sequence_length, ModelSubst *model, double *trans_matrix, vector<vector<short int>> &sequence_cache, bool store_seq_at_cache, ostream &out, vector<string> &state_mapping, map<string,string> input_msa, int* rstream, default_random_engine& generator)
 {
-    // process its neighbors/children
-    NeighborVec::iterator it;
-    FOR_NEIGHBOR(node, dad, it) {
+    // open the spill file of this thread if the sequence cache cannot hold all sequences needed at a time
+    fstream spill_file;
+    string spill_filename;
+    if (store_seq_at_cache && scheduler.num_file_slots > 0)
+    {
+        spill_filename = params->alisim_output_filename + "_" + convertIntToString(MPIHelper::getInstance().getProcessID()) + "_" + convertIntToString(thread_id) + ".spill";
+        spill_file.open(spill_filename.c_str(), std::ios_base::in | std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        if (!spill_file.is_open())
+            outError(ERR_WRITE_OUTPUT, spill_filename);
+    }
+    
+    // the sites of the Gillespie algorithm, reused by all branches so that the nodes are only allocated once
+    RateSampler sites;
+    
+    // process the steps in the order planned by the scheduler (a preorder traversal without recursion)
+    for (vector<SimulationStep>::iterator step = scheduler.steps.begin(); step != scheduler.steps.end(); step++)
+    {
+        Node *node = step->dad;
+        NeighborVec::iterator it = node->neighbors.begin() + step->neighbor_index;
+        
         //  clone the number of gaps from the ancestral sequence if using Indels
         if (params->alisim_insertion_ratio + params->alisim_deletion_ratio > 0)
             (*it)->node->sequence->num_gaps = node->sequence->num_gaps;
@@ -1405,9 +1549,9 @@ void AliSimulator::simulateSeqs(int thread_id, int segment_start, int &segment_l
         vector<short int> *dad_seq_chunk, *node_seq_chunk;
         if (store_seq_at_cache)
         {
-            int dad_depth = node->sequence->depth;
-            dad_seq_chunk = &sequence_cache[dad_depth];
-            node_seq_chunk = &sequence_cache[dad_depth + 1];
+            executeSpillActions(step->spill_actions, sequence_cache, spill_file);
+            dad_seq_chunk = &sequence_cache[step->dad_slot];
+            node_seq_chunk = &sequence_cache[step->node_slot];
         }
         else
         {
@@ -1416,8 +1560,9 @@ void AliSimulator::simulateSeqs(int thread_id, int segment_start, int &segment_l
         }
         
         // select the appropriate simulation method
+        // (the counter-based RNG draws per-site random numbers, which the Gillespie algorithm cannot use)
         SIMULATION_METHOD simulation_method = RATE_MATRIX;
-        if (((*it)->length * params->alisim_branch_scale > params->alisim_simulation_thresh && !(model->isMixture() && params->alisim_mixture_at_sub_level))
+        if ((((*it)->length * params->alisim_branch_scale > params->alisim_simulation_thresh || params->alisim_counter_rng) && !(model->isMixture() && params->alisim_mixture_at_sub_level))
             || tree->getRate()->isHeterotachy()
             || (*it)->attributes.find("model") != (*it)->attributes.end())
             simulation_method = TRANS_PROB_MATRIX;
@@ -1451,7 +1596,7 @@ void AliSimulator::simulateSeqs(int thread_id, int segment_start, int &segment_l
                 
                 // handle indels
                 if (params->alisim_insertion_ratio + params->alisim_deletion_ratio > 0)
-                    simulateSeqByGillespie(segment_start, segment_length, model, *node_seq_chunk, sequence_length, it, simulation_method, rstream, generator);
+                    simulateSeqByGillespie(segment_start, segment_length, model, *node_seq_chunk, sequence_length, it, simulation_method, sites, rstream, generator);
             }
             // otherwise (Rate_matrix is used as the simulation method) + also handle Indels (if any).
             else
@@ -1460,7 +1605,7 @@ void AliSimulator::simulateSeqs(int thread_id, int segment_start, int &segment_l
                 (*node_seq_chunk) = (*dad_seq_chunk);
                 
                 // Each thread simulate a chunk of sequence using the Gillespie algorithm
-                simulateSeqByGillespie(segment_start, segment_length, model, *node_seq_chunk, sequence_length, it, simulation_method, rstream, generator);
+                simulateSeqByGillespie(segment_start, segment_length, model, *node_seq_chunk, sequence_length, it, simulation_method, sites, rstream, generator);
             }
         }
         
@@ -1494,9 +1639,13 @@ void AliSimulator::simulateSeqs(int thread_id, int segment_start, int &segment_l
         
         // merge and write sequence in simulations with Indels or FunDi model
         mergeAndWriteSeqIndelFunDi(thread_id, out, sequence_length, state_mapping, input_msa, it, node);
-        
-        // browse 1-step deeper to the neighbor node
-        simulateSeqs(thread_id, segment_start, segment_length, sequence_length, model, trans_matrix, sequence_cache, store_seq_at_cache, (*it)->node, node, out, state_mapping, input_msa, rstream, generator);
+    }
+    
+    // remove the spill file
+    if (spill_file.is_open())
+    {
+        spill_file.close();
+        remove(spill_filename.c_str());
     }
 }
 
@@ -1717,7 +1866,10 @@ void AliSimulator::writeAndDeleteSequenceChunkIfPossible(int thread_id, int segm
                 
                 // convert numerical states into readable characters
                 string input_sequence = input_msa[(*it)->node->name];
-                if (input_sequence.length()>0)
+                if (params->aln_output_format == IN_PACKED)
+                    // pack the sequence without converting it into characters
+                    exportPackedSequence(node_seq_chunk, output, input_sequence, segment_start, segment_length);
+                else if (input_sequence.length()>0)
                     // extract sequence and copying gaps from the input sequences to the output.
                     exportSequenceWithGaps(node_seq_chunk, output, sequence_length, num_sites_per_state, input_sequence, state_mapping, segment_start, segment_length);
                 else
@@ -1737,7 +1889,10 @@ void AliSimulator::writeAndDeleteSequenceChunkIfPossible(int thread_id, int segm
                 
                 // convert numerical states into readable characters
                 string input_sequence = input_msa[node->name];
-                if (input_sequence.length()>0)
+                if (params->aln_output_format == IN_PACKED)
+                    // pack the sequence without converting it into characters
+                    exportPackedSequence(dad_seq_chunk, output, input_sequence, segment_start, segment_length);
+                else if (input_sequence.length()>0)
                     // extract sequence and copying gaps from the input sequences to the output.
                     exportSequenceWithGaps(dad_seq_chunk, output, sequence_length, num_sites_per_state, input_sequence, state_mapping, segment_start, segment_length);
                 else
@@ -1757,7 +1912,13 @@ void AliSimulator::writeAndDeleteSequenceChunkIfPossible(int thread_id, int segm
             string output(num_sites_per_state == 1 ? segment_length : (segment_length * num_sites_per_state), '-');
             
             // convert numerical states into readable characters
-            convertNumericalStatesIntoReadableCharacters(node_seq_chunk, output, sequence_length, num_sites_per_state, state_mapping, segment_length);
+            if (params->aln_output_format == IN_PACKED)
+            {
+                string input_sequence = "";
+                exportPackedSequence(node_seq_chunk, output, input_sequence, segment_start, segment_length);
+            }
+            else
+                convertNumericalStatesIntoReadableCharacters(node_seq_chunk, output, sequence_length, num_sites_per_state, state_mapping, segment_length);
             
             // the memory allocated to the current sequence chunk of INTERNAL nodes will be release later
             
@@ -1786,7 +1947,10 @@ void AliSimulator::outputOneSequence(Node* node, string &output, int thread_id,
         if (thread_id == 0)
         {
             string pre_output = exportPreOutputString(node, params->aln_output_format, max_length_taxa_name, force_output_PHYLIP);
-            out << pre_output << output << "\n";
+            out << pre_output << output;
+            // records of the packed format have a fixed length without line breaks
+            if (params->aln_output_format != IN_PACKED)
+                out << "\n";
         }
         // write sequence chunk in other threads
         else
@@ -1810,14 +1974,18 @@ void AliSimulator::outputOneSequence(Node* node, string &output, int thread_id,
             output = exportPreOutputString(node, params->aln_output_format, max_length_taxa_name) + output;
         
         // add break-line in the last simulating thread
-        if (thread_id == num_simulating_threads - 1)
+        if (thread_id == num_simulating_threads - 1 && params->aln_output_format != IN_PACKED)
             output = output + "\n";
         
         //  cache output into the writing queue
         if (num_threads > 1)
         {
             int64_t pos = ((int64_t)node->id) * ((int64_t)output_line_length);
-            pos += starting_pos + (num_sites_per_state == 1 ? segment_start : (segment_start * num_sites_per_state)) + (thread_id == 0 ? 0 : seq_name_length);
+            // segments start at whole bytes of the packed sequences
+            if (params->aln_output_format == IN_PACKED)
+                pos += starting_pos + packed_header.getPackedLength(segment_start) + (thread_id == 0 ? 0 : seq_name_length);
+            else
+                pos += starting_pos + (num_sites_per_state == 1 ? segment_start : (segment_start * num_sites_per_state)) + (thread_id == 0 ? 0 : seq_name_length);
             cacheSeqChunkStr(pos, output, thread_id);
         }
         // write output to file
@@ -1887,10 +2055,10 @@ string AliSimulator::exportPreOutputString(Node *node, InputType output_format,
 /**
 *  get a random item from a set of items with a probability array
 */
-int AliSimulator::getRandomItemWithProbabilityMatrix(double *probability_maxtrix, int starting_index, int num_items, int* rstream)
+int AliSimulator::getRandomItemWithProbabilityMatrix(double *probability_maxtrix, int starting_index, int num_items, int* rstream, double *site_random_number)
 {
     // generate a random number
-    double random_number = random_double(rstream);
+    double random_number = site_random_number ? *site_random_number : random_double(rstream);
     
     // select the current state, considering the random_number, and the probability_matrix
     double accummulated_probability = 0;
@@ -1938,9 +2106,9 @@ void AliSimulator::convertProMatrixIntoAccumulatedProMatrix(double *probability_
 /**
 *  get a random item from a set of items with an accumulated probability array by binary search starting at the max probability
 */
-int AliSimulator::getRandomItemWithAccumulatedProbMatrixMaxProbFirst(double *accumulated_probability_maxtrix, int starting_index, int num_columns, int max_prob_position, int* rstream){
+int AliSimulator::getRandomItemWithAccumulatedProbMatrixMaxProbFirst(double *accumulated_probability_maxtrix, int starting_index, int num_columns, int max_prob_position, int* rstream, double *site_random_number){
     // generate a random number
-    double random_number = random_double(rstream);
+    double random_number = site_random_number ? *site_random_number : random_double(rstream);
     
     // starting at the probability of unchange first
     if (random_number >= (max_prob_position==0?0:accumulated_probability_maxtrix[starting_index+max_prob_position-1]))
@@ -1956,6 +2124,101 @@ int AliSimulator::getRandomItemWithAccumulatedProbMatrixMaxProbFirst(double *acc
     return binarysearchItemWithAccumulatedProbabilityMatrix(accumulated_probability_maxtrix, random_number, starting_index, starting_index+max_prob_position-1, starting_index)-starting_index;
 }
 
+/**
+*  build Walker's alias tables from the rows of an accumulated probability matrix (Vose's method)
+*/
+void AliSimulator::buildAliasTables(double *accumulated_probability_maxtrix, int num_rows, int num_columns, double *alias_prob, int *alias_item)
+{
+    double *scaled_prob = new double[num_columns];
+    int *small_items = new int[num_columns];
+    int *large_items = new int[num_columns];
+    for (int r = 0; r < num_rows; r++)
+    {
+        double *row = accumulated_probability_maxtrix + r * num_columns;
+        double *row_prob = alias_prob + r * num_columns;
+        int *row_item = alias_item + r * num_columns;
+        int num_small = 0, num_large = 0;
+        
+        // split the items into those with probability below and above the average
+        for (int c = 0; c < num_columns; c++)
+        {
+            double prob = (c == 0) ? row[0] : (row[c] - row[c - 1]);
+            scaled_prob[c] = (prob > 0 ? prob : 0) * num_columns;
+            if (scaled_prob[c] < 1.0)
+                small_items[num_small++] = c;
+            else
+                large_items[num_large++] = c;
+        }
+        
+        // fill each small column up with a large item
+        while (num_small > 0 && num_large > 0)
+        {
+            int small = small_items[--num_small];
+            int large = large_items[--num_large];
+            row_prob[small] = scaled_prob[small];
+            row_item[small] = large;
+            scaled_prob[large] += scaled_prob[small] - 1.0;
+            if (scaled_prob[large] < 1.0)
+                small_items[num_small++] = large;
+            else
+                large_items[num_large++] = large;
+        }
+        
+        // the remaining columns are full (up to rounding errors)
+        while (num_large > 0)
+        {
+            int large = large_items[--num_large];
+            row_prob[large] = 1.0;
+            row_item[large] = large;
+        }
+        while (num_small > 0)
+        {
+            int small = small_items[--num_small];
+            row_prob[small] = 1.0;
+            row_item[small] = small;
+        }
+    }
+    delete[] large_items;
+    delete[] small_items;
+    delete[] scaled_prob;
+}
+
+/**
+*  get a random item from a row of alias tables
+*/
+int AliSimulator::getRandomItemWithAliasTable(double *alias_prob, int *alias_item, int starting_index, int num_columns, int* rstream, double *site_random_number)
+{
+    // the integer part of a random number selects the column, its fraction decides between the column and its alias
+    double random_number = (site_random_number ? *site_random_number : random_double(rstream)) * num_columns;
+    int column = (int) random_number;
+    if (column >= num_columns)
+        column = num_columns - 1;
+    return (random_number - column < alias_prob[starting_index + column]) ? column : alias_item[starting_index + column];
+}
+
+/**
+*  draw the random numbers for the sites of a sequence chunk from the counter-based RNG
+*/
+void AliSimulator::generateSiteRandomNumbers(Node *node, int segment_start, int num_sites, vector<double> &random_numbers)
+{
+    generateSiteRandomNumbers(node->id, segment_start, num_sites, random_numbers);
+}
+
+/**
+*  draw the random numbers for sites from a stream of the counter-based RNG
+*/
+double *AliSimulator::generateSiteRandomNumbers(uint32_t stream_id, int first_site, int num_sites, vector<double> &random_numbers)
+{
+    if (!params->alisim_counter_rng || num_sites <= 0)
+        return NULL;
+    
+    // the key ignores the MPI process and the thread, the counter consists of the stream ID and the site position
+    CounterRNG counter_rng(params->ran_seed, params->alignment_id);
+    random_numbers.resize(num_sites);
+    counter_rng.generateDoubles(stream_id, first_site, num_sites, random_numbers.data());
+    return random_numbers.data();
+}
+
 /**
 *  binary search an item from a set with accumulated probability array
 */
@@ -2469,6 +2732,20 @@ void AliSimulator::simulateASequenceFromBranchAfterInitVariables(int segment_sta
     // convert the probability matrix into an accumulated probability matrix
     convertProMatrixIntoAccumulatedProMatrix(trans_matrix, max_num_states, max_num_states);
     
+    // with many states, draw the child states from alias tables in O(1) time
+    vector<double> alias_prob;
+    vector<int> alias_item;
+    if (max_num_states >= ALIAS_TABLE_MIN_NUM_STATES)
+    {
+        alias_prob.resize(max_num_states * max_num_states);
+        alias_item.resize(max_num_states * max_num_states);
+        buildAliasTables(trans_matrix, max_num_states, max_num_states, alias_prob.data(), alias_item.data());
+    }
+    
+    // draw the random numbers from the counter-based RNG if needed
+    vector<double> random_numbers;
+    generateSiteRandomNumbers((*it)->node, segment_start, node_seq_chunk.size(), random_numbers);
+    
     // estimate the sequence for the current neighbor
     for (int i = 0; i < node_seq_chunk.size(); i++)
     {
@@ -2479,7 +2756,10 @@ void AliSimulator::simulateASequenceFromBranchAfterInitVariables(int segment_sta
         {
             // iteratively select the state for each site of the child node, considering it's dad states, and the transition_probability_matrix
             int parent_state = dad_seq_chunk[i];
-            node_seq_chunk[i] = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(trans_matrix, parent_state * max_num_states, max_num_states, parent_state, rstream);
+            if (alias_prob.empty())
+                node_seq_chunk[i] = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(trans_matrix, parent_state * max_num_states, max_num_states, parent_state, rstream, random_numbers.empty() ? NULL : &random_numbers[i]);
+            else
+                node_seq_chunk[i] = getRandomItemWithAliasTable(alias_prob.data(), alias_item.data(), parent_state * max_num_states, max_num_states, rstream, random_numbers.empty() ? NULL : &random_numbers[i]);
         }
     }
 }
@@ -2495,7 +2775,7 @@ void AliSimulator::initVariablesRateHeterogeneity(int sequence_length, default_r
 /**
     regenerate the root sequence if the user has specified specific state frequencies in branch-specific model
 */
-void AliSimulator::regenerateRootSequenceBranchSpecificModel(string freqs, int sequence_length, vector<short int> &sequence){
+void AliSimulator::regenerateRootSequenceBranchSpecificModel(string freqs, int sequence_length, vector<short int> &sequence, double *site_random_numbers){
     std::cout << "Regenerate the root sequence according to user-defined state frequencies." << std::endl;
     
     // initizlize state_freqs
@@ -2538,7 +2818,7 @@ void AliSimulator::regenerateRootSequenceBranchSpecificModel(string freqs, int s
     }
     
     // re-generate a new sequence for the root from the state frequencies
-    generateRandomSequenceFromStateFreqs(sequence_length, sequence, state_freqs, max_prob_pos);
+    generateRandomSequenceFromStateFreqs(sequence_length, sequence, state_freqs, max_prob_pos, site_random_numbers);
     
     // release the memory of state_freqs
     delete[] state_freqs;
@@ -2547,7 +2827,7 @@ void AliSimulator::regenerateRootSequenceBranchSpecificModel(string freqs, int s
 /**
     generate a random sequence by state frequencies
 */
-void AliSimulator::generateRandomSequenceFromStateFreqs(int sequence_length, vector<short int> &sequence, double* state_freqs, int max_prob_pos)
+void AliSimulator::generateRandomSequenceFromStateFreqs(int sequence_length, vector<short int> &sequence, double* state_freqs, int max_prob_pos, double *site_random_numbers)
 {
     sequence.resize(sequence_length);
     
@@ -2556,7 +2836,7 @@ void AliSimulator::generateRandomSequenceFromStateFreqs(int sequence_length, vec
     
     // randomly generate each site in the sequence follows the base frequencies defined by the user
     for (int i = 0; i < sequence_length; i++)
-        sequence[i] =  getRandomItemWithAccumulatedProbMatrixMaxProbFirst(state_freqs, 0, max_num_states, max_prob_pos, NULL);
+        sequence[i] =  getRandomItemWithAccumulatedProbMatrixMaxProbFirst(state_freqs, 0, max_num_states, max_prob_pos, NULL, site_random_numbers ? &site_random_numbers[i] : NULL);
 }
 
 /**
@@ -2614,6 +2894,95 @@ void AliSimulator::exportSequenceWithGaps(vector<short int> &sequence_chunk, str
     }
 }
 
+/**
+*  export a sequence chunk in the packed format, with gaps copied from the input sequence (if any)
+*/
+void AliSimulator::exportPackedSequence(vector<short int> &sequence_chunk, string &output, string &input_sequence, int segment_start, int segment_length)
+{
+    ASSERT(segment_length <= sequence_chunk.size());
+    vector<short int> codes(sequence_chunk.begin(), sequence_chunk.begin() + segment_length);
+    
+    // states outside the alphabet (e.g. unknown states) are written as gaps if the alphabet has one
+    bool with_gaps = packed_header.alphabet.size() > tree->aln->num_states;
+    short int gap_code = packed_header.alphabet.size() - 1;
+    for (int i = 0; i < segment_length; i++)
+        if (codes[i] < 0 || codes[i] >= tree->aln->num_states)
+        {
+            if (!with_gaps)
+                outError("Unknown states cannot be written in the packed format. Please use another output format (e.g. -af fasta)");
+            codes[i] = gap_code;
+        }
+    
+    // copy gaps from the input sequence, the gap is the last code in the alphabet
+    if (input_sequence.length() > 0)
+    {
+        for (int i = 0; i < segment_length; i++)
+        {
+            size_t pos = ((size_t) segment_start + i) * num_sites_per_state;
+            for (int j = 0; j < num_sites_per_state; j++)
+                if (pos + j < input_sequence.length() && input_sequence[pos + j] == '-')
+                    codes[i] = gap_code;
+        }
+    }
+    
+    output.resize(packed_header.getPackedLength(segment_length));
+    packCodes(codes.data(), segment_length, packed_header.bits_per_code, &output[0]);
+}
+
+/**
+*  init the header and the record length of the packed output
+*/
+void AliSimulator::initPackedOutput(vector<string> &state_mapping, bool with_gaps)
+{
+    // the alphabet includes all states, and the gap if it may appear
+    StrVector alphabet(state_mapping.begin(), state_mapping.begin() + tree->aln->num_states);
+    if (with_gaps)
+        alphabet.push_back(string(num_sites_per_state, '-'));
+    
+    int num_nodes = tree->leafNum;
+    if (params->alisim_write_internal_sequences)
+        num_nodes = tree->nodeNum;
+    // don't count the fake root
+    num_nodes -= ((tree->root->isLeaf() && tree->root->name == ROOT_NAME)?1:0);
+    
+    // record the genetic code of codon sequences
+    string seq_type = tree->aln->getSeqTypeStr(tree->aln->seq_type);
+    if (tree->aln->seq_type == SEQ_CODON && tree->aln->sequence_type.length() > 0)
+        seq_type = tree->aln->sequence_type;
+    
+    packed_header = PackedAlignmentHeader(num_nodes, round(expected_num_sites * inverse_length_ratio), max_length_taxa_name, seq_type, alphabet);
+    
+    // each record has a fixed length: the padded taxon name followed by the packed sequence
+    seq_name_length = max_length_taxa_name;
+    output_line_length = packed_header.getRecordLength();
+}
+
+/**
+*  get the length of the segments simulated by each thread (except the last one)
+*/
+int AliSimulator::getDefaultSegmentLength(int sequence_length)
+{
+    int default_segment_length = sequence_length / num_simulating_threads;
+    
+    // align the segments to 8 sites so that each thread outputs whole bytes of the packed sequences
+    if (params->aln_output_format == IN_PACKED && num_simulating_threads > 1)
+        default_segment_length = max(default_segment_length - default_segment_length % 8, 8);
+    
+    return default_segment_length;
+}
+
+/**
+*  get the first site and the length of the segment simulated by a thread
+*/
+void AliSimulator::getSegment(int thread_id, int sequence_length, int default_segment_length, int &segment_start, int &segment_length)
+{
+    segment_start = min(thread_id * default_segment_length, sequence_length);
+    if (thread_id < num_simulating_threads - 1)
+        segment_length = min(default_segment_length, sequence_length - segment_start);
+    else
+        segment_length = sequence_length - segment_start;
+}
+
 /**
     extract array of substitution rates
 */
@@ -2698,15 +3067,15 @@ void AliSimulator::initVariables4RateMatrix(int segment_start, double &total_sub
 /**
     handle indels
 */
-void AliSimulator::simulateSeqByGillespie(int segment_start, int &segment_length, ModelSubst *model, vector<short int> &node_seq_chunk, int &sequence_length, NeighborVec::iterator it, SIMULATION_METHOD simulation_method, int *rstream, default_random_engine& generator)
+void AliSimulator::simulateSeqByGillespie(int segment_start, int &segment_length, ModelSubst *model, vector<short int> &node_seq_chunk, int &sequence_length, NeighborVec::iterator it, SIMULATION_METHOD simulation_method, RateSampler &sites, int *rstream, default_random_engine& generator)
 {
     int num_gaps = 0;
     double total_sub_rate = 0;
-    vector<double> sub_rate_by_site;
+    vector<double> site_rates;
     // If AliSim is using RATE_MATRIX approach -> initialize variables for Rate_matrix approach: total_sub_rate, accumulated_rates, num_gaps
     if (simulation_method == RATE_MATRIX || params->indel_rate_variation)
     {
-        initVariables4RateMatrix(segment_start, total_sub_rate, num_gaps, sub_rate_by_site, node_seq_chunk);
+        initVariables4RateMatrix(segment_start, total_sub_rate, num_gaps, site_rates, node_seq_chunk);
         
         // handle cases when total_sub_rate == NaN due to extreme freqs
         if (total_sub_rate != total_sub_rate)
@@ -2714,6 +3083,9 @@ void AliSimulator::simulateSeqByGillespie(int segment_start, int &segment_length
     }
     else // otherwise, TRANS_PROB_MATRIX approach is used -> only count the number of gaps
         num_gaps = (*it)->node->sequence->num_gaps;
+    sites.init(node_seq_chunk, site_rates, STATE_UNKNOWN);
+    site_rates.clear();
+    site_rates.shrink_to_fit();
     
     double total_ins_rate = 0;
     double total_del_rate = 0;
@@ -2775,13 +3147,13 @@ void AliSimulator::simulateSeqByGillespie(int segment_start, int &segment_length
             {
                 case INSERTION:
                 {
-                    length_change = handleInsertion(sequence_length, node_seq_chunk, total_sub_rate, sub_rate_by_site, simulation_method, generator);
+                    length_change = handleInsertion(sequence_length, total_sub_rate, sites, simulation_method, generator);
                     segment_length = sequence_length;
                     break;
                 }
                 case DELETION:
                 {
-                    int deletion_length = handleDeletion(sequence_length, node_seq_chunk, total_sub_rate, sub_rate_by_site, simulation_method, generator);
+                    int deletion_length = handleDeletion(sequence_length, total_sub_rate, sites, simulation_method, generator);
                     length_change = -deletion_length;
                     (*it)->node->sequence->num_gaps += deletion_length;
                     break;
@@ -2790,7 +3162,7 @@ void AliSimulator::simulateSeqByGillespie(int segment_start, int &segment_length
                 {
                     if (simulation_method == RATE_MATRIX)
                     {
-                        handleSubs(segment_start, total_sub_rate, sub_rate_by_site, node_seq_chunk, model->getNMixtures(), rstream, generator);
+                        handleSubs(segment_start, total_sub_rate, sites, model->getNMixtures(), rstream, generator);
                     }
                     break;
                 }
@@ -2824,6 +3196,17 @@ void AliSimulator::simulateSeqByGillespie(int segment_start, int &segment_length
 
     }
     
+    // copy the simulated states back into the sequence
+    // and put the site-specific variables of the inserted sites in place
+    if (sites.getNextSiteID() > ori_seq_length)
+    {
+        vector<int> site_ids;
+        sites.exportStates(node_seq_chunk, &site_ids);
+        sortSiteSpecificVariables(site_ids, sites.getNextSiteID());
+    }
+    else
+        sites.exportStates(node_seq_chunk);
+    
     // if insertion events occur -> insert gaps to other nodes
     if (insertion_before_simulation && insertion_before_simulation->next)
     {
@@ -2846,9 +3229,34 @@ void AliSimulator::simulateSeqByGillespie(int segment_start, int &segment_length
 *  insert a new sequence into the current sequence
 *
 */
-void AliSimulator::insertNewSequenceForInsertionEvent(vector<short int> &indel_sequence, int position, vector<short int> &new_sequence, default_random_engine& generator)
+void AliSimulator::insertNewSequenceForInsertionEvent(RateSampler &sites, int position, vector<short int> &new_sequence, default_random_engine& generator)
 {
-    indel_sequence.insert(indel_sequence.begin()+position, new_sequence.begin(), new_sequence.end());
+    sites.insertSites(position, new_sequence);
+}
+
+/**
+*  reorder the elements of a vector indexed by site ID into sequence order, if it has one element per site ID
+*/
+template <class T>
+static void sortBySiteIDs(vector<T> &values, vector<int> &site_ids, int num_site_ids)
+{
+    if (values.size() != num_site_ids)
+        return;
+    vector<T> sorted_values(site_ids.size());
+    for (int i = 0; i < site_ids.size(); i++)
+        sorted_values[i] = values[site_ids[i]];
+    values.swap(sorted_values);
+}
+
+/**
+*  put the site-specific variables, indexed by site ID during the Gillespie algorithm, in sequence order
+*/
+void AliSimulator::sortSiteSpecificVariables(vector<int> &site_ids, int num_site_ids)
+{
+    sortBySiteIDs(site_specific_model_index, site_ids, num_site_ids);
+    sortBySiteIDs(site_specific_rate_index, site_ids, num_site_ids);
+    sortBySiteIDs(site_specific_rates, site_ids, num_site_ids);
+    sortBySiteIDs(site_to_patternID, site_ids, num_site_ids);
 }
 
 /**
@@ -2926,18 +3334,18 @@ void AliSimulator::updateInternalSeqsFromNodeToRoot(GenomeTree* genome_tree, int
 /**
     handle insertion events
 */
-int AliSimulator::handleInsertion(int &sequence_length, vector<short int> &indel_sequence, double &total_sub_rate, vector<double> &sub_rate_by_site, SIMULATION_METHOD simulation_method, default_random_engine& generator)
+int AliSimulator::handleInsertion(int &sequence_length, double &total_sub_rate, RateSampler &sites, SIMULATION_METHOD simulation_method, default_random_engine& generator)
 {
     // Randomly select the position/site (from the set of all sites) where the insertion event occurs
     int position;
     // with constant indel-rate -> based on a uniform distribution between 0 and the current length of the sequence
     if (!params->indel_rate_variation)
-        position = selectValidPositionForIndels(sequence_length + 1, indel_sequence);
-    // with indel-rate variation -> based on the sub_rate_by_site
+        position = selectValidPositionForIndels(sequence_length + 1, sites);
+    // with indel-rate variation -> based on the substitution rates of the sites
     else
     {
-        discrete_distribution<> random_discrete_dis(sub_rate_by_site.begin(), sub_rate_by_site.end());
-        position = random_discrete_dis(generator);
+        uniform_real_distribution<double> random_uniform_dis(0.0, 1.0);
+        position = sites.sampleSite(random_uniform_dis(generator));
     }
     
     // Randomly generate the length (length_I) of inserted sites from the indel-length distribution (​​geometric distribution (by default) or user-defined distributions).
@@ -2957,21 +3365,24 @@ int AliSimulator::handleInsertion(int &sequence_length, vector<short int> &indel
     // insert new_sequence into the current sequence
     vector<short int> new_sequence;
     generateRandomSequence(length, new_sequence, false);
-    insertNewSequenceForInsertionEvent(indel_sequence, position, new_sequence, generator);
+    int first_site_id = sites.getNextSiteID();
+    insertNewSequenceForInsertionEvent(sites, position, new_sequence, generator);
     
-    // if RATE_MATRIX approach is used -> update total_sub_rate and sub_rate_by_site
+    // if RATE_MATRIX approach is used -> update total_sub_rate and the rates of the sites
     if (simulation_method == RATE_MATRIX || params->indel_rate_variation)
     {
-        // update sub_rate_by_site of the inserted sites
+        // update the rates of the inserted sites, whose states are new_sequence
         double sub_rate_change = 0;
-        sub_rate_by_site.insert(sub_rate_by_site.begin()+position, length, 0);
         for (int i = position; i < position + length; i++)
         {
             // NHANLT: potential improvement
             // cache site_specific_model_index[i] * max_num_states
-            double sub_rate_from_model = site_specific_model_index.size() == 0 ? sub_rates[indel_sequence[i]] : sub_rates[site_specific_model_index[i] * max_num_states + indel_sequence[i]];
-            sub_rate_by_site[i] = site_specific_rates.size() > 0 ? (site_specific_rates[i] * sub_rate_from_model) : sub_rate_from_model;
-            sub_rate_change += sub_rate_by_site[i];
+            short int state = new_sequence[i - position];
+            int site_id = first_site_id + i - position;
+            double sub_rate_from_model = site_specific_model_index.size() == 0 ? sub_rates[state] : sub_rates[site_specific_model_index[site_id] * max_num_states + state];
+            double new_rate = site_specific_rates.size() > 0 ? (site_specific_rates[site_id] * sub_rate_from_model) : sub_rate_from_model;
+            sites.setRate(i, new_rate);
+            sub_rate_change += new_rate;
         }
         
         // update total_sub_rate
@@ -2993,7 +3404,7 @@ int AliSimulator::handleInsertion(int &sequence_length, vector<short int> &indel
 /**
     handle deletion events
 */
-int AliSimulator::handleDeletion(int sequence_length, vector<short int> &indel_sequence, double &total_sub_rate, vector<double> &sub_rate_by_site, SIMULATION_METHOD simulation_method, default_random_engine& generator)
+int AliSimulator::handleDeletion(int sequence_length, double &total_sub_rate, RateSampler &sites, SIMULATION_METHOD simulation_method, default_random_engine& generator)
 {
     // Randomly generate the length (length_D) of sites (which will be deleted) from the indel-length distribution.
     int length = -1;
@@ -3016,43 +3427,42 @@ int AliSimulator::handleDeletion(int sequence_length, vector<short int> &indel_s
     {
         int upper_bound = sequence_length - length;
         if (upper_bound > 0)
-            position = selectValidPositionForIndels(upper_bound, indel_sequence);
+            position = selectValidPositionForIndels(upper_bound, sites);
     }
-    // with indel-rate variation -> based on the sub_rate_by_site
+    // with indel-rate variation -> based on the substitution rates of the sites
     else
     {
-        discrete_distribution<> random_discrete_dis(sub_rate_by_site.begin(), sub_rate_by_site.end());
-        position = random_discrete_dis(generator);
+        uniform_real_distribution<double> random_uniform_dis(0.0, 1.0);
+        position = sites.sampleSite(random_uniform_dis(generator));
     }
     
     // Replace up to length_D sites by gaps from the sequence starting at the selected location
     int real_deleted_length = 0;
     double sub_rate_change = 0;
-    for (int i = 0; i < length && (position + i) < indel_sequence.size(); i++)
+    bool update_rates = simulation_method == RATE_MATRIX || params->indel_rate_variation;
+    for (int i = 0; i < length && (position + i) < sites.size(); i++)
     {
-        // if the current site is not a gap (has not been deleted) -> replacing it by a gap
-        if (indel_sequence[position + i ] != STATE_UNKNOWN)
-        {
-            indel_sequence[position + i ] = STATE_UNKNOWN;
-            real_deleted_length++;
-        }
-        // otherwise, ignore the current site, moving forward to find a valid site (not a gap)
-        else
+        short int state;
+        double rate;
+        sites.getSite(position + i, state, rate);
+        
+        // if the current site is a gap (has been deleted) -> ignore it and the following gaps, moving forward to find a valid site (not a gap)
+        if (state == STATE_UNKNOWN)
         {
+            position = sites.findNextNonGap(position + i) - i;
             i--;
-            position++;
+            continue;
         }
         
-        // if RATE_MATRIX approach is used -> update sub_rate_by_site
-        if (simulation_method == RATE_MATRIX || params->indel_rate_variation)
-        {
-            sub_rate_change -= sub_rate_by_site[position + i];
-            sub_rate_by_site[position + i] = 0;
-        }
+        // replace the current site by a gap, if RATE_MATRIX approach is used -> update the rate of the site
+        sites.setSite(position + i, STATE_UNKNOWN, update_rates ? 0.0 : rate);
+        real_deleted_length++;
+        if (update_rates)
+            sub_rate_change -= rate;
     }
     
     // if RATE_MATRIX approach is used -> update total_sub_rate
-    if (simulation_method == RATE_MATRIX || params->indel_rate_variation)
+    if (update_rates)
         total_sub_rate += sub_rate_change;
     
     // return deletion-size
@@ -3062,62 +3472,63 @@ int AliSimulator::handleDeletion(int sequence_length, vector<short int> &indel_s
 /**
     handle substitution events
 */
-void AliSimulator::handleSubs(int segment_start, double &total_sub_rate, vector<double> &sub_rate_by_site, vector<short int> &indel_sequence, int num_mixture_models, int* rstream, default_random_engine& generator)
+void AliSimulator::handleSubs(int segment_start, double &total_sub_rate, RateSampler &sites, int num_mixture_models, int* rstream, default_random_engine& generator)
 {
     // select a position where the substitution event occurs
-    discrete_distribution<> random_discrete_dis(sub_rate_by_site.begin(), sub_rate_by_site.end());
-    int pos = random_discrete_dis(generator);
+    uniform_real_distribution<double> random_uniform_dis(0.0, 1.0);
+    int pos = sites.sampleSite(random_uniform_dis(generator));
     
-    // extract the current state
-    short int current_state = indel_sequence[pos];
+    // extract the current state, the site-specific variables are indexed by the site ID
+    short int current_state;
+    double current_rate;
+    int site_id = segment_start + sites.getSite(pos, current_state, current_rate);
     
     // estimate the new state
     int mixture_index = 0;
     // randomly select a model component if mixture model at substitution level is used
-    if (site_specific_model_index.size() > segment_start + pos)
+    if (site_specific_model_index.size() > site_id)
     {
         if (params->alisim_mixture_at_sub_level)
             mixture_index = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(mixture_accumulated_weight, 0, num_mixture_models, mixture_max_weight_pos, rstream);
         else
-            mixture_index = site_specific_model_index[segment_start + pos];
+            mixture_index = site_specific_model_index[site_id];
     }
     
     int mixture_index_times_num_states = (mixture_index == 0 ? 0 : (mixture_index * max_num_states));
     int starting_index = (mixture_index_times_num_states + current_state) * max_num_states;
-    indel_sequence[pos] = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(Jmatrix, starting_index, max_num_states, max_num_states * 0.5, rstream);
+    short int new_state = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(Jmatrix, starting_index, max_num_states, max_num_states * 0.5, rstream);
     
     // update total_sub_rate
-    double sub_rate_change = sub_rates[mixture_index_times_num_states + indel_sequence[pos]] - sub_rates[mixture_index_times_num_states + current_state];
-    sub_rate_change = (site_specific_rates.size() == 0 ? sub_rate_change : (sub_rate_change * site_specific_rates[segment_start + pos]));
+    double sub_rate_change = sub_rates[mixture_index_times_num_states + new_state] - sub_rates[mixture_index_times_num_states + current_state];
+    sub_rate_change = (site_specific_rates.size() == 0 ? sub_rate_change : (sub_rate_change * site_specific_rates[site_id]));
     total_sub_rate += sub_rate_change;
     
-    // update sub_rate_by_site
-    sub_rate_by_site[pos] += sub_rate_change;
+    // update the state and the rate of the site
+    sites.setSite(pos, new_state, current_rate + sub_rate_change);
 }
 
 /**
 *  randomly select a valid position (not a deleted-site) for insertion/deletion event
 *
 */
-int AliSimulator::selectValidPositionForIndels(int upper_bound, vector<short int> &sequence)
+int AliSimulator::selectValidPositionForIndels(int upper_bound, RateSampler &sites)
 {
     int position = -1;
+    int num_sites = sites.size();
     for (int i = 0; i < upper_bound; i++)
     {
         position = random_int(upper_bound);
         
         // try to move to the following site if the selected site is a gap
-        if (position < sequence.size() && sequence[position] == STATE_UNKNOWN)
-            for (; position < upper_bound; position++)
-                if (position == sequence.size() || sequence[position] != STATE_UNKNOWN)
-                    break;
+        if (position < num_sites && sites.getState(position) == STATE_UNKNOWN)
+            position = min(sites.findNextNonGap(position), upper_bound);
         
         // a valid position must not be a deleted site
-        if (position == sequence.size() || sequence[position] != STATE_UNKNOWN)
+        if (position == num_sites || sites.getState(position) != STATE_UNKNOWN)
             break;
     }
     // validate the position
-    if (position < sequence.size() && sequence[position] == STATE_UNKNOWN)
+    if (position < num_sites && sites.getState(position) == STATE_UNKNOWN)
         outError("Sorry! Could not select a valid position (not a deleted-site) for insertion/deletion events. You may specify a too high deletion rate, thus almost all sites were deleted. Please try again a a smaller deletion ratio!");
     return position;
 }
@@ -3498,39 +3909,65 @@ void AliSimulator::updateNewGenomeIndels(int seq_length)
 *  reset tree (by setting the parents of all node to NULL) -> only using when simulating MSAs with openMP
 *
 */
-void AliSimulator::resetTree(int &max_depth, bool store_seq_at_cache, Node *node, Node *dad)
+void AliSimulator::resetTree(bool store_seq_at_cache)
 {
-    // set starting node
-    if (!node && !dad)
+    // separate root sequence into chunks
+    separateSeqIntoChunks(tree->root);
+    
+    for (vector<SimulationStep>::iterator step = scheduler.steps.begin(); step != scheduler.steps.end(); step++)
     {
-        node = tree->root;
-        dad = tree->root;
-        
-        // init depth at root
-        node->sequence->depth = 0;
-        max_depth = 0;
+        Node *node = step->dad;
+        Node *child = node->neighbors[step->neighbor_index]->node;
         
-        // separate root sequence into chunks
-        separateSeqIntoChunks(node);
-    }
-    
-    NeighborVec::iterator it;
-    FOR_NEIGHBOR(node, dad, it) {
         // update parent node of the current node
-        (*it)->node->sequence->parent = node;
-        (*it)->node->sequence->depth = node->sequence->depth + 1;
-        if ((*it)->node->sequence->depth > max_depth)
-            max_depth = (*it)->node->sequence->depth;
-        (*it)->node->sequence->num_threads_done_simulation = 0;
-        (*it)->node->sequence->num_threads_reach_barrier = 0;
+        child->sequence->parent = node;
+        child->sequence->num_threads_done_simulation = 0;
+        child->sequence->num_threads_reach_barrier = 0;
         if (!store_seq_at_cache)
-            (*it)->node->sequence->sequence_chunks.resize(num_threads);
+            child->sequence->sequence_chunks.resize(num_threads);
         node->sequence->nums_children_done_simulation.resize(num_threads);
         for (int i = 0; i < num_threads; i++)
             node->sequence->nums_children_done_simulation[i] = 0;
+    }
+}
+
+/**
+*  get the maximum number of sequences kept in memory, according to the memory cap (-mem)
+*/
+int AliSimulator::getMaxNumCachedSeqs(int sequence_length)
+{
+    double mem_cap = getMemorySize();
+    if (params->lh_mem_save == LM_MEM_SAVE && params->max_mem_size > 0)
+        mem_cap = params->max_mem_size > 1 ? params->max_mem_size : params->max_mem_size * mem_cap;
+    
+    // the sequences of all threads together take sequence_length states
+    double max_num_seqs = mem_cap / ((double) max(sequence_length, 1) * sizeof(short int));
+    return max_num_seqs >= INT_MAX ? INT_MAX : max((int) max_num_seqs, 2);
+}
+
+/**
+*  move sequences between the sequence cache and the spill file of a thread
+*/
+void AliSimulator::executeSpillActions(vector<SpillAction> &spill_actions, vector<vector<short int>> &sequence_cache, fstream &spill_file)
+{
+    for (vector<SpillAction>::iterator action = spill_actions.begin(); action != spill_actions.end(); action++)
+    {
+        vector<short int> &seq_chunk = sequence_cache[action->slot];
         
-        // browse 1-step deeper to the neighbor node
-        resetTree(max_depth, store_seq_at_cache, (*it)->node, node);
+        // all sequences of a thread have the same length
+        std::streamoff offset = (std::streamoff) action->file_slot * seq_chunk.size() * sizeof(short int);
+        if (action->to_disk)
+        {
+            spill_file.seekp(offset);
+            spill_file.write((char*) seq_chunk.data(), seq_chunk.size() * sizeof(short int));
+        }
+        else
+        {
+            spill_file.seekg(offset);
+            spill_file.read((char*) seq_chunk.data(), seq_chunk.size() * sizeof(short int));
+        }
+        if (spill_file.fail())
+            outError("Failed to spill sequences to disk (check the available disk space)");
     }
 }
 
@@ -3544,16 +3981,17 @@ void AliSimulator::separateSeqIntoChunks(Node* node)
         vector<short int> root_seq = node->sequence->sequence_chunks[0];
         assert(root_seq.size() == expected_num_sites);
         node->sequence->sequence_chunks.resize(num_simulating_threads);
-        int default_segment_length = expected_num_sites / num_simulating_threads;
+        int default_segment_length = getDefaultSegmentLength(expected_num_sites);
+        int starting_index, actual_segment_length;
         
         // resize the first chunk from the root sequence
-        node->sequence->sequence_chunks[0].resize(default_segment_length);
+        getSegment(0, expected_num_sites, default_segment_length, starting_index, actual_segment_length);
+        node->sequence->sequence_chunks[0].resize(actual_segment_length);
         
         // clone other chunks
-        int starting_index = default_segment_length;
-        for (int i = 1; i < num_simulating_threads; i++, starting_index += default_segment_length)
+        for (int i = 1; i < num_simulating_threads; i++)
         {
-            int actual_segment_length = i < num_simulating_threads - 1 ? default_segment_length : expected_num_sites - (num_simulating_threads - 1) * default_segment_length;
+            getSegment(i, expected_num_sites, default_segment_length, starting_index, actual_segment_length);
             node->sequence->sequence_chunks[i].resize(actual_segment_length);
             
             for (int j = 0; j < actual_segment_length; j++)
@@ -29,6 +29,10 @@
 #endif
 #include "utils/MPIHelper.h"
 #include "alignment/sequencechunkstr.h"
+#include "alignment/packedalignment.h"
+#include "ratesampler.h"
+#include "counterrng.h"
+#include "simulationscheduler.h"
 
 struct FunDi_Item {
   int selected_site;
@@ -76,7 +80,7 @@ protected:
     *  randomly generate the ancestral sequence for the root node
     *  by default (initial_freqs = true) freqs could be randomly generated if they are not specified
     */
-    void generateRandomSequence(int sequence_length, vector<short int> &sequence, bool initial_freqs = true);
+    void generateRandomSequence(int sequence_length, vector<short int> &sequence, bool initial_freqs = true, double *site_random_numbers = NULL);
     
     /**
     *  randomly generate the base frequencies
@@ -85,13 +89,42 @@ protected:
     
     /**
     *  get a random item from a set of items with a probability array
+    *  @param site_random_number a pre-drawn random number (e.g., from the counter-based RNG), or NULL to draw one from rstream
     */
-    int getRandomItemWithProbabilityMatrix(double *probability_maxtrix, int starting_index, int num_items, int* rstream);
+    int getRandomItemWithProbabilityMatrix(double *probability_maxtrix, int starting_index, int num_items, int* rstream, double *site_random_number = NULL);
     
     /**
     *  get a random item from a set of items with an accumulated probability array by binary search starting at the max probability
+    *  @param site_random_number a pre-drawn random number (e.g., from the counter-based RNG), or NULL to draw one from rstream
     */
-    int getRandomItemWithAccumulatedProbMatrixMaxProbFirst(double *accumulated_probability_maxtrix, int starting_index, int num_columns, int max_prob_position, int* rstream);
+    int getRandomItemWithAccumulatedProbMatrixMaxProbFirst(double *accumulated_probability_maxtrix, int starting_index, int num_columns, int max_prob_position, int* rstream, double *site_random_number = NULL);
+
+    /**
+    *  build Walker's alias tables from the rows of an accumulated probability matrix, to draw an item of a row in O(1) time
+    *  @param alias_prob (OUT) probability to keep the selected column, one per matrix entry
+    *  @param alias_item (OUT) alternative item of the selected column, one per matrix entry
+    */
+    void buildAliasTables(double *accumulated_probability_maxtrix, int num_rows, int num_columns, double *alias_prob, int *alias_item);
+    
+    /**
+    *  get a random item from a row of alias tables built by buildAliasTables()
+    */
+    int getRandomItemWithAliasTable(double *alias_prob, int *alias_item, int starting_index, int num_columns, int* rstream, double *site_random_number = NULL);
+    
+    /**
+    *  draw the random numbers for the sites of a sequence chunk from the counter-based RNG, keyed by the node and the site positions,
+    *  so that the simulated sequences do not depend on the number of threads
+    *  @param random_numbers (OUT) one random number per site, or empty if the counter-based RNG is not used
+    */
+    void generateSiteRandomNumbers(Node *node, int segment_start, int num_sites, vector<double> &random_numbers);
+
+    /**
+    *  draw the random numbers for sites from a stream of the counter-based RNG, e.g., CounterRNG::ROOT_STATE_STREAM
+    *  @param first_site position of the first site
+    *  @param random_numbers (OUT) one random number per site, or empty if the counter-based RNG is not used
+    *  @return random_numbers.data(), or NULL if the counter-based RNG is not used
+    */
+    double *generateSiteRandomNumbers(uint32_t stream_id, int first_site, int num_sites, vector<double> &random_numbers);
 
     /**
     *  convert an probability matrix into an accumulated probability matrix
@@ -109,16 +142,28 @@ protected:
     int binarysearchItemWithAccumulatedProbabilityMatrix(vector<double> &accumulated_probability_maxtrix, double random_number, int start, int end, int first);
     
     /**
-    *  simulate sequences for all nodes in the tree by DFS
+    *  simulate sequences for all nodes in the tree, following the steps of the scheduler
     *
     */
-    void simulateSeqs(int thread_id, int segment_start, int &segment_length, int &sequence_length, ModelSubst *model, double *trans_matrix, vector<vector<short int>> &sequence_cache, bool store_seq_at_cache, Node *node, Node *dad, ostream &out, vector<string> &state_mapping, map<string, string> input_msa, int* rstream, default_random_engine& generator);
+    void simulateSeqs(int thread_id, int segment_start, int &segment_length, int &sequence_length, ModelSubst *model, double *trans_matrix, vector<vector<short int>> &sequence_cache, bool store_seq_at_cache, ostream &out, vector<string> &state_mapping, map<string, string> input_msa, int* rstream, default_random_engine& generator);
     
     /**
     *  reset tree (by reset some variables of nodes)
     *
     */
-    void resetTree(int &max_depth, bool store_seq_at_cache, Node *node = NULL, Node *dad = NULL);
+    void resetTree(bool store_seq_at_cache);
+    
+    /**
+    *  get the maximum number of sequences kept in memory, according to the memory cap (-mem)
+    *
+    */
+    int getMaxNumCachedSeqs(int sequence_length);
+    
+    /**
+    *  move sequences between the sequence cache and the spill file of a thread
+    *
+    */
+    void executeSpillActions(vector<SpillAction> &spill_actions, vector<vector<short int>> &sequence_cache, fstream &spill_file);
     
     /**
     *  validate sequence length of codon
@@ -210,7 +255,7 @@ protected:
     /**
         initialize variables
     */
-    void initVariables(int sequence_length, string output_filepath, vector<string> &state_mapping, ModelSubst *model, int &default_segment_length, int &max_depth, bool &write_sequences_to_tmp_data, bool &store_seq_at_cache, default_random_engine& generator);
+    void initVariables(int sequence_length, string output_filepath, vector<string> &state_mapping, ModelSubst *model, int &default_segment_length, bool &write_sequences_to_tmp_data, bool &store_seq_at_cache, default_random_engine& generator);
     
     /**
         process after simulating sequences
@@ -219,43 +264,67 @@ protected:
     
     /**
         initialize variables (e.g., site-specific rate)
+        @param regenerate_root_sequence TRUE for the alignment (rather than a branch-specific model):
+        the root sequence may be regenerated, and the draws per site come from the counter-based RNG if it is used
     */
     virtual void initVariablesRateHeterogeneity(int sequence_length, default_random_engine& generator, bool regenerate_root_sequence = false);
     
     /**
         regenerate the root sequence if the user has specified specific state frequencies in branch-specific model
     */
-    void regenerateRootSequenceBranchSpecificModel(string freqs, int sequence_length, vector<short int> &sequence);
+    void regenerateRootSequenceBranchSpecificModel(string freqs, int sequence_length, vector<short int> &sequence, double *site_random_numbers = NULL);
     
     /**
         generate a random sequence by state frequencies
     */
-    void generateRandomSequenceFromStateFreqs(int sequence_length, vector<short int> &sequence, double* state_freqs, int max_prob_pos);
+    void generateRandomSequenceFromStateFreqs(int sequence_length, vector<short int> &sequence, double* state_freqs, int max_prob_pos, double *site_random_numbers = NULL);
     
     /**
     *  export a sequence with gaps copied from the input sequence
     */
     void exportSequenceWithGaps(vector<short int> &sequence_chunk, string &output, int sequence_length, int num_sites_per_state, string input_sequence, vector<string> &state_mapping, int segment_start = 0, int segment_length = -1);
     
+    /**
+    *  export a sequence chunk in the packed format, with gaps copied from the input sequence (if any)
+    */
+    void exportPackedSequence(vector<short int> &sequence_chunk, string &output, string &input_sequence, int segment_start, int segment_length);
+    
+    /**
+    *  init the header and the record length of the packed output
+    */
+    void initPackedOutput(vector<string> &state_mapping, bool with_gaps);
+    
+    /**
+    *  get the length of the segments simulated by each thread (except the last one)
+    */
+    int getDefaultSegmentLength(int sequence_length);
+    
+    /**
+    *  get the first site and the number of sites of the segment simulated by a thread,
+    *  segments beyond the end of a short sequence are empty
+    */
+    void getSegment(int thread_id, int sequence_length, int default_segment_length, int &segment_start, int &segment_length);
+    
     /**
         handle indels
+        @param sites sampler of the sites, reinitialized from node_seq_chunk
     */
-    void simulateSeqByGillespie(int segment_start, int &segment_length, ModelSubst *model, vector<short int> &node_seq_chunk, int &sequence_length, NeighborVec::iterator it, SIMULATION_METHOD simulation_method, int *rstream, default_random_engine& generator);
+    void simulateSeqByGillespie(int segment_start, int &segment_length, ModelSubst *model, vector<short int> &node_seq_chunk, int &sequence_length, NeighborVec::iterator it, SIMULATION_METHOD simulation_method, RateSampler &sites, int *rstream, default_random_engine& generator);
     
     /**
         handle substitution events
     */
-    void handleSubs(int segment_start, double &total_sub_rate, vector<double> &sub_rate_by_site, vector<short int> &indel_sequence, int num_mixture_models, int* rstream, default_random_engine& generator);
+    void handleSubs(int segment_start, double &total_sub_rate, RateSampler &sites, int num_mixture_models, int* rstream, default_random_engine& generator);
     
     /**
         handle insertion events, return the insertion-size
     */
-    int handleInsertion(int &sequence_length, vector<short int> &indel_sequence, double &total_sub_rate, vector<double> &sub_rate_by_site, SIMULATION_METHOD simulation_method, default_random_engine& generator);
+    int handleInsertion(int &sequence_length, double &total_sub_rate, RateSampler &sites, SIMULATION_METHOD simulation_method, default_random_engine& generator);
     
     /**
         handle deletion events, return the deletion-size
     */
-    int handleDeletion(int sequence_length, vector<short int> &indel_sequence, double &total_sub_rate, vector<double> &sub_rate_by_site, SIMULATION_METHOD simulation_method, default_random_engine& generator);
+    int handleDeletion(int sequence_length, double &total_sub_rate, RateSampler &sites, SIMULATION_METHOD simulation_method, default_random_engine& generator);
     
     /**
         extract array of substitution rates and Jmatrix
@@ -269,9 +338,14 @@ protected:
     
     /**
     *  insert a new sequence into the current sequence
-    *
+    *  the site-specific variables of the new sites are appended, as they are indexed by site ID until sortSiteSpecificVariables()
+    */
+    virtual void insertNewSequenceForInsertionEvent(RateSampler &sites, int position, vector<short int> &new_sequence, default_random_engine& generator);
+    
+    /**
+    *  put the site-specific variables, indexed by site ID during the Gillespie algorithm, in sequence order
     */
-    virtual void insertNewSequenceForInsertionEvent(vector<short int> &indel_sequence, int position, vector<short int> &new_sequence, default_random_engine& generator);
+    void sortSiteSpecificVariables(vector<int> &site_ids, int num_site_ids);
     
     /**
     *  update internal sequences due to Indels
@@ -295,7 +369,7 @@ protected:
     *  randomly select a valid position (not a deleted-site) for insertion/deletion event
     *
     */
-    int selectValidPositionForIndels(int upper_bound, vector<short int> &sequence);
+    int selectValidPositionForIndels(int upper_bound, RateSampler &sites);
     
     /**
         generate indel-size from its distribution
@@ -382,6 +456,23 @@ protected:
     */
     void writeAllSeqChunkFromCache(ostream *&output);
     
+    /**
+        compress a block of output into an independent gzip member, so that members compressed by different threads
+        could be concatenated into a single gzip file
+    */
+    string compressBlock(const string &block);
+    
+    /**
+        write a sequence chunk into its line (compressed output with multiple threads),
+        a completed line is appended to the block of the writing thread, which is compressed and written when it is full
+    */
+    void assembleSeqChunkIntoLine(ostream *&out, int64_t pos, string &chunk_str);
+    
+    /**
+        compress and write the block of the writing thread (compressed output with multiple threads)
+    */
+    void writeCompressedBlock(ostream *&out, string &block);
+    
     /**
         cache a sequence chunk (in readable string) into the cache (writing queue)
     */
@@ -395,12 +486,12 @@ protected:
     /**
     *  simulate sequences with AliSim-OpenMP-IM algorithm
     */
-    void executeIM(int thread_id, int &sequence_length, int default_segment_length, ModelSubst *model, map<string,string> input_msa, string output_filepath, std::ios_base::openmode open_mode, bool write_sequences_to_tmp_data, bool store_seq_at_cache, int max_depth, vector<string> &state_mapping);
+    void executeIM(int thread_id, int &sequence_length, int default_segment_length, ModelSubst *model, map<string,string> input_msa, string output_filepath, std::ios_base::openmode open_mode, bool write_sequences_to_tmp_data, bool store_seq_at_cache, vector<string> &state_mapping);
     
     /**
     *  simulate sequences with AliSim-OpenMP-EM algorithm
     */
-    void executeEM(int thread_id, int &sequence_length, int default_segment_length, ModelSubst *model, map<string,string> input_msa, string output_filepath, std::ios_base::openmode open_mode, bool write_sequences_to_tmp_data, bool store_seq_at_cache, int max_depth, vector<string> &state_mapping);
+    void executeEM(int thread_id, int &sequence_length, int default_segment_length, ModelSubst *model, map<string,string> input_msa, string output_filepath, std::ios_base::openmode open_mode, bool write_sequences_to_tmp_data, bool store_seq_at_cache, vector<string> &state_mapping);
     
     /**
         merge output files when using multiple threads
@@ -430,6 +521,8 @@ public:
     vector<double> site_specific_rates;
     const int RATE_ZERO_INDEX = -1;
     const int RATE_ONE_INDEX = 0;
+    // minimum number of states to draw child states from alias tables instead of binary search (e.g., protein, codon)
+    const int ALIAS_TABLE_MIN_NUM_STATES = 20;
     double* sub_rates;
     double* Jmatrix;
     double* mixture_accumulated_weight = NULL;
@@ -451,6 +544,18 @@ public:
     int cache_size_per_thread;
     bool force_output_PHYLIP = false;
     
+    // variables to output compressed sequences with multiple threads, without seeking in the output file
+    bool write_compressed_blocks = false; // compress independent blocks into gzip members instead of using ogzstream
+    map<int64_t, pair<string, int64_t>> pending_lines; // lines being assembled from sequence chunks and their number of received characters
+    string pending_block; // completed lines waiting to be compressed by the writing thread
+    const size_t COMPRESSED_BLOCK_SIZE = 1 << 20;
+    
+    // the header of the output in packed format, the gap (if any) has the code right after the last state
+    PackedAlignmentHeader packed_header;
+    
+    // traversal order and sequence cache plan of the simulation
+    SimulationScheduler scheduler;
+    
     // variables using for posterior mean rates/state frequencies
     bool applyPosRateHeterogeneity = false;
     double* ptn_state_freq = NULL;
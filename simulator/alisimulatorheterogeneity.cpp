@@ -38,7 +38,7 @@ AliSimulatorHeterogeneity::AliSimulatorHeterogeneity(AliSimulator *alisimulator)
 /**
     initialize site specific model index based on its weights in the mixture model
 */
-void AliSimulatorHeterogeneity::intializeSiteSpecificModelIndex(int sequence_length, vector<short int> &new_site_specific_model_index, IntVector &site_to_patternID)
+void AliSimulatorHeterogeneity::intializeSiteSpecificModelIndex(int sequence_length, vector<short int> &new_site_specific_model_index, IntVector &site_to_patternID, double *site_random_numbers)
 {
     new_site_specific_model_index.resize(sequence_length);
     
@@ -47,7 +47,7 @@ void AliSimulatorHeterogeneity::intializeSiteSpecificModelIndex(int sequence_len
     {
         // if inference_mode is used -> randomly select a model for each site based on the posterior model probability
         if (tree->params->alisim_inference_mode)
-            intSiteSpecificModelIndexPosteriorProb(sequence_length, new_site_specific_model_index, site_to_patternID);
+            intSiteSpecificModelIndexPosteriorProb(sequence_length, new_site_specific_model_index, site_to_patternID, site_random_numbers);
         // otherwise, randomly select a model for each site based on the weights of model components
         else
         {
@@ -92,7 +92,7 @@ void AliSimulatorHeterogeneity::intializeSiteSpecificModelIndex(int sequence_len
             for (int i = 0; i < sequence_length; i++)
             {
                 // randomly select a model from the set of model components, considering its probability array.
-                new_site_specific_model_index[i] = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(mixture_accumulated_weight, 0, num_models, mixture_max_weight_pos, NULL);
+                new_site_specific_model_index[i] = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(mixture_accumulated_weight, 0, num_models, mixture_max_weight_pos, NULL, site_random_numbers ? &site_random_numbers[i] : NULL);
             }
             
             // delete the mixture_accumulated_weight if mixture model at substitution level is not used
@@ -117,7 +117,7 @@ void AliSimulatorHeterogeneity::intializeSiteSpecificModelIndex(int sequence_len
 /**
     initialize site specific model index based on posterior model probability
 */
-void AliSimulatorHeterogeneity::intSiteSpecificModelIndexPosteriorProb(int sequence_length, vector<short int> &new_site_specific_model_index, IntVector &site_to_patternID)
+void AliSimulatorHeterogeneity::intSiteSpecificModelIndexPosteriorProb(int sequence_length, vector<short int> &new_site_specific_model_index, IntVector &site_to_patternID, double *site_random_numbers)
 {
     // dummy variables
     int nmixture = tree->getModel()->getNMixtures();
@@ -128,7 +128,7 @@ void AliSimulatorHeterogeneity::intSiteSpecificModelIndexPosteriorProb(int seque
     ASSERT(site_to_patternID.size() >= sequence_length);
     for (int i = 0; i < sequence_length; i++)
     {
-        double rand_num = random_double();
+        double rand_num = site_random_numbers ? site_random_numbers[i] : random_double();
         // extract pattern id from site id
         int site_pattern_id = site_to_patternID[i];
         
@@ -147,7 +147,7 @@ void AliSimulatorHeterogeneity::intSiteSpecificModelIndexPosteriorProb(int seque
 /**
     regenerate ancestral sequence based on mixture model component base fequencies
 */
-vector<short int> AliSimulatorHeterogeneity::regenerateSequenceMixtureModel(int length, vector<short int> &new_site_specific_model_index){
+vector<short int> AliSimulatorHeterogeneity::regenerateSequenceMixtureModel(int length, vector<short int> &new_site_specific_model_index, double *site_random_numbers){
     // dummy variables
     ModelSubst* model = tree->getModel();
     int num_models = model->getNMixtures();
@@ -179,7 +179,7 @@ vector<short int> AliSimulatorHeterogeneity::regenerateSequenceMixtureModel(int
     int num_states_minus_one = num_states - 1;
     for (int i = 0; i < length; i++)
     {
-        double rand_num = random_double();
+        double rand_num = site_random_numbers ? site_random_numbers[i] : random_double();
         // NHANLT: potential improvement
         // cache new_site_specific_model_index[i]*num_states
         int starting_index = new_site_specific_model_index[i] * num_states;
@@ -221,7 +221,7 @@ void AliSimulatorHeterogeneity::extractPatternPosteriorFreqsAndModelProb()
 /**
     regenerate sequence based on posterior mean state frequencies (for mixture models)
 */
-vector<short int> AliSimulatorHeterogeneity::regenerateSequenceMixtureModelPosteriorMean(int length, IntVector &site_to_patternID)
+vector<short int> AliSimulatorHeterogeneity::regenerateSequenceMixtureModelPosteriorMean(int length, IntVector &site_to_patternID, double *site_random_numbers)
 {
     ASSERT(tree->params->alisim_stationarity_heterogeneity == POSTERIOR_MEAN);
     
@@ -245,7 +245,7 @@ vector<short int> AliSimulatorHeterogeneity::regenerateSequenceMixtureModelPoste
     int max_num_states_minus_one = max_num_states - 1;
     for (int i = 0; i < length; i++)
     {
-        double rand_num = random_double();
+        double rand_num = site_random_numbers ? site_random_numbers[i] : random_double();
         // extract pattern id from site id
         int site_pattern_id = site_to_patternID[i];
         
@@ -312,7 +312,7 @@ void AliSimulatorHeterogeneity::intializeCachingAccumulatedTransMatrices(double
 /**
   estimate the state from accumulated trans_matrices
 */
-int AliSimulatorHeterogeneity::estimateStateFromAccumulatedTransMatrices(double *cache_trans_matrix, double site_specific_rate, int site_index, int num_rate_categories, int dad_state, int* rstream)
+int AliSimulatorHeterogeneity::estimateStateFromAccumulatedTransMatrices(double *cache_trans_matrix, double site_specific_rate, int site_index, int num_rate_categories, int dad_state, int* rstream, double *alias_prob, int *alias_item, double *site_random_number)
 {
     // randomly select the state, considering it's dad states, and the accumulated trans_matrices
     int model_index_times_num_rate_categories = site_specific_model_index[site_index];
@@ -327,13 +327,15 @@ int AliSimulatorHeterogeneity::estimateStateFromAccumulatedTransMatrices(double
     
     starting_index = (starting_index + dad_state) * max_num_states;
   
-    return getRandomItemWithAccumulatedProbMatrixMaxProbFirst(cache_trans_matrix, starting_index, max_num_states, dad_state, rstream);
+    if (alias_prob)
+        return getRandomItemWithAliasTable(alias_prob, alias_item, starting_index, max_num_states, rstream, site_random_number);
+    return getRandomItemWithAccumulatedProbMatrixMaxProbFirst(cache_trans_matrix, starting_index, max_num_states, dad_state, rstream, site_random_number);
 }
 
 /**
   estimate the state from an original trans_matrix
 */
-int AliSimulatorHeterogeneity::estimateStateFromOriginalTransMatrix(ModelSubst *model, int model_component_index, double rate, double *trans_matrix, double branch_length, int dad_state, int site_index, int* rstream)
+int AliSimulatorHeterogeneity::estimateStateFromOriginalTransMatrix(ModelSubst *model, int model_component_index, double rate, double *trans_matrix, double branch_length, int dad_state, int site_index, int* rstream, double *site_random_number)
 {
     double combine_rate = partition_rate * params->alisim_branch_scale;
     // Bug fixed
@@ -368,7 +370,7 @@ int AliSimulatorHeterogeneity::estimateStateFromOriginalTransMatrix(ModelSubst *
     // cache dad_state * max_num_states
     // iteratively select the state, considering it's dad states, and the transition_probability_matrix
     int starting_index = dad_state * max_num_states;
-    return getRandomItemWithProbabilityMatrix(trans_matrix, starting_index, max_num_states, rstream);
+    return getRandomItemWithProbabilityMatrix(trans_matrix, starting_index, max_num_states, rstream, site_random_number);
 }
 
 /**
@@ -387,7 +389,7 @@ void AliSimulatorHeterogeneity::getSiteSpecificRatesContinuousGamma(vector<doubl
 /**
     get site-specific rates based on Discrete Distribution (Gamma/FreeRate)
 */
-void AliSimulatorHeterogeneity::getSiteSpecificRatesDiscrete(vector<short int> &new_site_specific_rate_index, vector<double> &site_specific_rates, int sequence_length)
+void AliSimulatorHeterogeneity::getSiteSpecificRatesDiscrete(vector<short int> &new_site_specific_rate_index, vector<double> &site_specific_rates, int sequence_length, double *site_random_numbers)
 {
     int num_rate_categories = rate_heterogeneity->getNDiscreteRate();
     
@@ -432,7 +434,7 @@ void AliSimulatorHeterogeneity::getSiteSpecificRatesDiscrete(vector<short int> &
     for (int i = 0; i < sequence_length; i++)
     {
         // randomly select a rate from the set of rate categories, considering its probability array.
-        int rate_category = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(category_probability_matrix, 0, num_rate_categories, max_prob_pos, NULL);
+        int rate_category = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(category_probability_matrix, 0, num_rate_categories, max_prob_pos, NULL, site_random_numbers ? &site_random_numbers[i] : NULL);
         
         // if rate_category == -1 <=> this site is invariant -> return dad's state
         if (rate_category == -1)
@@ -454,7 +456,7 @@ void AliSimulatorHeterogeneity::getSiteSpecificRatesDiscrete(vector<short int> &
 /**
     get site-specific on Posterior Mean Rates (Discrete Gamma/FreeRate)
 */
-void AliSimulatorHeterogeneity::getSiteSpecificPosteriorRateHeterogeneity(vector<short int> &new_site_specific_rate_index, vector<double> &site_specific_rates, int sequence_length, IntVector &site_to_patternID)
+void AliSimulatorHeterogeneity::getSiteSpecificPosteriorRateHeterogeneity(vector<short int> &new_site_specific_rate_index, vector<double> &site_specific_rates, int sequence_length, IntVector &site_to_patternID, double *site_random_numbers)
 {
     int num_rates = rate_heterogeneity->getNDiscreteRate();
     
@@ -510,7 +512,7 @@ void AliSimulatorHeterogeneity::getSiteSpecificPosteriorRateHeterogeneity(vector
             // extract pattern id from site id
             int site_pattern_id = site_to_patternID[i];
             int starting_index = site_pattern_id * num_rates;
-            double rand_num = random_double();
+            double rand_num = site_random_numbers ? site_random_numbers[i] : random_double();
             int rate_cat = binarysearchItemWithAccumulatedProbabilityMatrix(ptn_accumulated_rate_dis, rand_num, starting_index, starting_index + num_rates - 1, starting_index);
             
             // if rate_category == -1 <=> this site is invariant
@@ -538,7 +540,7 @@ void AliSimulatorHeterogeneity::getSiteSpecificPosteriorRateHeterogeneity(vector
 /**
     get site-specific rates
 */
-void AliSimulatorHeterogeneity::getSiteSpecificRates(vector<short int> &new_site_specific_rate_index, vector<double> &site_specific_rates, vector<short int> &new_site_specific_model_index, int sequence_length, IntVector &site_to_patternID, default_random_engine& generator)
+void AliSimulatorHeterogeneity::getSiteSpecificRates(vector<short int> &new_site_specific_rate_index, vector<double> &site_specific_rates, vector<short int> &new_site_specific_model_index, int sequence_length, IntVector &site_to_patternID, default_random_engine& generator, double *site_random_numbers)
 {
     new_site_specific_rate_index.resize(sequence_length);
     site_specific_rates.resize(sequence_length, 1);
@@ -552,7 +554,7 @@ void AliSimulatorHeterogeneity::getSiteSpecificRates(vector<short int> &new_site
         for (int i = 0; i < sequence_length; i++)
         {
             // handle invariant sites
-            if (random_double() <= invariant_prop)
+            if ((site_random_numbers ? site_random_numbers[i] : random_double()) <= invariant_prop)
             {
                 new_site_specific_rate_index[i] = RATE_ZERO_INDEX;
                 site_specific_rates[i] = 0;
@@ -591,9 +593,9 @@ void AliSimulatorHeterogeneity::getSiteSpecificRates(vector<short int> &new_site
         else
         {
             if (applyPosRateHeterogeneity)
-                getSiteSpecificPosteriorRateHeterogeneity(new_site_specific_rate_index, site_specific_rates, sequence_length, site_to_patternID);
+                getSiteSpecificPosteriorRateHeterogeneity(new_site_specific_rate_index, site_specific_rates, sequence_length, site_to_patternID, site_random_numbers);
             else
-                getSiteSpecificRatesDiscrete(new_site_specific_rate_index, site_specific_rates, sequence_length);
+                getSiteSpecificRatesDiscrete(new_site_specific_rate_index, site_specific_rates, sequence_length, site_random_numbers);
         }
     }
 }
@@ -634,6 +636,21 @@ void AliSimulatorHeterogeneity::simulateASequenceFromBranchAfterInitVariables(in
         
         // initialize caching accumulated trans_matrices
         intializeCachingAccumulatedTransMatrices(cache_trans_matrix, num_models, num_rate_categories, branch_lengths, trans_matrix, model);
+        
+        // with many states, draw the child states from alias tables in O(1) time
+        double *alias_prob = NULL;
+        int *alias_item = NULL;
+        int num_rows = num_models * num_rate_categories * max_num_states;
+        if (max_num_states >= ALIAS_TABLE_MIN_NUM_STATES)
+        {
+            alias_prob = new double[num_rows * max_num_states];
+            alias_item = new int[num_rows * max_num_states];
+            buildAliasTables(cache_trans_matrix, num_rows, max_num_states, alias_prob, alias_item);
+        }
+        
+        // draw the random numbers from the counter-based RNG if needed
+        vector<double> random_numbers;
+        generateSiteRandomNumbers((*it)->node, segment_start, node_seq_chunk.size(), random_numbers);
 
         // estimate the sequence
         for (int i = 0 ; i < node_seq_chunk.size(); i++)
@@ -643,16 +660,25 @@ void AliSimulatorHeterogeneity::simulateASequenceFromBranchAfterInitVariables(in
                 node_seq_chunk[i] = STATE_UNKNOWN;
             else
             {
-                node_seq_chunk[i] = estimateStateFromAccumulatedTransMatrices(cache_trans_matrix, site_specific_rates[segment_start + i] , segment_start + i, num_rate_categories, dad_seq_chunk[i], rstream);
+                node_seq_chunk[i] = estimateStateFromAccumulatedTransMatrices(cache_trans_matrix, site_specific_rates[segment_start + i] , segment_start + i, num_rate_categories, dad_seq_chunk[i], rstream, alias_prob, alias_item, random_numbers.empty() ? NULL : &random_numbers[i]);
             }
         }
         
         // delete cache_trans_matrix
         delete [] cache_trans_matrix;
+        if (alias_prob)
+        {
+            delete [] alias_item;
+            delete [] alias_prob;
+        }
     }
     // otherwise, estimating the sequence without trans_matrix caching
     else
     {
+        // draw the random numbers from the counter-based RNG if needed
+        vector<double> random_numbers;
+        generateSiteRandomNumbers((*it)->node, segment_start, node_seq_chunk.size(), random_numbers);
+        
         for (int i = 0 ; i < node_seq_chunk.size(); i++)
         {
             // if the parent's state is a gap -> the children's state should also be a gap
@@ -661,7 +687,7 @@ void AliSimulatorHeterogeneity::simulateASequenceFromBranchAfterInitVariables(in
             else
             {
                 // randomly select the state, considering it's dad states, and the transition_probability_matrix
-                node_seq_chunk[i] = estimateStateFromOriginalTransMatrix(model, site_specific_model_index[segment_start + i], site_specific_rates[segment_start + i], trans_matrix, (*it)->length, dad_seq_chunk[i], segment_start + i, rstream);
+                node_seq_chunk[i] = estimateStateFromOriginalTransMatrix(model, site_specific_model_index[segment_start + i], site_specific_rates[segment_start + i], trans_matrix, (*it)->length, dad_seq_chunk[i], segment_start + i, rstream, random_numbers.empty() ? NULL : &random_numbers[i]);
             }
         }
     }
@@ -672,18 +698,29 @@ void AliSimulatorHeterogeneity::simulateASequenceFromBranchAfterInitVariables(in
 */
 void AliSimulatorHeterogeneity::initVariablesRateHeterogeneity(int sequence_length, default_random_engine& generator, bool regenerate_root_sequence)
 {
+    // for the alignment, draw the model components, the root states and the rates of the sites from the counter-based RNG if needed;
+    // the regenerated root states replace those drawn from the same stream before
+    vector<double> model_random_numbers, state_random_numbers, rate_random_numbers;
+    double *site_model_random_numbers = NULL, *root_state_random_numbers = NULL, *site_rate_random_numbers = NULL;
+    if (regenerate_root_sequence)
+    {
+        site_model_random_numbers = generateSiteRandomNumbers(CounterRNG::SITE_MODEL_STREAM, 0, sequence_length, model_random_numbers);
+        root_state_random_numbers = generateSiteRandomNumbers(CounterRNG::ROOT_STATE_STREAM, 0, expected_num_sites, state_random_numbers);
+        site_rate_random_numbers = generateSiteRandomNumbers(CounterRNG::SITE_RATE_STREAM, 0, sequence_length, rate_random_numbers);
+    }
+    
     // initialize site specific model index based on its weights (in the mixture model)
-    intializeSiteSpecificModelIndex(sequence_length, site_specific_model_index, site_to_patternID);
+    intializeSiteSpecificModelIndex(sequence_length, site_specific_model_index, site_to_patternID, site_model_random_numbers);
     
     // only regenerate the ancestral sequence if mixture model is used and the ancestral sequence is not specified by the user.
     if (regenerate_root_sequence && tree->getModel()->isMixture() && !tree->params->alisim_ancestral_sequence_aln_filepath)
     {
         // re-generate sequence based on posterior mean/distribution state frequencies if users want to do so
         if (tree->getModel()->isMixtureSameQ() && tree->params->alisim_stationarity_heterogeneity == POSTERIOR_MEAN)
-            tree->root->sequence->sequence_chunks[0] = regenerateSequenceMixtureModelPosteriorMean(expected_num_sites, site_to_patternID);
+            tree->root->sequence->sequence_chunks[0] = regenerateSequenceMixtureModelPosteriorMean(expected_num_sites, site_to_patternID, root_state_random_numbers);
         // otherwise re-generate sequence based on the state frequencies the model component for each site
         else
-            tree->root->sequence->sequence_chunks[0] = regenerateSequenceMixtureModel(expected_num_sites, site_specific_model_index);
+            tree->root->sequence->sequence_chunks[0] = regenerateSequenceMixtureModel(expected_num_sites, site_specific_model_index, root_state_random_numbers);
     
         // separate root sequence into chunks
         separateSeqIntoChunks(tree->root);
@@ -691,14 +728,14 @@ void AliSimulatorHeterogeneity::initVariablesRateHeterogeneity(int sequence_leng
 
     
     // initialize site-specific rates
-    getSiteSpecificRates(site_specific_rate_index, site_specific_rates, site_specific_model_index, sequence_length, site_to_patternID, generator);
+    getSiteSpecificRates(site_specific_rate_index, site_specific_rates, site_specific_model_index, sequence_length, site_to_patternID, generator, site_rate_random_numbers);
 }
 
 /**
 *  insert a new sequence into the current sequence
 *
 */
-void AliSimulatorHeterogeneity::insertNewSequenceForInsertionEvent(vector<short int> &indel_sequence, int position, vector<short int> &new_sequence, default_random_engine& generator)
+void AliSimulatorHeterogeneity::insertNewSequenceForInsertionEvent(RateSampler &sites, int position, vector<short int> &new_sequence, default_random_engine& generator)
 {
     // init new_site_to_patternID
     IntVector new_site_to_patternID;
@@ -714,27 +751,28 @@ void AliSimulatorHeterogeneity::insertNewSequenceForInsertionEvent(vector<short
             new_site_to_patternID[i] = site_to_patternID[site_id];
         }
         
-        // insert new_site_to_patternID into site_to_patternID
-        site_to_patternID.insert(site_to_patternID.begin()+position, new_site_to_patternID.begin(), new_site_to_patternID.end());
+        // append new_site_to_patternID to site_to_patternID (indexed by site ID)
+        site_to_patternID.insert(site_to_patternID.end(), new_site_to_patternID.begin(), new_site_to_patternID.end());
     }
     
     // initialize new_site_specific_model_index
     vector<short int> new_site_specific_model_index;
     intializeSiteSpecificModelIndex(new_sequence.size(), new_site_specific_model_index, new_site_to_patternID);
     
-    // insert new_site_specific_model_index into site_specific_model_index
-    site_specific_model_index.insert(site_specific_model_index.begin()+position, new_site_specific_model_index.begin(), new_site_specific_model_index.end());
+    // append new_site_specific_model_index to site_specific_model_index (indexed by site ID)
+    ASSERT(site_specific_model_index.size() == sites.getNextSiteID());
+    site_specific_model_index.insert(site_specific_model_index.end(), new_site_specific_model_index.begin(), new_site_specific_model_index.end());
     
     // initialize new_site_specific_rates, and new_site_specific_rate_index for new sequence
     vector<double> new_site_specific_rates;
     vector<short int> new_site_specific_rate_index;
     getSiteSpecificRates(new_site_specific_rate_index, new_site_specific_rates, new_site_specific_model_index, new_sequence.size(), new_site_to_patternID, generator);
     
-    // insert new_site_specific_rates into site_specific_rates
-    site_specific_rates.insert(site_specific_rates.begin()+position, new_site_specific_rates.begin(), new_site_specific_rates.end());
+    // append new_site_specific_rates to site_specific_rates (indexed by site ID)
+    site_specific_rates.insert(site_specific_rates.end(), new_site_specific_rates.begin(), new_site_specific_rates.end());
     
-    // insert new_site_specific_rate_index into site_specific_rate_index
-    site_specific_rate_index.insert(site_specific_rate_index.begin()+position, new_site_specific_rate_index.begin(), new_site_specific_rate_index.end());
+    // append new_site_specific_rate_index to site_specific_rate_index (indexed by site ID)
+    site_specific_rate_index.insert(site_specific_rate_index.end(), new_site_specific_rate_index.begin(), new_site_specific_rate_index.end());
     
     // regenerate new_sequence if mixture model is used
     if (tree->getModel()->isMixture())
@@ -748,7 +786,7 @@ void AliSimulatorHeterogeneity::insertNewSequenceForInsertionEvent(vector<short
     }
     
     // insert new_sequence into the current sequence
-    AliSimulator::insertNewSequenceForInsertionEvent(indel_sequence, position, new_sequence, generator);
+    AliSimulator::insertNewSequenceForInsertionEvent(sites, position, new_sequence, generator);
 }
 
 /**
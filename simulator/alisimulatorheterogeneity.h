@@ -20,33 +20,37 @@ protected:
     
     /**
         get site-specific rates based on Discrete Distribution (Gamma/FreeRate)
+        @param site_random_numbers one random number per site from the counter-based RNG, or NULL to draw them from the random stream
     */
-    void getSiteSpecificRatesDiscrete(vector<short int> &new_site_specific_rate_index, vector<double> &site_specific_rates, int sequence_length);
+    void getSiteSpecificRatesDiscrete(vector<short int> &new_site_specific_rate_index, vector<double> &site_specific_rates, int sequence_length, double *site_random_numbers = NULL);
     
     /**
         get site-specific on Posterior Mean Rates (Discrete Gamma/FreeRate)
+        @param site_random_numbers one random number per site from the counter-based RNG, or NULL to draw them from the random stream
     */
-    void getSiteSpecificPosteriorRateHeterogeneity(vector<short int> &new_site_specific_rate_index, vector<double> &site_specific_rates, int sequence_length, IntVector &site_to_patternID);
+    void getSiteSpecificPosteriorRateHeterogeneity(vector<short int> &new_site_specific_rate_index, vector<double> &site_specific_rates, int sequence_length, IntVector &site_to_patternID, double *site_random_numbers = NULL);
     
     /**
-      estimate the state from accumulated trans_matrices
+      estimate the state from accumulated trans_matrices, or from their alias tables if given
     */
-    virtual int estimateStateFromAccumulatedTransMatrices(double *cache_trans_matrix, double site_specific_rate, int site_index, int num_rate_categories, int dad_state, int* rstream);
+    virtual int estimateStateFromAccumulatedTransMatrices(double *cache_trans_matrix, double site_specific_rate, int site_index, int num_rate_categories, int dad_state, int* rstream, double *alias_prob = NULL, int *alias_item = NULL, double *site_random_number = NULL);
     
     /**
       estimate the state from an original trans_matrix
     */
-    virtual int estimateStateFromOriginalTransMatrix(ModelSubst *model, int model_component_index, double rate, double *trans_matrix, double branch_length, int dad_state, int site_index, int* rstream);
+    virtual int estimateStateFromOriginalTransMatrix(ModelSubst *model, int model_component_index, double rate, double *trans_matrix, double branch_length, int dad_state, int site_index, int* rstream, double *site_random_number = NULL);
     
     /**
         initialize site specific model index based on its weights in the mixture model
+        @param site_random_numbers one random number per site from the counter-based RNG, or NULL to draw them from the random stream
     */
-    void intializeSiteSpecificModelIndex(int length, vector<short int> &new_site_specific_model_index, IntVector &site_to_patternID);
+    void intializeSiteSpecificModelIndex(int length, vector<short int> &new_site_specific_model_index, IntVector &site_to_patternID, double *site_random_numbers = NULL);
     
     /**
         initialize site specific model index based on posterior model probability
+        @param site_random_numbers one random number per site from the counter-based RNG, or NULL to draw them from the random stream
     */
-    void intSiteSpecificModelIndexPosteriorProb(int length, vector<short int> &new_site_specific_model_index, IntVector &site_to_patternID);
+    void intSiteSpecificModelIndexPosteriorProb(int length, vector<short int> &new_site_specific_model_index, IntVector &site_to_patternID, double *site_random_numbers = NULL);
     
     /**
         initialize caching accumulated_trans_matrix
@@ -55,13 +59,15 @@ protected:
     
     /**
         regenerate sequence based on mixture model component base fequencies
+        @param site_random_numbers one random number per site from the counter-based RNG, or NULL to draw them from the random stream
     */
-    vector<short int> regenerateSequenceMixtureModel(int length, vector<short int> &new_site_specific_model_index);
+    vector<short int> regenerateSequenceMixtureModel(int length, vector<short int> &new_site_specific_model_index, double *site_random_numbers = NULL);
     
     /**
         regenerate sequence based on posterior mean state frequencies (for mixture models)
+        @param site_random_numbers one random number per site from the counter-based RNG, or NULL to draw them from the random stream
     */
-    vector<short int> regenerateSequenceMixtureModelPosteriorMean(int length, IntVector &site_to_patternID);
+    vector<short int> regenerateSequenceMixtureModelPosteriorMean(int length, IntVector &site_to_patternID, double *site_random_numbers = NULL);
     
     /**
         simulate a sequence for a node from a specific branch after all variables has been initializing
@@ -77,7 +83,7 @@ protected:
     *  insert a new sequence into the current sequence
     *
     */
-    virtual void insertNewSequenceForInsertionEvent(vector<short int> &indel_sequence, int position, vector<short int> &new_sequence, default_random_engine& generator);
+    virtual void insertNewSequenceForInsertionEvent(RateSampler &sites, int position, vector<short int> &new_sequence, default_random_engine& generator);
     
     /**
         initialize variables for Rate_matrix approach: total_sub_rate, accumulated_rates, num_gaps
@@ -105,8 +111,10 @@ public:
     
     /**
         get site-specific rates
+        @param site_random_numbers one random number per site from the counter-based RNG, or NULL to draw them from the random stream
+        (rates from a continuous gamma distribution are always drawn from generator)
     */
-    void getSiteSpecificRates(vector<short int> &new_site_specific_rate_index, vector<double> &new_site_specific_rates, vector<short int> &new_site_specific_model_index, int sequence_length, IntVector &site_to_patternID, default_random_engine& generator);
+    void getSiteSpecificRates(vector<short int> &new_site_specific_rate_index, vector<double> &new_site_specific_rates, vector<short int> &new_site_specific_model_index, int sequence_length, IntVector &site_to_patternID, default_random_engine& generator, double *site_random_numbers = NULL);
 };
 
 #endif /* alisimulatorheterogeneity_h */
@@ -32,25 +32,25 @@ void AliSimulatorHeterogeneityInvar::getSiteSpecificRatesContinuousGamma(vector<
 /**
   estimate the state from accumulated trans_matrices
 */
-int AliSimulatorHeterogeneityInvar::estimateStateFromAccumulatedTransMatrices(double *cache_trans_matrix, double site_specific_rate, int site_index, int num_rate_categories, int dad_state, int* rstream)
+int AliSimulatorHeterogeneityInvar::estimateStateFromAccumulatedTransMatrices(double *cache_trans_matrix, double site_specific_rate, int site_index, int num_rate_categories, int dad_state, int* rstream, double *alias_prob, int *alias_item, double *site_random_number)
 {
     // if this site is invariant -> preserve the dad's state
     if (site_specific_rate == 0)
         return dad_state;
     
     // otherwise, randomly select the state, considering it's dad states, and the accumulated trans_matrices
-    return AliSimulatorHeterogeneity::estimateStateFromAccumulatedTransMatrices(cache_trans_matrix, site_specific_rate, site_index, num_rate_categories, dad_state, rstream);
+    return AliSimulatorHeterogeneity::estimateStateFromAccumulatedTransMatrices(cache_trans_matrix, site_specific_rate, site_index, num_rate_categories, dad_state, rstream, alias_prob, alias_item, site_random_number);
 }
 
 /**
   estimate the state from an original trans_matrix
 */
-int AliSimulatorHeterogeneityInvar::estimateStateFromOriginalTransMatrix(ModelSubst *model, int model_component_index, double rate, double *trans_matrix, double branch_length, int dad_state, int site_index, int* rstream)
+int AliSimulatorHeterogeneityInvar::estimateStateFromOriginalTransMatrix(ModelSubst *model, int model_component_index, double rate, double *trans_matrix, double branch_length, int dad_state, int site_index, int* rstream, double *site_random_number)
 {
     // if this site is invariant -> preserve the dad's state
     if (rate == 0)
         return dad_state;
     
     // otherwise, select the state, considering it's dad states, and the transition_probability_matrix
-    return AliSimulatorHeterogeneity::estimateStateFromOriginalTransMatrix(model, model_component_index, rate, trans_matrix, branch_length, dad_state, site_index, rstream);
+    return AliSimulatorHeterogeneity::estimateStateFromOriginalTransMatrix(model, model_component_index, rate, trans_matrix, branch_length, dad_state, site_index, rstream, site_random_number);
 }
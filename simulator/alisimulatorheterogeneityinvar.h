@@ -21,14 +21,14 @@ protected:
     virtual void getSiteSpecificRatesContinuousGamma(vector<double> &site_specific_rates, int sequence_length, default_random_engine& generator);
     
     /**
-      estimate the state from accumulated trans_matrices
+      estimate the state from accumulated trans_matrices, or from their alias tables if given
     */
-    virtual int estimateStateFromAccumulatedTransMatrices(double *cache_trans_matrix, double site_specific_rate, int site_index, int num_rate_categories, int dad_state, int* rstream);
+    virtual int estimateStateFromAccumulatedTransMatrices(double *cache_trans_matrix, double site_specific_rate, int site_index, int num_rate_categories, int dad_state, int* rstream, double *alias_prob = NULL, int *alias_item = NULL, double *site_random_number = NULL);
     
     /**
       estimate the state from an original trans_matrix
     */
-    virtual int estimateStateFromOriginalTransMatrix(ModelSubst *model, int model_component_index, double rate, double *trans_matrix, double branch_length, int dad_state, int site_index, int* rstream);
+    virtual int estimateStateFromOriginalTransMatrix(ModelSubst *model, int model_component_index, double rate, double *trans_matrix, double branch_length, int dad_state, int site_index, int* rstream, double *site_random_number = NULL);
     
 public:
     
@@ -49,6 +49,20 @@ void AliSimulatorInvar::simulateASequenceFromBranchAfterInitVariables(int segmen
     // convert the probability matrix into an accumulated probability matrix
     convertProMatrixIntoAccumulatedProMatrix(trans_matrix, max_num_states, max_num_states);
     
+    // with many states, draw the child states from alias tables in O(1) time
+    vector<double> alias_prob;
+    vector<int> alias_item;
+    if (max_num_states >= ALIAS_TABLE_MIN_NUM_STATES)
+    {
+        alias_prob.resize(max_num_states * max_num_states);
+        alias_item.resize(max_num_states * max_num_states);
+        buildAliasTables(trans_matrix, max_num_states, max_num_states, alias_prob.data(), alias_item.data());
+    }
+    
+    // draw the random numbers from the counter-based RNG if needed
+    vector<double> random_numbers;
+    generateSiteRandomNumbers((*it)->node, segment_start, node_seq_chunk.size(), random_numbers);
+    
     // estimate the sequence for the current neighbor
     for (int i = 0; i < node_seq_chunk.size(); i++)
     {
@@ -61,7 +75,10 @@ void AliSimulatorInvar::simulateASequenceFromBranchAfterInitVariables(int segmen
             // NHANLT: potential improvement
             // cache parent_state * max_num_states
             int parent_state = dad_seq_chunk[i];
-            node_seq_chunk[i] = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(trans_matrix, parent_state * max_num_states, max_num_states, parent_state, rstream);
+            if (alias_prob.empty())
+                node_seq_chunk[i] = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(trans_matrix, parent_state * max_num_states, max_num_states, parent_state, rstream, random_numbers.empty() ? NULL : &random_numbers[i]);
+            else
+                node_seq_chunk[i] = getRandomItemWithAliasTable(alias_prob.data(), alias_item.data(), parent_state * max_num_states, max_num_states, rstream, random_numbers.empty() ? NULL : &random_numbers[i]);
         }
     }
 }
@@ -71,19 +88,21 @@ void AliSimulatorInvar::simulateASequenceFromBranchAfterInitVariables(int segmen
 */
 void AliSimulatorInvar::initVariablesRateHeterogeneity(int sequence_length, default_random_engine& generator, bool regenerate_root_sequence)
 {
-    initSiteSpecificRates(site_specific_rates, sequence_length);
+    // for the alignment, draw the invariant sites from the counter-based RNG if needed
+    vector<double> random_numbers;
+    initSiteSpecificRates(site_specific_rates, sequence_length, regenerate_root_sequence ? generateSiteRandomNumbers(CounterRNG::SITE_RATE_STREAM, 0, sequence_length, random_numbers) : NULL);
 }
 
 /**
   initialize site_specific_rate
 */
-void AliSimulatorInvar::initSiteSpecificRates(vector<double> &site_specific_rates, int sequence_length)
+void AliSimulatorInvar::initSiteSpecificRates(vector<double> &site_specific_rates, int sequence_length, double *site_random_numbers)
 {
     site_specific_rates.resize(sequence_length, 1);
     for (int i = 0; i < sequence_length; i++)
     {
         // if this site is invariant -> preserve the dad's state
-        if (random_double() <= invariant_proportion)
+        if ((site_random_numbers ? site_random_numbers[i] : random_double()) <= invariant_proportion)
             site_specific_rates[i] = 0;
         else
             site_specific_rates[i] = 1;
@@ -94,15 +113,16 @@ void AliSimulatorInvar::initSiteSpecificRates(vector<double> &site_specific_rate
 *  insert a new sequence into the current sequence
 *
 */
-void AliSimulatorInvar::insertNewSequenceForInsertionEvent(vector<short int> &indel_sequence, int position, vector<short int> &new_sequence, default_random_engine& generator)
+void AliSimulatorInvar::insertNewSequenceForInsertionEvent(RateSampler &sites, int position, vector<short int> &new_sequence, default_random_engine& generator)
 {
     // initialize new_site_specific_rates for new sequence
     vector<double> new_site_specific_rates;
     initSiteSpecificRates(new_site_specific_rates, new_sequence.size());
     
-    // insert new_site_specific_rates into site_specific_rates
-    site_specific_rates.insert(site_specific_rates.begin()+position, new_site_specific_rates.begin(), new_site_specific_rates.end());
+    // append new_site_specific_rates to site_specific_rates (indexed by site ID)
+    ASSERT(site_specific_rates.size() == sites.getNextSiteID());
+    site_specific_rates.insert(site_specific_rates.end(), new_site_specific_rates.begin(), new_site_specific_rates.end());
     
     // insert new_sequence into the current sequence
-    AliSimulator::insertNewSequenceForInsertionEvent(indel_sequence, position, new_sequence, generator);
+    AliSimulator::insertNewSequenceForInsertionEvent(sites, position, new_sequence, generator);
 }
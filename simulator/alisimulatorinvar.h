@@ -29,13 +29,14 @@ protected:
     *  insert a new sequence into the current sequence
     *
     */
-    virtual void insertNewSequenceForInsertionEvent(vector<short int> &indel_sequence, int position, vector<short int> &new_sequence, default_random_engine& generator);
+    virtual void insertNewSequenceForInsertionEvent(RateSampler &sites, int position, vector<short int> &new_sequence, default_random_engine& generator);
 
     
     /**
       initialize site_specific_rates
+      @param site_random_numbers one random number per site from the counter-based RNG, or NULL to draw them from the random stream
     */
-    void initSiteSpecificRates(vector<double> &site_specific_rates, int sequence_length);
+    void initSiteSpecificRates(vector<double> &site_specific_rates, int sequence_length, double *site_random_numbers = NULL);
     
 public:
     
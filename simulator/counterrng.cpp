@@ -0,0 +1,91 @@
+//
+//  counterrng.cpp
+//  iqtree
+//
+//  Counter-based random number generator (Philox4x32-10) for AliSim
+//
+
+#include "counterrng.h"
+
+// multipliers and Weyl constants of Philox4x32
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+#define PHILOX_ROUNDS 10
+
+// number of draws generated together, so that the compiler computes several of them per SIMD instruction
+#define PHILOX_BLOCK 8
+
+/**
+    convert the first 53 of 64 random bits into a double in [0, 1),
+    using only 32-bit integer conversions, which have SIMD instructions
+ */
+static inline double philoxToDouble(uint32_t c0, uint32_t c1)
+{
+    return ((int32_t) (c0 >> 5) * 67108864.0 + (int32_t) (c1 >> 6)) * (1.0 / 9007199254740992.0);
+}
+
+/**
+    Philox4x32-10 on the counter (c0, c1, c2, 0), return the first 64 bits of the output as a double in [0, 1)
+ */
+static inline double philoxDouble(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t k0, uint32_t k1)
+{
+    uint32_t c3 = 0;
+    for (int r = 0; r < PHILOX_ROUNDS; r++)
+    {
+        uint64_t prod0 = (uint64_t) PHILOX_M0 * c0;
+        uint64_t prod1 = (uint64_t) PHILOX_M1 * c2;
+        c0 = (uint32_t) (prod1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t) prod1;
+        c2 = (uint32_t) (prod0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t) prod0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    return philoxToDouble(c0, c1);
+}
+
+CounterRNG::CounterRNG(int seed, int alignment_id) {
+    key0 = (uint32_t) seed;
+    key1 = (uint32_t) alignment_id;
+}
+
+double CounterRNG::getDouble(uint32_t stream_id, uint64_t index) const {
+    return philoxDouble((uint32_t) index, (uint32_t) (index >> 32), stream_id, key0, key1);
+}
+
+void CounterRNG::generateDoubles(uint32_t stream_id, uint64_t first_index, int num, double *random_numbers) const {
+    // the same rounds as philoxDouble() on a block of counters stored as separate arrays,
+    // the draws are independent of each other, so that the inner loops are vectorized
+    uint32_t c0[PHILOX_BLOCK], c1[PHILOX_BLOCK], c2[PHILOX_BLOCK], c3[PHILOX_BLOCK];
+    for (int start = 0; start < num; start += PHILOX_BLOCK)
+    {
+        for (int j = 0; j < PHILOX_BLOCK; j++)
+        {
+            uint64_t index = first_index + start + j;
+            c0[j] = (uint32_t) index;
+            c1[j] = (uint32_t) (index >> 32);
+            c2[j] = stream_id;
+            c3[j] = 0;
+        }
+        uint32_t k0 = key0, k1 = key1;
+        for (int r = 0; r < PHILOX_ROUNDS; r++)
+        {
+            for (int j = 0; j < PHILOX_BLOCK; j++)
+            {
+                uint64_t prod0 = (uint64_t) PHILOX_M0 * c0[j];
+                uint64_t prod1 = (uint64_t) PHILOX_M1 * c2[j];
+                c0[j] = (uint32_t) (prod1 >> 32) ^ c1[j] ^ k0;
+                c1[j] = (uint32_t) prod1;
+                c2[j] = (uint32_t) (prod0 >> 32) ^ c3[j] ^ k1;
+                c3[j] = (uint32_t) prod0;
+            }
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+        int block_size = num - start < PHILOX_BLOCK ? num - start : PHILOX_BLOCK;
+        for (int j = 0; j < block_size; j++)
+            random_numbers[start + j] = philoxToDouble(c0[j], c1[j]);
+    }
+}
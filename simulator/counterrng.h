@@ -0,0 +1,62 @@
+//
+//  counterrng.h
+//  iqtree
+//
+//  Counter-based random number generator (Philox4x32-10) for AliSim
+//
+
+#ifndef counterrng_h
+#define counterrng_h
+
+#include <stdint.h>
+
+/**
+    Philox4x32-10 counter-based random number generator (Salmon et al., SC 2011).
+    Each random number is a pure function of a key (the random seed and the alignment index)
+    and a counter (a stream ID and an index in that stream), not of the order of the draws.
+    AliSim draws from it the states of the root sequence, the rate categories and mixture
+    components of the sites and the child states on every branch; its other draws (e.g.,
+    random frequencies) come from a stream seeded by the alignment index
+ */
+class CounterRNG {
+public:
+
+    /**
+        stream IDs reserved for the draws per site of the whole alignment; node IDs are smaller
+     */
+    static const uint32_t ROOT_STATE_STREAM = 0xFFFFFFFFu;
+    static const uint32_t SITE_RATE_STREAM = 0xFFFFFFFEu;
+    static const uint32_t SITE_MODEL_STREAM = 0xFFFFFFFDu;
+
+    /**
+        constructor
+        @param seed random seed
+        @param alignment_id index of the alignment (and partition) being simulated
+     */
+    CounterRNG(int seed, int alignment_id);
+
+    /**
+        @return a random number uniformly drawn from [0, 1)
+        @param stream_id ID of the stream, e.g., the node ID
+        @param index index of the random number in the stream, e.g., the site ID
+     */
+    double getDouble(uint32_t stream_id, uint64_t index) const;
+
+    /**
+        generate consecutive random numbers of a stream in a batch, which is vectorized by the compiler
+        @param stream_id ID of the stream, e.g., the node ID
+        @param first_index index of the first random number in the stream
+        @param num number of random numbers
+        @param random_numbers (OUT) random numbers uniformly drawn from [0, 1)
+     */
+    void generateDoubles(uint32_t stream_id, uint64_t first_index, int num, double *random_numbers) const;
+
+private:
+
+    /**
+        the key of the generator
+     */
+    uint32_t key0, key1;
+};
+
+#endif /* counterrng_h */
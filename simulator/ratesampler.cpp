@@ -0,0 +1,272 @@
+//
+//  ratesampler.cpp
+//  iqtree
+//
+//  Sampling of sites proportional to their rates for the Gillespie algorithm of AliSim
+//
+
+#include "ratesampler.h"
+
+RateSampler::RateSampler() {
+    root = -1;
+    num_init_sites = 0;
+    gap_state = 0;
+    priority_seed = 2463534242u;
+}
+
+uint32_t RateSampler::nextPriority() {
+    priority_seed ^= priority_seed << 13;
+    priority_seed ^= priority_seed >> 17;
+    priority_seed ^= priority_seed << 5;
+    return priority_seed;
+}
+
+void RateSampler::init(const vector<short int> &states, const vector<double> &rates, short int gap_state) {
+    this->gap_state = gap_state;
+    nodes.clear();
+    num_init_sites = states.size();
+    // leave room for inserted sites, so that the first insertions do not copy all nodes
+    nodes.reserve(states.size() + states.size() / 8 + 16);
+    root = buildTreap(states, rates);
+}
+
+void RateSampler::updateNode(int node) {
+    SiteNode &n = nodes[node];
+    n.num_sites = 1;
+    n.num_valid = (n.state != gap_state);
+    n.sum_rates = n.rate;
+    if (n.left >= 0) {
+        n.num_sites += nodes[n.left].num_sites;
+        n.num_valid += nodes[n.left].num_valid;
+        n.sum_rates += nodes[n.left].sum_rates;
+    }
+    if (n.right >= 0) {
+        n.num_sites += nodes[n.right].num_sites;
+        n.num_valid += nodes[n.right].num_valid;
+        n.sum_rates += nodes[n.right].sum_rates;
+    }
+}
+
+int RateSampler::buildTreap(const vector<short int> &states, const vector<double> &rates) {
+    int first = nodes.size(), num = states.size();
+    if (num == 0)
+        return -1;
+    nodes.resize(first + num);
+    for (int i = 0; i < num; i++) {
+        SiteNode &n = nodes[first + i];
+        n.rate = rates.empty() ? 0.0 : rates[i];
+        n.state = states[i];
+    }
+    int height;
+    return linkBalanced(first, first + num, height);
+}
+
+int RateSampler::linkBalanced(int begin, int end, int &height) {
+    if (begin >= end) {
+        height = -1;
+        return -1;
+    }
+    int middle = begin + (end - begin) / 2;
+    int left_height, right_height;
+    SiteNode &n = nodes[middle];
+    n.left = linkBalanced(begin, middle, left_height);
+    n.right = linkBalanced(middle + 1, end, right_height);
+    height = max(left_height, right_height) + 1;
+    // the height is the major part of the priority, which keeps the heap order of the treap;
+    // random minor parts break the ties with other nodes of the same height when inserting sites
+    n.priority = ((uint32_t)height << 26) | (nextPriority() >> 6);
+    updateNode(middle);
+    return middle;
+}
+
+int RateSampler::findSite(int site) const {
+    int node = root;
+    for (;;) {
+        const SiteNode &n = nodes[node];
+        int num_left = (n.left >= 0) ? nodes[n.left].num_sites : 0;
+        if (site < num_left)
+            node = n.left;
+        else if (site == num_left)
+            return node;
+        else {
+            site -= num_left + 1;
+            node = n.right;
+        }
+    }
+}
+
+int RateSampler::getSite(int site, short int &state, double &rate) const {
+    int node = findSite(site);
+    state = nodes[node].state;
+    rate = nodes[node].rate;
+    return node;
+}
+
+void RateSampler::setSite(int node, int site, short int state, double rate) {
+    SiteNode &n = nodes[node];
+    int num_left = (n.left >= 0) ? nodes[n.left].num_sites : 0;
+    if (site < num_left)
+        setSite(n.left, site, state, rate);
+    else if (site > num_left)
+        setSite(n.right, site - num_left - 1, state, rate);
+    else {
+        n.state = state;
+        n.rate = rate;
+    }
+    updateNode(node);
+}
+
+void RateSampler::split(int node, int num_sites, int &left, int &right) {
+    if (node < 0) {
+        left = right = -1;
+        return;
+    }
+    int num_left = (nodes[node].left >= 0) ? nodes[nodes[node].left].num_sites : 0;
+    if (num_sites <= num_left) {
+        int sub_right;
+        split(nodes[node].left, num_sites, left, sub_right);
+        nodes[node].left = sub_right;
+        right = node;
+    } else {
+        int sub_left;
+        split(nodes[node].right, num_sites - num_left - 1, sub_left, right);
+        nodes[node].right = sub_left;
+        left = node;
+    }
+    updateNode(node);
+}
+
+int RateSampler::merge(int left, int right) {
+    if (left < 0)
+        return right;
+    if (right < 0)
+        return left;
+    if (nodes[left].priority > nodes[right].priority) {
+        nodes[left].right = merge(nodes[left].right, right);
+        updateNode(left);
+        return left;
+    }
+    nodes[right].left = merge(left, nodes[right].left);
+    updateNode(right);
+    return right;
+}
+
+void RateSampler::insertSites(int site, const vector<short int> &states) {
+    vector<double> no_rates;
+    int middle = buildTreap(states, no_rates);
+    int left, right;
+    split(root, site, left, right);
+    root = merge(merge(left, middle), right);
+}
+
+int RateSampler::sampleSite(double random_num) const {
+    int n = size();
+    double target = random_num * getTotalRate();
+    // descend the tree to find the first site whose cumulative rate exceeds target.
+    // This is the site discrete_distribution would pick up to rounding: the tree nodes sum the rates
+    // in a different order than a running sum, so a target close to a boundary may select a
+    // neighbouring site and a given seed does not always reproduce the same simulation
+    int pos = 0, node = root;
+    double rate = 0.0;
+    while (node >= 0) {
+        const SiteNode &cur = nodes[node];
+        double left_rates = (cur.left >= 0) ? nodes[cur.left].sum_rates : 0.0;
+        int num_left = (cur.left >= 0) ? nodes[cur.left].num_sites : 0;
+        if (target < left_rates) {
+            node = cur.left;
+            continue;
+        }
+        target -= left_rates;
+        if (target < cur.rate || cur.right < 0) {
+            pos += num_left;
+            rate = cur.rate;
+            break;
+        }
+        target -= cur.rate;
+        pos += num_left + 1;
+        node = cur.right;
+    }
+    // rounding errors might select a site with a zero rate, move to the nearest positive one
+    if (rate <= 0.0) {
+        int site;
+        for (site = pos + 1; site < n && getRate(site) <= 0.0; site++) {}
+        if (site < n)
+            return site;
+        for (site = pos - 1; site >= 0 && getRate(site) <= 0.0; site--) {}
+        if (site >= 0)
+            return site;
+    }
+    return pos;
+}
+
+int RateSampler::findNextNonGap(int site) const {
+    // number of non-gap sites before site
+    int num_valid = 0, node = root, rest = site;
+    while (node >= 0 && rest > 0) {
+        const SiteNode &n = nodes[node];
+        int num_left = (n.left >= 0) ? nodes[n.left].num_sites : 0;
+        if (rest <= num_left) {
+            node = n.left;
+            continue;
+        }
+        if (n.left >= 0)
+            num_valid += nodes[n.left].num_valid;
+        num_valid += (n.state != gap_state);
+        rest -= num_left + 1;
+        node = n.right;
+    }
+    if (root < 0 || num_valid >= nodes[root].num_valid)
+        return size();
+    // position of the non-gap site with index num_valid among the non-gap sites
+    int pos = 0;
+    node = root;
+    for (;;) {
+        const SiteNode &n = nodes[node];
+        int left_valid = (n.left >= 0) ? nodes[n.left].num_valid : 0;
+        int num_left = (n.left >= 0) ? nodes[n.left].num_sites : 0;
+        if (num_valid < left_valid) {
+            node = n.left;
+            continue;
+        }
+        num_valid -= left_valid;
+        if (n.state != gap_state) {
+            if (num_valid == 0)
+                return pos + num_left;
+            num_valid--;
+        }
+        pos += num_left + 1;
+        node = n.right;
+    }
+}
+
+void RateSampler::exportStates(vector<short int> &states, vector<int> *site_ids) const {
+    int num = size();
+    states.resize(num);
+    if (site_ids)
+        site_ids->resize(num);
+    // without inserted sites, the node IDs are the positions
+    if (nodes.size() == num_init_sites) {
+        for (int i = 0; i < num; i++) {
+            states[i] = nodes[i].state;
+            if (site_ids)
+                (*site_ids)[i] = i;
+        }
+        return;
+    }
+    // iterative in-order traversal
+    vector<int> stack;
+    int node = root, pos = 0;
+    while (node >= 0 || !stack.empty()) {
+        while (node >= 0) {
+            stack.push_back(node);
+            node = nodes[node].left;
+        }
+        node = stack.back();
+        stack.pop_back();
+        states[pos] = nodes[node].state;
+        if (site_ids)
+            (*site_ids)[pos] = node;
+        pos++;
+        node = nodes[node].right;
+    }
+}
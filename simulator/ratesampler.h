@@ -0,0 +1,206 @@
+//
+//  ratesampler.h
+//  iqtree
+//
+//  Sampling of sites proportional to their rates for the Gillespie algorithm of AliSim
+//
+
+#ifndef ratesampler_h
+#define ratesampler_h
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+using namespace std;
+
+/**
+    States and rates of the sites of a sequence during the Gillespie algorithm, stored in an
+    implicit treap (a balanced binary tree keyed by site position) whose nodes keep the
+    sum of rates and the number of non-gap sites of their subtree. A site is selected proportional
+    to its rate, a site is accessed or changed and new sites are inserted in O(log L) time, so
+    that indels do not shift the whole sequence.
+    Each site also has a stable ID: the sites given to init() have IDs 0, 1, ... in sequence order and
+    inserted sites get the next IDs in the order of insertion, so that other data of the sites can be
+    appended to vectors indexed by site ID and be put in sequence order once by exportStates()
+ */
+class RateSampler {
+public:
+
+    /**
+        constructor
+     */
+    RateSampler();
+
+    /**
+        (re)build the tree in O(L) time
+        @param states state of each site
+        @param rates rate of each site, empty if all rates are zero
+        @param gap_state state of a gap (deleted site)
+     */
+    void init(const vector<short int> &states, const vector<double> &rates, short int gap_state);
+
+    /**
+        @return number of sites
+     */
+    int size() const { return (root < 0) ? 0 : nodes[root].num_sites; }
+
+    /**
+        @return rate of a site
+     */
+    double getRate(int site) const { return nodes[findSite(site)].rate; }
+
+    /**
+        @return state of a site
+     */
+    short int getState(int site) const { return nodes[findSite(site)].state; }
+
+    /**
+        @return sum of all rates in the tree
+     */
+    double getTotalRate() const { return (root < 0) ? 0.0 : nodes[root].sum_rates; }
+
+    /**
+        get the state and the rate of a site in one O(log L) descent
+        @return ID of the site
+     */
+    int getSite(int site, short int &state, double &rate) const;
+
+    /**
+        @return ID of a site
+     */
+    int getSiteID(int site) const { return findSite(site); }
+
+    /**
+        @return ID of the next inserted site, i.e., the number of site IDs
+     */
+    int getNextSiteID() const { return nodes.size(); }
+
+    /**
+        set the rate of a site in O(log L) time
+     */
+    void setRate(int site, double rate) { setSite(root, site, nodes[findSite(site)].state, rate); }
+
+    /**
+        set the state of a site in O(log L) time
+     */
+    void setState(int site, short int state) { setSite(root, site, state, nodes[findSite(site)].rate); }
+
+    /**
+        set the state and the rate of a site in one O(log L) descent
+     */
+    void setSite(int site, short int state, double rate) { setSite(root, site, state, rate); }
+
+    /**
+        insert new sites with zero rates in O(K + log L) time
+        @param site position of the first new site
+        @param states states of the new sites
+     */
+    void insertSites(int site, const vector<short int> &states);
+
+    /**
+        select a site proportional to its rate in O(log L) time
+        @param random_num a random number uniformly drawn from [0, 1)
+        @return site ID, whose rate is positive if the total rate is positive
+     */
+    int sampleSite(double random_num) const;
+
+    /**
+        @return the first site from site onwards that is not a gap, or size() if there is none
+     */
+    int findNextNonGap(int site) const;
+
+    /**
+        @param[out] states states of all sites in sequence order
+        @param[out] site_ids if not NULL, IDs of all sites in sequence order
+     */
+    void exportStates(vector<short int> &states, vector<int> *site_ids = NULL) const;
+
+private:
+
+    /**
+        a site, and the root of the subtree of the sites in its left and right subtrees
+     */
+    struct SiteNode {
+        /** children, -1 if none */
+        int left, right;
+        /** random priority, higher than those of the children */
+        uint32_t priority;
+        /** number of sites and number of non-gap sites in the subtree */
+        int num_sites, num_valid;
+        /** rate of the site and sum of the rates in the subtree */
+        double rate, sum_rates;
+        /** state of the site */
+        short int state;
+    };
+
+    /**
+        @return ID of the node of a site
+     */
+    int findSite(int site) const;
+
+    /**
+        recompute the subtree sums of a node from its children
+     */
+    void updateNode(int node);
+
+    /**
+        set the state and the rate of a site in the subtree of node, and recompute the sums on the path,
+        which keeps them exact instead of accumulating rounding errors of added differences
+     */
+    void setSite(int node, int site, short int state, double rate);
+
+    /**
+        add new nodes for the sites of states and link them into a balanced treap in O(K) time
+        @return root of the new treap
+     */
+    int buildTreap(const vector<short int> &states, const vector<double> &rates);
+
+    /**
+        link the nodes begin...end-1 into a balanced subtree
+        @param[out] height height of the subtree, -1 if it is empty
+        @return root of the subtree
+     */
+    int linkBalanced(int begin, int end, int &height);
+
+    /**
+        split a treap into its first num_sites sites and the remaining ones
+     */
+    void split(int node, int num_sites, int &left, int &right);
+
+    /**
+        @return root of the concatenation of the treaps left and right
+     */
+    int merge(int left, int right);
+
+    /**
+        @return next random priority of an xorshift generator, separate from the simulation streams
+     */
+    uint32_t nextPriority();
+
+    /**
+        all nodes, sites are never removed; the ID of a site is the index of its node
+     */
+    vector<SiteNode> nodes;
+
+    /**
+        root node, -1 if there are no sites
+     */
+    int root;
+
+    /**
+        number of sites given to init(), the nodes of the other sites were inserted
+     */
+    int num_init_sites;
+
+    /**
+        state of a gap
+     */
+    short int gap_state;
+
+    /**
+        state of the generator of priorities
+     */
+    uint32_t priority_seed;
+};
+
+#endif /* ratesampler_h */
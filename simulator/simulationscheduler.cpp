@@ -0,0 +1,247 @@
+//
+//  simulationscheduler.cpp
+//  iqtree
+//
+//  Traversal order and sequence cache plan of AliSim under a memory cap
+//
+
+#include "simulationscheduler.h"
+#include <algorithm>
+#include <set>
+
+/**
+    compare two children of a node by the number of slots needed for their subtrees
+ */
+struct ChildNumSlotsCmp {
+    Node *node;
+    vector<int> *num_slots_needed;
+
+    bool operator()(int first, int second) const
+    {
+        return (*num_slots_needed)[node->neighbors[first]->node->id] < (*num_slots_needed)[node->neighbors[second]->node->id];
+    }
+};
+
+/**
+    slots of the sequence cache and the spill file while planning the simulation
+ */
+struct SequenceCacheState {
+    int max_num_slots;
+    int num_slots;
+    int num_file_slots;
+
+    /** slot of the sequence of each node (-1 if not in the cache) */
+    vector<int> slot_of;
+
+    /** slot in the spill file of each spilled sequence */
+    vector<int> file_slot_of;
+
+    /** depth of each node */
+    vector<int> depth;
+
+    vector<int> free_slots;
+    vector<int> free_file_slots;
+
+    /** (depth, node ID) of the sequences of internal nodes in the cache */
+    set<pair<int, int> > cached_seqs;
+
+    /**
+        get a free slot of the cache, spill a sequence to disk if the cache is full
+        @param pinned_id ID of the node whose sequence must stay in the cache
+        @param spill_actions (OUT) the spill action if any
+     */
+    int allocateSlot(int pinned_id, vector<SpillAction> &spill_actions)
+    {
+        if (!free_slots.empty())
+        {
+            int slot = free_slots.back();
+            free_slots.pop_back();
+            return slot;
+        }
+        if (num_slots < max_num_slots)
+            return num_slots++;
+
+        // spill the sequence used furthest in the future, i.e., the shallowest ancestor
+        set<pair<int, int> >::iterator victim = cached_seqs.begin();
+        if (victim->second == pinned_id)
+            victim++;
+        ASSERT(victim != cached_seqs.end());
+        int id = victim->second;
+        int file_slot;
+        if (!free_file_slots.empty())
+        {
+            file_slot = free_file_slots.back();
+            free_file_slots.pop_back();
+        }
+        else
+            file_slot = num_file_slots++;
+        SpillAction action = {true, slot_of[id], file_slot};
+        spill_actions.push_back(action);
+        file_slot_of[id] = file_slot;
+        slot_of[id] = -1;
+        cached_seqs.erase(victim);
+        return action.slot;
+    }
+
+    /**
+        read a spilled sequence back to the cache
+     */
+    void reload(int id, vector<SpillAction> &spill_actions)
+    {
+        int slot = allocateSlot(-1, spill_actions);
+        SpillAction action = {false, slot, file_slot_of[id]};
+        spill_actions.push_back(action);
+        free_file_slots.push_back(file_slot_of[id]);
+        file_slot_of[id] = -1;
+        slot_of[id] = slot;
+        cached_seqs.insert(make_pair(depth[id], id));
+    }
+
+    /**
+        release the slot of a sequence
+     */
+    void release(int id)
+    {
+        free_slots.push_back(slot_of[id]);
+        cached_seqs.erase(make_pair(depth[id], id));
+        slot_of[id] = -1;
+    }
+};
+
+SimulationScheduler::SimulationScheduler()
+{
+    num_slots = 0;
+    num_file_slots = 0;
+    reordered = false;
+}
+
+int SimulationScheduler::computeNumSlotsNeeded(vector<Node*> &preorder, vector<vector<int> > &children, bool reorder)
+{
+    vector<int> num_slots_needed(children.size(), 1);
+
+    // browse the nodes in reverse preorder, so that the children are processed before their parent
+    for (vector<Node*>::reverse_iterator rit = preorder.rbegin(); rit != preorder.rend(); rit++)
+    {
+        Node *node = *rit;
+        vector<int> &node_children = children[node->id];
+        if (node_children.empty())
+            continue;
+
+        if (reorder)
+        {
+            ChildNumSlotsCmp cmp = {node, &num_slots_needed};
+            stable_sort(node_children.begin(), node_children.end(), cmp);
+        }
+
+        // the sequence of the node is kept while simulating the subtrees of all children but the last one,
+        // it is released once the sequence of the last child has been simulated
+        int num_slots_node = 2;
+        for (size_t i = 0; i < node_children.size(); i++)
+        {
+            int num_slots_child = num_slots_needed[node->neighbors[node_children[i]]->node->id];
+            if (i + 1 < node_children.size())
+                num_slots_child++;
+            num_slots_node = max(num_slots_node, num_slots_child);
+        }
+        num_slots_needed[node->id] = num_slots_node;
+    }
+    return num_slots_needed[preorder[0]->id];
+}
+
+void SimulationScheduler::plan(Node *root, int max_num_slots)
+{
+    ASSERT(max_num_slots >= 2);
+    steps.clear();
+    num_slots = 0;
+    num_file_slots = 0;
+    reordered = false;
+
+    // collect the nodes in preorder by an explicit stack (deep trees would overflow the call stack)
+    vector<Node*> preorder;
+    vector<Node*> dads;
+    vector<pair<Node*, Node*> > node_stack(1, make_pair(root, (Node*) NULL));
+    int max_id = 0;
+    while (!node_stack.empty())
+    {
+        Node *node = node_stack.back().first;
+        Node *dad = node_stack.back().second;
+        node_stack.pop_back();
+        preorder.push_back(node);
+        dads.push_back(dad);
+        max_id = max(max_id, node->id);
+        for (NeighborVec::reverse_iterator rit = node->neighbors.rbegin(); rit != node->neighbors.rend(); rit++)
+            if ((*rit)->node != dad)
+                node_stack.push_back(make_pair((*rit)->node, node));
+    }
+
+    // indices of the children in the neighbors of each node
+    vector<vector<int> > children(max_id + 1);
+    for (size_t i = 0; i < preorder.size(); i++)
+        for (size_t j = 0; j < preorder[i]->neighbors.size(); j++)
+            if (preorder[i]->neighbors[j]->node != dads[i])
+                children[preorder[i]->id].push_back(j);
+
+    // only change the order of the children (and thus the output order of sequences) if needed
+    if (computeNumSlotsNeeded(preorder, children, false) > max_num_slots)
+    {
+        reordered = true;
+        computeNumSlotsNeeded(preorder, children, true);
+    }
+
+    // generate the steps, allocating the slots of the cache on the fly
+    SequenceCacheState cache;
+    cache.max_num_slots = max_num_slots;
+    cache.num_slots = 0;
+    cache.num_file_slots = 0;
+    cache.slot_of.resize(max_id + 1, -1);
+    cache.file_slot_of.resize(max_id + 1, -1);
+    cache.depth.resize(max_id + 1, 0);
+    vector<SpillAction> no_actions;
+    cache.slot_of[root->id] = cache.allocateSlot(-1, no_actions);
+    cache.cached_seqs.insert(make_pair(0, root->id));
+
+    steps.reserve(preorder.size() - 1);
+    vector<pair<Node*, size_t> > frames(1, make_pair(root, (size_t) 0));
+    while (!frames.empty())
+    {
+        Node *dad = frames.back().first;
+        vector<int> &dad_children = children[dad->id];
+        if (frames.back().second == dad_children.size())
+        {
+            frames.pop_back();
+            continue;
+        }
+        int neighbor_index = dad_children[frames.back().second++];
+        bool last_child = frames.back().second == dad_children.size();
+        Node *node = dad->neighbors[neighbor_index]->node;
+        cache.depth[node->id] = cache.depth[dad->id] + 1;
+
+        steps.push_back(SimulationStep());
+        SimulationStep &step = steps.back();
+        step.dad = dad;
+        step.neighbor_index = neighbor_index;
+
+        // read the sequence of the parent back if it has been spilled
+        if (cache.slot_of[dad->id] < 0)
+            cache.reload(dad->id, step.spill_actions);
+        step.dad_slot = cache.slot_of[dad->id];
+        step.node_slot = cache.allocateSlot(dad->id, step.spill_actions);
+
+        // the sequence of the parent is no longer needed after simulating its last child
+        if (last_child)
+            cache.release(dad->id);
+
+        // a leaf sequence is released right after being output
+        if (children[node->id].empty())
+            cache.free_slots.push_back(step.node_slot);
+        else
+        {
+            cache.slot_of[node->id] = step.node_slot;
+            cache.cached_seqs.insert(make_pair(cache.depth[node->id], node->id));
+            frames.push_back(make_pair(node, (size_t) 0));
+        }
+    }
+
+    num_slots = cache.num_slots;
+    num_file_slots = cache.num_file_slots;
+}
@@ -0,0 +1,94 @@
+//
+//  simulationscheduler.h
+//  iqtree
+//
+//  Traversal order and sequence cache plan of AliSim under a memory cap
+//
+
+#ifndef simulationscheduler_h
+#define simulationscheduler_h
+
+#include "tree/node.h"
+
+/**
+    moving a sequence between a slot of the sequence cache and a slot of the spill file
+ */
+struct SpillAction {
+    /** TRUE to write the sequence to the spill file, FALSE to read it back */
+    bool to_disk;
+
+    /** slot of the sequence cache */
+    int slot;
+
+    /** slot of the spill file */
+    int file_slot;
+};
+
+/**
+    a simulation step: simulating the sequence of a child from the sequence of its parent
+ */
+struct SimulationStep {
+    /** the parent node */
+    Node *dad;
+
+    /** index of the child in the neighbors of the parent */
+    int neighbor_index;
+
+    /** slot of the sequence cache storing the sequence of the parent */
+    int dad_slot;
+
+    /** slot of the sequence cache receiving the sequence of the child */
+    int node_slot;
+
+    /** spill actions to execute before this step */
+    vector<SpillAction> spill_actions;
+};
+
+/**
+    Plan the simulation of all sequences along a tree in a flat list of steps (without recursion).
+    A sequence is kept in the cache only until its last child has been simulated, and a leaf sequence
+    is released right after it is output. The natural order of the children is kept if it fits in the cap;
+    otherwise, the child needing the most cache slots is visited last (Sethi-Ullman order), which needs
+    O(log(#taxa)) slots instead of O(depth). If the cap is still exceeded, the sequences which are
+    used furthest in the future (the shallowest ancestors) are spilled to disk.
+ */
+class SimulationScheduler {
+public:
+
+    /** simulation steps in their order of execution */
+    vector<SimulationStep> steps;
+
+    /** number of slots of the sequence cache (the root sequence is in slot 0) */
+    int num_slots;
+
+    /** number of slots of the spill file */
+    int num_file_slots;
+
+    /** TRUE if the children are visited in Sethi-Ullman order instead of the natural order */
+    bool reordered;
+
+    /**
+        constructor
+     */
+    SimulationScheduler();
+
+    /**
+        plan the simulation
+        @param root root of the tree
+        @param max_num_slots maximum number of sequences kept in memory
+     */
+    void plan(Node *root, int max_num_slots);
+
+private:
+
+    /**
+        order the children of each node and compute the number of slots needed for the subtree rooted at each node
+        @param preorder nodes in preorder
+        @param children (IN/OUT) indices of the children in the neighbors of each node (indexed by node ID), sorted if reorder is TRUE
+        @param reorder TRUE to visit the child with the largest subtree need last
+        @return the number of slots needed for the whole tree
+     */
+    int computeNumSlotsNeeded(vector<Node*> &preorder, vector<vector<int> > &children, bool reorder);
+};
+
+#endif /* simulationscheduler_h */
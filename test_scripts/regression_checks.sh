@@ -0,0 +1,447 @@
+#!/bin/bash -
+#===============================================================================
+#
+#          FILE: regression_checks.sh
+#
+#         USAGE: ./regression_checks.sh <iqtree_binary> [<check> ...]
+#
+#   DESCRIPTION: Quick checks that the faster code paths give the same results
+#                as the reference ones. Without check names all checks are run.
+#
+#       OPTIONS: ---
+#  REQUIREMENTS: g++, python3
+#          BUGS: ---
+#         NOTES: Run from the test_scripts directory
+#        AUTHOR:
+#  ORGANIZATION:
+#       CREATED: 2026-10-18
+#      REVISION:  ---
+#===============================================================================
+
+set -o nounset                              # Treat unset variables as an error
+
+if [ "$#" -lt 1 ]
+then
+    echo "USAGE: $0 <iqtree_binary> [<check> ...]" >&2
+    exit 1
+fi
+
+iqtree=$(readlink -f $1)
+shift
+srcDir=$(readlink -f ..)
+dataDir=$(readlink -f test_data)
+workDir=$(mktemp -d regression_XXXXXX)
+workDir=$(readlink -f $workDir)
+numFailed=0
+# number of threads for the multithreading checks
+numThreads=$(nproc)
+if [ $numThreads -gt 4 ]; then
+    numThreads=4
+fi
+
+pass() {
+    echo "PASSED: $1"
+}
+
+fail() {
+    echo "FAILED: $1"
+    numFailed=$((numFailed+1))
+}
+
+skip() {
+    echo "SKIPPED: $1 ($2)"
+}
+
+#-------------------------------------------------------------------------------
+# RateSampler selects sites proportional to their rates
+#-------------------------------------------------------------------------------
+check_ratesampler() {
+    g++ -O2 -I${srcDir} ${srcDir}/test_scripts/test_ratesampler.cpp ${srcDir}/simulator/ratesampler.cpp \
+        -o ${workDir}/test_ratesampler && ${workDir}/test_ratesampler
+    if [ $? -eq 0 ]; then pass ratesampler; else fail ratesampler; fi
+}
+
+#-------------------------------------------------------------------------------
+# AliSim draws codon states (alias tables) with the stationary frequencies
+#-------------------------------------------------------------------------------
+check_alias_freqs() {
+    cd $workDir
+    echo "(A:5,B:5,(C:5,D:5):5);" > alias.nwk
+    $iqtree --alisim alias -m GY+FQ -st CODON -t alias.nwk --length 150000 -af fasta -seed 1 -redo > alias.log 2>&1
+    # chi-square statistic of the 61 codon counts of the taxa below the root taxon A
+    python3 - alias.fa <<'PYEOF'
+import sys
+from collections import Counter
+seqs = {}
+for line in open(sys.argv[1]):
+    line = line.strip()
+    if line.startswith('>'):
+        name = line[1:].strip()
+        seqs[name] = []
+    else:
+        seqs[name].append(line)
+status = 0
+for name in ('B', 'C', 'D'):
+    seq = ''.join(seqs[name])
+    count = Counter(seq[i:i+3] for i in range(0, len(seq), 3))
+    expected = len(seq) / 3 / 61.0
+    chi2 = sum((count[codon] - expected)**2 / expected for codon in count) + (61 - len(count)) * expected
+    print('%s: chi-square %.1f with 60 degrees of freedom' % (name, chi2))
+    if len(count) > 61 or chi2 > 130:
+        status = 1
+sys.exit(status)
+PYEOF
+    if [ $? -eq 0 ]; then pass alias_freqs; else fail alias_freqs; fi
+    cd - > /dev/null
+}
+
+#-------------------------------------------------------------------------------
+# AliSim with --counter-rng gives the same alignment with 1 and more threads,
+# and the same alignments (root states and site rates included) whether they
+# are simulated one after another or concurrently with --parallel-alignments
+#-------------------------------------------------------------------------------
+check_counter_rng() {
+    if [ $numThreads -lt 2 ]; then
+        skip counter_rng "needs 2 CPU cores"
+        return
+    fi
+    cd $workDir
+    for threads in 1 $numThreads
+    do
+        $iqtree --alisim counter_rng_T$threads -t RANDOM{yh/50} -m "GTR{1/2/1/1/2}+F{0.2/0.3/0.3/0.2}+G4{0.5}" --length 20000 --counter-rng \
+            -af fasta -seed 1 -T $threads -redo > counter_rng_T$threads.log 2>&1
+    done
+    simulate="$iqtree -t RANDOM{yh/30} -m HKY+I{0.2}+G4{0.5} --length 5000 --num-alignments 3 --counter-rng -af fasta -seed 7 -redo"
+    $simulate --alisim counter_rng_seq -T 1 > counter_rng_seq.log 2>&1
+    $simulate --alisim counter_rng_par --parallel-alignments -T $numThreads > counter_rng_par.log 2>&1
+    same=1
+    cmp -s counter_rng_T1.fa counter_rng_T$numThreads.fa || same=0
+    for i in 1 2 3
+    do
+        cmp -s counter_rng_seq_$i.fa counter_rng_par_$i.fa || same=0
+    done
+    if [ $same -eq 1 ]; then pass counter_rng; else fail counter_rng; fi
+    cd - > /dev/null
+}
+
+#-------------------------------------------------------------------------------
+# multithreaded -gz output in gzip blocks decompresses to the same sequences
+# as the uncompressed single-threaded output (sequences may come in another order)
+#-------------------------------------------------------------------------------
+check_gzip_blocks() {
+    if [ $numThreads -lt 2 ]; then
+        skip gzip_blocks "needs 2 CPU cores"
+        return
+    fi
+    cd $workDir
+    simulate="$iqtree -t RANDOM{yh/200} -m GTR{1/2/1/1/2}+F{0.2/0.3/0.3/0.2}+G4{0.5} --length 50000 --counter-rng -af fasta -seed 1 -redo"
+    $simulate --alisim gzip_plain -T 1 > gzip_plain.log 2>&1
+    $simulate --alisim gzip_blocks -T $numThreads -gz > gzip_blocks.log 2>&1
+    python3 - gzip_plain.fa gzip_blocks.fa <<'PYEOF'
+import sys, gzip
+def read_fasta(filename):
+    seqs = {}
+    with open(filename, 'rb') as f:
+        compressed = f.read(2) == b'\x1f\x8b'
+    with (gzip.open(filename, 'rt') if compressed else open(filename)) as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith('>'):
+                name = line[1:].strip()
+                seqs[name] = []
+            elif line:
+                seqs[name].append(line)
+    return dict((name, ''.join(seq)) for name, seq in seqs.items())
+plain, blocks = read_fasta(sys.argv[1]), read_fasta(sys.argv[2])
+print('%d and %d sequences' % (len(plain), len(blocks)))
+sys.exit(0 if plain == blocks and len(plain) > 0 else 1)
+PYEOF
+    if [ $? -eq 0 ]; then pass gzip_blocks; else fail gzip_blocks; fi
+    cd - > /dev/null
+}
+
+#-------------------------------------------------------------------------------
+# alignments written in the packed format are read back unchanged, also when
+# AliSim writes the packed records with several threads
+#-------------------------------------------------------------------------------
+check_packed_roundtrip() {
+    cd $workDir
+    status=0
+    # converting an alignment with gaps and ambiguous states
+    cp $dataDir/example.phy packed_example.phy
+    $iqtree -s packed_example.phy --out-aln packed_ref.phy -af phy -redo > packed_ref.log 2>&1
+    $iqtree -s packed_example.phy --out-aln packed_example.packed -af packed -redo > packed_example.log 2>&1
+    $iqtree -s packed_example.packed --out-aln packed_back.phy -af phy -redo > packed_back.log 2>&1
+    cmp -s packed_ref.phy packed_back.phy || status=1
+    # simulated alignments, including one shorter than 8 sites per thread
+    for length in 1003 20
+    do
+        simulate="$iqtree -t RANDOM{yh/20} -m GTR{1/2/1/1/2}+F{0.2/0.3/0.3/0.2}+G4{0.5} --length $length --counter-rng -seed 1 -redo"
+        $simulate --alisim packed_sim_$length -af phy -T 1 > packed_sim_${length}_T1.log 2>&1
+        $simulate --alisim packed_sim_$length -af packed -T $numThreads > packed_sim_${length}_T$numThreads.log 2>&1
+        $iqtree -s packed_sim_$length.packed --out-aln packed_sim_$length.back.phy -af phy -redo > packed_sim_$length.back.log 2>&1
+        python3 - packed_sim_$length.phy packed_sim_$length.back.phy <<'PYEOF' || status=1
+import sys
+def read_phylip(filename):
+    lines = open(filename).read().split('\n')[1:]
+    return dict(line.split() for line in lines if line.strip())
+simulated, back = read_phylip(sys.argv[1]), read_phylip(sys.argv[2])
+print('%d and %d sequences' % (len(simulated), len(back)))
+sys.exit(0 if simulated == back and len(simulated) > 0 else 1)
+PYEOF
+    done
+    if [ $status -eq 0 ]; then pass packed_roundtrip; else fail packed_roundtrip; fi
+    cd - > /dev/null
+}
+
+#-------------------------------------------------------------------------------
+# AliSim spilling sequences to disk under a tiny memory cap (-mem) gives the
+# same sequences as without the cap (the simulation order may change, hence
+# --counter-rng)
+#-------------------------------------------------------------------------------
+check_spill() {
+    cd $workDir
+    simulate="$iqtree -t RANDOM{yh/200} -m GTR{1/2/1/1/2}+F{0.2/0.3/0.3/0.2}+G4{0.5} --length 100000 --counter-rng -af phy -seed 1 -redo"
+    $simulate --alisim spill_ref > spill_ref.log 2>&1
+    $simulate --alisim spill_capped -mem 0.5M > spill_capped.log 2>&1
+    status=0
+    grep -q "temporarily spilled to disk" spill_capped.log || status=1
+    python3 - spill_ref.phy spill_capped.phy <<'PYEOF' || status=1
+import sys
+def read_phylip(filename):
+    lines = open(filename).read().split('\n')[1:]
+    return dict(line.split() for line in lines if line.strip())
+ref, capped = read_phylip(sys.argv[1]), read_phylip(sys.argv[2])
+print('%d and %d sequences' % (len(ref), len(capped)))
+sys.exit(0 if ref == capped and len(ref) > 0 else 1)
+PYEOF
+    if [ $status -eq 0 ]; then pass spill; else fail spill; fi
+    cd - > /dev/null
+}
+
+#-------------------------------------------------------------------------------
+# building the alignment patterns by several threads gives the same patterns
+# and site-to-pattern map as by one thread
+#-------------------------------------------------------------------------------
+check_parallel_patterns() {
+    if [ $numThreads -lt 2 ]; then
+        skip parallel_patterns "needs 2 CPU cores"
+        return
+    fi
+    cd $workDir
+    # enough sites for the parallel builder, DNA and codons
+    $iqtree --alisim patterns_dna -t RANDOM{yh/30} -m JC --branch-scale 0.05 --length 30000 -af phy -seed 1 -redo > patterns_dna.log 2>&1
+    $iqtree --alisim patterns_codon -t RANDOM{yh/30} -m GY -st CODON --branch-scale 0.05 --length 36000 -af phy -seed 1 -redo > patterns_codon.log 2>&1
+    status=0
+    for data in dna codon
+    do
+        seqtype=DNA
+        if [ $data = codon ]; then seqtype=CODON; fi
+        for threads in 1 $numThreads
+        do
+            $iqtree -s patterns_$data.phy -st $seqtype --out-aln patterns_${data}_T$threads.phy -af phy \
+                -T $threads -pre patterns_${data}_T$threads -redo > patterns_${data}_T$threads.out 2>&1
+            grep "distinct patterns" patterns_${data}_T$threads.out > patterns_${data}_T$threads.count
+        done
+        cmp -s patterns_${data}_T1.phy patterns_${data}_T$numThreads.phy || status=1
+        cmp -s patterns_${data}_T1.count patterns_${data}_T$numThreads.count || status=1
+        [ -s patterns_${data}_T1.count ] || status=1
+    done
+    if [ $status -eq 0 ]; then pass parallel_patterns; else fail parallel_patterns; fi
+    cd - > /dev/null
+}
+
+#-------------------------------------------------------------------------------
+# the alignments parsed through a memory map have the same patterns and
+# site-to-pattern map as those parsed line by line (gzipped copies)
+#-------------------------------------------------------------------------------
+check_mmap_parse() {
+    cd $workDir
+    status=0
+    for aln in example.phy d59_8.phy prot_M126_27_269.phy
+    do
+        # FASTA copies written by the line-by-line parser
+        gzip -c $dataDir/$aln > mmap_$aln.gz
+        $iqtree -s mmap_$aln.gz --out-aln mmap_$aln.fa -af fasta -pre mmap_${aln}_convert -redo > mmap_${aln}_convert.out 2>&1
+        for input in $aln $aln.fa
+        do
+            if [ $input = $aln ]; then cp $dataDir/$aln mmap_$input; fi
+            gzip -c mmap_$input > mmap_$input.gz
+            for parser in mmap line
+            do
+                file=mmap_$input
+                if [ $parser = line ]; then file=mmap_$input.gz; fi
+                $iqtree -s $file --out-aln mmap_${input}_$parser.phy -af phy -pre mmap_${input}_$parser -v -redo > mmap_${input}_$parser.out 2>&1
+                grep "distinct patterns" mmap_${input}_$parser.out > mmap_${input}_$parser.count
+            done
+            # make sure that each parser was used
+            grep -q "memory-mapped" mmap_${input}_mmap.out || status=1
+            grep -q "memory-mapped" mmap_${input}_line.out && status=1
+            cmp -s mmap_${input}_mmap.phy mmap_${input}_line.phy || status=1
+            cmp -s mmap_${input}_mmap.count mmap_${input}_line.count || status=1
+            [ -s mmap_${input}_mmap.count ] || status=1
+            echo "$input: $(cat mmap_${input}_mmap.count)"
+        done
+    done
+    if [ $status -eq 0 ]; then pass mmap_parse; else fail mmap_parse; fi
+    cd - > /dev/null
+}
+
+#-------------------------------------------------------------------------------
+# likelihoods of the tip states match the reference values
+# (BIONJ tree, fixed model and branch lengths)
+#-------------------------------------------------------------------------------
+check_tip_states() {
+    cd $workDir
+    status=0
+    for test in "example.phy GTR{1/2/1/1/2/1}+F{0.2/0.3/0.3/0.2}+G4{0.5} -11501.3917" \
+                "prot_M126_27_269.phy LG+G4{0.5} -5048.3154"
+    do
+        set -- $test
+        cp $dataDir/$1 tip_states_$1
+        $iqtree -s tip_states_$1 -m "$2" -t BIONJ -n 0 -blfix -T 1 -redo > tip_states_$1.out 2>&1
+        logl=$(grep "Log-likelihood of the tree" tip_states_$1.iqtree | awk '{print $5}')
+        echo "$1: $logl, expected $3"
+        awk -v a="$logl" -v b="$3" 'BEGIN { d = a - b; exit (a != "" && d < 0.01 && d > -0.01) ? 0 : 1 }' || status=1
+    done
+    if [ $status -eq 0 ]; then pass tip_states; else fail tip_states; fi
+    cd - > /dev/null
+}
+
+#-------------------------------------------------------------------------------
+# transfer bootstrap supports, raw transfer distances and statistics match the
+# naive minimum transfer distances to all branches of the bootstrap trees
+#-------------------------------------------------------------------------------
+check_tbe() {
+    cd $workDir
+    cp $dataDir/example.phy tbe.phy
+    $iqtree -s tbe.phy -b 5 --tbe-raw -seed 1 -T 1 -redo > tbe.out 2>&1
+    # naive transfer distances to all branches of the bootstrap trees
+    python3 - tbe.phy <<'PYEOF'
+import sys
+prefix = sys.argv[1]
+def parse_newick(text):
+    # returns (leaf mask, label) of the inner nodes in postorder and the leaf indices by name
+    text = text.strip().rstrip(';')
+    names, clades, pos = {}, [], [0]
+    def read_token():
+        start = pos[0]
+        while pos[0] < len(text) and text[pos[0]] not in ',():':
+            pos[0] += 1
+        return text[start:pos[0]]
+    def skip_length():
+        if pos[0] < len(text) and text[pos[0]] == ':':
+            pos[0] += 1
+            read_token()
+    def read_node():
+        if text[pos[0]] == '(':
+            mask = 0
+            while text[pos[0]] in '(,':
+                pos[0] += 1
+                mask |= read_node()
+            pos[0] += 1
+            clades.append((mask, read_token()))
+        else:
+            name = read_token()
+            mask = 1 << names.setdefault(name, len(names))
+        skip_length()
+        return mask
+    read_node()
+    return clades, names
+def leaf_masks(text, names):
+    # masks of all branches of a tree, leaves numbered as in names
+    clades, tree_names = parse_newick(text)
+    index = [0] * len(tree_names)
+    for name, i in tree_names.items():
+        index[i] = names[name]
+    def convert(mask):
+        return sum(1 << index[i] for i in range(len(index)) if mask >> i & 1)
+    return [convert(mask) for mask, label in clades[:-1]] + [1 << i for i in range(len(names))]
+tree_clades, names = parse_newick(open(prefix + '.tbe.tree').read())
+raw_clades, raw_names = parse_newick(open(prefix + '.tbe.rawtree').read())
+boot_trees = [leaf_masks(line, names) for line in open(prefix + '.boottrees') if line.strip()]
+n = len(names)
+status = 0
+expected_stats = []
+# the last clade is the whole tree, the other ones are the branches of the target tree
+for (mask, label), (_, raw_label) in zip(tree_clades[:-1], raw_clades[:-1]):
+    depth = min(bin(mask).count('1'), n - bin(mask).count('1'))
+    if depth < 2:
+        continue
+    mean_dist = 0.0
+    for boot_masks in boot_trees:
+        mean_dist += min(min(d, n - d) for d in (bin(mask ^ b).count('1') for b in boot_masks))
+    mean_dist /= len(boot_trees)
+    expected_stats.append((depth, mean_dist))
+    raw = raw_label.split('|')
+    if abs(float(label) - (1.0 - mean_dist / (depth - 1))) > 1e-5 or abs(float(raw[1]) - mean_dist) > 1e-5 or int(raw[2]) != depth:
+        print('branch', label, raw_label, 'expected', 1.0 - mean_dist / (depth - 1), mean_dist, depth)
+        status = 1
+# the statistics file has the depth and mean transfer distance of each branch, then the transfer index of each taxon
+stat_lines = open(prefix + '.tbe.stat').read().split('Taxon')[0].split('\n')[1:]
+stats = sorted((int(row[1]), float(row[2])) for row in (line.split() for line in stat_lines) if row)
+if len(stats) != len(expected_stats) or any(a[0] != b[0] or abs(a[1] - b[1]) > 1e-5 for a, b in zip(stats, sorted(expected_stats))):
+    print('statistics differ')
+    status = 1
+sys.exit(status)
+PYEOF
+    if [ $? -eq 0 ]; then pass tbe; else fail tbe; fi
+    cd - > /dev/null
+}
+
+#-------------------------------------------------------------------------------
+# all-pairs RF distances streamed by tiles of trees match the distances of
+# the split maps used between two tree sets (a tree file against itself)
+#-------------------------------------------------------------------------------
+check_rf() {
+    cd $workDir
+    # a random tree made by joining random pairs of subtrees, and copies of it with up to 4 pairs of taxa swapped
+    python3 - > rf.trees <<'PYEOF'
+import random
+random.seed(1)
+subtrees = ['T%d_' % i for i in range(20)]
+while len(subtrees) > 3:
+    random.shuffle(subtrees)
+    subtrees.append('(%s,%s)' % (subtrees.pop(), subtrees.pop()))
+tree = '(%s);' % ','.join(subtrees)
+for t in range(150):
+    taxa = list(range(20))
+    for swap in range(random.randint(0, 4)):
+        a, b = random.sample(range(20), 2)
+        taxa[a], taxa[b] = taxa[b], taxa[a]
+    copy = tree
+    for i in range(20):
+        copy = copy.replace('T%d_' % i, 'X%d' % taxa[i])
+    print(copy.replace('X', 'T'))
+PYEOF
+    $iqtree -rf rf.trees rf.trees -pre rf_sets -redo > rf_sets.out 2>&1
+    status=0
+    for threads in 1 $numThreads
+    do
+        $iqtree -rf_all rf.trees -T $threads -pre rf_all_T$threads -redo > rf_all_T$threads.out 2>&1
+        cmp -s rf_sets.rfdist rf_all_T$threads.rfdist || status=1
+    done
+    [ -s rf_sets.rfdist ] || status=1
+    if [ $status -eq 0 ]; then pass rf; else fail rf; fi
+    cd - > /dev/null
+}
+
+checks="ratesampler alias_freqs counter_rng gzip_blocks packed_roundtrip spill parallel_patterns mmap_parse tip_states tbe rf"
+if [ "$#" -gt 0 ]; then
+    checks="$@"
+fi
+
+for check in $checks
+do
+    echo -e "\n=== $check ===\n"
+    check_$check
+done
+
+echo
+if [ $numFailed -eq 0 ]; then
+    echo "All checks passed"
+    rm -rf $workDir
+else
+    echo "$numFailed check(s) failed, outputs kept in $workDir"
+fi
+exit $numFailed
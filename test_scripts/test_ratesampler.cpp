@@ -0,0 +1,160 @@
+//
+//  test_ratesampler.cpp
+//  iqtree
+//
+//  Check that RateSampler selects sites with frequencies proportional to their rates,
+//  also after rates are changed and sites are inserted, and that its sites stay in
+//  the same order as in a plain vector. Compiled by regression_checks.sh
+//
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include "simulator/ratesampler.h"
+
+/**
+    draw num_samples sites and compare the counts with the expected ones
+    @return number of sites whose count deviates by more than 5 standard deviations
+*/
+int checkFrequencies(RateSampler &sampler, int num_samples, default_random_engine &generator) {
+    uniform_real_distribution<double> random_uniform_dis(0.0, 1.0);
+    vector<int> count(sampler.size(), 0);
+    for (int i = 0; i < num_samples; i++)
+        count[sampler.sampleSite(random_uniform_dis(generator))]++;
+    double total_rate = 0.0;
+    for (int site = 0; site < sampler.size(); site++)
+        total_rate += sampler.getRate(site);
+    int num_errors = 0;
+    for (int site = 0; site < sampler.size(); site++) {
+        double prob = sampler.getRate(site) / total_rate;
+        double expected = prob * num_samples;
+        double sd = sqrt(num_samples * prob * (1.0 - prob));
+        if ((prob == 0.0 && count[site] > 0) || fabs(count[site] - expected) > 5.0 * sd + 1e-9) {
+            cout << "site " << site << ": " << count[site] << " samples, expected " << expected << endl;
+            num_errors++;
+        }
+    }
+    if (fabs(sampler.getTotalRate() - total_rate) > 1e-9 * total_rate) {
+        cout << "total rate " << sampler.getTotalRate() << ", expected " << total_rate << endl;
+        num_errors++;
+    }
+    return num_errors;
+}
+
+/**
+    apply random insertions, state and rate changes to the sampler and to plain vectors
+    @return number of sites, states or rates that differ from the vectors
+*/
+int checkSequence(default_random_engine &generator) {
+    const short int gap = 4;
+    vector<short int> states(5000);
+    vector<double> rates(5000);
+    for (int site = 0; site < states.size(); site++) {
+        states[site] = generator() % 5;
+        rates[site] = (states[site] == gap) ? 0.0 : 0.5 * (generator() % 4);
+    }
+    RateSampler sampler;
+    sampler.init(states, rates, gap);
+    int num_errors = 0;
+    for (int event = 0; event < 20000; event++) {
+        int site = generator() % (states.size() + 1);
+        switch (generator() % 5) {
+            case 0: {
+                // insertion with zero rates
+                vector<short int> new_states(1 + generator() % 5);
+                for (int i = 0; i < new_states.size(); i++)
+                    new_states[i] = generator() % 5;
+                sampler.insertSites(site, new_states);
+                states.insert(states.begin() + site, new_states.begin(), new_states.end());
+                rates.insert(rates.begin() + site, new_states.size(), 0.0);
+                break;
+            }
+            case 1:
+                if (site < states.size()) {
+                    states[site] = generator() % 5;
+                    sampler.setState(site, states[site]);
+                }
+                break;
+            case 2:
+                if (site < states.size()) {
+                    rates[site] = 0.25 * (generator() % 4);
+                    sampler.setRate(site, rates[site]);
+                }
+                break;
+            case 3:
+                if (site < states.size()) {
+                    short int state;
+                    double rate;
+                    sampler.getSite(site, state, rate);
+                    if (state != states[site] || rate != rates[site])
+                        num_errors++;
+                    states[site] = (state == gap) ? 1 : gap;
+                    rates[site] = 0.5 * (generator() % 4);
+                    sampler.setSite(site, states[site], rates[site]);
+                }
+                break;
+            default: {
+                int next = site;
+                while (next < states.size() && states[next] == gap)
+                    next++;
+                if (sampler.findNextNonGap(site) != next)
+                    num_errors++;
+            }
+        }
+    }
+    vector<short int> sampler_states;
+    sampler.exportStates(sampler_states);
+    if (sampler.size() != states.size() || sampler_states != states)
+        num_errors++;
+    double total_rate = 0.0;
+    for (int site = 0; site < rates.size(); site++)
+        total_rate += rates[site];
+    if (fabs(sampler.getTotalRate() - total_rate) > 1e-9)
+        num_errors++;
+    for (int site = 0; site < states.size(); site++)
+        if (sampler.getState(site) != states[site] || sampler.getRate(site) != rates[site])
+            num_errors++;
+    if (num_errors)
+        cout << num_errors << " differences to the plain sequence" << endl;
+    return num_errors;
+}
+
+int main() {
+    default_random_engine generator(12345);
+    uniform_real_distribution<double> rate_dis(0.0, 2.0);
+    const int num_sites = 1000, num_samples = 2000000;
+    int num_errors = 0;
+
+    // rates with some zero (deleted) sites
+    vector<double> rates(num_sites);
+    for (int site = 0; site < num_sites; site++)
+        rates[site] = (site % 7 == 3) ? 0.0 : rate_dis(generator);
+    vector<short int> states(num_sites, 0);
+    RateSampler sampler;
+    sampler.init(states, rates, -1);
+    num_errors += checkFrequencies(sampler, num_samples, generator);
+
+    // change some rates
+    for (int site = 0; site < num_sites; site += 5)
+        sampler.setRate(site, (site % 10 == 0) ? 0.0 : 3.0 * rate_dis(generator));
+    num_errors += checkFrequencies(sampler, num_samples, generator);
+
+    // insert sites in the middle and at the end
+    vector<double> new_rates(37);
+    for (int i = 0; i < new_rates.size(); i++)
+        new_rates[i] = rate_dis(generator);
+    vector<short int> new_states(new_rates.size(), 0);
+    sampler.insertSites(num_sites / 3, new_states);
+    for (int i = 0; i < new_rates.size(); i++)
+        sampler.setRate(num_sites / 3 + i, new_rates[i]);
+    sampler.insertSites(sampler.size(), new_states);
+    for (int i = 0; i < new_rates.size(); i++)
+        sampler.setRate(sampler.size() - new_rates.size() + i, new_rates[i]);
+    num_errors += checkFrequencies(sampler, num_samples, generator);
+
+    num_errors += checkSequence(generator);
+
+    if (num_errors)
+        cout << num_errors << " errors" << endl;
+    return num_errors ? 1 : 0;
+}
@@ -12,6 +12,17 @@
 
 #define PUT_MEANING(value, description) meanings.insert({#value, description})
 
+#if defined (__GNUC__) || defined(__clang__)
+#define popcount64 __builtin_popcountll
+#else
+static inline int popcount64(uint64_t a) {
+    a = a - ((a >> 1) & 0x5555555555555555ULL);
+    a = (a & 0x3333333333333333ULL) + ((a >> 2) & 0x3333333333333333ULL);
+    a = (a + (a >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (a * 0x0101010101010101ULL) >> 56;
+}
+#endif
+
 void PhyloTree::computeSiteConcordance(map<string,string> &meanings) {
     BranchVector branches;
     getInnerBranches(branches);
@@ -30,14 +41,11 @@ void PhyloTree::computeSiteConcordance(map<string,string> &meanings) {
     }
 
     bool do_openmp = (params->ancestral_site_concordance == 0);
+    if (!params->ancestral_site_concordance)
+        aln->buildQuartetSupportBits();
     
-#ifdef _OPENMP
-    if (params->ancestral_site_concordance) {
-        if (omp_get_num_threads() != 1) {
-            outWarning("--scfl works but does not yet support multi-threading");
-        }
-    }
-#endif
+    if (params->ancestral_site_concordance)
+        computeAncestralSiteConcordance(branches, params->site_concordance);
 
 #if defined(_OPENMP) && (do_openmp == true)
 #pragma omp parallel
@@ -50,10 +58,7 @@ void PhyloTree::computeSiteConcordance(map<string,string> &meanings) {
 #endif
     for (auto ii = 0; ii < branches.size(); ii++) {
         BranchVector::iterator it = branches.begin()+ii;
-        if (params->ancestral_site_concordance)
-            computeAncestralSiteConcordance((*it), params->site_concordance, rstream,
-                marginal_ancestral_prob, marginal_ancestral_seq);
-        else
+        if (!params->ancestral_site_concordance)
             computeSiteConcordance((*it), params->site_concordance, rstream);
         Neighbor *nei = it->second->findNeighbor(it->first);
         double sCF = 0.0;
@@ -83,6 +88,8 @@ void PhyloTree::computeSiteConcordance(map<string,string> &meanings) {
 
     if (params->ancestral_site_concordance)
         endMarginalAncestralState(orig_kernel_nonrev, marginal_ancestral_prob, marginal_ancestral_seq);
+    else
+        aln->clearQuartetSupportBits();
     
     PUT_MEANING(sCF, "Site concordance factor averaged over " + convertIntToString(params->site_concordance) +  " quartets (=sCF_N/sN %)");
     PUT_MEANING(sN, "Number of informative sites averaged over " + convertIntToString(params->site_concordance) +  " quartets");
@@ -97,7 +104,36 @@ void Alignment::computeQuartetSupports(IntVector &quartet, vector<int64_t> &supp
     // sanity check e.g. when having rooted tree
     for (auto q = quartet.begin(); q != quartet.end(); q++)
         ASSERT(*q < getNSeq());
-        
+
+    if (!quartet_bits.empty()) {
+        // bit-sliced version: 64 patterns per word
+        size_t seq_words = (quartet_state_bits+1) * quartet_words;
+        uint64_t *seq[4];
+        for (int j = 0; j < 4; j++)
+            seq[j] = &quartet_bits[quartet[j]*seq_words];
+        uint64_t *freq = &quartet_bits[getNSeq()*seq_words];
+        for (size_t w = 0; w < quartet_words; w++) {
+            // eq[i][j]: patterns where sequences i and j have the same unambiguous state
+            uint64_t eq[4][4];
+            for (int i = 0; i < 4; i++)
+                for (int j = i+1; j < 4; j++) {
+                    uint64_t diff = 0;
+                    for (int b = 1; b <= quartet_state_bits; b++)
+                        diff |= seq[i][b*quartet_words+w] ^ seq[j][b*quartet_words+w];
+                    eq[i][j] = seq[i][w] & seq[j][w] & ~diff;
+                }
+            uint64_t sup[3];
+            sup[0] = eq[0][1] & eq[2][3] & ~eq[0][2];
+            sup[1] = eq[0][2] & eq[1][3] & ~eq[0][1];
+            sup[2] = eq[0][3] & eq[1][2] & ~eq[0][1];
+            for (int k = 0; k < 3; k++)
+                if (sup[k])
+                    for (int f = 0; f < quartet_freq_bits; f++)
+                        support[k] += ((int64_t)popcount64(sup[k] & freq[f*quartet_words+w])) << f;
+        }
+        return;
+    }
+
     for (auto pat = begin(); pat != end(); pat++) {
         if (!pat->isInformative()) continue;
         bool informative = true;
@@ -116,6 +152,63 @@ void Alignment::computeQuartetSupports(IntVector &quartet, vector<int64_t> &supp
     }
 }
 
+void Alignment::buildQuartetSupportBits() {
+    clearQuartetSupportBits();
+    IntVector informative_ptn;
+    int max_freq = 0;
+    for (size_t ptn = 0; ptn < size(); ptn++)
+        if (at(ptn).isInformative()) {
+            informative_ptn.push_back(ptn);
+            max_freq = max(max_freq, at(ptn).frequency);
+        }
+    if (informative_ptn.empty())
+        return;
+    quartet_words = (informative_ptn.size() + 63) / 64;
+    while ((1 << quartet_state_bits) < num_states)
+        quartet_state_bits++;
+    while ((1 << quartet_freq_bits) <= max_freq)
+        quartet_freq_bits++;
+    size_t nseq = getNSeq();
+    size_t seq_words = (quartet_state_bits+1) * quartet_words;
+    quartet_bits.resize(nseq*seq_words + quartet_freq_bits*quartet_words, 0);
+    uint64_t *freq = &quartet_bits[nseq*seq_words];
+    for (size_t i = 0; i < informative_ptn.size(); i++) {
+        Pattern &pat = at(informative_ptn[i]);
+        size_t w = i / 64;
+        uint64_t bit = 1ULL << (i % 64);
+        for (size_t seq = 0; seq < nseq; seq++) {
+            int state = pat[seq];
+            if (state >= num_states)
+                continue;
+            uint64_t *planes = &quartet_bits[seq*seq_words + w];
+            planes[0] |= bit;
+            for (int b = 0; b < quartet_state_bits; b++)
+                if ((state >> b) & 1)
+                    planes[(b+1)*quartet_words] |= bit;
+        }
+        for (int f = 0; f < quartet_freq_bits; f++)
+            if ((pat.frequency >> f) & 1)
+                freq[f*quartet_words + w] |= bit;
+    }
+}
+
+void Alignment::clearQuartetSupportBits() {
+    quartet_bits.clear();
+    quartet_bits.shrink_to_fit();
+    quartet_words = 0;
+    quartet_state_bits = quartet_freq_bits = 0;
+}
+
+void SuperAlignment::buildQuartetSupportBits() {
+    for (auto it = partitions.begin(); it != partitions.end(); it++)
+        (*it)->buildQuartetSupportBits();
+}
+
+void SuperAlignment::clearQuartetSupportBits() {
+    for (auto it = partitions.begin(); it != partitions.end(); it++)
+        (*it)->clearQuartetSupportBits();
+}
+
 void SuperAlignment::computeQuartetSupports(IntVector &quartet, vector<int64_t> &support) {
     for (int part = 0; part < partitions.size(); part++) {
         IntVector part_quartet;
@@ -316,7 +409,7 @@ void PhyloTree::computeSiteConcordance(Branch &branch, int nquartets, int *rstre
 }
 
 int random_int_multinomial(int n, double *prob, int most_likely, int *rstream) {
-    double r = random_double();
+    double r = random_double(rstream);
     // accumulative probability
     double accum = prob[most_likely];
     if (r < accum)
@@ -332,7 +425,7 @@ int random_int_multinomial(int n, double *prob, int most_likely, int *rstream) {
 }
 
 int random_int_multinomial(int n, double *prob, int *rstream) {
-    double r = random_double();
+    double r = random_double(rstream);
     // accumulative probability
     double accum = 0.0;
     for (int k = 0; k < n; k++) {
@@ -437,63 +530,123 @@ double* PhyloTree::newAncestralProb() {
     }
 }
 
-void PhyloTree::computeAncestralSiteConcordance(Branch &branch, int nquartets, int *rstream,
-        double *marginal_ancestral_prob, int* marginal_ancestral_seq)
-{
-    
-//    vector<Neighbor*> first_nei;
-//    vector<Neighbor*> second_nei;
-    vector<double*> first_ancestral_prob;
-    vector<double*> second_ancestral_prob;
-    vector<int*> first_ancestral_seq;
-    vector<int*> second_ancestral_seq;
-
-    // extract two nodes adjecent to branch.first
-    FOR_NEIGHBOR_DECLARE(branch.first, branch.second, it) {
-        // do not consider internal branch at the root
-        if (rooted && (*it)->node == root)
-            return;
-//        first_nei.push_back(*it);
-        double *ptn_ancestral_prob = newAncestralProb();
-        int *ptn_ancestral_seq = aligned_alloc<int>(getAlnNPattern());
-        if (params->ancestral_site_concordance == 1)
-            computeMarginalAncestralState((PhyloNeighbor*)(*it), (PhyloNode*)branch.first,
-                ptn_ancestral_prob, ptn_ancestral_seq);
-        else
-            computeSubtreeAncestralState((PhyloNeighbor*)(*it), (PhyloNode*)branch.first,
-                ptn_ancestral_prob, ptn_ancestral_seq);
-//        PhyloNeighbor* nei = (PhyloNeighbor*)(*it)->node->findNeighbor(branch.first);
-//        computeMarginalAncestralState(nei, (PhyloNode*)(*it)->node,
-//            ptn_ancestral_prob, marginal_ancestral_seq);
-        if (verbose_mode >= VB_MED)
-            writeMarginalAncestralState(cout, (PhyloNode*)((*it)->node), ptn_ancestral_prob, ptn_ancestral_seq);
-        first_ancestral_prob.push_back(ptn_ancestral_prob);
-        first_ancestral_seq.push_back(ptn_ancestral_seq);
+void PhyloTree::computeAncestralSiteConcordance(BranchVector &branches, int nquartets) {
+    // subtrees around each branch, empty if the branch is next to the root
+    vector<NeighborVec> first_nei(branches.size()), second_nei(branches.size());
+    // number of branches still needing the ancestral probabilities of a subtree
+    map<Neighbor*, int> nei_count;
+    size_t i;
+    for (i = 0; i < branches.size(); i++) {
+        bool at_root = false;
+        FOR_NEIGHBOR_IT(branches[i].first, branches[i].second, it) {
+            if (rooted && (*it)->node == root)
+                at_root = true;
+            first_nei[i].push_back(*it);
+        }
+        FOR_NEIGHBOR_IT(branches[i].second, branches[i].first, it) {
+            if (rooted && (*it)->node == root)
+                at_root = true;
+            second_nei[i].push_back(*it);
+        }
+        if (at_root) {
+            first_nei[i].clear();
+            second_nei[i].clear();
+            continue;
+        }
+        for (auto it = first_nei[i].begin(); it != first_nei[i].end(); it++)
+            nei_count[*it]++;
+        for (auto it = second_nei[i].begin(); it != second_nei[i].end(); it++)
+            nei_count[*it]++;
     }
 
-    // extract the taxa from the two right subtrees
-    FOR_NEIGHBOR(branch.second, branch.first, it) {
-        // do not consider internal branch at the root
-        if (rooted && (*it)->node == root)
-            return;
-//        second_nei.push_back(*it);
-        double *ptn_ancestral_prob = newAncestralProb();
-        int *ptn_ancestral_seq = aligned_alloc<int>(getAlnNPattern());
-        if (params->ancestral_site_concordance == 1)
-            computeMarginalAncestralState((PhyloNeighbor*)(*it), (PhyloNode*)branch.second,
-                ptn_ancestral_prob, ptn_ancestral_seq);
-        else
-            computeSubtreeAncestralState((PhyloNeighbor*)(*it), (PhyloNode*)branch.second,
-                ptn_ancestral_prob, ptn_ancestral_seq);
-//        PhyloNeighbor* nei = (PhyloNeighbor*)(*it)->node->findNeighbor(branch.second);
-//        computeMarginalAncestralState(nei, (PhyloNode*)(*it)->node,
-//            ptn_ancestral_prob, marginal_ancestral_seq);
-        if (verbose_mode >= VB_MED)
-            writeMarginalAncestralState(cout, (PhyloNode*)((*it)->node), ptn_ancestral_prob, ptn_ancestral_seq);
-        second_ancestral_prob.push_back(ptn_ancestral_prob);
-        second_ancestral_seq.push_back(ptn_ancestral_seq);
+    int nthreads = max(num_threads, 1);
+
+    // ancestral probabilities and states of subtrees, freed after their last use
+    map<Neighbor*, pair<double*, int*> > cache;
+    size_t num_computed = 0, num_reused = 0;
+    size_t batch_size = nthreads * 4;
+    for (size_t start = 0; start < branches.size(); start += batch_size) {
+        size_t end = min(start + batch_size, branches.size());
+        vector<vector<double*> > first_prob(end-start), second_prob(end-start);
+        vector<vector<int*> > first_seq(end-start), second_seq(end-start);
+        // the likelihood kernel is shared, so compute the ancestral probabilities sequentially
+        for (i = start; i < end; i++) {
+            for (int side = 0; side < 2; side++) {
+                NeighborVec &neis = (side == 0) ? first_nei[i] : second_nei[i];
+                Node *dad = (side == 0) ? branches[i].first : branches[i].second;
+                for (auto it = neis.begin(); it != neis.end(); it++) {
+                    auto cit = cache.find(*it);
+                    if (cit != cache.end()) {
+                        num_reused++;
+                    } else {
+                        double *ptn_ancestral_prob = newAncestralProb();
+                        int *ptn_ancestral_seq = aligned_alloc<int>(getAlnNPattern());
+                        if (params->ancestral_site_concordance == 1)
+                            computeMarginalAncestralState((PhyloNeighbor*)(*it), (PhyloNode*)dad,
+                                ptn_ancestral_prob, ptn_ancestral_seq);
+                        else
+                            computeSubtreeAncestralState((PhyloNeighbor*)(*it), (PhyloNode*)dad,
+                                ptn_ancestral_prob, ptn_ancestral_seq);
+                        if (verbose_mode >= VB_MED)
+                            writeMarginalAncestralState(cout, (PhyloNode*)((*it)->node), ptn_ancestral_prob, ptn_ancestral_seq);
+                        cit = cache.insert(make_pair(*it, make_pair(ptn_ancestral_prob, ptn_ancestral_seq))).first;
+                        num_computed++;
+                    }
+                    if (side == 0) {
+                        first_prob[i-start].push_back(cit->second.first);
+                        first_seq[i-start].push_back(cit->second.second);
+                    } else {
+                        second_prob[i-start].push_back(cit->second.first);
+                        second_seq[i-start].push_back(cit->second.second);
+                    }
+                }
+            }
+        }
+
+        // one random stream per branch, so that the sampled quartets do not depend on the threads
+        vector<int*> rstreams(end-start, NULL);
+        for (i = start; i < end; i++)
+            if (!first_nei[i].empty())
+                init_random_stream(params->ran_seed, i, &rstreams[i-start]);
+
+        // sample the quartets of the branches in parallel
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(nthreads) if(nthreads > 1 && end-start > 1)
+#endif
+        for (int b = start; b < (int)end; b++) {
+            if (first_nei[b].empty())
+                continue;
+            computeAncestralSiteConcordance(branches[b], nquartets, rstreams[b-start],
+                first_prob[b-start], first_seq[b-start], second_prob[b-start], second_seq[b-start]);
+        }
+        for (i = start; i < end; i++)
+            if (rstreams[i-start])
+                finish_random(rstreams[i-start]);
+
+        // free the ancestral probabilities not needed any more
+        for (i = start; i < end; i++) {
+            for (int side = 0; side < 2; side++) {
+                NeighborVec &neis = (side == 0) ? first_nei[i] : second_nei[i];
+                for (auto it = neis.begin(); it != neis.end(); it++)
+                    if (--nei_count[*it] == 0) {
+                        auto cit = cache.find(*it);
+                        aligned_free(cit->second.second);
+                        aligned_free(cit->second.first);
+                        cache.erase(cit);
+                    }
+            }
+        }
     }
-    
+    ASSERT(cache.empty());
+    if (verbose_mode >= VB_MED)
+        cout << "Ancestral probabilities of " << num_computed << " subtrees computed, "
+             << num_reused << " reused from cache" << endl;
+}
+
+void PhyloTree::computeAncestralSiteConcordance(Branch &branch, int nquartets, int *rstream,
+    vector<double*> &first_ancestral_prob, vector<int*> &first_ancestral_seq,
+    vector<double*> &second_ancestral_prob, vector<int*> &second_ancestral_seq)
+{
     ASSERT(first_ancestral_prob.size() >= 2);
     ASSERT(second_ancestral_prob.size() >= 2);
     
@@ -615,14 +768,6 @@ void PhyloTree::computeAncestralSiteConcordance(Branch &branch, int nquartets, i
 //        else
 //            nei->putAttr(keys[i%3] + convertIntToString(i/3), "NA");
 //    }
-    for (auto it2 = second_ancestral_prob.rbegin(); it2 != second_ancestral_prob.rend(); it2++)
-        aligned_free(*it2);
-    for (auto it1 = first_ancestral_prob.rbegin(); it1 != first_ancestral_prob.rend(); it1++)
-        aligned_free(*it1);
-    for (auto it3 = second_ancestral_seq.rbegin(); it3 != second_ancestral_seq.rend(); it3++)
-        aligned_free(*it3);
-    for (auto it4 = first_ancestral_seq.rbegin(); it4 != first_ancestral_seq.rend(); it4++)
-        aligned_free(*it4);
 }
 
 
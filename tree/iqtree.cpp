@@ -66,6 +66,8 @@ void IQTree::init() {
     duplication_counter = 0;
     //boot_splits = new SplitGraph;
     pll2iqtree_pattern_index = NULL;
+    boot_sample_size = 1;
+    boot_sample_stride = 0;
 
     treels_name = Params::getInstance().out_prefix;
     treels_name += ".treels";
@@ -100,6 +102,7 @@ void IQTree::setCheckpoint(Checkpoint *checkpoint) {
 }
 
 void IQTree::saveUFBoot(Checkpoint *checkpoint) {
+    scoreSavedTrees();
     checkpoint->startStruct("UFBoot");
     if (MPIHelper::getInstance().isWorker()) {
         CKP_SAVE(sample_start);
@@ -366,8 +369,11 @@ void IQTree::initSettings(Params &params) {
 #else
         size_t nptn = get_safe_upper_limit(orig_nptn);
 #endif
-        BootValType *mem = aligned_alloc<BootValType>(nptn * (size_t)(params.gbo_replicates));
-        memset(mem, 0, nptn * (size_t)(params.gbo_replicates) * sizeof(BootValType));
+        // start with 8-bit counts, widened by setBootSample() if a count does not fit
+        boot_sample_size = 1;
+        boot_sample_stride = nptn;
+        unsigned char *mem = aligned_alloc<unsigned char>(nptn * (size_t)(params.gbo_replicates));
+        memset(mem, 0, nptn * (size_t)(params.gbo_replicates));
         for (i = 0; i < params.gbo_replicates; i++)
             boot_samples[i] = mem + i*nptn;
 
@@ -390,15 +396,13 @@ void IQTree::initSettings(Params &params) {
                     bootstrap_alignment = new Alignment;
                 IntVector this_sample;
                 bootstrap_alignment->createBootstrapAlignment(aln, &this_sample, params.bootstrap_spec);
-                for (size_t j = 0; j < orig_nptn; j++)
-                    boot_samples[i][j] = this_sample[j];
+                setBootSample(i, this_sample);
                 bootstrap_alignment->printAlignment(params.aln_output_format, bootaln_name.c_str(), true);
                 delete bootstrap_alignment;
             } else {
                 IntVector this_sample;
                 aln->createBootstrapAlignment(this_sample, params.bootstrap_spec);
-                for (size_t j = 0; j < orig_nptn; j++)
-                    boot_samples[i][j] = this_sample[j];
+                setBootSample(i, this_sample);
             }
         }
         verbose_mode = saved_mode;
@@ -420,7 +424,7 @@ void IQTree::initSettings(Params &params) {
             for (size_t i = 0; i < params.gbo_replicates; i++) {
                 boot_samples_int[i].resize(nptn, 0);
                 for (size_t j = 0; j < orig_nptn; j++)
-                    boot_samples_int[i][j] = boot_samples[i][j];
+                    boot_samples_int[i][j] = getBootSampleFreq(i, j);
                }
         }
 
@@ -445,12 +449,72 @@ IQTree::~IQTree() {
     boot_splits.clear();
     //if (boot_splits) delete boot_splits;
 
+    for (auto it = rell_batch_ptnlh.begin(); it != rell_batch_ptnlh.end(); it++)
+        aligned_free(*it);
+    rell_batch_ptnlh.clear();
+
     if (!boot_samples.empty()) {
         aligned_free(boot_samples[0]); // free memory
         boot_samples.clear();
     }
 }
 
+int IQTree::getBootSampleFreq(int sample, size_t ptn) {
+    switch (boot_sample_size) {
+    case 1:
+        return boot_samples[sample][ptn];
+    case 2:
+        return ((unsigned short*)boot_samples[sample])[ptn];
+    default:
+        return ((BootValType*)boot_samples[sample])[ptn];
+    }
+}
+
+void IQTree::setBootSample(int sample, IntVector &freq) {
+    int max_freq = *max_element(freq.begin(), freq.end());
+    if (max_freq > USHRT_MAX && boot_sample_size <= 2)
+        widenBootSamples(sizeof(BootValType));
+    else if (max_freq > UCHAR_MAX && boot_sample_size == 1)
+        widenBootSamples(2);
+    size_t nptn = freq.size();
+    switch (boot_sample_size) {
+    case 1:
+        for (size_t ptn = 0; ptn < nptn; ptn++)
+            boot_samples[sample][ptn] = freq[ptn];
+        break;
+    case 2:
+        for (size_t ptn = 0; ptn < nptn; ptn++)
+            ((unsigned short*)boot_samples[sample])[ptn] = freq[ptn];
+        break;
+    default:
+        for (size_t ptn = 0; ptn < nptn; ptn++)
+            ((BootValType*)boot_samples[sample])[ptn] = freq[ptn];
+        break;
+    }
+}
+
+void IQTree::widenBootSamples(int new_size) {
+    size_t nsamples = boot_samples.size();
+    size_t total = boot_sample_stride * nsamples;
+    unsigned char *mem = aligned_alloc<unsigned char>(total * new_size);
+    for (size_t i = 0; i < total; i++) {
+        int freq;
+        switch (boot_sample_size) {
+        case 1: freq = boot_samples[0][i]; break;
+        case 2: freq = ((unsigned short*)boot_samples[0])[i]; break;
+        default: freq = ((BootValType*)boot_samples[0])[i]; break;
+        }
+        if (new_size == 2)
+            ((unsigned short*)mem)[i] = freq;
+        else
+            ((BootValType*)mem)[i] = freq;
+    }
+    aligned_free(boot_samples[0]);
+    boot_sample_size = new_size;
+    for (size_t i = 0; i < nsamples; i++)
+        boot_samples[i] = mem + i * boot_sample_stride * new_size;
+}
+
 extern const char *aa_model_names_rax[];
 
 void IQTree::createPLLPartition(Params &params, ostream &pllPartitionFileHandle) {
@@ -2433,6 +2497,8 @@ double IQTree::doTreeSearch() {
         pllDestroyUFBootData();
     }
 
+    scoreSavedTrees();
+
 #ifdef _IQTREE_MPI
     cout << "Total number of trees received: " << MPIHelper::getInstance().getNumTreeReceived() << endl;
     cout << "Total number of trees sent: " << MPIHelper::getInstance().getNumTreeSent() << endl;
@@ -2685,131 +2751,90 @@ void IQTree::refineBootTrees() {
 
     ModelsBlock *models_block = readModelsDefinition(*params);
     
-	// do bootstrap analysis
-	for (int sample = refined_samples; sample < boot_trees.size(); sample++) {
-        // create bootstrap alignment
-        Alignment* bootstrap_alignment;
-        if (aln->isSuperAlignment())
-            bootstrap_alignment = new SuperAlignment;
-        else
-            bootstrap_alignment = new Alignment;
-        bootstrap_alignment->createBootstrapAlignment(aln, NULL, params->bootstrap_spec);
+    // refine up to max_trees trees at the same time, each with a share of the threads
+    int max_trees = (params->u2c_parallel_trees > 0) ? min(params->u2c_parallel_trees, num_threads) : num_threads;
+    max_trees = max(max_trees, 1);
+    int tree_threads = max(num_threads / max_trees, 1);
+    vector<IQTree*> window_trees;
+    DoubleVector window_logl;
 
-        // create bootstrap tree
-        IQTree *boot_tree;
-        if (aln->isSuperAlignment()){
-            if(params->partition_type != BRLEN_OPTIMIZE){
-                boot_tree = new PhyloSuperTreePlen((SuperAlignment*) bootstrap_alignment, (PhyloSuperTree*) this);
-            } else {
-                boot_tree = new PhyloSuperTree((SuperAlignment*) bootstrap_alignment, (PhyloSuperTree*) this);
-            }
-        } else {
-            // allocate heterotachy tree if neccessary
-            int pos = posRateHeterotachy(aln->model_name);
-            
-            if (params->num_mixlen > 1) {
-                boot_tree = new PhyloTreeMixlen(bootstrap_alignment, params->num_mixlen);
-            } else if (pos != string::npos) {
-                boot_tree = new PhyloTreeMixlen(bootstrap_alignment, 0);
-            } else
-                boot_tree = new IQTree(bootstrap_alignment);
-        }
+#ifdef _OPENMP
+    // trees with more than one thread open their own parallel regions inside the tree loop
+    if (max_trees > 1 && tree_threads > 1)
+        omp_set_nested(true);
+#endif
 
-        boot_tree->on_refine_btree = true;
-        boot_tree->save_all_trees = 0;
+	// do bootstrap analysis
+	for (int start = refined_samples; start < boot_trees.size(); start += max_trees) {
+        int end = min(start + max_trees, (int)boot_trees.size());
 
-        // initialize constraint tree
-        if (!constraintTree.empty()) {
-            boot_tree->constraintTree.readConstraint(constraintTree);
-        }
+        // bootstrap alignments are created in sample order to consume the random stream as before
+        window_trees.clear();
+        for (int sample = start; sample < end; sample++)
+            window_trees.push_back(createRefineBootTree(sample, models_block, tree_threads));
+        window_logl.assign(boot_logl.begin() + start, boot_logl.begin() + end);
 
-        boot_tree->setParams(params);
+        bool saved_progress = progress_display::getProgressDisplay();
+        if (end - start > 1)
+            progress_display::setProgressDisplay(false);
 
-        // 2019-06-03: bug fix setting part_info properly
-        if (boot_tree->isSuperTree())
-            ((PhyloSuperTree*)boot_tree)->setPartInfo((PhyloSuperTree*)this);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(end-start) if(end-start > 1) reduction(+: refined_trees)
+#endif
+        for (int sample = start; sample < end; sample++) {
+            IQTree *boot_tree = window_trees[sample-start];
 
-        // copy model
-        // BQM 2019-05-31: bug fix with -bsam option
-        boot_tree->initializeModel(*params, aln->model_name, models_block);
-        boot_tree->getModelFactory()->setCheckpoint(getCheckpoint());
-        if (isSuperTree())
-            ((PartitionModel*)boot_tree->getModelFactory())->PartitionModel::restoreCheckpoint();
-        else
-            boot_tree->getModelFactory()->restoreCheckpoint();
+            // REMARK: branch lengths were estimated from original alignments
+            // for bootstrap_alignment, they still thus need to be reoptimized a bit
+            boot_tree->optimizeBranches(2);
 
-        // set likelihood kernel
-        boot_tree->setParams(params);
-        boot_tree->setLikelihoodKernel(sse);
-        boot_tree->setNumThreads(num_threads);
+            auto num_nnis = boot_tree->doNNISearch();
+            if (num_nnis.second != 0)
+                refined_trees++;
 
-        // load the current ufboot tree
-        // 2019-02-06: fix crash with -sp and -bnni
-        if (isSuperTree())
-            boot_tree->PhyloTree::readTreeString(boot_trees[sample]);
-        else
-            boot_tree->readTreeString(boot_trees[sample]);
-        
-        if (boot_tree->isSuperTree() && params->partition_type == BRLEN_OPTIMIZE) {
-            if (((PhyloSuperTree*)boot_tree)->size() > 1) {
-                // re-initialize branch lengths for unlinked model
-                boot_tree->wrapperFixNegativeBranch(true);
-            }
+            stringstream ostr;
+            if (params->print_ufboot_trees == 2)
+                boot_tree->printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA | WT_BR_LEN | WT_BR_LEN_SHORT);
+            else
+                boot_tree->printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
+            boot_trees[sample] = ostr.str();
+            boot_logl[sample] = boot_tree->curScore;
         }
-        
-        // TODO: check if this resolves the crash in reorientPartialLh()
-        boot_tree->initializeAllPartialLh();
 
-        // just in case some branch lengths are negative
-        if (int num_neg = boot_tree->wrapperFixNegativeBranch(false))
-            outWarning("Bootstrap tree " + convertIntToString(sample+1) + " has " +
-                convertIntToString(num_neg) + "non-positive branch lengths");
+        progress_display::setProgressDisplay(saved_progress);
 
-        // REMARK: branch lengths were estimated from original alignments
-        // for bootstrap_alignment, they still thus need to be reoptimized a bit
-        boot_tree->optimizeBranches(2);
+        for (int sample = start; sample < end; sample++) {
+            IQTree *boot_tree = window_trees[sample-start];
+            if (verbose_mode >= VB_MED)
+                cout << "UFBoot tree " << sample+1 << ": " << window_logl[sample-start] << " -> " << boot_logl[sample] << endl;
 
+            // delete memory
+            //boot_tree->setModelFactory(NULL);
+            boot_tree->save_all_trees = 2;
 
-        auto num_nnis = boot_tree->doNNISearch();
-        if (num_nnis.second != 0)
-            refined_trees++;
+            Alignment *bootstrap_alignment = boot_tree->aln;
+            delete boot_tree;
+            // fix bug: bootstrap_alignment might be changed
+            delete bootstrap_alignment;
 
-        if (verbose_mode >= VB_MED) {
-            cout << "UFBoot tree " << sample+1 << ": " << boot_logl[sample] << " -> " << boot_tree->getCurScore() << endl;
+            if ((sample+1) % 100 == 0)
+                cout << sample+1 << " samples done" << endl;
         }
 
-        stringstream ostr;
-        if (params->print_ufboot_trees == 2)
-            boot_tree->printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA | WT_BR_LEN | WT_BR_LEN_SHORT);
-        else
-            boot_tree->printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-        boot_trees[sample] = ostr.str();
-        boot_logl[sample] = boot_tree->curScore;
-
-
-        // delete memory
-        //boot_tree->setModelFactory(NULL);
-        boot_tree->save_all_trees = 2;
-
-        bootstrap_alignment = boot_tree->aln;
-        delete boot_tree;
-        // fix bug: bootstrap_alignment might be changed
-        delete bootstrap_alignment;
-
-
-        if ((sample+1) % 100 == 0)
-            cout << sample+1 << " samples done" << endl;
-
         saveCheckpoint();
         checkpoint->startStruct("UFBoot");
-        refined_samples = sample;
+        refined_samples = end-1;
         CKP_SAVE(refined_samples);
         checkpoint->endStruct();
 
         checkpoint->dump();
 
 	}
-    
+#ifdef _OPENMP
+    if (max_trees > 1 && tree_threads > 1)
+        omp_set_nested(false);
+#endif
+
     delete models_block;
 
     cout << "Total " << refined_trees << " ufboot trees refined" << endl;
@@ -2841,6 +2866,87 @@ void IQTree::refineBootTrees() {
 }
 
 
+IQTree *IQTree::createRefineBootTree(int sample, ModelsBlock *models_block, int tree_threads) {
+    // create bootstrap alignment
+    Alignment* bootstrap_alignment;
+    if (aln->isSuperAlignment())
+        bootstrap_alignment = new SuperAlignment;
+    else
+        bootstrap_alignment = new Alignment;
+    bootstrap_alignment->createBootstrapAlignment(aln, NULL, params->bootstrap_spec);
+
+    // create bootstrap tree
+    IQTree *boot_tree;
+    if (aln->isSuperAlignment()){
+        if(params->partition_type != BRLEN_OPTIMIZE){
+            boot_tree = new PhyloSuperTreePlen((SuperAlignment*) bootstrap_alignment, (PhyloSuperTree*) this);
+        } else {
+            boot_tree = new PhyloSuperTree((SuperAlignment*) bootstrap_alignment, (PhyloSuperTree*) this);
+        }
+    } else {
+        // allocate heterotachy tree if neccessary
+        int pos = posRateHeterotachy(aln->model_name);
+        
+        if (params->num_mixlen > 1) {
+            boot_tree = new PhyloTreeMixlen(bootstrap_alignment, params->num_mixlen);
+        } else if (pos != string::npos) {
+            boot_tree = new PhyloTreeMixlen(bootstrap_alignment, 0);
+        } else
+            boot_tree = new IQTree(bootstrap_alignment);
+    }
+
+    boot_tree->on_refine_btree = true;
+    boot_tree->save_all_trees = 0;
+
+    // initialize constraint tree
+    if (!constraintTree.empty()) {
+        boot_tree->constraintTree.readConstraint(constraintTree);
+    }
+
+    boot_tree->setParams(params);
+
+    // 2019-06-03: bug fix setting part_info properly
+    if (boot_tree->isSuperTree())
+        ((PhyloSuperTree*)boot_tree)->setPartInfo((PhyloSuperTree*)this);
+
+    // copy model
+    // BQM 2019-05-31: bug fix with -bsam option
+    boot_tree->initializeModel(*params, aln->model_name, models_block);
+    boot_tree->getModelFactory()->setCheckpoint(getCheckpoint());
+    if (isSuperTree())
+        ((PartitionModel*)boot_tree->getModelFactory())->PartitionModel::restoreCheckpoint();
+    else
+        boot_tree->getModelFactory()->restoreCheckpoint();
+
+    // set likelihood kernel
+    boot_tree->setParams(params);
+    boot_tree->setLikelihoodKernel(sse);
+    boot_tree->setNumThreads(tree_threads);
+
+    // load the current ufboot tree
+    // 2019-02-06: fix crash with -sp and -bnni
+    if (isSuperTree())
+        boot_tree->PhyloTree::readTreeString(boot_trees[sample]);
+    else
+        boot_tree->readTreeString(boot_trees[sample]);
+    
+    if (boot_tree->isSuperTree() && params->partition_type == BRLEN_OPTIMIZE) {
+        if (((PhyloSuperTree*)boot_tree)->size() > 1) {
+            // re-initialize branch lengths for unlinked model
+            boot_tree->wrapperFixNegativeBranch(true);
+        }
+    }
+    
+    // TODO: check if this resolves the crash in reorientPartialLh()
+    boot_tree->initializeAllPartialLh();
+
+    // just in case some branch lengths are negative
+    if (int num_neg = boot_tree->wrapperFixNegativeBranch(false))
+        outWarning("Bootstrap tree " + convertIntToString(sample+1) + " has " +
+            convertIntToString(num_neg) + "non-positive branch lengths");
+    return boot_tree;
+}
+
 void IQTree::printIterationInfo(int sourceProcID) {
     double realtime_remaining = stop_rule.getRemainingTime(stop_rule.getCurIt());
     cout.setf(ios_base::fixed, ios_base::floatfield);
@@ -2990,7 +3096,7 @@ pair<int, int> IQTree::doNNISearch(bool write_info) {
             }
         }
     }
-    MPIHelper::getInstance().setNumNNISearch(MPIHelper::getInstance().getNumNNISearch() + 1);
+    MPIHelper::getInstance().increaseNumNNISearch();
 
     return nniInfos;
 }
@@ -3157,6 +3263,8 @@ pair<int, int> IQTree::optimizeNNI(bool speedNNI) {
         cout << "NOTE: Input tree is already NNI-optimal" << endl;
     }
 
+    scoreSavedTrees();
+
     if (numSteps == MAXSTEPS) {
         cout << "WARNING: NNI search needs unusual large number of steps (" << numSteps << ") to converge!" << endl;
     }
@@ -3273,7 +3381,7 @@ void IQTree::pllInitUFBootData(){
                 if(!pllUFBootDataPtr->boot_samples[i]) outError("Not enough dynamic memory!");
                 for(int j = 0; j < pllAlignment->sequenceLength; j++){
                     pllUFBootDataPtr->boot_samples[i][j] =
-                        boot_samples[i][pll2iqtree_pattern_index[j]];
+                        getBootSampleFreq(i, pll2iqtree_pattern_index[j]);
                 }
             }
 
@@ -3550,6 +3658,12 @@ void IQTree::estimateNNICutoff(Params* params) {
     delete[] delta;
 }
 
+/** number of saved trees scored together against the bootstrap samples */
+#define RELL_BATCH_TREES 16
+
+/** number of bootstrap samples per block in scoreSavedTrees() */
+#define RELL_SAMPLE_BLOCK 8
+
 void IQTree::saveCurrentTree(double cur_logl) {
 
     if (logl_cutoff != 0.0 && cur_logl < logl_cutoff - 1.0)
@@ -3581,59 +3695,20 @@ void IQTree::saveCurrentTree(double cur_logl) {
     if (boot_samples.empty()) {
         // for runGuidedBootstrap
     } else {
-        // online bootstrap
-//        int ptn;
-//        int updated = 0;
-//        int nsamples = boot_samples.size();
+        // online bootstrap: queue the tree, all queued trees are scored at once
         ostringstream ostr;
-        string tree_str;
         setRootNode(params->root);
         if (params->print_ufboot_trees == 2)
             printTree(ostr, WT_TAXON_ID + WT_SORT_TAXA + WT_BR_LEN + WT_BR_LEN_SHORT);
         else
             printTree(ostr, WT_TAXON_ID + WT_SORT_TAXA);
-        tree_str = ostr.str();
-
+        rell_batch_ptnlh.push_back(pattern_lh);
+        rell_batch_logl.push_back(cur_logl);
+        rell_batch_trees.push_back(ostr.str());
     #ifdef _OPENMP
-        int rand_seed = random_int(1000);
-        #pragma omp parallel
-        {
-        int *rstream;
-        init_random(rand_seed + omp_get_thread_num(), false, &rstream);
-        #pragma omp for
+        rell_batch_seeds.push_back(random_int(1000));
     #else
-        int *rstream = randstream;
-    #endif
-        for (int sample = sample_start; sample < sample_end; sample++) {
-            double rell = 0.0;
-
-            {
-                // SSE optimized version of the above loop
-                BootValType *boot_sample = boot_samples[sample];
-
-                BootValType res = (this->*dotProduct)(pattern_lh, boot_sample, nptn);
-
-                rell = res;
-            }
-
-            bool better = rell > boot_logl[sample] + params->ufboot_epsilon;
-            if (!better && rell > boot_logl[sample] - params->ufboot_epsilon) {
-                better = (random_double(rstream) <= 1.0 / (boot_counts[sample] + 1));
-            }
-            if (better) {
-                if (rell <= boot_logl[sample] + params->ufboot_epsilon) {
-                    boot_counts[sample]++;
-                } else {
-                    boot_counts[sample] = 1;
-                }
-                boot_logl[sample] = max(boot_logl[sample], rell);
-                boot_orig_logl[sample] = cur_logl;
-                boot_trees[sample] = tree_str;
-            }
-        }
-    #ifdef _OPENMP
-        finish_random(rstream);
-        }
+        rell_batch_seeds.push_back(0);
     #endif
     }
     if (Params::getInstance().print_tree_lh) {
@@ -3658,7 +3733,15 @@ void IQTree::saveCurrentTree(double cur_logl) {
 #ifdef BOOT_VAL_FLOAT
         aligned_free(pattern_lh_orig);
 #endif
-        aligned_free(pattern_lh);
+        // pattern_lh is freed by scoreSavedTrees()
+#ifdef _OPENMP
+        if (rell_batch_ptnlh.size() >= RELL_BATCH_TREES)
+            scoreSavedTrees();
+#else
+        // ties are broken with randstream, which the tree search also uses:
+        // score each tree right away to keep the order of the random draws
+        scoreSavedTrees();
+#endif
     } else {
 #ifdef BOOT_VAL_FLOAT
         aligned_free(pattern_lh);
@@ -3667,6 +3750,73 @@ void IQTree::saveCurrentTree(double cur_logl) {
 
 }
 
+void IQTree::scoreSavedTrees() {
+    int ntrees = rell_batch_ptnlh.size();
+    if (ntrees == 0)
+        return;
+    int nptn = getAlnNPattern();
+    int nsamples = sample_end - sample_start;
+
+    // RELL log-likelihoods of all trees on all samples, blocked over samples
+    BootValType *rell_matrix = aligned_alloc<BootValType>((size_t)nsamples*ntrees);
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int sample = sample_start; sample < sample_end; sample += RELL_SAMPLE_BLOCK) {
+        int nblock = min(RELL_SAMPLE_BLOCK, sample_end - sample);
+        (this->*dotProductBatch)(&rell_batch_ptnlh[0], ntrees, &boot_samples[sample], boot_sample_size, nblock, nptn,
+            rell_matrix + (size_t)(sample - sample_start)*ntrees);
+    }
+
+    // update the bootstrap trees, for each sample in the order the trees were saved
+#ifdef _OPENMP
+    #pragma omp parallel
+    {
+    vector<int*> rstreams(ntrees);
+    for (int tree = 0; tree < ntrees; tree++)
+        init_random(rell_batch_seeds[tree] + omp_get_thread_num(), false, &rstreams[tree]);
+    #pragma omp for
+    for (int sample = sample_start; sample < sample_end; sample++) {
+        BootValType *sample_rell = rell_matrix + (size_t)(sample - sample_start)*ntrees;
+        for (int tree = 0; tree < ntrees; tree++)
+            updateBootSample(sample, tree, sample_rell[tree], rstreams[tree]);
+    }
+    for (int tree = 0; tree < ntrees; tree++)
+        finish_random(rstreams[tree]);
+    }
+#else
+    // all trees share one random stream: draw in the order of scoring the trees one by one
+    for (int tree = 0; tree < ntrees; tree++)
+        for (int sample = sample_start; sample < sample_end; sample++)
+            updateBootSample(sample, tree, rell_matrix[(size_t)(sample - sample_start)*ntrees + tree], randstream);
+#endif
+
+    aligned_free(rell_matrix);
+    for (auto it = rell_batch_ptnlh.begin(); it != rell_batch_ptnlh.end(); it++)
+        aligned_free(*it);
+    rell_batch_ptnlh.clear();
+    rell_batch_logl.clear();
+    rell_batch_trees.clear();
+    rell_batch_seeds.clear();
+}
+
+void IQTree::updateBootSample(int sample, int tree, double rell, int *rstream) {
+    bool better = rell > boot_logl[sample] + params->ufboot_epsilon;
+    if (!better && rell > boot_logl[sample] - params->ufboot_epsilon) {
+        better = (random_double(rstream) <= 1.0 / (boot_counts[sample] + 1));
+    }
+    if (better) {
+        if (rell <= boot_logl[sample] + params->ufboot_epsilon) {
+            boot_counts[sample]++;
+        } else {
+            boot_counts[sample] = 1;
+        }
+        boot_logl[sample] = max(boot_logl[sample], rell);
+        boot_orig_logl[sample] = rell_batch_logl[tree];
+        boot_trees[sample] = rell_batch_trees[tree];
+    }
+}
+
 void IQTree::saveNNITrees(PhyloNode *node, PhyloNode *dad) {
     if (!node) {
         node = (PhyloNode*) root;
@@ -3784,6 +3934,7 @@ void IQTree::summarizeBootstrap(Params &params, MTreeSet &trees) {
 }
 
 void IQTree::writeUFBootTrees(Params &params) {
+    scoreSavedTrees();
     MTreeSet trees;
 //    IntVector tree_weights;
     int i, j;
@@ -3814,6 +3965,7 @@ void IQTree::writeUFBootTrees(Params &params) {
 }
 
 void IQTree::summarizeBootstrap(Params &params) {
+    scoreSavedTrees();
     setRootNode(params.root);
     MTreeSet trees;
     trees.init(boot_trees, rooted);
@@ -771,8 +771,35 @@ public:
     /** log-likelihood threshold (l_min) */
     double logl_cutoff;
 
-    /** vector of bootstrap alignments generated */
-    vector<BootValType* > boot_samples;
+    /** vector of bootstrap alignments generated, as pattern frequencies of boot_sample_size bytes each */
+    vector<unsigned char* > boot_samples;
+
+    /**
+        number of bytes per pattern frequency in boot_samples: 1 or 2 for unsigned integer counts,
+        sizeof(BootValType) once a count exceeds 16 bits
+     */
+    int boot_sample_size;
+
+    /** number of entries per bootstrap sample in boot_samples, padded for SIMD */
+    size_t boot_sample_stride;
+
+    /**
+        @return frequency of pattern ptn in bootstrap sample
+     */
+    int getBootSampleFreq(int sample, size_t ptn);
+
+    /**
+        store the pattern frequencies of a bootstrap sample, widening boot_samples if needed
+        @param sample sample ID
+        @param freq pattern frequencies
+     */
+    void setBootSample(int sample, IntVector &freq);
+
+    /**
+        convert boot_samples to a wider storage
+        @param new_size new number of bytes per pattern frequency
+     */
+    void widenBootSamples(int new_size);
 
     /** starting sample for UFBoot, used for MPI */
     int sample_start;
@@ -798,6 +825,32 @@ public:
     /** Set of splits occurring in bootstrap trees */
     vector<SplitGraph*> boot_splits;
 
+    /** pattern log-likelihoods of saved trees not yet scored against boot_samples */
+    vector<BootValType*> rell_batch_ptnlh;
+
+    /** log-likelihoods of the trees in rell_batch_ptnlh */
+    DoubleVector rell_batch_logl;
+
+    /** newick strings of the trees in rell_batch_ptnlh */
+    StrVector rell_batch_trees;
+
+    /** random seeds to break RELL ties for the trees in rell_batch_ptnlh */
+    IntVector rell_batch_seeds;
+
+    /**
+        score all trees saved by saveCurrentTree() against all bootstrap samples at once
+        and update boot_logl, boot_counts and boot_trees in the order the trees were saved
+     */
+    void scoreSavedTrees();
+
+    /**
+        update boot_logl, boot_counts and boot_trees of a bootstrap sample with a saved tree
+        @param tree index of the tree in rell_batch_trees
+        @param rell RELL log-likelihood of the tree on the sample
+        @param rstream random stream to break ties
+     */
+    void updateBootSample(int sample, int tree, double rell, int *rstream);
+
     /** log-likelihood of bootstrap consensus tree */
     double boot_consense_logl;
 
@@ -1019,6 +1072,16 @@ public:
 
     // Diep added for UFBoot2-Corr
     void refineBootTrees();
+
+    /**
+        create the tree to refine a UFBoot tree on its bootstrap alignment (UFBoot2-Corr),
+        with model and branch lengths initialized
+        @param sample bootstrap sample ID
+        @param models_block models definition
+        @param tree_threads number of threads for the new tree
+        @return bootstrap tree
+     */
+    IQTree *createRefineBootTree(int sample, ModelsBlock *models_block, int tree_threads);
     bool on_refine_btree;
     Alignment* saved_aln_on_refine_btree;
     vector<IntVector> boot_samples_int;
@@ -1557,6 +1557,49 @@ void MTree::convertSplits(SplitGraph &sg, Split *resp, BranchVector *branches, N
         resp->addTaxon(node->id);
 }
 
+void MTree::getSplitFingerprints(vector<SplitFingerprint> &taxon_key, vector<SplitFingerprint> &fps,
+    DoubleVector &weights, BranchVector &branches)
+{
+    SplitFingerprint all_fp, resp;
+    for (int i = 0; i < leafNum; i++)
+        all_fp ^= taxon_key[i];
+    bool resp_has0;
+    getSplitFingerprints(taxon_key, all_fp, fps, weights, branches, resp, resp_has0, root, NULL);
+}
+
+int MTree::getSplitFingerprints(vector<SplitFingerprint> &taxon_key, SplitFingerprint &all_fp,
+    vector<SplitFingerprint> &fps, DoubleVector &weights, BranchVector &branches,
+    SplitFingerprint &resp, bool &resp_has0, Node *node, Node *dad)
+{
+    int ntaxa = 0;
+    resp_has0 = false;
+    bool has_child = false;
+    FOR_NEIGHBOR_IT(node, dad, it) {
+        SplitFingerprint fp;
+        bool has0;
+        int count = getSplitFingerprints(taxon_key, all_fp, fps, weights, branches, fp, has0, (*it)->node, node);
+        resp ^= fp;
+        ntaxa += count;
+        resp_has0 |= has0;
+        // same orientation as Split::shouldInvert()
+        if (count * 2 > leafNum || (count * 2 == leafNum && !has0))
+            fp ^= all_fp;
+        /* ignore nodes with degree of 2 because such split will be added before */
+        if (node->degree() != 2) {
+            fps.push_back(fp);
+            weights.push_back((*it)->length);
+            branches.push_back(make_pair(node, (*it)->node));
+        }
+        has_child = true;
+    }
+    if (!has_child) {
+        resp ^= taxon_key[node->id];
+        resp_has0 = (node->id == 0);
+        ntaxa = 1;
+    }
+    return ntaxa;
+}
+
 void MTree::convertSplits(vector<string> &taxname, SplitGraph &sg, NodeVector *nodes, Node *node, Node *dad) {
     if (!sg.taxa) {
         sg.taxa = new NxsTaxaBlock();
@@ -2730,6 +2773,341 @@ void MTree::createBootstrapSupport(vector<string> &taxname, MTreeSet &trees, Spl
 	}	
 }
 
+/**
+	tree in post-order (root last) with the leaf range [first,last) of each node in the DFS leaf order
+*/
+struct LeafOrderTree {
+	IntVector order;                 // leaf IDs in DFS order
+	IntVector leaf_node;             // node index of each leaf in order
+	vector<pair<int,int> > ranges;   // leaf range of each node
+	IntVector parent, first_child, next_sibling, heavy;
+	BranchVector branches;           // (dad, node) of each node except the root
+
+	int build(Node *node, Node *dad) {
+		int start = order.size(), leaf_pos = -1;
+		if (node->isLeaf()) {
+			leaf_pos = order.size();
+			order.push_back(node->id);
+			leaf_node.push_back(-1);
+		}
+		int child_list = -1, heavy_child = -1;
+		FOR_NEIGHBOR_IT(node, dad, it) {
+			int child = build((*it)->node, node);
+			next_sibling[child] = child_list;
+			child_list = child;
+			if (heavy_child < 0 || size(child) > size(heavy_child))
+				heavy_child = child;
+		}
+		int id = ranges.size();
+		ranges.push_back(make_pair(start, (int)order.size()));
+		parent.push_back(-1);
+		first_child.push_back(child_list);
+		next_sibling.push_back(-1);
+		heavy.push_back(heavy_child);
+		for (int child = child_list; child >= 0; child = next_sibling[child])
+			parent[child] = id;
+		if (leaf_pos >= 0)
+			leaf_node[leaf_pos] = id;
+		if (dad)
+			branches.push_back(make_pair(dad, node));
+		return id;
+	}
+
+	int size(int node) {
+		return ranges[node].second - ranges[node].first;
+	}
+};
+
+/**
+	value S(b) = sum of leaf weights below each branch b of a tree, with weight +1 or -1 per leaf.
+	Leaf weights are changed along heavy paths in a segment tree keeping the minimum and maximum S,
+	ties broken by the smaller post-order index like a linear scan over the branches.
+*/
+class TransferSideTree {
+public:
+	TransferSideTree(LeafOrderTree &tree) : tree(tree) {
+		int nnodes = tree.ranges.size();
+		path_head.resize(nnodes);
+		path_pos.resize(nnodes);
+		int cnt = 0;
+		decompose(nnodes-1, nnodes-1, cnt);
+		node_at.resize(nnodes);
+		for (int i = 0; i < nnodes; i++)
+			node_at[path_pos[i]] = i;
+		min_val.resize(4*nnodes);
+		max_val.resize(4*nnodes);
+		min_id.resize(4*nnodes);
+		max_id.resize(4*nnodes);
+		lazy.assign(4*nnodes, 0);
+		init(1, 0, nnodes-1);
+	}
+
+	/** add delta to the weight of the leaf at position leaf of the leaf order */
+	void addLeaf(int leaf, int delta) {
+		int nnodes = tree.ranges.size();
+		for (int node = tree.leaf_node[leaf]; node >= 0; node = tree.parent[path_head[node]])
+			add(1, 0, nnodes-1, path_pos[path_head[node]], path_pos[node], delta);
+	}
+
+	int minValue() { return min_val[1]; }
+	int maxValue() { return max_val[1]; }
+	int minBranch() { return min_id[1]; }
+	int maxBranch() { return max_id[1]; }
+
+private:
+	LeafOrderTree &tree;
+	IntVector path_head, path_pos, node_at;
+	IntVector min_val, max_val, min_id, max_id, lazy;
+
+	void decompose(int node, int head, int &cnt) {
+		path_head[node] = head;
+		path_pos[node] = cnt++;
+		int heavy = tree.heavy[node];
+		if (heavy >= 0)
+			decompose(heavy, head, cnt);
+		for (int child = tree.first_child[node]; child >= 0; child = tree.next_sibling[child])
+			if (child != heavy)
+				decompose(child, child, cnt);
+	}
+
+	void pull(int k) {
+		int l = 2*k, r = 2*k+1;
+		bool left = (min_val[l] < min_val[r] || (min_val[l] == min_val[r] && min_id[l] < min_id[r]));
+		min_val[k] = (left ? min_val[l] : min_val[r]) + lazy[k];
+		min_id[k] = left ? min_id[l] : min_id[r];
+		left = (max_val[l] > max_val[r] || (max_val[l] == max_val[r] && max_id[l] < max_id[r]));
+		max_val[k] = (left ? max_val[l] : max_val[r]) + lazy[k];
+		max_id[k] = left ? max_id[l] : max_id[r];
+	}
+
+	void init(int k, int lo, int hi) {
+		if (lo == hi) {
+			int node = node_at[lo];
+			// the root is not a branch
+			bool is_root = (tree.parent[node] < 0);
+			min_val[k] = tree.size(node) + (is_root ? INT_MAX/4 : 0);
+			max_val[k] = tree.size(node) - (is_root ? INT_MAX/4 : 0);
+			min_id[k] = max_id[k] = node;
+			return;
+		}
+		int mid = (lo + hi) / 2;
+		init(2*k, lo, mid);
+		init(2*k+1, mid+1, hi);
+		pull(k);
+	}
+
+	void add(int k, int lo, int hi, int first, int last, int delta) {
+		if (last < lo || hi < first)
+			return;
+		if (first <= lo && hi <= last) {
+			min_val[k] += delta;
+			max_val[k] += delta;
+			lazy[k] += delta;
+			return;
+		}
+		int mid = (lo + hi) / 2;
+		add(2*k, lo, mid, first, last, delta);
+		add(2*k+1, mid+1, hi, first, last, delta);
+		pull(k);
+	}
+};
+
+/**
+	transfer distances of the branches of a reference tree to one other tree. The leaves below the
+	reference node get weight -1 (small-to-large over the reference tree), so that the distance to
+	branch b is |A| + S(b) and the minimum over b is read off the segment tree.
+*/
+struct TransferDistanceState {
+	LeafOrderTree &ref;
+	IntVector &branch_of;   // internal branch index of each reference node, or -1
+	IntVector &leaf_map;    // leaf position in the other tree of each reference leaf position
+	TransferSideTree &side;
+	int n;
+	IntVector min_dist, min_diff, min_branch;
+
+	TransferDistanceState(LeafOrderTree &ref, IntVector &branch_of, IntVector &leaf_map, TransferSideTree &side,
+		int nbranches) : ref(ref), branch_of(branch_of), leaf_map(leaf_map), side(side)
+	{
+		n = ref.order.size();
+		min_dist.resize(nbranches);
+		min_diff.resize(nbranches);
+		min_branch.resize(nbranches);
+	}
+
+	void addLeaves(int first, int last, int delta) {
+		for (int i = first; i < last; i++)
+			side.addLeaf(leaf_map[i], delta);
+	}
+
+	void collect(int node, bool keep) {
+		int heavy = ref.heavy[node];
+		for (int child = ref.first_child[node]; child >= 0; child = ref.next_sibling[child])
+			if (child != heavy)
+				collect(child, false);
+		if (ref.parent[node] < 0) {
+			if (heavy >= 0)
+				collect(heavy, false);
+			return;
+		}
+		if (heavy >= 0) {
+			collect(heavy, true);
+			addLeaves(ref.ranges[node].first, ref.ranges[heavy].first, -2);
+			addLeaves(ref.ranges[heavy].second, ref.ranges[node].second, -2);
+		} else
+			addLeaves(ref.ranges[node].first, ref.ranges[node].second, -2);
+
+		int j = branch_of[node];
+		if (j >= 0) {
+			int size = ref.size(node);
+			int dist1 = size + side.minValue(), dist2 = n - size - side.maxValue();
+			if (dist1 < dist2 || (dist1 == dist2 && side.minBranch() < side.maxBranch())) {
+				min_dist[j] = dist1;
+				min_diff[j] = dist1;
+				min_branch[j] = side.minBranch();
+			} else {
+				min_dist[j] = dist2;
+				min_diff[j] = n - dist2;
+				min_branch[j] = side.maxBranch();
+			}
+		}
+		if (!keep)
+			addLeaves(ref.ranges[node].first, ref.ranges[node].second, 2);
+	}
+};
+
+/**
+	count the taxa at positions [first,last) of one leaf order that are (not) in the range
+	[other_first,other_last) of the other leaf order
+*/
+static void countMovedTaxa(int first, int last, IntVector &other_pos, int other_first, int other_last,
+	bool in_other, IntVector &taxon, IntVector &moved)
+{
+	for (int i = first; i < last; i++)
+		if ((other_pos[i] >= other_first && other_pos[i] < other_last) == in_other)
+			moved[taxon[i]]++;
+}
+
+void MTree::computeTransferDistances(MTreeSet &trees, BranchVector &branches, IntVector &sum_dist,
+	IntVector &depth, DoubleVector *transfer_index, double dist_cutoff)
+{
+	int n = leafNum;
+	int i, j;
+
+	LeafOrderTree ref;
+	ref.build(root, NULL);
+	ASSERT(ref.order.size() == n);
+	IntVector &ref_order = ref.order;
+	IntVector ref_pos(n);
+	for (i = 0; i < n; i++)
+		ref_pos[ref_order[i]] = i;
+
+	vector<pair<int,int> > ranges;
+	IntVector branch_of(ref.ranges.size(), -1);
+	branches.clear();
+	depth.clear();
+	for (i = 0; i < ref.branches.size(); i++)
+		if (!ref.branches[i].first->isLeaf() && !ref.branches[i].second->isLeaf()) {
+			branch_of[i] = branches.size();
+			branches.push_back(ref.branches[i]);
+			ranges.push_back(ref.ranges[i]);
+			int size = ref.size(i);
+			depth.push_back(min(size, n - size));
+		}
+	int m = branches.size();
+	sum_dist.assign(m, 0);
+	if (transfer_index)
+		transfer_index->assign(n, 0.0);
+
+	StringIntMap name_id;
+	NodeVector taxa;
+	getTaxa(taxa);
+	for (NodeVector::iterator it = taxa.begin(); it != taxa.end(); it++)
+		name_id[(*it)->name] = (*it)->id;
+	int min_depth = (int)ceil(1.0/dist_cutoff + 1.0);
+	int ntrees = trees.size();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) private(i, j)
+#endif
+	for (int tree_id = 0; tree_id < ntrees; tree_id++) {
+		MTree *tree = trees[tree_id];
+		if (tree->leafNum != n)
+			outError("Tree has different number of taxa!");
+		// map leaves of tree to positions in this tree
+		NodeVector tree_taxa;
+		tree->getTaxa(tree_taxa);
+		IntVector leaf_pos(n);
+		for (NodeVector::iterator it = tree_taxa.begin(); it != tree_taxa.end(); it++) {
+			StringIntMap::iterator found = name_id.find((*it)->name);
+			if (found == name_id.end())
+				outError("Tree does not contain taxon ", (*it)->name);
+			leaf_pos[(*it)->id] = ref_pos[found->second];
+		}
+		LeafOrderTree other;
+		other.build(tree->root, NULL);
+		// pos: position in this tree of each leaf of the other tree, and the inverse
+		IntVector pos(n), inv_pos(n);
+		for (i = 0; i < n; i++) {
+			pos[i] = leaf_pos[other.order[i]];
+			inv_pos[pos[i]] = i;
+		}
+
+		TransferSideTree side(other);
+		TransferDistanceState state(ref, branch_of, inv_pos, side, m);
+		state.collect(ref.ranges.size()-1, false);
+
+		DoubleVector moved_rate;
+		if (transfer_index) {
+			// taxa to move around each close branch: the symmetric difference between the smaller
+			// side of the branch and the matching side of the closest branch of the other tree
+			IntVector moved(n, 0);
+			IntVector other_taxon(n);
+			for (i = 0; i < n; i++)
+				other_taxon[i] = ref_order[pos[i]];
+			int nclose = 0;
+			for (j = 0; j < m; j++) {
+				if (depth[j] < min_depth || state.min_dist[j] > dist_cutoff * (depth[j] - 1))
+					continue;
+				nclose++;
+				int first = ranges[j].first, last = ranges[j].second;
+				int other_first = other.ranges[state.min_branch[j]].first;
+				int other_last = other.ranges[state.min_branch[j]].second;
+				bool move_diff = (state.min_diff[j] < n - state.min_diff[j]);
+				// complement both sides if this side is the larger one
+				bool ref_compl = (last - first > n - (last - first));
+				bool other_compl = (move_diff == ref_compl);
+				if (ref_compl) {
+					countMovedTaxa(0, first, inv_pos, other_first, other_last, other_compl, ref_order, moved);
+					countMovedTaxa(last, n, inv_pos, other_first, other_last, other_compl, ref_order, moved);
+				} else
+					countMovedTaxa(first, last, inv_pos, other_first, other_last, other_compl, ref_order, moved);
+				if (other_compl) {
+					countMovedTaxa(0, other_first, pos, first, last, ref_compl, other_taxon, moved);
+					countMovedTaxa(other_last, n, pos, first, last, ref_compl, other_taxon, moved);
+				} else
+					countMovedTaxa(other_first, other_last, pos, first, last, ref_compl, other_taxon, moved);
+			}
+			if (nclose > 0) {
+				moved_rate.resize(n);
+				for (i = 0; i < n; i++)
+					moved_rate[i] = ((double)moved[i]) / nclose;
+			}
+		}
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+		{
+			for (j = 0; j < m; j++)
+				sum_dist[j] += state.min_dist[j];
+			for (i = 0; i < moved_rate.size(); i++)
+				(*transfer_index)[i] += moved_rate[i];
+		}
+	}
+	if (transfer_index && ntrees > 0)
+		for (i = 0; i < n; i++)
+			(*transfer_index)[i] *= 100.0 / ntrees;
+}
+
 void MTree::removeNode(Node *dad, Node *node) {
 //    Node *child = (*it)->node;
     bool first = true;
@@ -698,6 +698,28 @@ public:
      */
     void convertSplits(SplitGraph &sg, Split *resp, BranchVector *branches, Node *node = NULL, Node *dad = NULL);
 
+    /**
+            compute the fingerprints of all splits of the tree, in the same order and with the same
+            orientation (see Split::shouldInvert) as convertSplits(), without creating Split objects
+            @param taxon_key fingerprint key of each taxon
+            @param[out] fps split fingerprints
+            @param[out] weights split weights (branch lengths)
+            @param[out] branches branch of each split, the split is the set of taxa below branch.second
+     */
+    void getSplitFingerprints(vector<SplitFingerprint> &taxon_key, vector<SplitFingerprint> &fps,
+        DoubleVector &weights, BranchVector &branches);
+
+    /**
+            compute the split fingerprints below node, iterative procedure
+            @param all_fp fingerprint of all taxa
+            @param[out] resp fingerprint of taxa below node
+            @param[out] resp_has0 TRUE if taxon 0 is below node
+            @return number of taxa below node
+     */
+    int getSplitFingerprints(vector<SplitFingerprint> &taxon_key, SplitFingerprint &all_fp,
+        vector<SplitFingerprint> &fps, DoubleVector &weights, BranchVector &branches,
+        SplitFingerprint &resp, bool &resp_has0, Node *node, Node *dad);
+
     /**
      * Initialize the hash stable splitBranchMap which contain mapping from split to branch
      * @param resp (internal) set of taxa below node
@@ -931,6 +953,22 @@ public:
 
 	void reportDisagreedTrees(vector<string> &taxname, MTreeSet &trees, Split &mysplit);
 
+	/**
+		compute the minimum transfer distance of each internal branch of this tree to each tree in a set,
+		for the transfer bootstrap expectation (TBE, Lemoine et al. 2018). Each branch is represented by
+		an interval of the leaf order of this tree, so that the memory is linear in the number of taxa.
+		Trees are processed in parallel.
+		@param trees set of trees with the same leaf names as this tree
+		@param[out] branches internal branches of this tree
+		@param[out] sum_dist sum over all trees of the minimum transfer distance of each branch
+		@param[out] depth topological depth of each branch (size of the smaller side)
+		@param[out] transfer_index if not NULL, per-taxon average rate of moving around branches
+			with normalized distance <= dist_cutoff
+		@param dist_cutoff normalized distance cutoff for transfer_index
+	*/
+	void computeTransferDistances(MTreeSet &trees, BranchVector &branches, IntVector &sum_dist,
+		IntVector &depth, DoubleVector *transfer_index = NULL, double dist_cutoff = 0.3);
+
 
     /********************************************************
         COLLAPSING BRANCHES
@@ -354,9 +354,13 @@ void MTreeSet::convertSplits(SplitGraph &sg, double split_threshold, int weighti
 	}*/
 	//SplitGraph temp;
 	convertSplits(sg, hash_ss, weighting_type, weight_threshold);
+	discardSplits(sg, hash_ss, split_threshold);
+}
+
+void MTreeSet::discardSplits(SplitGraph &sg, SplitIntMap &hash_ss, double split_threshold) {
 	int nsplits = sg.getNSplits();
 
-	double threshold = split_threshold * size();
+	double threshold = split_threshold * tree_weights.size();
 //	cout << "threshold = " << threshold << endl;
 	int count=0;
 	for (SplitGraph::iterator it = sg.begin(); it != sg.end(); ) {
@@ -412,6 +416,26 @@ void MTreeSet::convertSplits(SplitGraph &sg, SplitIntMap &hash_ss, int weighting
 	convertSplits(taxname, sg, hash_ss, weighting_type, weight_threshold, NULL);
 }
 
+/**
+	check that tree has the taxa of the sorted taxname and number its leaves accordingly
+*/
+static void assignSortedTaxonID(MTree *tree, vector<string> &taxname) {
+	if (tree->leafNum != taxname.size())
+		outError("Tree has different number of taxa!");
+	NodeVector taxa;
+	tree->getTaxa(taxa);
+	sort(taxa.begin(), taxa.end(), nodenamecmp);
+	int i = 0;
+	for (NodeVector::iterator it = taxa.begin(); it != taxa.end(); it++) {
+		if ((*it)->name != taxname[i]) {
+			cout << "Name 1: " <<  (*it)->name << endl;
+			cout << "Name 2: " <<  taxname[i] << endl;
+			outError("Tree has different taxa names!");
+		}
+		(*it)->id = i++;
+	}
+}
+
 void MTreeSet::convertSplits(vector<string> &taxname, SplitGraph &sg, SplitIntMap &hash_ss, 
 	int weighting_type, double weight_threshold, char *tag_str, bool sort_taxa) {
 
@@ -442,6 +466,20 @@ void MTreeSet::convertSplits(vector<string> &taxname, SplitGraph &sg, SplitIntMa
 		return;
 	}*/
 
+	if (!tag_str) {
+		// check and number taxa of all trees, then count splits by fingerprints
+		int tree_id = 0;
+		for (iterator it = begin(); it != end(); it++, tree_id++) {
+			if (tree_weights[tree_id] == 0) continue;
+			if (sort_taxa)
+				assignSortedTaxonID(*it, taxname);
+			else if ((*it)->leafNum != taxname.size())
+				outError("Tree has different number of taxa!");
+		}
+		convertSplitsByFingerprint(taxname, sg, hash_ss, weighting_type, weight_threshold);
+		return;
+	}
+
 
 	SplitGraph *isg;
 	int tree_id = 0;
@@ -530,6 +568,407 @@ void MTreeSet::convertSplits(vector<string> &taxname, SplitGraph &sg, SplitIntMa
 }
 
 
+/**
+	average the counted split weights and discard those not above weight_threshold,
+	in the same order as convertSplits()
+	@param split_weight (IN/OUT) summed split weights
+	@param split_value number of trees containing each split
+	@param ntrees number of trees
+	@param kept (OUT) IDs of remaining splits
+	@return number of discarded splits
+*/
+static int selectCountedSplits(DoubleVector &split_weight, IntVector &split_value,
+	int weighting_type, int ntrees, double weight_threshold, IntVector &kept)
+{
+	int nsplits = split_weight.size();
+	int id;
+	if (weighting_type == SW_AVG_PRESENT) {
+		for (id = 0; id < nsplits; id++)
+			split_weight[id] /= split_value[id];
+	} else if (weighting_type == SW_AVG_ALL) {
+		for (id = 0; id < nsplits; id++)
+			split_weight[id] /= ntrees;
+	}
+
+	kept.resize(nsplits);
+	for (id = 0; id < nsplits; id++)
+		kept[id] = id;
+	int discarded = 0;
+	for (id = 0; id < kept.size(); ) {
+		if (split_weight[kept[id]] <= weight_threshold) {
+			discarded++;
+			kept[id] = kept.back();
+			kept.pop_back();
+		} else id++;
+	}
+	return discarded;
+}
+
+void MTreeSet::convertSplitsByFingerprint(vector<string> &taxname, SplitGraph &sg, SplitIntMap &hash_ss,
+	int weighting_type, double weight_threshold)
+{
+	int ntrees = size();
+	int ntaxa = taxname.size();
+	vector<SplitFingerprint> taxon_key;
+	initSplitFingerprintKeys(ntaxa, taxon_key);
+
+	// splits are fingerprinted in parallel for a bounded chunk of trees at a time
+	// and counted in the order of first appearance, like convertSplits()
+	int chunk_size = min(STREAM_TREE_CHUNK, max(ntrees, 1));
+	vector<vector<SplitFingerprint> > tree_fps(chunk_size);
+	vector<DoubleVector> tree_weights_br(chunk_size);
+	vector<BranchVector> tree_branches(chunk_size);
+
+	unordered_map<SplitFingerprint, int, hashfunc_SplitFingerprint> fp_index;
+	DoubleVector split_weight;
+	IntVector split_value;
+	vector<pair<int,Branch> > split_origin; // (tree, branch) of first appearance
+	for (int start = 0; start < ntrees; start += chunk_size) {
+		int end = min(start + chunk_size, ntrees);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int tree_id = start; tree_id < end; tree_id++) {
+			if (tree_weights[tree_id] == 0) continue;
+			at(tree_id)->getSplitFingerprints(taxon_key, tree_fps[tree_id-start],
+				tree_weights_br[tree_id-start], tree_branches[tree_id-start]);
+		}
+
+		for (int tree_id = start; tree_id < end; tree_id++) {
+			if (tree_weights[tree_id] == 0) continue;
+			vector<SplitFingerprint> &fps = tree_fps[tree_id-start];
+			DoubleVector &weights_br = tree_weights_br[tree_id-start];
+			BranchVector &branches = tree_branches[tree_id-start];
+			for (int i = 0; i < fps.size(); i++) {
+				double weight = (weighting_type != SW_COUNT) ?
+					weights_br[i] * tree_weights[tree_id] : tree_weights[tree_id];
+				auto found = fp_index.find(fps[i]);
+				if (found != fp_index.end()) {
+					split_weight[found->second] += weight;
+					split_value[found->second] += tree_weights[tree_id];
+				} else {
+					fp_index[fps[i]] = split_weight.size();
+					split_weight.push_back(weight);
+					split_value.push_back(tree_weights[tree_id]);
+					split_origin.push_back(make_pair(tree_id, branches[i]));
+				}
+			}
+			// free memory of this tree as we go
+			fps.clear();
+			weights_br.clear();
+			branches.clear();
+		}
+	}
+	fp_index.clear();
+
+	IntVector kept;
+	int discarded = selectCountedSplits(split_weight, split_value, weighting_type, tree_weights.size(),
+		weight_threshold, kept);
+
+	// only now create the Split objects
+	int nkept = kept.size();
+	size_t first = sg.size();
+	sg.resize(first + nkept, NULL);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+	for (int i = 0; i < nkept; i++) {
+		int split = kept[i];
+		MTree *tree = at(split_origin[split].first);
+		Branch &branch = split_origin[split].second;
+		IntVector taxa;
+		tree->getTaxaID(taxa, branch.second, branch.first);
+		sg[first + i] = new Split(ntaxa, split_weight[split], taxa);
+	}
+	for (int i = 0; i < nkept; i++)
+		hash_ss.insertSplit(sg[first + i], split_value[kept[i]]);
+
+	if (discarded)
+		cout << discarded << " split(s) discarded because weight <= " << weight_threshold << endl;
+}
+
+/**
+	read the next NEWICK string (up to and including ';') from a tree file
+	@return false at end of file
+*/
+static bool readTreeString(istream &in, string &str) {
+	if (!getline(in, str, ';'))
+		return false;
+	size_t pos = str.find_first_not_of(" \t\r\n");
+	if (pos == string::npos)
+		return false;
+	str.erase(0, pos);
+	str += ';';
+	return true;
+}
+
+void MTreeSet::convertSplitsStreaming(const char *infile, bool &is_rooted, int burnin, int max_count,
+	const char *tree_weight_file, vector<string> &taxname, SplitGraph &sg, SplitIntMap &hash_ss,
+	int weighting_type, double weight_threshold)
+{
+	cout << "Streaming tree(s) file " << infile << " ..." << endl;
+	IntVector file_weights;
+	if (tree_weight_file)
+		readIntVector(tree_weight_file, burnin, max_count, file_weights);
+
+	// igzstream reads both gzipped and plain text files
+	igzstream in;
+	try {
+		in.exceptions(ios::failbit | ios::badbit);
+		in.open(infile);
+		in.exceptions(ios::goodbit);
+	} catch (ios::failure) {
+		outError(ERR_READ_INPUT, infile);
+	}
+
+	string str;
+	if (burnin > 0) {
+		int cnt = 0;
+		while (cnt < burnin && readTreeString(in, str))
+			cnt++;
+		cout << cnt << " beginning tree(s) discarded" << endl;
+		if (cnt < burnin || in.eof())
+			outError("Burnin value is too large.");
+	}
+
+	vector<SplitFingerprint> taxon_key;
+	unordered_map<SplitFingerprint, int, hashfunc_SplitFingerprint> fp_index;
+	DoubleVector split_weight;
+	IntVector split_value;
+	vector<Split*> splits;
+	int ntrees = 0, nrooted = 0;
+	bool more = true;
+	vector<string> tree_strs;
+	tree_weights.clear();
+
+	while (more && ntrees < max_count) {
+		// read a chunk of tree strings, then parse and process them in parallel
+		tree_strs.clear();
+		while (tree_strs.size() < STREAM_TREE_CHUNK && ntrees + tree_strs.size() < max_count &&
+			(more = readTreeString(in, str)))
+			tree_strs.push_back(str);
+		int n = tree_strs.size();
+		if (n == 0)
+			break;
+		IntVector weights(n, 1);
+		if (tree_weight_file) {
+			if (ntrees + n > file_weights.size())
+				outError("Tree file and tree weight file have different number of entries");
+			for (int i = 0; i < n; i++)
+				weights[i] = file_weights[ntrees + i];
+		}
+
+		vector<MTree*> trees(n, NULL);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int i = 0; i < n; i++) {
+			if (weights[i] == 0) continue;
+			stringstream ss(tree_strs[i]);
+			bool myrooted = is_rooted;
+			trees[i] = newTree();
+			trees[i]->readTree(ss, myrooted);
+		}
+		vector<string>().swap(tree_strs);
+
+		if (taxon_key.empty()) {
+			// taxon set is given by the first tree
+			int first;
+			for (first = 0; first < n && !trees[first]; first++);
+			if (first < n) {
+				if (taxname.empty()) {
+					taxname.resize(trees[first]->leafNum);
+					trees[first]->getTaxaName(taxname);
+				}
+				sort(taxname.begin(), taxname.end());
+				sg.createBlocks();
+				for (vector<string>::iterator its = taxname.begin(); its != taxname.end(); its++)
+					sg.getTaxa()->AddTaxonLabel(NxsString(its->c_str()));
+				initSplitFingerprintKeys(taxname.size(), taxon_key);
+				is_rooted = trees[first]->rooted;
+			}
+		}
+
+		vector<vector<SplitFingerprint> > tree_fps(n);
+		vector<DoubleVector> tree_lens(n);
+		vector<BranchVector> tree_branches(n);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int i = 0; i < n; i++) {
+			if (!trees[i]) continue;
+			assignSortedTaxonID(trees[i], taxname);
+			trees[i]->getSplitFingerprints(taxon_key, tree_fps[i], tree_lens[i], tree_branches[i]);
+		}
+
+		// count splits sequentially, remember where new splits first appear
+		vector<pair<int,int> > new_origin;
+		for (int i = 0; i < n; i++) {
+			if (!trees[i]) continue;
+			if (trees[i]->rooted)
+				nrooted++;
+			for (int j = 0; j < tree_fps[i].size(); j++) {
+				double weight = (weighting_type != SW_COUNT) ? tree_lens[i][j] * weights[i] : weights[i];
+				auto found = fp_index.find(tree_fps[i][j]);
+				if (found != fp_index.end()) {
+					split_weight[found->second] += weight;
+					split_value[found->second] += weights[i];
+				} else {
+					fp_index[tree_fps[i][j]] = split_weight.size();
+					split_weight.push_back(weight);
+					split_value.push_back(weights[i]);
+					new_origin.push_back(make_pair(i, j));
+				}
+			}
+		}
+
+		// create Split objects of new splits before the trees are freed
+		int first_new = splits.size();
+		int nnew = new_origin.size();
+		splits.resize(first_new + nnew, NULL);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+		for (int k = 0; k < nnew; k++) {
+			Branch &branch = tree_branches[new_origin[k].first][new_origin[k].second];
+			IntVector taxa;
+			trees[new_origin[k].first]->getTaxaID(taxa, branch.second, branch.first);
+			splits[first_new + k] = new Split(taxname.size(), 0.0, taxa);
+		}
+
+		for (int i = 0; i < n; i++)
+			if (trees[i])
+				delete trees[i];
+		tree_weights.insert(tree_weights.end(), weights.begin(), weights.end());
+		ntrees += n;
+	}
+	in.close();
+	fp_index.clear();
+
+	if (tree_weight_file && ntrees != file_weights.size())
+		outError("Tree file and tree weight file have different number of entries");
+	cout << ntrees << " tree(s) streamed (" << nrooted << " rooted and "
+		<< ntrees - nrooted << " unrooted)" << endl;
+	equal_taxon_set = true;
+
+	IntVector kept;
+	int discarded = selectCountedSplits(split_weight, split_value, weighting_type, ntrees,
+		weight_threshold, kept);
+	BoolVector is_kept(splits.size(), false);
+	for (IntVector::iterator it = kept.begin(); it != kept.end(); it++) {
+		Split *sp = splits[*it];
+		sp->setWeight(split_weight[*it]);
+		sg.push_back(sp);
+		hash_ss.insertSplit(sp, split_value[*it]);
+		is_kept[*it] = true;
+	}
+	for (int id = 0; id < splits.size(); id++)
+		if (!is_kept[id])
+			delete splits[id];
+
+	if (discarded)
+		cout << discarded << " split(s) discarded because weight <= " << weight_threshold << endl;
+}
+
+SplitIDIndex::SplitIDIndex(MTreeSet &trees, double weight_threshold) {
+	int ntrees = trees.size();
+	split_ids.resize(ntrees);
+	heavy_ids.resize(ntrees);
+	use_heavy = false;
+	if (ntrees == 0)
+		return;
+	vector<SplitFingerprint> taxon_key;
+	initSplitFingerprintKeys(trees.front()->leafNum, taxon_key);
+
+	// fingerprints of non-trivial splits, trivial splits are common to all trees
+	vector<vector<SplitFingerprint> > tree_fps(ntrees);
+	vector<DoubleVector> tree_lens(ntrees);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (int tree_id = 0; tree_id < ntrees; tree_id++) {
+		vector<SplitFingerprint> fps;
+		DoubleVector lens;
+		BranchVector branches;
+		trees[tree_id]->getSplitFingerprints(taxon_key, fps, lens, branches);
+		for (int i = 0; i < fps.size(); i++)
+			if (!branches[i].first->isLeaf() && !branches[i].second->isLeaf()) {
+				tree_fps[tree_id].push_back(fps[i]);
+				tree_lens[tree_id].push_back(lens[i]);
+			}
+	}
+
+	// assign global split IDs in tree order
+	unordered_map<SplitFingerprint, int, hashfunc_SplitFingerprint> split_id;
+	for (int tree_id = 0; tree_id < ntrees; tree_id++) {
+		vector<SplitFingerprint> &fps = tree_fps[tree_id];
+		for (int i = 0; i < fps.size(); i++) {
+			int id = split_id.insert(make_pair(fps[i], (int)split_id.size())).first->second;
+			split_ids[tree_id].push_back(id);
+			if (tree_lens[tree_id][i] >= weight_threshold)
+				heavy_ids[tree_id].push_back(id);
+			else
+				use_heavy = true;
+		}
+		vector<SplitFingerprint>().swap(fps);
+	}
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for (int tree_id = 0; tree_id < ntrees; tree_id++) {
+		sort(split_ids[tree_id].begin(), split_ids[tree_id].end());
+		sort(heavy_ids[tree_id].begin(), heavy_ids[tree_id].end());
+	}
+	if (!use_heavy)
+		vector<IntVector>().swap(heavy_ids);
+}
+
+/**
+	@return number of common elements of two sorted vectors
+*/
+static inline int countCommonIDs(IntVector &a, IntVector &b) {
+	const int *pa = a.data(), *end_a = pa + a.size();
+	const int *pb = b.data(), *end_b = pb + b.size();
+	int common = 0;
+	// branch-free merge
+	while (pa < end_a && pb < end_b) {
+		int x = *pa, y = *pb;
+		common += (x == y);
+		pa += (x <= y);
+		pb += (y <= x);
+	}
+	return common;
+}
+
+int SplitIDIndex::getRFDist(int i, int j) {
+	if (!use_heavy)
+		return split_ids[i].size() + split_ids[j].size() - 2 * countCommonIDs(split_ids[i], split_ids[j]);
+	return heavy_ids[i].size() - countCommonIDs(heavy_ids[i], split_ids[j]) +
+		heavy_ids[j].size() - countCommonIDs(heavy_ids[j], split_ids[i]);
+}
+
+void SplitIDIndex::computeRFDist(int first_tree, int num_trees, IntVector &dist) {
+	int ntrees = split_ids.size();
+	int end_tree = first_tree + num_trees;
+	dist.resize((size_t)num_trees * ntrees);
+	// the trees of the tile stay in cache while the other trees are compared with them one by one.
+	// Pairs within the tile are computed once and mirrored, pairs with other trees are also computed by their tiles
+	for (int j = 0; j < ntrees; j++) {
+		for (int i = first_tree; i < end_tree; i++) {
+			if (j == i)
+				dist[(size_t)(i-first_tree)*ntrees + j] = 0;
+			else if (j < first_tree || j >= end_tree) {
+				dist[(size_t)(i-first_tree)*ntrees + j] = getRFDist(i, j);
+			} else if (i < j) {
+				int d = getRFDist(i, j);
+				dist[(size_t)(i-first_tree)*ntrees + j] = d;
+				dist[(size_t)(j-first_tree)*ntrees + i] = d;
+			}
+		}
+	}
+}
+
 MTreeSet::~MTreeSet()
 {
 	for (reverse_iterator it = rbegin(); it != rend(); it++) {
@@ -26,6 +26,12 @@
 
 void readIntVector(const char *file_name, int burnin, int max_count, IntVector &vec);
 
+/** number of trees parsed together in parallel when streaming a tree file */
+#define STREAM_TREE_CHUNK 1024
+
+/** number of trees per row tile when computing RF distances with SplitIDIndex */
+#define RF_TILE 64
+
 /**
 Set of trees
 
@@ -134,6 +140,48 @@ public:
 	void convertSplits(vector<string> &taxname, SplitGraph &sg, SplitIntMap &hash_ss, 
 		int weighting_type, double weight_threshold, char *tag_str, bool sort_taxa = true);
 
+	/**
+		convert all trees into the split system by counting split fingerprints, in parallel over trees.
+		Trees are processed in chunks of STREAM_TREE_CHUNK and only the first branch of each
+		distinct split is kept. Split objects are only created for splits above weight_threshold.
+		Same result as convertSplits() without tag_str
+		@param taxname taxa name, leaf IDs of trees must index into taxname
+		@param sg (OUT) resulting split graph
+		@param hash_ss (OUT) hash split set
+		@param weighting_type split weighting type
+		@param weight_threshold minimum weight cutoff
+	*/
+	void convertSplitsByFingerprint(vector<string> &taxname, SplitGraph &sg, SplitIntMap &hash_ss,
+		int weighting_type, double weight_threshold);
+
+	/**
+		read trees one at a time from a NEWICK file (plain or gzipped) and count their splits
+		without keeping the trees in memory. Trees are parsed in parallel in chunks of STREAM_TREE_CHUNK.
+		Only tree_weights is filled, the tree set itself stays empty.
+		All trees must have the same taxon set.
+		@param infile the name of the tree file
+		@param is_rooted (IN/OUT) true if trees are rooted
+		@param burnin the number of beginning trees to be discarded
+		@param max_count max number of trees to read
+		@param tree_weight_file file containing INTEGER weights of input trees
+		@param taxname (IN/OUT) taxa name, taken from the first tree if empty
+		@param sg (OUT) resulting split graph
+		@param hash_ss (OUT) hash split set
+		@param weighting_type split weighting type
+		@param weight_threshold minimum weight cutoff
+	*/
+	void convertSplitsStreaming(const char *infile, bool &is_rooted, int burnin, int max_count,
+		const char *tree_weight_file, vector<string> &taxname, SplitGraph &sg, SplitIntMap &hash_ss,
+		int weighting_type, double weight_threshold);
+
+	/**
+		discard splits from the split system which appear in at most split_threshold of trees
+		@param sg (IN/OUT) split graph
+		@param hash_ss (IN/OUT) hash split set of sg
+		@param split_threshold only keep those splits which appear more than this threshold
+	*/
+	void discardSplits(SplitGraph &sg, SplitIntMap &hash_ss, double split_threshold);
+
 	/**
 		convert all trees into the split system
 		@param sg (OUT) resulting split graph
@@ -197,4 +245,49 @@ public:
     
 };
 
+/**
+	Index of the non-trivial splits of a tree set for Robinson-Foulds (RF) distances:
+	each distinct split gets a global integer ID once, and each tree becomes a sorted vector of split IDs.
+	Trees must have the same taxon set with consistent leaf IDs (see MTreeSet::checkConsistency()).
+*/
+class SplitIDIndex {
+public:
+	/**
+		constructor, index the splits of all trees in parallel
+		@param trees set of trees
+		@param weight_threshold splits with weight below this are matched but not counted as different,
+			like in MTreeSet::computeRFDist()
+	*/
+	SplitIDIndex(MTreeSet &trees, double weight_threshold);
+
+	/**
+		compute RF distances between a tile of trees and all trees, so that the rows of the
+		distance matrix can be written as soon as their tile is done
+		@param first_tree first tree of the tile
+		@param num_trees number of trees of the tile
+		@param[out] dist dist[k*getNTrees()+j] is the RF distance between tree first_tree+k and tree j
+	*/
+	void computeRFDist(int first_tree, int num_trees, IntVector &dist);
+
+	/**
+		@return number of trees
+	*/
+	int getNTrees() { return split_ids.size(); }
+
+protected:
+	/** sorted split IDs of each tree */
+	vector<IntVector> split_ids;
+
+	/** sorted IDs of splits with weight >= weight_threshold of each tree, only used if use_heavy */
+	vector<IntVector> heavy_ids;
+
+	/** TRUE if some split has weight below the threshold */
+	bool use_heavy;
+
+	/**
+		@return RF distance between tree i and tree j
+	*/
+	int getRFDist(int i, int j);
+};
+
 #endif
@@ -69,6 +69,70 @@ Numeric PhyloTree::dotProductSIMD(Numeric *x, Numeric *y, int size) {
     return horizontal_add(res);
 }
 
+/** number of elements of each vector processed per block in dotProductBatchSIMD */
+#define DOT_PRODUCT_BLOCK 2048
+
+template <class Numeric, class VectorClass>
+void PhyloTree::dotProductBatchSIMD(Numeric **x, int nx, unsigned char **y, int y_size, int ny, int size, Numeric *res) {
+    const int VCSIZE = VectorClass::size();
+    int i, j, k;
+    // accumulate lane-wise exactly like dotProductSIMD, so that results are identical
+    VectorClass *acc = aligned_alloc<VectorClass>(nx*ny);
+    Numeric *w = aligned_alloc<Numeric>(DOT_PRODUCT_BLOCK);
+    for (i = 0; i < nx*ny; i++)
+        acc[i] = 0.0;
+    for (int start = 0; start < size; start += DOT_PRODUCT_BLOCK) {
+        int end = min(start + DOT_PRODUCT_BLOCK, size);
+        int nelem = ((end - start + VCSIZE - 1) / VCSIZE) * VCSIZE;
+        for (j = 0; j < ny; j++) {
+            // unpack the weights of this block into w
+            switch (y_size) {
+            case 1: {
+                unsigned char *yj = y[j] + start;
+                for (k = 0; k < nelem; k++)
+                    w[k] = yj[k];
+                break;
+            }
+            case 2: {
+                unsigned short *yj = (unsigned short*)y[j] + start;
+                for (k = 0; k < nelem; k++)
+                    w[k] = yj[k];
+                break;
+            }
+            default:
+                ASSERT(y_size == sizeof(Numeric));
+                memcpy(w, (Numeric*)y[j] + start, nelem*sizeof(Numeric));
+                break;
+            }
+            VectorClass *accj = acc + j*nx;
+            // four x-vectors at a time to reuse each loaded weight
+            for (i = 0; i+4 <= nx; i += 4) {
+                Numeric *x0 = x[i] + start, *x1 = x[i+1] + start, *x2 = x[i+2] + start, *x3 = x[i+3] + start;
+                VectorClass a0 = accj[i], a1 = accj[i+1], a2 = accj[i+2], a3 = accj[i+3];
+                for (k = 0; k < nelem; k += VCSIZE) {
+                    VectorClass wk = VectorClass().load_a(&w[k]);
+                    a0 = mul_add(VectorClass().load_a(&x0[k]), wk, a0);
+                    a1 = mul_add(VectorClass().load_a(&x1[k]), wk, a1);
+                    a2 = mul_add(VectorClass().load_a(&x2[k]), wk, a2);
+                    a3 = mul_add(VectorClass().load_a(&x3[k]), wk, a3);
+                }
+                accj[i] = a0; accj[i+1] = a1; accj[i+2] = a2; accj[i+3] = a3;
+            }
+            for (; i < nx; i++) {
+                Numeric *xi = x[i] + start;
+                VectorClass a0 = accj[i];
+                for (k = 0; k < nelem; k += VCSIZE)
+                    a0 = mul_add(VectorClass().load_a(&xi[k]), VectorClass().load_a(&w[k]), a0);
+                accj[i] = a0;
+            }
+        }
+    }
+    for (i = 0; i < nx*ny; i++)
+        res[i] = horizontal_add(acc[i]);
+    aligned_free(w);
+    aligned_free(acc);
+}
+
 /************************************************************************************************
  *
  *   Highly optimized vectorized versions of likelihood functions
@@ -39,8 +39,10 @@ void PhyloTree::setParsimonyKernelSSE() {
 void PhyloTree::setDotProductSSE() {
 #ifdef BOOT_VAL_FLOAT
 		dotProduct = &PhyloTree::dotProductSIMD<float, Vec4f>;
+		dotProductBatch = &PhyloTree::dotProductBatchSIMD<float, Vec4f>;
 #else
 		dotProduct = &PhyloTree::dotProductSIMD<double, Vec2d>;
+		dotProductBatch = &PhyloTree::dotProductBatchSIMD<double, Vec2d>;
 #endif
         dotProductDouble = &PhyloTree::dotProductSIMD<double, Vec2d>;
 }
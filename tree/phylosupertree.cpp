@@ -28,12 +28,18 @@ PhyloSuperTree::PhyloSuperTree()
  : IQTree()
 {
 	totalNNIs = evalNNIs = 0;
+    part_sched_passes = 0;
+    arena_partial_lh = NULL;
+    arena_scale_num = NULL;
     rescale_codon_brlen = false;
 	// Initialize the counter for evaluated NNIs on subtrees. FOR THIS CASE IT WON'T BE initialized.
 }
 
 PhyloSuperTree::PhyloSuperTree(SuperAlignment *alignment, bool new_iqtree) :  IQTree(alignment) {
     totalNNIs = evalNNIs = 0;
+    part_sched_passes = 0;
+    arena_partial_lh = NULL;
+    arena_scale_num = NULL;
 
     rescale_codon_brlen = false;
     bool has_codon = false;
@@ -71,6 +77,9 @@ PhyloSuperTree::PhyloSuperTree(SuperAlignment *alignment, bool new_iqtree) :  IQ
 
 PhyloSuperTree::PhyloSuperTree(SuperAlignment *alignment, PhyloSuperTree *super_tree) :  IQTree(alignment) {
 	totalNNIs = evalNNIs = 0;
+    part_sched_passes = 0;
+    arena_partial_lh = NULL;
+    arena_scale_num = NULL;
     rescale_codon_brlen = super_tree->rescale_codon_brlen;
 	part_info = super_tree->part_info;
 	for (vector<Alignment*>::iterator it = alignment->partitions.begin(); it != alignment->partitions.end(); it++) {
@@ -225,6 +234,14 @@ void PhyloSuperTree::changeLikelihoodKernel(LikelihoodKernel lk) {
 }
 
 void PhyloSuperTree::setNumThreads(int num_threads) {
+    part_teams.clear();
+    if (Params::getInstance().partition_hybrid_threads && num_threads > 1) {
+        // hybrid scheduler: partitions get up to all threads, later reduced to their team size
+        PhyloTree::setNumThreads(num_threads);
+        for (iterator it = begin(); it != end(); it++)
+            (*it)->setNumThreads(min(num_threads, max((int)(*it)->aln->getNPattern()/8, 1)));
+        return;
+    }
     PhyloTree::setNumThreads((size() >= num_threads) ? num_threads : 1);
     for (iterator it = begin(); it != end(); it++)
         (*it)->setNumThreads((size() >= num_threads) ? 1 : num_threads);
@@ -552,9 +569,6 @@ void PhyloSuperTree::mapTrees() {
         Pattern taxa_pat = aln->getPattern(part);
         taxa_set.insert(taxa_set.begin(), taxa_pat.begin(), taxa_pat.end());
 		(*it)->copyTree(this, taxa_set);
-        if ((*it)->getModel()) {
-			(*it)->initializeAllPartialLh();
-        }
         (*it)->resetCurScore();
 		NodeVector my_taxa, part_taxa;
 		(*it)->getOrderedTaxa(my_taxa);
@@ -578,6 +592,7 @@ void PhyloSuperTree::mapTrees() {
 		}
 		linkTree(part, part_taxa);
 	}
+	initializeAllPartialLh();
 
 	if (verbose_mode >= VB_DEBUG) printMapInfo();
 }
@@ -588,9 +603,6 @@ void PhyloSuperTree::linkTrees() {
 	for (it = begin(), part = 0; it != end(); it++, part++) {
 		(*it)->initializeTree();
 		(*it)->setAlignment((*it)->aln);
-        if ((*it)->getModel()) {
-			(*it)->initializeAllPartialLh();
-        }
         (*it)->resetCurScore();
 		NodeVector my_taxa, part_taxa;
 		(*it)->getOrderedTaxa(my_taxa);
@@ -608,21 +620,99 @@ void PhyloSuperTree::linkTrees() {
 		}
 		linkTree(part, part_taxa);
 	}
+	initializeAllPartialLh();
 }
 
 void PhyloSuperTree::initializeAllPartialLh() {
+	initPartialLhArena();
 	for (iterator it = begin(); it != end(); it++) {
-		(*it)->initializeAllPartialLh();
+        if ((*it)->getModel())
+			(*it)->initializeAllPartialLh();
 	}
 }
 
 
 void PhyloSuperTree::deleteAllPartialLh() {
+	freePartialLhArena();
 	for (iterator it = begin(); it != end(); it++) {
 		(*it)->deleteAllPartialLh();
 	}
 }
 
+void PhyloSuperTree::initPartialLhArena() {
+    int part, ntrees = size();
+    if (!arena_partial_lh)
+        getMemoryRequired();
+    vector<uint64_t> lh_size(ntrees, 0), scale_size(ntrees, 0);
+    uint64_t total_lh_size = 0, total_scale_size = 0;
+    for (part = 0; part < ntrees; part++) {
+        PhyloTree *tree = at(part);
+        if (!tree->getModel() || !tree->root)
+            continue;
+        tree->getCentralPartialLhSize(lh_size[part], scale_size[part]);
+        // keep every partition block aligned
+        lh_size[part] = ((lh_size[part]+7)/8)*8;
+        scale_size[part] = ((scale_size[part]+63)/64)*64;
+        total_lh_size += lh_size[part];
+        total_scale_size += scale_size[part];
+    }
+    if (arena_partial_lh && lh_size == arena_lh_size && scale_size == arena_scale_size)
+        return;
+    freePartialLhArena();
+    if (total_lh_size == 0)
+        return;
+
+    try {
+        arena_partial_lh = aligned_alloc<double>(total_lh_size);
+        arena_scale_num = aligned_alloc<UBYTE>(total_scale_size);
+    } catch (std::bad_alloc &ba) {
+        outError("Not enough memory for partial likelihood vectors (bad_alloc)");
+    }
+    arena_lh_size = lh_size;
+    arena_scale_size = scale_size;
+
+    double *lh_addr = arena_partial_lh;
+    UBYTE *scale_addr = arena_scale_num;
+    for (part = 0; part < ntrees; part++) {
+        if (lh_size[part] == 0)
+            continue;
+        PhyloTree *tree = at(part);
+        // vectors allocated by the partition tree itself are moved into the arena
+        aligned_free(tree->central_partial_lh);
+        aligned_free(tree->central_scale_num);
+        tree->central_partial_lh = lh_addr;
+        tree->central_scale_num = scale_addr;
+        lh_addr += lh_size[part];
+        scale_addr += scale_size[part];
+    }
+
+    if (verbose_mode >= VB_MED) {
+        cout << "Allocating " << (total_lh_size*sizeof(double) + total_scale_size) / 1048576.0
+             << " MB for partial likelihood vectors of all partitions" << endl;
+        for (part = 0; part < ntrees; part++)
+            if (lh_size[part] > 0)
+                cout << "  " << at(part)->aln->name << ": " << at(part)->max_lh_slots << " slots, "
+                     << (lh_size[part]*sizeof(double) + scale_size[part]) / 1048576.0 << " MB" << endl;
+    }
+}
+
+void PhyloSuperTree::freePartialLhArena() {
+    if (!arena_partial_lh)
+        return;
+    for (int part = 0; part < arena_lh_size.size(); part++) {
+        if (arena_lh_size[part] == 0)
+            continue;
+        // reset these pointers so that they are not deleted by partition trees
+        at(part)->central_partial_lh = NULL;
+        at(part)->central_scale_num = NULL;
+        at(part)->tip_partial_lh = NULL;
+    }
+    aligned_free(arena_partial_lh);
+    aligned_free(arena_scale_num);
+    arena_lh_size.clear();
+    arena_scale_size.clear();
+}
+
 void PhyloSuperTree::clearAllPartialLH(bool make_null) {
     for (iterator it = begin(); it != end(); it++) {
         (*it)->clearAllPartialLH(make_null);
@@ -698,6 +788,180 @@ void PhyloSuperTree::computePartitionOrder() {
 #endif // OPENMP
 }
 
+/** number of scheduled passes before the hybrid thread teams are rebalanced */
+#define HYBRID_REBALANCE_PASSES 100
+
+bool PhyloSuperTree::isHybridSchedule() {
+#ifdef _OPENMP
+    return params->partition_hybrid_threads && num_threads > 1 && size() > 1;
+#else
+    return false;
+#endif
+}
+
+/**
+    @return number of rate and mixture categories of the likelihood vectors of a partition tree
+ */
+static int getNumCatMix(PhyloTree *tree) {
+    if (!tree->getModelFactory())
+        return 1;
+    return tree->getRate()->getNRate() *
+        ((tree->getModelFactory()->fused_mix_rate) ? 1 : tree->getModel()->getNMixtures());
+}
+
+void PhyloSuperTree::computePartitionSchedule(DoubleVector &cost) {
+    int i, ntrees = size();
+    int *id = new int[ntrees];
+    double *neg_cost = new double[ntrees];
+    double total_cost = 0.0;
+    for (i = 0; i < ntrees; i++) {
+        neg_cost[i] = -cost[i];
+        id[i] = i;
+        total_cost += cost[i];
+    }
+    quicksort(neg_cost, 0, ntrees-1, id);
+    delete [] neg_cost;
+
+    part_cost = cost;
+    part_teams.clear();
+    int free_threads = num_threads;
+
+    // large partitions: own team with threads proportional to cost
+    for (i = 0; i < ntrees; i++) {
+        int part = id[i];
+        int team_threads = (total_cost > 0.0) ? (int)floor(cost[part] / total_cost * num_threads) : 0;
+        // not more threads than allocated for this partition by setNumThreads()
+        team_threads = min(team_threads, max((int)at(part)->aln->getNPattern()/8, 1));
+        // keep at least one thread for the remaining partitions
+        team_threads = min(team_threads, (i < ntrees-1) ? free_threads-1 : free_threads);
+        if (team_threads < 2)
+            break;
+        PartitionTeam team;
+        team.num_threads = team_threads;
+        team.parts.push_back(part);
+        team.cost = cost[part];
+        part_teams.push_back(team);
+        free_threads -= team_threads;
+    }
+
+    // small partitions: packed onto single-thread teams, largest first to the least loaded
+    int first_small = part_teams.size();
+    int num_small_teams = min(free_threads, ntrees - i);
+    for (int t = 0; t < num_small_teams; t++) {
+        PartitionTeam team;
+        team.num_threads = 1;
+        team.cost = 0.0;
+        part_teams.push_back(team);
+    }
+    for (; i < ntrees; i++) {
+        int best = first_small;
+        for (int t = first_small+1; t < part_teams.size(); t++)
+            if (part_teams[t].cost < part_teams[best].cost)
+                best = t;
+        part_teams[best].parts.push_back(id[i]);
+        part_teams[best].cost += cost[id[i]];
+    }
+    delete [] id;
+
+    for (auto team = part_teams.begin(); team != part_teams.end(); team++)
+        for (auto part : team->parts)
+            at(part)->setNumThreads(team->num_threads);
+
+    if (verbose_mode >= VB_MAX) {
+        cout << "Hybrid partition schedule with " << part_teams.size() << " thread teams:" << endl;
+        for (i = 0; i < part_teams.size(); i++)
+            cout << "  team " << i+1 << ": " << part_teams[i].num_threads << " threads, "
+                 << part_teams[i].parts.size() << " partitions, cost " << part_teams[i].cost << endl;
+    }
+}
+
+int PhyloSuperTree::beginPartitionSchedule() {
+    if (part_teams.empty()) {
+        // initial estimate: patterns x states x categories
+        int ntrees = size();
+        DoubleVector cost(ntrees);
+        for (int i = 0; i < ntrees; i++) {
+            PhyloTree *tree = at(i);
+            cost[i] = ((double)tree->aln->getNPattern()) * tree->aln->num_states * getNumCatMix(tree);
+        }
+        computePartitionSchedule(cost);
+        part_time.assign(ntrees, 0.0);
+        part_sched_passes = 0;
+    }
+    if (!isHybridSchedule())
+        return num_threads;
+#ifdef _OPENMP
+    omp_set_nested(true);
+#endif
+    return part_teams.size();
+}
+
+void PhyloSuperTree::endPartitionSchedule() {
+#ifdef _OPENMP
+    if (isHybridSchedule())
+        omp_set_nested(false);
+#endif
+    if (++part_sched_passes < HYBRID_REBALANCE_PASSES)
+        return;
+    // rebalance by measured times; unmeasured partitions keep their previous cost, rescaled
+    int i, ntrees = size();
+    DoubleVector cost = part_cost;
+    double measured_time = 0.0, measured_cost = 0.0;
+    for (i = 0; i < ntrees; i++)
+        if (part_time[i] > 0.0) {
+            measured_time += part_time[i];
+            measured_cost += cost[i];
+        }
+    if (measured_time > 0.0 && measured_cost > 0.0) {
+        for (i = 0; i < ntrees; i++)
+            cost[i] = (part_time[i] > 0.0) ? part_time[i] : cost[i] * measured_time / measured_cost;
+        computePartitionSchedule(cost);
+    }
+    part_time.assign(ntrees, 0.0);
+    part_sched_passes = 0;
+}
+
+void PhyloSuperTree::forEachPartition(PartitionWork &work, bool by_nptn) {
+    int ntrees = size();
+    bool teams = isHybridSchedule();
+    int nteams = ntrees, outer_threads = num_threads;
+    if (teams) {
+        outer_threads = beginPartitionSchedule();
+        nteams = part_teams.size();
+    } else if (part_order.empty())
+        computePartitionOrder();
+    IntVector &order = by_nptn ? part_order_by_nptn : part_order;
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(outer_threads) if(num_threads > 1)
+    #endif
+    for (int teamid = 0; teamid < nteams; teamid++) {
+        int team_size = teams ? part_teams[teamid].parts.size() : 1;
+        for (int k = 0; k < team_size; k++) {
+            int part = teams ? part_teams[teamid].parts[k] : order[teamid];
+            double start_time = getRealTime();
+            work.run(part);
+            if (teams)
+                part_time[part] += (getRealTime() - start_time) * part_teams[teamid].num_threads;
+        }
+    }
+    if (teams)
+        endPartitionSchedule();
+}
+
+/**
+    compute the log-likelihood of a partition tree
+ */
+class PartitionLikelihoodWork : public PartitionWork {
+public:
+    PhyloSuperTree *tree;
+
+    PartitionLikelihoodWork(PhyloSuperTree *tree) : tree(tree) {}
+
+    virtual void run(int part) {
+        tree->part_info[part].cur_score = tree->at(part)->computeLikelihood();
+    }
+};
+
 double PhyloSuperTree::computeLikelihood(double *pattern_lh) {
 	double tree_lh = 0.0;
 	int ntrees = size();
@@ -711,15 +975,10 @@ double PhyloSuperTree::computeLikelihood(double *pattern_lh) {
 			pattern_lh += at(i)->getAlnNPattern();
 		}
 	} else {
-        if (part_order.empty()) computePartitionOrder();
-		#ifdef _OPENMP
-		#pragma omp parallel for reduction(+: tree_lh) schedule(dynamic) if(num_threads > 1)
-		#endif
-		for (int j = 0; j < ntrees; j++) {
-            int i = part_order[j];
-			part_info[i].cur_score = at(i)->computeLikelihood();
+        PartitionLikelihoodWork work(this);
+        forEachPartition(work);
+		for (int i = 0; i < ntrees; i++)
 			tree_lh += part_info[i].cur_score;
-		}
 	}
 	return tree_lh;
 }
@@ -769,16 +1028,30 @@ void PhyloSuperTree::computePatternProbabilityCategory(double *ptn_prob_cat, Sit
 	}
 }
 
+/**
+    optimize all branch lengths of a partition tree
+ */
+class PartitionBranchWork : public PartitionWork {
+public:
+    PhyloSuperTree *tree;
+    int my_iterations;
+    double tolerance;
+    int maxNRStep;
+
+    PartitionBranchWork(PhyloSuperTree *tree, int my_iterations, double tolerance, int maxNRStep)
+        : tree(tree), my_iterations(my_iterations), tolerance(tolerance), maxNRStep(maxNRStep) {}
+
+    virtual void run(int part) {
+        tree->part_info[part].cur_score = tree->at(part)->optimizeAllBranches(my_iterations, tolerance, maxNRStep);
+    }
+};
+
 double PhyloSuperTree::optimizeAllBranches(int my_iterations, double tolerance, int maxNRStep) {
 	double tree_lh = 0.0;
 	int ntrees = size();
-    if (part_order.empty()) computePartitionOrder();
-	#ifdef _OPENMP
-	#pragma omp parallel for reduction(+: tree_lh) schedule(dynamic) if(num_threads > 1)
-	#endif
-	for (int j = 0; j < ntrees; j++) {
-        int i = part_order[j];
-		part_info[i].cur_score = at(i)->optimizeAllBranches(my_iterations, tolerance/min(ntrees,10), maxNRStep);
+    PartitionBranchWork work(this, my_iterations, tolerance/min(ntrees,10), maxNRStep);
+    forEachPartition(work);
+	for (int i = 0; i < ntrees; i++) {
 		tree_lh += part_info[i].cur_score;
 		if (verbose_mode >= VB_MAX)
 			at(i)->printTree(cout, WT_BR_LEN + WT_NEWLINE);
@@ -803,6 +1076,7 @@ PhyloSuperTree::~PhyloSuperTree()
 	}
 	part_info.clear();
 
+	freePartialLhArena();
 	for (reverse_iterator it = rbegin(); it != rend(); it++)
 		delete (*it);
 	clear();
@@ -849,6 +1123,84 @@ int PhyloSuperTree::getMaxPartNameLength() {
 	return namelen;
 }
 
+/**
+    evaluate the two NNIs around a branch on a partition tree
+ */
+class PartitionNNIWork : public PartitionWork {
+public:
+    PhyloSuperTree *tree;
+    vector<PartitionInfo> &part_info;
+    PhyloNode *node1, *node2;
+    SuperNeighbor *nei1, *nei2, *node1_nei, *node2_nei, *node2_nei_other;
+    bool save_ptnlh;         // whether the pattern likelihoods of partitions without the NNI are needed
+    vector<char> evaluated;  // whether the NNIs were evaluated on each partition
+
+    PartitionNNIWork(PhyloSuperTree *tree, PhyloNode *node1, PhyloNode *node2, SuperNeighbor *nei1, SuperNeighbor *nei2,
+                     SuperNeighbor *node1_nei, SuperNeighbor *node2_nei, SuperNeighbor *node2_nei_other, bool save_ptnlh)
+        : tree(tree), part_info(tree->part_info), node1(node1), node2(node2), nei1(nei1), nei2(nei2),
+          node1_nei(node1_nei), node2_nei(node2_nei), node2_nei_other(node2_nei_other), save_ptnlh(save_ptnlh),
+          evaluated(tree->size(), 0) {}
+
+    virtual void run(int part) {
+        bool is_nni = true;
+        FOR_NEIGHBOR_DECLARE(node1, NULL, nit) {
+            if (! ((SuperNeighbor*)*nit)->link_neighbors[part]) { is_nni = false; break; }
+        }
+        FOR_NEIGHBOR(node2, NULL, nit) {
+            if (! ((SuperNeighbor*)*nit)->link_neighbors[part]) { is_nni = false; break; }
+        }
+        if (!is_nni && tree->params->terrace_aware) {
+            if (part_info[part].cur_score == 0.0)  {
+                part_info[part].cur_score = tree->at(part)->computeLikelihood();
+                if (save_ptnlh)
+                    tree->at(part)->computePatternLikelihood(part_info[part].cur_ptnlh, &part_info[part].cur_score);
+            }
+            return;
+        }
+
+        evaluated[part] = 1;
+        part_info[part].evalNNIs++;
+
+        PhyloNeighbor *nei1_part = nei1->link_neighbors[part];
+        PhyloNeighbor *nei2_part = nei2->link_neighbors[part];
+
+        int brid = nei1_part->id;
+
+        //NNIMove part_moves[2];
+        //part_moves[0].node1Nei_it = NULL;
+
+        // setup subtree NNI correspondingly
+        PhyloNode *node1_part = (PhyloNode*)nei2_part->node;
+        PhyloNode *node2_part = (PhyloNode*)nei1_part->node;
+        part_info[part].nniMoves[0].node1 = part_info[part].nniMoves[1].node1 = node1;
+        part_info[part].nniMoves[0].node2 = part_info[part].nniMoves[1].node2 = node2;
+        part_info[part].nniMoves[0].node1Nei_it = node1_part->findNeighborIt(node1_nei->link_neighbors[part]->node);
+        part_info[part].nniMoves[0].node2Nei_it = node2_part->findNeighborIt(node2_nei->link_neighbors[part]->node);
+
+        part_info[part].nniMoves[1].node1Nei_it = node1_part->findNeighborIt(node1_nei->link_neighbors[part]->node);
+        part_info[part].nniMoves[1].node2Nei_it = node2_part->findNeighborIt(node2_nei_other->link_neighbors[part]->node);
+
+        tree->at(part)->getBestNNIForBran((PhyloNode*)nei2_part->node, (PhyloNode*)nei1_part->node, part_info[part].nniMoves);
+        // detect the corresponding NNIs and swap if necessary (the swapping refers to the swapping of NNI order)
+        if (!((*part_info[part].nniMoves[0].node1Nei_it == node1_nei->link_neighbors[part] &&
+                *part_info[part].nniMoves[0].node2Nei_it == node2_nei->link_neighbors[part]) ||
+            (*part_info[part].nniMoves[0].node1Nei_it != node1_nei->link_neighbors[part] &&
+                    *part_info[part].nniMoves[0].node2Nei_it != node2_nei->link_neighbors[part])))
+        {
+            outError("WRONG");
+            NNIMove tmp = part_info[part].nniMoves[0];
+            part_info[part].nniMoves[0] = part_info[part].nniMoves[1];
+            part_info[part].nniMoves[1] = tmp;
+        }
+        int numlen = 1;
+        if (tree->params->nni5) numlen = 5;
+        for (int i = 0; i < numlen; i++) {
+            part_info[part].nni1_brlen[brid*numlen + i] = part_info[part].nniMoves[0].newLen[i];
+            part_info[part].nni2_brlen[brid*numlen + i] = part_info[part].nniMoves[1].newLen[i];
+        }
+    }
+};
+
 NNIMove PhyloSuperTree::getBestNNIForBran(PhyloNode *node1, PhyloNode *node2, NNIMove *nniMoves) {
     if (((PhyloNeighbor*)node1->findNeighbor(node2))->direction == TOWARD_ROOT) {
         // swap node1 and node2 if the direction is not right, only for nonreversible models
@@ -910,75 +1262,20 @@ NNIMove PhyloSuperTree::getBestNNIForBran(PhyloNode *node1, PhyloNode *node2, NN
 	double nni_score1 = 0.0, nni_score2 = 0.0;
 	int local_totalNNIs = 0, local_evalNNIs = 0;
 
-    if (part_order.empty()) computePartitionOrder();
-	#ifdef _OPENMP
-	#pragma omp parallel for reduction(+: nni_score1, nni_score2, local_totalNNIs, local_evalNNIs) private(part) schedule(dynamic) if(num_threads>1)
-	#endif
-	for (int treeid = 0; treeid < ntrees; treeid++) {
-        part = part_order_by_nptn[treeid];
-		bool is_nni = true;
-		local_totalNNIs++;
-		FOR_NEIGHBOR_DECLARE(node1, NULL, nit) {
-			if (! ((SuperNeighbor*)*nit)->link_neighbors[part]) { is_nni = false; break; }
-		}
-		FOR_NEIGHBOR(node2, NULL, nit) {
-			if (! ((SuperNeighbor*)*nit)->link_neighbors[part]) { is_nni = false; break; }
-		}
-		if (!is_nni && params->terrace_aware) {
-			if (part_info[part].cur_score == 0.0)  {
-				part_info[part].cur_score = at(part)->computeLikelihood();
-				if (save_all_trees == 2 || nniMoves)
-					at(part)->computePatternLikelihood(part_info[part].cur_ptnlh, &part_info[part].cur_score);
-			}
-			nni_score1 += part_info[part].cur_score;
-			nni_score2 += part_info[part].cur_score;
-			continue;
-		}
-
-		local_evalNNIs++;
-		part_info[part].evalNNIs++;
-
-		PhyloNeighbor *nei1_part = nei1->link_neighbors[part];
-		PhyloNeighbor *nei2_part = nei2->link_neighbors[part];
-
-		int brid = nei1_part->id;
-
-		//NNIMove part_moves[2];
-		//part_moves[0].node1Nei_it = NULL;
-
-		// setup subtree NNI correspondingly
-		PhyloNode *node1_part = (PhyloNode*)nei2_part->node;
-		PhyloNode *node2_part = (PhyloNode*)nei1_part->node;
-		part_info[part].nniMoves[0].node1 = part_info[part].nniMoves[1].node1 = node1;
-		part_info[part].nniMoves[0].node2 = part_info[part].nniMoves[1].node2 = node2;
-		part_info[part].nniMoves[0].node1Nei_it = node1_part->findNeighborIt(node1_nei->link_neighbors[part]->node);
-		part_info[part].nniMoves[0].node2Nei_it = node2_part->findNeighborIt(node2_nei->link_neighbors[part]->node);
-
-		part_info[part].nniMoves[1].node1Nei_it = node1_part->findNeighborIt(node1_nei->link_neighbors[part]->node);
-		part_info[part].nniMoves[1].node2Nei_it = node2_part->findNeighborIt(node2_nei_other->link_neighbors[part]->node);
-
-		at(part)->getBestNNIForBran((PhyloNode*)nei2_part->node, (PhyloNode*)nei1_part->node, part_info[part].nniMoves);
-		// detect the corresponding NNIs and swap if necessary (the swapping refers to the swapping of NNI order)
-		if (!((*part_info[part].nniMoves[0].node1Nei_it == node1_nei->link_neighbors[part] &&
-				*part_info[part].nniMoves[0].node2Nei_it == node2_nei->link_neighbors[part]) ||
-			(*part_info[part].nniMoves[0].node1Nei_it != node1_nei->link_neighbors[part] &&
-					*part_info[part].nniMoves[0].node2Nei_it != node2_nei->link_neighbors[part])))
-		{
-			outError("WRONG");
-			NNIMove tmp = part_info[part].nniMoves[0];
-			part_info[part].nniMoves[0] = part_info[part].nniMoves[1];
-			part_info[part].nniMoves[1] = tmp;
-		}
-		nni_score1 += part_info[part].nniMoves[0].newloglh;
-		nni_score2 += part_info[part].nniMoves[1].newloglh;
-		int numlen = 1;
-		if (params->nni5) numlen = 5;
-		for (int i = 0; i < numlen; i++) {
-			part_info[part].nni1_brlen[brid*numlen + i] = part_info[part].nniMoves[0].newLen[i];
-			part_info[part].nni2_brlen[brid*numlen + i] = part_info[part].nniMoves[1].newLen[i];
-		}
-
-	}
+    PartitionNNIWork work(this, node1, node2, nei1, nei2, node1_nei, node2_nei, node2_nei_other,
+                          save_all_trees == 2 || nniMoves);
+    forEachPartition(work, true);
+    for (part = 0; part < ntrees; part++) {
+        local_totalNNIs++;
+        if (work.evaluated[part]) {
+            local_evalNNIs++;
+            nni_score1 += part_info[part].nniMoves[0].newloglh;
+            nni_score2 += part_info[part].nniMoves[1].newloglh;
+        } else {
+            nni_score1 += part_info[part].cur_score;
+            nni_score2 += part_info[part].cur_score;
+        }
+    }
 	totalNNIs += local_totalNNIs;
 	evalNNIs += local_evalNNIs;
 	double nni_scores[2] = {nni_score1, nni_score2};
@@ -1222,12 +1519,75 @@ PhyloTree *PhyloSuperTree::extractSubtree(set<int> &ids) {
 uint64_t PhyloSuperTree::getMemoryRequired(size_t ncategory, bool full_mem) {
 //	uint64_t mem_size = PhyloTree::getMemoryRequired(ncategory);
 	// supertree does not need any memory for likelihood vectors!
+    // -mem in bytes is one budget shared by all partitions
+    if (!full_mem && params->lh_mem_save == LM_MEM_SAVE && params->max_mem_size > 1)
+        return distributeMemoryBudget(ncategory);
 	uint64_t mem_size = 0;
 	for (iterator it = begin(); it != end(); it++)
 		mem_size += (*it)->getMemoryRequired(ncategory, full_mem);
 	return mem_size;
 }
 
+/**
+    order partitions for the memory budget: recomputing a partial likelihood vector costs about
+    #states times its size, ties are broken by more patterns first, then by the partition index
+ */
+struct MemoryBudgetOrder {
+    PhyloSuperTree *tree;
+    bool operator()(int a, int b) const {
+        Alignment *aln_a = tree->at(a)->aln, *aln_b = tree->at(b)->aln;
+        if (aln_a->num_states != aln_b->num_states)
+            return aln_a->num_states > aln_b->num_states;
+        if (aln_a->getNPattern() != aln_b->getNPattern())
+            return aln_a->getNPattern() > aln_b->getNPattern();
+        return a < b;
+    }
+};
+
+uint64_t PhyloSuperTree::distributeMemoryBudget(size_t ncategory) {
+    int i, ntrees = size();
+    double saved_max_mem_size = params->max_mem_size;
+    vector<uint64_t> min_mem(ntrees), max_mem(ntrees);
+    vector<int64_t> min_slots(ntrees), max_slots(ntrees);
+    IntVector id(ntrees);
+    uint64_t total_min_mem = 0;
+
+    for (i = 0; i < ntrees; i++) {
+        PhyloTree *tree = at(i);
+        max_mem[i] = tree->getMemoryRequired(ncategory, true);
+        max_slots[i] = tree->max_lh_slots;
+        params->max_mem_size = 0.0;
+        min_mem[i] = tree->getMemoryRequired(ncategory, false);
+        min_slots[i] = tree->max_lh_slots;
+        params->max_mem_size = saved_max_mem_size;
+        total_min_mem += min_mem[i];
+        id[i] = i;
+    }
+    MemoryBudgetOrder order = {this};
+    sort(id.begin(), id.end(), order);
+
+    if (total_min_mem > params->max_mem_size)
+        cout << "WARNING: Too low -mem, automatically increased to " << total_min_mem/1048576.0 << " MB" << endl;
+
+    int64_t rest_mem = (int64_t)params->max_mem_size - (int64_t)total_min_mem;
+    uint64_t mem_size = 0;
+    for (i = 0; i < ntrees; i++) {
+        int part = id[i];
+        int64_t slots = min_slots[part];
+        uint64_t part_mem = min_mem[part];
+        if (max_slots[part] > min_slots[part] && rest_mem > 0) {
+            uint64_t slot_mem = (max_mem[part] - min_mem[part]) / (max_slots[part] - min_slots[part]);
+            int64_t extra_slots = min((int64_t)(rest_mem / slot_mem), max_slots[part] - min_slots[part]);
+            slots += extra_slots;
+            part_mem += extra_slots * slot_mem;
+            rest_mem -= extra_slots * slot_mem;
+        }
+        at(part)->max_lh_slots = slots;
+        mem_size += part_mem;
+    }
+    return mem_size;
+}
+
 // get memory requirement for ModelFinder
 uint64_t PhyloSuperTree::getMemoryRequiredThreaded(size_t ncategory, bool full_mem) {
     // only get the largest k partitions (k=#threads)
@@ -1418,18 +1778,9 @@ void PhyloSuperTree::writeMarginalAncestralState(ostream &out, PhyloNode *node,
     double *ptn_ancestral_prob, int *ptn_ancestral_seq) {
     int part = 1;
     for (auto it = begin(); it != end(); ++it, ++part) {
-        size_t nsites  = (*it)->getAlnNSite();
         int    nstates = (*it)->model->num_states;
-        for (size_t site = 0; site < nsites; ++site) {
-            int ptn = (*it)->aln->getPatternID(site);
-            out << node->name << "\t" << part << "\t" << site+1 << "\t";
-            out << (*it)->aln->convertStateBackStr(ptn_ancestral_seq[ptn]);
-            double *state_prob = ptn_ancestral_prob + ptn*nstates;
-            for (int j = 0; j < nstates; ++j) {
-                out << "\t" << state_prob[j];
-            }
-            out << endl;
-        }
+        writeMarginalAncestralSites(out, node->name + "\t" + convertIntToString(part) + "\t", (*it)->aln, nstates,
+            ptn_ancestral_prob, ptn_ancestral_seq);
         size_t nptn = (*it)->getAlnNPattern();
         ptn_ancestral_prob += nptn*nstates;
         ptn_ancestral_seq += nptn;
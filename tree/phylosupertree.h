@@ -49,6 +49,33 @@ struct PartitionInfo {
     NNIMove nniMoves[2];
 };
 
+/**
+    A group of partitions handled by one thread of the outer partition loop
+    in the hybrid scheduler (--thread-hybrid). Each partition of the team
+    is computed with num_threads threads over its patterns.
+ */
+struct PartitionTeam {
+    int num_threads;  // number of threads for each partition of this team
+    IntVector parts;  // partition IDs, in descending order of cost
+    double cost;      // total cost of all partitions of this team
+};
+
+/**
+    The work on one partition in a pass over all partitions (see PhyloSuperTree::forEachPartition).
+    run() is called concurrently for different partitions, so it must only
+    write results belonging to its partition.
+ */
+class PartitionWork {
+public:
+    virtual ~PartitionWork() {}
+
+    /**
+        do the work on one partition
+        @param part partition ID
+     */
+    virtual void run(int part) = 0;
+};
+
 /**
 Phylogenetic tree for partition model (multi-gene alignment)
 
@@ -365,6 +392,54 @@ public:
     /* compute part_order vector */
     void computePartitionOrder();
 
+    /* thread teams of the hybrid partition scheduler */
+    vector<PartitionTeam> part_teams;
+
+    /* cost of each partition used for the current thread teams */
+    DoubleVector part_cost;
+
+    /* measured kernel time (in thread-seconds) per partition since last rebalancing */
+    DoubleVector part_time;
+
+    /* number of scheduled passes since last rebalancing */
+    int part_sched_passes;
+
+    /**
+        @return true if partitions are scheduled by the hybrid scheduler
+     */
+    bool isHybridSchedule();
+
+    /**
+        compute the thread teams for the hybrid scheduler. Partitions whose cost
+        exceed the share of 2 threads get their own team with a number of threads
+        proportional to their cost; the remaining partitions are packed onto
+        single-thread teams by longest-processing-time-first.
+        @param cost computational cost of each partition
+     */
+    void computePartitionSchedule(DoubleVector &cost);
+
+    /**
+        compute the thread teams if needed and enable nested OpenMP parallelism
+        before a scheduled pass over all partitions
+        @return number of threads for the loop over part_teams
+     */
+    int beginPartitionSchedule();
+
+    /**
+        disable nested OpenMP parallelism after a scheduled pass and periodically
+        rebalance the thread teams using the measured kernel times
+     */
+    void endPartitionSchedule();
+
+    /**
+        run the work on every partition, by the thread teams if isHybridSchedule(),
+        otherwise by a dynamic loop over the partitions from the most costly one
+        @param work the work on one partition
+        @param by_nptn TRUE to order the partitions by their number of patterns (part_order_by_nptn)
+               instead of their cost (part_order) if there are no thread teams
+     */
+    void forEachPartition(PartitionWork &work, bool by_nptn = false);
+
     /**
             get the name of the model
     */
@@ -388,6 +463,35 @@ public:
      */
     virtual uint64_t getMemoryRequiredThreaded(size_t ncategory = 1, bool full_mem = false);
 
+    /**
+     * distribute the -mem budget over all partitions: every partition gets the minimum
+     * number of partial likelihood slots, the rest is given in full to partitions where
+     * recomputation is most expensive (more states), so that memory saving happens in
+     * partitions where recomputation is cheapest. Sets max_lh_slots of partition trees.
+     * @return memory size required in bytes
+     */
+    uint64_t distributeMemoryBudget(size_t ncategory = 1);
+
+    /**
+     * allocate central_partial_lh and central_scale_num of all partition trees from one
+     * shared arena; reuse the arena if the sizes did not change
+     */
+    void initPartialLhArena();
+
+    /**
+     * detach partition trees from the shared arena and free it
+     */
+    void freePartialLhArena();
+
+    /** shared arena for central_partial_lh of all partition trees */
+    double *arena_partial_lh;
+
+    /** shared arena for central_scale_num of all partition trees */
+    UBYTE *arena_scale_num;
+
+    /** number of entries of central_partial_lh and central_scale_num per partition in the arena */
+    vector<uint64_t> arena_lh_size, arena_scale_size;
+
     /**
      * count the number of super branches that map to no branches in gene trees
      */
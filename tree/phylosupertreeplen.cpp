@@ -303,6 +303,73 @@ void PhyloSuperTreePlen::optimizeOneBranch(PhyloNode *node1, PhyloNode *node2, b
 //	return tree_lh;
 }
 
+/**
+    move a branch of a partition tree by lambda times the partition rate and compute
+    the log-likelihood of the partition tree, or reuse it if the partition tree lacks the branch
+ */
+class PartitionBranchLikelihoodWork : public PartitionWork {
+public:
+    PhyloSuperTree *tree;
+    SuperNeighbor *nei1, *nei2;
+    double lambda;
+
+    PartitionBranchLikelihoodWork(PhyloSuperTree *tree, SuperNeighbor *nei1, SuperNeighbor *nei2, double lambda)
+        : tree(tree), nei1(nei1), nei2(nei2), lambda(lambda) {}
+
+    virtual void run(int part) {
+        PartitionInfo &info = tree->part_info[part];
+        PhyloNeighbor *nei1_part = nei1->link_neighbors[part];
+        PhyloNeighbor *nei2_part = nei2->link_neighbors[part];
+        if (nei1_part && nei2_part) {
+            tree->at(part)->current_it = nei1_part;
+            tree->at(part)->current_it_back = nei2_part;
+            nei1_part->length += lambda*info.part_rate;
+            nei2_part->length += lambda*info.part_rate;
+            info.cur_score = tree->at(part)->computeLikelihoodBranch(nei2_part,(PhyloNode*)nei1_part->node);
+        } else if (info.cur_score == 0.0)
+            info.cur_score = tree->at(part)->computeLikelihood();
+    }
+};
+
+/**
+    move a branch of a partition tree by lambda times the partition rate and compute
+    the derivatives of the log-likelihood with respect to the super tree branch
+ */
+class PartitionBranchDervWork : public PartitionWork {
+public:
+    PhyloSuperTree *tree;
+    SuperNeighbor *nei1, *nei2;
+    double lambda;
+    DoubleVector df, ddf;  // derivatives of each partition, 0 if the partition tree lacks the branch
+
+    PartitionBranchDervWork(PhyloSuperTree *tree, SuperNeighbor *nei1, SuperNeighbor *nei2, double lambda)
+        : tree(tree), nei1(nei1), nei2(nei2), lambda(lambda), df(tree->size(), 0.0), ddf(tree->size(), 0.0) {}
+
+    virtual void run(int part) {
+        PartitionInfo &info = tree->part_info[part];
+        double df_aux, ddf_aux;
+        PhyloNeighbor *nei1_part = nei1->link_neighbors[part];
+        PhyloNeighbor *nei2_part = nei2->link_neighbors[part];
+        if (nei1_part && nei2_part) {
+            tree->at(part)->current_it = nei1_part;
+            tree->at(part)->current_it_back = nei2_part;
+
+            nei1_part->length += lambda*info.part_rate;
+            nei2_part->length += lambda*info.part_rate;
+            if(nei1_part->length<-1e-4) {
+                cout<<"lambda = "<<lambda<<endl;
+                cout<<"NEGATIVE BRANCH len = "<<nei1_part->length<<endl<<" rate = "<<info.part_rate<<endl;
+                ASSERT(0);
+                outError("shit!!   ",__func__);
+            }
+            tree->at(part)->computeLikelihoodDerv(nei2_part,(PhyloNode*)nei1_part->node, &df_aux, &ddf_aux);
+            df[part] = info.part_rate*df_aux;
+            ddf[part] = info.part_rate*info.part_rate*ddf_aux;
+        } else if (info.cur_score == 0.0)
+            info.cur_score = tree->at(part)->computeLikelihood();
+    }
+};
+
 double PhyloSuperTreePlen::computeFunction(double value) {
 
 	double tree_lh = 0.0;
@@ -318,27 +385,10 @@ double PhyloSuperTreePlen::computeFunction(double value) {
 	SuperNeighbor *nei2 = (SuperNeighbor*)current_it->node->findNeighbor(current_it_back->node);
 	ASSERT(nei1 && nei2);
 
-    if (part_order.empty()) computePartitionOrder();
-    #ifdef _OPENMP
-    #pragma omp parallel for reduction(+: tree_lh) schedule(dynamic) if(num_threads > 1)
-    #endif    
-	for (int partid = 0; partid < ntrees; partid++) {
-            int part = part_order_by_nptn[partid];
-			PhyloNeighbor *nei1_part = nei1->link_neighbors[part];
-			PhyloNeighbor *nei2_part = nei2->link_neighbors[part];
-			if (nei1_part && nei2_part) {
-				at(part)->current_it = nei1_part;
-				at(part)->current_it_back = nei2_part;
-				nei1_part->length += lambda*part_info[part].part_rate;
-				nei2_part->length += lambda*part_info[part].part_rate;
-				part_info[part].cur_score = at(part)->computeLikelihoodBranch(nei2_part,(PhyloNode*)nei1_part->node);
-				tree_lh += part_info[part].cur_score;
-			} else {
-				if (part_info[part].cur_score == 0.0)
-					part_info[part].cur_score = at(part)->computeLikelihood();
-				tree_lh += part_info[part].cur_score;
-			}
-		}
+    PartitionBranchLikelihoodWork work(this, nei1, nei2, lambda);
+    forEachPartition(work, true);
+    for (int part = 0; part < ntrees; part++)
+        tree_lh += part_info[part].cur_score;
     return -tree_lh;
 }
 
@@ -376,36 +426,11 @@ void PhyloSuperTreePlen::computeFuncDerv(double value, double &df_ret, double &d
 	SuperNeighbor *nei2 = (SuperNeighbor*)current_it->node->findNeighbor(current_it_back->node);
 	ASSERT(nei1 && nei2);
 
-    if (part_order.empty()) computePartitionOrder();
-    #ifdef _OPENMP
-    #pragma omp parallel for reduction(+: df, ddf) schedule(dynamic) if(num_threads > 1)
-    #endif    
-	for (int partid = 0; partid < ntrees; partid++) {
-        int part = part_order_by_nptn[partid];
-        double df_aux, ddf_aux;
-        PhyloNeighbor *nei1_part = nei1->link_neighbors[part];
-        PhyloNeighbor *nei2_part = nei2->link_neighbors[part];
-        if (nei1_part && nei2_part) {
-            at(part)->current_it = nei1_part;
-            at(part)->current_it_back = nei2_part;
-            
-            nei1_part->length += lambda*part_info[part].part_rate;
-            nei2_part->length += lambda*part_info[part].part_rate;
-            if(nei1_part->length<-1e-4) {
-                cout<<"lambda = "<<lambda<<endl;
-                cout<<"NEGATIVE BRANCH len = "<<nei1_part->length<<endl<<" rate = "<<part_info[part].part_rate<<endl;
-                ASSERT(0);
-                outError("shit!!   ",__func__);
-            }
-            at(part)->computeLikelihoodDerv(nei2_part,(PhyloNode*)nei1_part->node, &df_aux, &ddf_aux);
-            df += part_info[part].part_rate*df_aux;
-            ddf += part_info[part].part_rate*part_info[part].part_rate*ddf_aux;
-        }
-        else {
-            if (part_info[part].cur_score == 0.0) {
-                part_info[part].cur_score = at(part)->computeLikelihood();
-            }
-        }
+    PartitionBranchDervWork work(this, nei1, nei2, lambda);
+    forEachPartition(work, true);
+    for (int part = 0; part < ntrees; part++) {
+        df += work.df[part];
+        ddf += work.ddf[part];
     }
     df_ret = -df;
     ddf_ret = -ddf;
@@ -980,9 +980,21 @@ uint64_t PhyloTree::getMemoryRequired(size_t ncategory, bool full_mem) {
     else
         mem_size = aln->num_states * (aln->STATE_UNKNOWN+1) * sizeof(double);
 
-    // memory for UFBoot
-    if (params->gbo_replicates)
-        mem_size += params->gbo_replicates*nptn*sizeof(BootValType);
+    // memory for UFBoot: the pattern frequencies of the samples are stored with 1 or 2 bytes
+    // if the largest count fits (see IQTree::setBootSample)
+    if (params->gbo_replicates) {
+        int max_freq = 0;
+        for (auto it = aln->begin(); it != aln->end(); it++)
+            max_freq = max(max_freq, it->frequency);
+        // a resampled count hardly exceeds the pattern frequency by 6 standard deviations
+        double max_count = max_freq + 6.0*sqrt((double)max_freq) + 6.0;
+        size_t count_size = sizeof(BootValType);
+        if (max_count <= UCHAR_MAX)
+            count_size = 1;
+        else if (max_count <= USHRT_MAX)
+            count_size = 2;
+        mem_size += params->gbo_replicates*nptn*count_size;
+    }
 
     // memory for model
     if (model)
@@ -1051,6 +1063,23 @@ void PhyloTree::getMemoryRequired(uint64_t &partial_lh_entries, uint64_t &scale_
     partial_pars_entries = (leafNum - 1) * 4 * pars_block_size + tip_partial_pars_size;
 }
 
+void PhyloTree::getCentralPartialLhSize(uint64_t &partial_lh_size, uint64_t &scale_num_size) {
+    // +num_states for ascertainment bias correction
+    size_t nptn = get_safe_upper_limit(aln->size())+ max(get_safe_upper_limit(aln->num_states), get_safe_upper_limit(model_factory->unobserved_ptns.size()));
+    uint64_t scale_block_size = nptn * site_rate->getNRate() * ((model_factory->fused_mix_rate)? 1 : model->getNMixtures());
+    uint64_t block_size = scale_block_size * model->num_states;
+
+    uint64_t tip_partial_lh_size = get_safe_upper_limit(aln->num_states * (aln->STATE_UNKNOWN+1) * model->getNMixtures());
+    if (model->isSiteSpecificModel())
+        tip_partial_lh_size = get_safe_upper_limit(aln->size()) * model->num_states * leafNum;
+
+    if (max_lh_slots == 0)
+        getMemoryRequired();
+
+    partial_lh_size = (uint64_t)max_lh_slots * block_size + 4 + tip_partial_lh_size;
+    scale_num_size = (uint64_t)max_lh_slots * scale_block_size;
+}
+
 void PhyloTree::initializeAllPartialLh(int &index, int &indexlh, PhyloNode *node, PhyloNode *dad) {
     uint64_t pars_block_size = getBitsBlockSize();
     // +num_states for ascertainment bias correction
@@ -1070,14 +1099,8 @@ void PhyloTree::initializeAllPartialLh(int &index, int &indexlh, PhyloNode *node
         }
 
         if (!central_partial_lh) {
-            uint64_t tip_partial_lh_size = get_safe_upper_limit(aln->num_states * (aln->STATE_UNKNOWN+1) * model->getNMixtures());
-            if (model->isSiteSpecificModel())
-                tip_partial_lh_size = get_safe_upper_limit(aln->size()) * model->num_states * leafNum;
-
-            if (max_lh_slots == 0)
-                getMemoryRequired();
-
-            uint64_t mem_size = (uint64_t)max_lh_slots * block_size + 4 + tip_partial_lh_size;
+            uint64_t mem_size, scale_mem_size;
+            getCentralPartialLhSize(mem_size, scale_mem_size);
 
             if (verbose_mode >= VB_MAX)
                 cout << "Allocating " << mem_size * sizeof(double) << " bytes for partial likelihood vectors" << endl;
@@ -1098,7 +1121,8 @@ void PhyloTree::initializeAllPartialLh(int &index, int &indexlh, PhyloNode *node
         }
 
         if (!central_scale_num) {
-            uint64_t mem_size = max_lh_slots * scale_block_size;
+            uint64_t mem_size, lh_mem_size;
+            getCentralPartialLhSize(lh_mem_size, mem_size);
 
             if (verbose_mode >= VB_MAX)
                 cout << "Allocating " << mem_size * sizeof(UBYTE) << " bytes for scale num vectors" << endl;
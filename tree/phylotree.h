@@ -344,6 +344,8 @@ class PhyloTree : public MTree, public Optimization, public CheckpointFactory {
 
 	friend class PhyloSuperTree;
 	friend class PhyloSuperTreePlen;
+	friend class PartitionBranchLikelihoodWork;
+	friend class PartitionBranchDervWork;
 	friend class RateGamma;
 	friend class RateGammaInvar;
 	friend class RateKategory;
@@ -606,6 +608,18 @@ public:
     typedef double (PhyloTree::*DotProductDoubleType)(double *x, double *y, int size);
     DotProductDoubleType dotProductDouble;
 
+    /**
+        all pairwise dot products of nx vectors x and ny vectors y, processed in cache-sized
+        blocks so that each y is streamed from memory once for all x
+        @param y vectors of unsigned char (y_size=1), unsigned short (y_size=2) or Numeric values
+        @param res (OUT) res[j*nx+i] = dot product of x[i] and y[j]
+     */
+    template <class Numeric, class VectorClass>
+    void dotProductBatchSIMD(Numeric **x, int nx, unsigned char **y, int y_size, int ny, int size, Numeric *res);
+
+    typedef void (PhyloTree::*DotProductBatchType)(BootValType **x, int nx, unsigned char **y, int y_size, int ny, int size, BootValType *res);
+    DotProductBatchType dotProductBatch;
+
     double dotProductDoubleCall(double *x, double *y, int size);
 
 #if defined(BINARY32) || defined(__NOAVX__)
@@ -1090,6 +1104,19 @@ public:
 
     virtual void writeMarginalAncestralState(ostream &out, PhyloNode *node, double *ptn_ancestral_prob, int *ptn_ancestral_seq);
 
+    /**
+        write ancestral states and probabilities of all sites of an alignment, one line per site;
+        blocks of sites are formatted in parallel and written in order
+        @param out output stream, its floatfield and precision are used for the probabilities
+        @param prefix beginning of each line (e.g. node name)
+        @param site_aln alignment of the sites
+        @param nstates number of states
+        @param ptn_ancestral_prob pattern ancestral probability vector
+        @param ptn_ancestral_seq vector of state with highest probability
+    */
+    void writeMarginalAncestralSites(ostream &out, const string &prefix, Alignment *site_aln, int nstates,
+        double *ptn_ancestral_prob, int *ptn_ancestral_seq);
+
     /**
         end computing ancestral sequence probability for an internal node by marginal reconstruction
     */
@@ -1954,15 +1981,25 @@ public:
      */
     double* newAncestralProb();
     
+    /**
+     compute ancestral site concordance factor of all branches in parallel,
+     computing the ancestral probabilities of each subtree only once
+     @param branches target branches
+     @param nquartets number of quartets per branch
+     */
+    void computeAncestralSiteConcordance(BranchVector &branches, int nquartets);
+
     /**
      compute ancestral site concordance factor
      @param branch target branch
      @param nquartets number of quartets
-     @param[out] info concordance information
      @param rstream random stream
+     @param first_ancestral_prob, first_ancestral_seq ancestral probabilities and states of subtrees next to branch.first
+     @param second_ancestral_prob, second_ancestral_seq ancestral probabilities and states of subtrees next to branch.second
      */
     virtual void computeAncestralSiteConcordance(Branch &branch, int nquartets, int *rstream,
-        double *marginal_ancestral_prob, int *marginal_ancestral_seq);
+        vector<double*> &first_ancestral_prob, vector<int*> &first_ancestral_seq,
+        vector<double*> &second_ancestral_prob, vector<int*> &second_ancestral_seq);
 
     /**
      compute ancestral sCF for all branches
@@ -2160,6 +2197,14 @@ public:
     
     void getMemoryRequired(uint64_t &partial_lh_entries, uint64_t &scale_num_entries, uint64_t &partial_pars_entries);
 
+    /**
+     * compute the number of entries of central_partial_lh and central_scale_num
+     * for the current max_lh_slots
+     * @param[out] partial_lh_size number of doubles in central_partial_lh (incl. tip_partial_lh)
+     * @param[out] scale_num_size number of entries in central_scale_num
+     */
+    void getCentralPartialLhSize(uint64_t &partial_lh_size, uint64_t &scale_num_size);
+
     /****** following variables are for ultra-fast bootstrap *******/
     /** 2 to save all trees, 1 to save intermediate trees */
     int save_all_trees;
@@ -119,6 +119,7 @@ void PhyloTree::setLikelihoodKernel(LikelihoodKernel lk) {
 //		dotProduct = &PhyloTree::dotProductSIMD<float, Vec1f>;
 #else
 		dotProduct = &PhyloTree::dotProductSIMD<double, Vec1d>;
+		dotProductBatch = &PhyloTree::dotProductBatchSIMD<double, Vec1d>;
 #endif
         dotProductDouble = &PhyloTree::dotProductSIMD<double, Vec1d>;
 #endif
@@ -1509,21 +1510,45 @@ void PhyloTree::computeMarginalAncestralState(PhyloNeighbor *dad_branch, PhyloNo
 }
 
 void PhyloTree::writeMarginalAncestralState(ostream &out, PhyloNode *node, double *ptn_ancestral_prob, int *ptn_ancestral_seq) {
-    size_t nsites = aln->getNSite();
-    size_t nstates = model->num_states;
-    for (size_t site = 0; site < nsites; ++site) {
-        int ptn = aln->getPatternID(site);
-        out << node->name << "\t" << site+1 << "\t";
-//        if (params->print_ancestral_sequence == AST_JOINT)
-//            out << aln->convertStateBackStr(joint_ancestral_node[ptn]) << "\t";
-        out << aln->convertStateBackStr(ptn_ancestral_seq[ptn]);
-        double *state_prob = ptn_ancestral_prob + ptn*nstates;
-        for (size_t j = 0; j < nstates; j++) {
-            out << "\t" << state_prob[j];
+    writeMarginalAncestralSites(out, node->name + "\t", aln, model->num_states, ptn_ancestral_prob, ptn_ancestral_seq);
+}
+
+void PhyloTree::writeMarginalAncestralSites(ostream &out, const string &prefix, Alignment *site_aln, int nstates,
+    double *ptn_ancestral_prob, int *ptn_ancestral_seq)
+{
+    // same number format as the stream, but with snprintf that is faster and thread-safe
+    const char *format = ((out.flags() & ios::floatfield) == ios::fixed) ? "\t%.*f" : "\t%.*g";
+    int precision = out.precision();
+    size_t nsites = site_aln->getNSite();
+    const size_t block_size = 4096;
+    int nthreads = max(num_threads, 1);
+    vector<string> blocks(nthreads);
+    for (size_t start = 0; start < nsites; start += block_size*nthreads) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static, 1) if(nthreads > 1)
+#endif
+        for (int block = 0; block < nthreads; block++) {
+            string &buf = blocks[block];
+            buf.clear();
+            char num[64];
+            size_t end = min(start + (block+1)*block_size, nsites);
+            for (size_t site = start + block*block_size; site < end; ++site) {
+                int ptn = site_aln->getPatternID(site);
+                buf += prefix;
+                buf += convertIntToString(site+1);
+                buf += '\t';
+                buf += site_aln->convertStateBackStr(ptn_ancestral_seq[ptn]);
+                double *state_prob = ptn_ancestral_prob + ptn*nstates;
+                for (int j = 0; j < nstates; j++) {
+                    int len = snprintf(num, sizeof(num), format, precision, state_prob[j]);
+                    buf.append(num, len);
+                }
+                buf += '\n';
+            }
         }
-        out << endl;
+        for (int block = 0; block < nthreads; block++)
+            out.write(blocks[block].data(), blocks[block].size());
     }
-
 }
 
 void PhyloTree::endMarginalAncestralState(bool orig_kernel_nonrev, double* &ptn_ancestral_prob, int* &ptn_ancestral_seq) {
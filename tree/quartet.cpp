@@ -13,6 +13,7 @@
 #include "phylosupertree.h"
 #include "model/partitionmodel.h"
 #include "alignment/alignment.h"
+#include <vectorclass/vectorclass.h>
 #if 0 // (HAS-bla)
 #include "tools.h"
 #endif
@@ -673,6 +674,555 @@ void finisheps(FILE *ofp, vector<SeqQuartetInfo> lmap_seq_quartet_info, int leaf
 //*** end of likelihood mapping stuff (imported from TREE-PUZZLE's lmap.c) (HAS)
 
 
+/**
+    Likelihood engine for quartet trees, used by computeQuartetLikelihoods() for
+    a single reversible model (no partitions, mixtures or site-specific rates).
+    Instead of building a sub-alignment and a PhyloTree per quartet, the distinct
+    site patterns of the 4 taxa are collected and the 5 branch lengths are optimized
+    by Newton-Raphson directly on the eigen decomposition of the model.
+    Partial likelihoods only depend on the states of 2 or 3 taxa, so they are computed
+    once per group of patterns sharing these states.
+    One object is created per thread and reused for all its quartets.
+*/
+class QuartetLikelihood : public Optimization {
+public:
+
+    /**
+        constructor
+        @param tree phylogenetic tree with the model and rate heterogeneity
+    */
+    QuartetLikelihood(PhyloTree *tree);
+
+    /**
+        @return TRUE if the model and rate heterogeneity of tree is supported
+    */
+    static bool isSupported(PhyloTree *tree);
+
+    /**
+        collect the distinct site patterns of a quartet
+        @param seq_id IDs of the 4 sequences
+    */
+    void setQuartet(int *seq_id);
+
+    /**
+        optimize the branch lengths of quartet tree (qc[0],qc[1]),(qc[2],qc[3]),
+        like PhyloTree::optimizeAllBranches()
+        @param qc positions of the 4 sequences of setQuartet() in the tree
+        @param my_iterations max number of rounds over all branches
+        @param tolerance stop if log-likelihood improves less than this
+        @return tree log-likelihood
+    */
+    double optimizeQuartet(int *qc, int my_iterations, double tolerance);
+
+    /**
+        compute the negative first and second derivatives of the log-likelihood
+        w.r.t. the length of the current branch
+    */
+    virtual void computeFuncDerv(double value, double &df, double &ddf);
+
+protected:
+
+    /**
+        group the patterns by the states of some taxa
+        @param mask bit i is set if position i of setQuartet() is considered
+    */
+    void groupPatterns(int mask);
+
+    /** @return log-likelihood with the current branch length set to value */
+    double computeBranchLikelihood(double value);
+
+    /** compute pattern coefficients of branch (0-3: external, 4: internal) for the current topology */
+    void computeBranchCoeff(int branch);
+
+    /** compute the transposed transition matrices of branch for all rate categories */
+    void computeTransMatrix(int branch);
+
+    /** apply the transition matrices of an external branch to the tip vectors of its taxon */
+    void computeTipTrans(int branch);
+
+    /**
+        apply the transition matrices of the internal branch to the partial likelihoods of a cherry
+        @param cherry 0 for tree taxa 0,1, 1 for tree taxa 2,3
+    */
+    void computeCherryTrans(int cherry);
+
+    /** initialize branch lengths from corrected pairwise distances */
+    void initBranchLengths();
+
+    PhyloTree *tree;
+
+    int nstates, ncat;
+
+    /** proportion of invariable sites */
+    double p_invar;
+
+    /** model parameters, evec_t and inv_evec_t are the transposed (inverse) eigenvectors */
+    DoubleVector state_freq, eval, evec, evec_t, inv_evec_t;
+
+    /** rate and proportion of each category */
+    DoubleVector cat_rate, cat_prop;
+
+    /** tip likelihood vector of every state */
+    DoubleVector tip_lh;
+
+    /** distinct states of each taxon and state index of each pattern and taxon */
+    IntVector taxon_states[4], ptn_state;
+
+    /** per taxon and distinct state, tip likelihoods times state frequencies times eigenvectors */
+    DoubleVector taxon_eigen[4];
+
+    /** pattern frequencies and contributions of invariable sites */
+    DoubleVector ptn_freq, ptn_invar;
+
+    /** map from packed states to pattern or group ID */
+    unordered_map<uint64_t, int> ptn_map;
+
+    /** by bit mask of taxa (see groupPatterns()): group of each pattern and first pattern of each group */
+    IntVector ptn_group[16], group_ptn[16];
+
+    /** position of each tree taxon in setQuartet(), taxa 0,1 and 2,3 form cherries */
+    int taxon[4];
+
+    /** branch lengths, 0-3: external branches to taxon[0..3], 4: internal branch */
+    double len[5];
+
+    /** transposed transition matrices of each branch and category */
+    DoubleVector trans[5];
+
+    /** exponentials of scaled eigenvalues of one category, used by computeTransMatrix() */
+    DoubleVector exp_val;
+
+    /** transition matrices of external branches applied to tip vectors, per category and state */
+    DoubleVector tip_trans[4];
+
+    /** per pattern group of each cherry and category, its partial likelihoods across the internal branch */
+    DoubleVector cherry_trans[2];
+
+    /** TRUE if cherry_trans is up to date with the branch lengths */
+    bool cherry_computed[2];
+
+    /** per pattern group and category, partial likelihoods times (inverse) eigenvectors */
+    DoubleVector group_eigen[2];
+
+    /** coefficients of current branch per pattern, category and eigenvalue */
+    DoubleVector coeff;
+
+    /** per category and eigenvalue: exponentials of scaled eigenvalues and their 1st and 2nd derivatives */
+    DoubleVector val0, val1, val2;
+
+    /** partial likelihoods */
+    DoubleVector partial_lh;
+};
+
+QuartetLikelihood::QuartetLikelihood(PhyloTree *tree) {
+    this->tree = tree;
+    ModelSubst *model = tree->getModel();
+    RateHeterogeneity *site_rate = tree->getRate();
+    nstates = model->num_states;
+    ncat = site_rate->getNDiscreteRate();
+    p_invar = site_rate->getPInvar();
+    state_freq.resize(nstates);
+    model->getStateFrequency(state_freq.data());
+    eval.assign(model->getEigenvalues(), model->getEigenvalues() + nstates);
+    evec.assign(model->getEigenvectors(), model->getEigenvectors() + nstates*nstates);
+    evec_t.resize(nstates*nstates);
+    for (int x = 0; x < nstates; x++)
+        for (int k = 0; k < nstates; k++)
+            evec_t[k*nstates+x] = evec[x*nstates+k];
+    inv_evec_t.assign(model->getInverseEigenvectorsTransposed(), model->getInverseEigenvectorsTransposed() + nstates*nstates);
+    cat_rate.resize(ncat);
+    cat_prop.resize(ncat);
+    for (int c = 0; c < ncat; c++) {
+        cat_rate[c] = site_rate->getRate(c);
+        cat_prop[c] = site_rate->getProp(c);
+    }
+    int nstates_all = tree->aln->STATE_UNKNOWN + 1;
+    tip_lh.resize(nstates_all * nstates);
+    for (int state = 0; state < nstates_all; state++)
+        model->computeTipLikelihood(state, &tip_lh[state*nstates]);
+    for (int i = 0; i < 5; i++)
+        trans[i].resize(ncat*nstates*nstates);
+    val0.resize(ncat*nstates);
+    val1.resize(ncat*nstates);
+    val2.resize(ncat*nstates);
+    partial_lh.resize(nstates);
+}
+
+bool QuartetLikelihood::isSupported(PhyloTree *tree) {
+    if (tree->isSuperTree() || tree->aln->seq_type == SEQ_POMO)
+        return false;
+    ModelSubst *model = tree->getModel();
+    RateHeterogeneity *site_rate = tree->getRate();
+    if (model->isMixture() || model->isSiteSpecificModel() || !model->isReversible() ||
+        model->isPolymorphismAware() || !model->getEigenvalues())
+        return false;
+    if (site_rate->isSiteSpecificRate() || site_rate->isHeterotachy())
+        return false;
+    return tree->getModelFactory()->ASC_type == ASC_NONE;
+}
+
+void QuartetLikelihood::groupPatterns(int mask) {
+    size_t nptn = ptn_freq.size();
+    IntVector &group = ptn_group[mask];
+    IntVector &first_ptn = group_ptn[mask];
+    group.resize(nptn);
+    first_ptn.clear();
+    ptn_map.clear();
+    for (size_t ptn = 0; ptn < nptn; ptn++) {
+        uint64_t key = 0;
+        for (int i = 0; i < 4; i++)
+            if (mask & (1 << i))
+                key = (key << 16) | ptn_state[ptn*4+i];
+        auto it = ptn_map.insert(make_pair(key, (int)first_ptn.size()));
+        if (it.second)
+            first_ptn.push_back(ptn);
+        group[ptn] = it.first->second;
+    }
+}
+
+void QuartetLikelihood::setQuartet(int *seq_id) {
+    Alignment *aln = tree->aln;
+    size_t nptn = aln->getNPattern();
+    int i, x;
+    ptn_map.clear();
+    ptn_state.clear();
+    ptn_freq.clear();
+    IntVector state_index[4];
+    for (i = 0; i < 4; i++) {
+        taxon_states[i].clear();
+        state_index[i].assign(aln->STATE_UNKNOWN + 1, -1);
+    }
+    for (size_t ptn = 0; ptn < nptn; ptn++) {
+        Pattern &pat = aln->at(ptn);
+        uint64_t key = 0;
+        for (i = 0; i < 4; i++)
+            key = (key << 16) | pat[seq_id[i]];
+        auto it = ptn_map.find(key);
+        if (it != ptn_map.end()) {
+            ptn_freq[it->second] += pat.frequency;
+            continue;
+        }
+        ptn_map[key] = ptn_freq.size();
+        ptn_freq.push_back(pat.frequency);
+        for (i = 0; i < 4; i++) {
+            int state = pat[seq_id[i]];
+            if (state_index[i][state] < 0) {
+                state_index[i][state] = taxon_states[i].size();
+                taxon_states[i].push_back(state);
+            }
+            ptn_state.push_back(state_index[i][state]);
+        }
+    }
+
+    // the 6 pairs of taxa for the cherries and the 4 triples of taxa for external branches
+    for (int mask = 0; mask < 16; mask++) {
+        int ntaxa = (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+        if (ntaxa == 2 || ntaxa == 3)
+            groupPatterns(mask);
+    }
+
+    // left-hand side of the coefficients of an external branch only depends on the tip state
+    for (i = 0; i < 4; i++) {
+        int nstate_taxon = taxon_states[i].size();
+        taxon_eigen[i].assign(nstate_taxon*nstates, 0.0);
+        for (int s = 0; s < nstate_taxon; s++) {
+            double *lh = &tip_lh[taxon_states[i][s]*nstates];
+            double *out = &taxon_eigen[i][s*nstates];
+            for (x = 0; x < nstates; x++)
+                if (lh[x] != 0.0)
+                    for (int k = 0; k < nstates; k++)
+                        out[k] += state_freq[x] * lh[x] * evec[x*nstates+k];
+        }
+    }
+
+    // invariable sites: states compatible with all 4 taxa, like PhyloTree::computePtnInvar()
+    nptn = ptn_freq.size();
+    ptn_invar.assign(nptn, 0.0);
+    if (p_invar > 0.0) {
+        for (size_t ptn = 0; ptn < nptn; ptn++) {
+            for (x = 0; x < nstates; x++) {
+                for (i = 0; i < 4; i++)
+                    if (tip_lh[taxon_states[i][ptn_state[ptn*4+i]]*nstates + x] <= 0.0)
+                        break;
+                if (i == 4)
+                    ptn_invar[ptn] += state_freq[x];
+            }
+            ptn_invar[ptn] *= p_invar;
+        }
+    }
+    coeff.resize(nptn*ncat*nstates);
+    exp_val.resize(nstates);
+}
+
+void QuartetLikelihood::initBranchLengths() {
+    // corrected pairwise distances between the 4 taxa
+    double dist[4][4];
+    int i, j;
+    size_t nptn = ptn_freq.size();
+    double alpha = tree->getRate()->getGammaShape();
+    for (i = 0; i < 4; i++)
+        for (j = i+1; j < 4; j++) {
+            double diff = 0.0, total = 0.0;
+            for (size_t ptn = 0; ptn < nptn; ptn++) {
+                int si = taxon_states[taxon[i]][ptn_state[ptn*4+taxon[i]]];
+                int sj = taxon_states[taxon[j]][ptn_state[ptn*4+taxon[j]]];
+                if (si >= nstates || sj >= nstates)
+                    continue;
+                total += ptn_freq[ptn];
+                if (si != sj)
+                    diff += ptn_freq[ptn];
+            }
+            double obs = (total > 0.0) ? (max(diff, 1.0) / total) : 0.0;
+            dist[i][j] = dist[j][i] = tree->correctBranchLengthF81(obs, alpha);
+        }
+    // least-squares branch lengths of tree (0,1),(2,3)
+    len[0] = 0.5*dist[0][1] + 0.25*(dist[0][2] + dist[0][3] - dist[1][2] - dist[1][3]);
+    len[1] = 0.5*dist[0][1] + 0.25*(dist[1][2] + dist[1][3] - dist[0][2] - dist[0][3]);
+    len[2] = 0.5*dist[2][3] + 0.25*(dist[0][2] + dist[1][2] - dist[0][3] - dist[1][3]);
+    len[3] = 0.5*dist[2][3] + 0.25*(dist[0][3] + dist[1][3] - dist[0][2] - dist[1][2]);
+    len[4] = 0.25*(dist[0][2] + dist[0][3] + dist[1][2] + dist[1][3]) - 0.5*(dist[0][1] + dist[2][3]);
+    Params *params = tree->params;
+    for (i = 0; i < 5; i++)
+        len[i] = min(max(len[i], params->min_branch_length), params->max_branch_length);
+}
+
+void QuartetLikelihood::computeTransMatrix(int branch) {
+    // row y of the transposed matrix: sum over k of inv_evec[k,y] * exp(eval[k]*rate*len) * evec[.,k]
+    double *P = trans[branch].data();
+    memset(P, 0, sizeof(double)*ncat*nstates*nstates);
+    for (int c = 0; c < ncat; c++) {
+        for (int k = 0; k < nstates; k++)
+            exp_val[k] = exp(eval[k] * cat_rate[c] * len[branch]);
+        for (int y = 0; y < nstates; y++, P += nstates)
+            for (int k = 0; k < nstates; k++) {
+                double a = inv_evec_t[y*nstates+k] * exp_val[k];
+                double *evec_row = &evec_t[k*nstates];
+                for (int x = 0; x < nstates; x++)
+                    P[x] += a * evec_row[x];
+            }
+    }
+}
+
+void QuartetLikelihood::computeTipTrans(int branch) {
+    IntVector &states = taxon_states[taxon[branch]];
+    int nstate_taxon = states.size();
+    tip_trans[branch].assign(ncat*nstate_taxon*nstates, 0.0);
+    double *out = tip_trans[branch].data();
+    for (int c = 0; c < ncat; c++) {
+        double *P = &trans[branch][c*nstates*nstates];
+        for (int s = 0; s < nstate_taxon; s++, out += nstates) {
+            double *lh = &tip_lh[states[s]*nstates];
+            for (int y = 0; y < nstates; y++)
+                if (lh[y] != 0.0)
+                    for (int x = 0; x < nstates; x++)
+                        out[x] += lh[y] * P[y*nstates+x];
+        }
+    }
+}
+
+void QuartetLikelihood::computeCherryTrans(int cherry) {
+    int t0 = taxon[cherry*2], t1 = taxon[cherry*2+1];
+    int mask = (1 << t0) | (1 << t1);
+    IntVector &first_ptn = group_ptn[mask];
+    size_t ngroups = first_ptn.size();
+    size_t nstate0 = taxon_states[t0].size(), nstate1 = taxon_states[t1].size();
+    cherry_trans[cherry].assign(ngroups*ncat*nstates, 0.0);
+    double *out = cherry_trans[cherry].data();
+    for (size_t group = 0; group < ngroups; group++) {
+        int *ptn_taxon = &ptn_state[first_ptn[group]*4];
+        for (int c = 0; c < ncat; c++, out += nstates) {
+            double *lh0 = &tip_trans[cherry*2][(c*nstate0 + ptn_taxon[t0])*nstates];
+            double *lh1 = &tip_trans[cherry*2+1][(c*nstate1 + ptn_taxon[t1])*nstates];
+            double *P = &trans[4][c*nstates*nstates];
+            for (int y = 0; y < nstates; y++) {
+                double lh = lh0[y] * lh1[y];
+                for (int x = 0; x < nstates; x++)
+                    out[x] += lh * P[y*nstates+x];
+            }
+        }
+    }
+    cherry_computed[cherry] = true;
+}
+
+void QuartetLikelihood::computeBranchCoeff(int branch) {
+    size_t nptn = ptn_freq.size();
+    size_t nstates_cat = ncat*nstates;
+    double *lh = partial_lh.data();
+    double *out = coeff.data();
+    int x, k, c;
+    if (branch == 4) {
+        // internal branch: partial likelihoods of each cherry in eigen space, the left one rooted
+        for (int cherry = 0; cherry < 2; cherry++) {
+            int t0 = taxon[cherry*2], t1 = taxon[cherry*2+1];
+            int mask = (1 << t0) | (1 << t1);
+            IntVector &first_ptn = group_ptn[mask];
+            size_t ngroups = first_ptn.size();
+            size_t nstate0 = taxon_states[t0].size(), nstate1 = taxon_states[t1].size();
+            group_eigen[cherry].assign(ngroups*nstates_cat, 0.0);
+            double *group_out = group_eigen[cherry].data();
+            for (size_t group = 0; group < ngroups; group++) {
+                int *ptn_taxon = &ptn_state[first_ptn[group]*4];
+                for (c = 0; c < ncat; c++, group_out += nstates) {
+                    double *lh0 = &tip_trans[cherry*2][(c*nstate0 + ptn_taxon[t0])*nstates];
+                    double *lh1 = &tip_trans[cherry*2+1][(c*nstate1 + ptn_taxon[t1])*nstates];
+                    for (x = 0; x < nstates; x++)
+                        lh[x] = lh0[x] * lh1[x];
+                    if (cherry == 0)
+                        for (x = 0; x < nstates; x++)
+                            lh[x] *= state_freq[x];
+                    // group_out[k] = sum over x of lh[x] * eigen[k,x]
+                    for (k = 0; k < nstates; k++) {
+                        double sum = 0.0;
+                        double *eigen_row = (cherry == 0) ? &evec[k] : &inv_evec_t[k];
+                        for (x = 0; x < nstates; x++)
+                            sum += lh[x] * eigen_row[x*nstates];
+                        group_out[k] = sum;
+                    }
+                }
+            }
+        }
+        IntVector &left_group = ptn_group[(1 << taxon[0]) | (1 << taxon[1])];
+        IntVector &right_group = ptn_group[(1 << taxon[2]) | (1 << taxon[3])];
+        for (size_t ptn = 0; ptn < nptn; ptn++) {
+            double *left = &group_eigen[0][left_group[ptn]*nstates_cat];
+            double *right = &group_eigen[1][right_group[ptn]*nstates_cat];
+            for (c = 0; c < ncat; c++)
+                for (k = 0; k < nstates; k++, out++)
+                    *out = left[c*nstates+k] * right[c*nstates+k] * cat_prop[c];
+        }
+        return;
+    }
+
+    // external branch: tip on the left, sibling and the other cherry on the right
+    int sibling = branch ^ 1;
+    int other = (branch < 2) ? 1 : 0;
+    if (!cherry_computed[other])
+        computeCherryTrans(other);
+    int tip = taxon[branch];
+    int mask = 15 & ~(1 << tip);
+    int cherry_mask = (1 << taxon[other*2]) | (1 << taxon[other*2+1]);
+    IntVector &first_ptn = group_ptn[mask];
+    IntVector &cherry_group = ptn_group[cherry_mask];
+    size_t ngroups = first_ptn.size();
+    size_t nstate_sibling = taxon_states[taxon[sibling]].size();
+    group_eigen[0].assign(ngroups*nstates_cat, 0.0);
+    double *group_out = group_eigen[0].data();
+    for (size_t group = 0; group < ngroups; group++) {
+        int ptn = first_ptn[group];
+        double *cherry = &cherry_trans[other][cherry_group[ptn]*nstates_cat];
+        for (c = 0; c < ncat; c++, group_out += nstates, cherry += nstates) {
+            double *sib = &tip_trans[sibling][(c*nstate_sibling + ptn_state[ptn*4+taxon[sibling]])*nstates];
+            for (x = 0; x < nstates; x++) {
+                double a = sib[x] * cherry[x];
+                double *inv_row = &inv_evec_t[x*nstates];
+                for (k = 0; k < nstates; k++)
+                    group_out[k] += a * inv_row[k];
+            }
+        }
+    }
+    IntVector &right_group = ptn_group[mask];
+    for (size_t ptn = 0; ptn < nptn; ptn++) {
+        double *left = &taxon_eigen[tip][ptn_state[ptn*4+tip]*nstates];
+        double *right = &group_eigen[0][right_group[ptn]*nstates_cat];
+        for (c = 0; c < ncat; c++, right += nstates)
+            for (k = 0; k < nstates; k++, out++)
+                *out = left[k] * right[k] * cat_prop[c];
+    }
+}
+
+void QuartetLikelihood::computeFuncDerv(double value, double &df, double &ddf) {
+    int c, k, nstates_cat = ncat*nstates;
+    size_t nptn = ptn_freq.size();
+    for (c = 0; c < ncat; c++)
+        for (k = 0; k < nstates; k++) {
+            double cof = eval[k] * cat_rate[c];
+            double val = exp(cof * value);
+            val0[c*nstates+k] = val;
+            val1[c*nstates+k] = cof * val;
+            val2[c*nstates+k] = cof * cof * val;
+        }
+    df = ddf = 0.0;
+    double *ptn_coeff = coeff.data();
+    int nstates_vec = nstates_cat - (nstates_cat % Vec2d::size());
+    for (size_t ptn = 0; ptn < nptn; ptn++, ptn_coeff += nstates_cat) {
+        Vec2d vc_lh(0.0), vc_lh1(0.0), vc_lh2(0.0), vc_coeff, vc_val;
+        for (k = 0; k < nstates_vec; k += Vec2d::size()) {
+            vc_coeff.load(ptn_coeff+k);
+            vc_lh += vc_coeff * vc_val.load(&val0[k]);
+            vc_lh1 += vc_coeff * vc_val.load(&val1[k]);
+            vc_lh2 += vc_coeff * vc_val.load(&val2[k]);
+        }
+        double lh = ptn_invar[ptn] + horizontal_add(vc_lh);
+        double lh1 = horizontal_add(vc_lh1), lh2 = horizontal_add(vc_lh2);
+        for (; k < nstates_cat; k++) {
+            lh += ptn_coeff[k] * val0[k];
+            lh1 += ptn_coeff[k] * val1[k];
+            lh2 += ptn_coeff[k] * val2[k];
+        }
+        lh1 /= lh;
+        df -= ptn_freq[ptn] * lh1;
+        ddf -= ptn_freq[ptn] * (lh2 / lh - lh1 * lh1);
+    }
+}
+
+double QuartetLikelihood::computeBranchLikelihood(double value) {
+    int c, k, nstates_cat = ncat*nstates;
+    size_t nptn = ptn_freq.size();
+    for (c = 0; c < ncat; c++)
+        for (k = 0; k < nstates; k++)
+            val0[c*nstates+k] = exp(eval[k] * cat_rate[c] * value);
+    double tree_lh = 0.0;
+    double *ptn_coeff = coeff.data();
+    for (size_t ptn = 0; ptn < nptn; ptn++, ptn_coeff += nstates_cat) {
+        double lh = ptn_invar[ptn];
+        for (k = 0; k < nstates_cat; k++)
+            lh += ptn_coeff[k] * val0[k];
+        tree_lh += ptn_freq[ptn] * log(lh);
+    }
+    return tree_lh;
+}
+
+double QuartetLikelihood::optimizeQuartet(int *qc, int my_iterations, double tolerance) {
+    int i, j;
+    for (i = 0; i < 4; i++)
+        taxon[i] = qc[i];
+    initBranchLengths();
+    for (i = 0; i < 5; i++)
+        computeTransMatrix(i);
+    for (i = 0; i < 4; i++)
+        computeTipTrans(i);
+    cherry_computed[0] = cherry_computed[1] = false;
+
+    Params *params = tree->params;
+    computeBranchCoeff(4);
+    double tree_lh = computeBranchLikelihood(len[4]);
+    double saved_len[5];
+    for (i = 0; i < my_iterations; i++) {
+        memcpy(saved_len, len, sizeof(len));
+        // the internal branch comes last, so that its coefficients give the tree log-likelihood
+        for (j = 0; j < 5; j++) {
+            computeBranchCoeff(j);
+            len[j] = minimizeNewton(params->min_branch_length, len[j], params->max_branch_length, params->min_branch_length);
+            computeTransMatrix(j);
+            if (j < 4) {
+                computeTipTrans(j);
+                cherry_computed[j/2] = false;
+            } else
+                cherry_computed[0] = cherry_computed[1] = false;
+        }
+        double new_tree_lh = computeBranchLikelihood(len[4]);
+        if (new_tree_lh < tree_lh - tolerance*0.1) {
+            // log-likelihood decreases, revert the branch lengths and stop
+            memcpy(len, saved_len, sizeof(len));
+            return tree_lh;
+        }
+        if (tree_lh <= new_tree_lh && new_tree_lh <= tree_lh + tolerance)
+            return new_tree_lh;
+        tree_lh = new_tree_lh;
+    }
+    return tree_lh;
+}
+
 void PhyloTree::computeQuartetLikelihoods(vector<QuartetInfo> &lmap_quartet_info, QuartetGroups &LMGroups) {
 
     if (leafNum < 4) 
@@ -838,6 +1388,11 @@ void PhyloTree::computeQuartetLikelihoods(vector<QuartetInfo> &lmap_quartet_info
     int *rstream = randstream;
 #endif    
 
+    // specialized quartet engine, or NULL to build a PhyloTree per quartet
+    QuartetLikelihood *quartet_lh = NULL;
+    if (QuartetLikelihood::isSupported(this))
+        quartet_lh = new QuartetLikelihood(this);
+
 #ifdef _OPENMP
     #pragma omp for schedule(guided)
 #endif
@@ -891,92 +1446,99 @@ void PhyloTree::computeQuartetLikelihoods(vector<QuartetInfo> &lmap_quartet_info
 	// *** taxa should not be sorted, because that changes the corners a dot is assigned to - removed HAS ;^)
         // obsolete: sort(lmap_quartet_info[qid].seqID, lmap_quartet_info[qid].seqID+4); // why sort them?!? HAS ;^)
 
-        // initialize sub-alignment and sub-tree
-        Alignment *quartet_aln;
-        if (aln->isSuperAlignment()) {
-            quartet_aln = new SuperAlignment;
-        } else {
-            quartet_aln = new Alignment;
-        }
-        IntVector seq_id;
-        seq_id.insert(seq_id.begin(), lmap_quartet_info[qid].seqID, lmap_quartet_info[qid].seqID+4);
-        IntVector kept_partitions;
-        // only keep partitions with at least 3 sequences
-        quartet_aln->extractSubAlignment(aln, seq_id, 0, 3, &kept_partitions);
-                
-        if (kept_partitions.size() == 0) {
-            // nothing kept
-            for (int k = 0; k < 3; k++) {
-                lmap_quartet_info[qid].logl[k] = -1.0;
-            }
+        if (quartet_lh) {
+            quartet_lh->setQuartet(lmap_quartet_info[qid].seqID);
+            // loop over 3 quartets to compute likelihood, with logl_epsilon=0.1 accuracy
+            for (int k = 0; k < 3; k++)
+                lmap_quartet_info[qid].logl[k] = quartet_lh->optimizeQuartet(qc + k*4, 10, 0.1);
         } else {
-            // something partition kept, do computations
-            if (quartet_aln->ordered_pattern.empty())
-                quartet_aln->orderPatternByNumChars(PAT_VARIANT);
-            PhyloTree *quartet_tree;
-            if (isSuperTree()) {
-                quartet_tree = new PhyloSuperTree((SuperAlignment*)quartet_aln, (PhyloSuperTree*)this);
+            // initialize sub-alignment and sub-tree
+            Alignment *quartet_aln;
+            if (aln->isSuperAlignment()) {
+                quartet_aln = new SuperAlignment;
             } else {
-                quartet_tree = new PhyloTree(quartet_aln);
+                quartet_aln = new Alignment;
             }
-
-            // set up parameters
-            quartet_tree->setParams(params);
-            quartet_tree->optimize_by_newton = params->optimize_by_newton;
-            quartet_tree->setLikelihoodKernel(params->SSE);
-            quartet_tree->setNumThreads(num_threads);
-
-            // set model and rate
-            quartet_tree->setModelFactory(model_factory);
-            quartet_tree->setModel(getModel());
-            quartet_tree->setRate(getRate());
-
-            // set up partition model
-            if (isSuperTree()) {
-                PhyloSuperTree *quartet_super_tree = (PhyloSuperTree*)quartet_tree;
-                PhyloSuperTree *super_tree = (PhyloSuperTree*)this;
-                for (int i = 0; i < quartet_super_tree->size(); i++) {
-                    quartet_super_tree->at(i)->setModelFactory(super_tree->at(kept_partitions[i])->getModelFactory());
-                    quartet_super_tree->at(i)->setModel(super_tree->at(kept_partitions[i])->getModel());
-                    quartet_super_tree->at(i)->setRate(super_tree->at(kept_partitions[i])->getRate());
-                    //quartet_super_tree->at(i)->aln->buildSeqStates(quartet_super_tree->at(i)->getModel()->seq_states);
+            IntVector seq_id;
+            seq_id.insert(seq_id.begin(), lmap_quartet_info[qid].seqID, lmap_quartet_info[qid].seqID+4);
+            IntVector kept_partitions;
+            // only keep partitions with at least 3 sequences
+            quartet_aln->extractSubAlignment(aln, seq_id, 0, 3, &kept_partitions);
+                
+            if (kept_partitions.size() == 0) {
+                // nothing kept
+                for (int k = 0; k < 3; k++) {
+                    lmap_quartet_info[qid].logl[k] = -1.0;
                 }
             } else {
-                //quartet_aln->buildSeqStates(getModel()->seq_states);
-            }
+                // something partition kept, do computations
+                if (quartet_aln->ordered_pattern.empty())
+                    quartet_aln->orderPatternByNumChars(PAT_VARIANT);
+                PhyloTree *quartet_tree;
+                if (isSuperTree()) {
+                    quartet_tree = new PhyloSuperTree((SuperAlignment*)quartet_aln, (PhyloSuperTree*)this);
+                } else {
+                    quartet_tree = new PhyloTree(quartet_aln);
+                }
+
+                // set up parameters
+                quartet_tree->setParams(params);
+                quartet_tree->optimize_by_newton = params->optimize_by_newton;
+                quartet_tree->setLikelihoodKernel(params->SSE);
+                quartet_tree->setNumThreads(num_threads);
+
+                // set model and rate
+                quartet_tree->setModelFactory(model_factory);
+                quartet_tree->setModel(getModel());
+                quartet_tree->setRate(getRate());
+
+                // set up partition model
+                if (isSuperTree()) {
+                    PhyloSuperTree *quartet_super_tree = (PhyloSuperTree*)quartet_tree;
+                    PhyloSuperTree *super_tree = (PhyloSuperTree*)this;
+                    for (int i = 0; i < quartet_super_tree->size(); i++) {
+                        quartet_super_tree->at(i)->setModelFactory(super_tree->at(kept_partitions[i])->getModelFactory());
+                        quartet_super_tree->at(i)->setModel(super_tree->at(kept_partitions[i])->getModel());
+                        quartet_super_tree->at(i)->setRate(super_tree->at(kept_partitions[i])->getRate());
+                        //quartet_super_tree->at(i)->aln->buildSeqStates(quartet_super_tree->at(i)->getModel()->seq_states);
+                    }
+                } else {
+                    //quartet_aln->buildSeqStates(getModel()->seq_states);
+                }
             
-            // NOTE: we don't need to set phylo_tree in model and rate because parameters are not reoptimized
+                // NOTE: we don't need to set phylo_tree in model and rate because parameters are not reoptimized
             
             
             
-            // loop over 3 quartets to compute likelihood
-            for (int k = 0; k < 3; k++) {
-                string quartet_tree_str;
-                quartet_tree_str = "(" + quartet_aln->getSeqName(qc[k*4]) + "," + quartet_aln->getSeqName(qc[k*4+1]) + ",(" + 
-                    quartet_aln->getSeqName(qc[k*4+2]) + "," + quartet_aln->getSeqName(qc[k*4+3]) + "));";
-                quartet_tree->readTreeStringSeqName(quartet_tree_str);
-                quartet_tree->initializeAllPartialLh();
-                quartet_tree->wrapperFixNegativeBranch(true);
-                // optimize branch lengths with logl_epsilon=0.1 accuracy
-                lmap_quartet_info[qid].logl[k] = quartet_tree->optimizeAllBranches(10, 0.1);
-            }
-            // reset model & rate so that they are not deleted
-            quartet_tree->setModel(NULL);
-            quartet_tree->setModelFactory(NULL);
-            quartet_tree->setRate(NULL);
-
-            if (isSuperTree()) {
-                PhyloSuperTree *quartet_super_tree = (PhyloSuperTree*)quartet_tree;
-                for (int i = 0; i < quartet_super_tree->size(); i++) {
-                    quartet_super_tree->at(i)->setModelFactory(NULL);
-                    quartet_super_tree->at(i)->setModel(NULL);
-                    quartet_super_tree->at(i)->setRate(NULL);
+                // loop over 3 quartets to compute likelihood
+                for (int k = 0; k < 3; k++) {
+                    string quartet_tree_str;
+                    quartet_tree_str = "(" + quartet_aln->getSeqName(qc[k*4]) + "," + quartet_aln->getSeqName(qc[k*4+1]) + ",(" + 
+                        quartet_aln->getSeqName(qc[k*4+2]) + "," + quartet_aln->getSeqName(qc[k*4+3]) + "));";
+                    quartet_tree->readTreeStringSeqName(quartet_tree_str);
+                    quartet_tree->initializeAllPartialLh();
+                    quartet_tree->wrapperFixNegativeBranch(true);
+                    // optimize branch lengths with logl_epsilon=0.1 accuracy
+                    lmap_quartet_info[qid].logl[k] = quartet_tree->optimizeAllBranches(10, 0.1);
+                }
+                // reset model & rate so that they are not deleted
+                quartet_tree->setModel(NULL);
+                quartet_tree->setModelFactory(NULL);
+                quartet_tree->setRate(NULL);
+
+                if (isSuperTree()) {
+                    PhyloSuperTree *quartet_super_tree = (PhyloSuperTree*)quartet_tree;
+                    for (int i = 0; i < quartet_super_tree->size(); i++) {
+                        quartet_super_tree->at(i)->setModelFactory(NULL);
+                        quartet_super_tree->at(i)->setModel(NULL);
+                        quartet_super_tree->at(i)->setRate(NULL);
+                    }
                 }
+                delete quartet_tree;
             }
-            delete quartet_tree;
-        }
         
-        delete quartet_aln;
+            delete quartet_aln;
+        }
 
         // determine likelihood order
         int qworder[3]; // local (thread-safe) vector for sorting
@@ -1147,6 +1709,8 @@ void PhyloTree::computeQuartetLikelihoods(vector<QuartetInfo> &lmap_quartet_info
 		}
 	}
     } /*** end draw lmap_num_quartets quartets randomly ***/
+    if (quartet_lh)
+        delete quartet_lh;
 #ifdef _OPENMP
     finish_random(rstream);
     }
@@ -202,6 +202,14 @@ public:
         MPIHelper::numNNISearch = numNNISearch;
     }
 
+    /** increase the number of NNI searches, safe when trees are searched in parallel */
+    void increaseNumNNISearch() {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+        numNNISearch++;
+    }
+
 private:
     int numNNISearch;
 
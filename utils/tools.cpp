@@ -1014,6 +1014,7 @@ void quickStartGuide();
 
 void parseArg(int argc, char *argv[], Params &params) {
     int cnt;
+    bool alisim_thresh_given = false;
     progress_display::setProgressDisplay(false);
     verbose_mode = VB_MIN;
     params.tree_gen = NONE;
@@ -1098,6 +1099,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.test_input = TEST_NONE;
     params.tree_burnin = 0;
     params.tree_max_count = 1000000;
+    params.stream_trees = false;
     params.split_threshold = 0.0;
     params.split_threshold_str = NULL;
     params.split_weight_threshold = -1000;
@@ -1341,6 +1343,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.num_threads = 1;
     params.num_threads_max = 10000;
     params.openmp_by_model = false;
+    params.partition_hybrid_threads = false;
     params.model_test_criterion = MTC_BIC;
 //    params.model_test_stop_rule = MTC_ALL;
     params.model_test_sample_size = 0;
@@ -1387,6 +1390,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.suppress_output_flags = 0;
     params.ufboot2corr = false;
     params.u2c_nni5 = false;
+    params.u2c_parallel_trees = 0;
     params.date_with_outgroup = true;
     params.date_debug = false;
     params.date_replicates = 0;
@@ -1484,6 +1488,8 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.rebuild_indel_history_param = 1.0/3;
     params.alisim_openmp_alg = IM;
     params.no_merge = false;
+    params.alisim_counter_rng = false;
+    params.alisim_parallel_alignments = false;
     params.alignment_id = 0;
     
     // store original params
@@ -2081,6 +2087,10 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.consensus_type = CT_CONSENSUS_NETWORK;
                 continue;
 			}
+			if (strcmp(argv[cnt], "--con-stream") == 0) {
+				params.stream_trees = true;
+				continue;
+			}
             
             /**MINH ANH: to serve some statistics on tree*/
 			if (strcmp(argv[cnt], "-comp") == 0) {
@@ -2908,6 +2918,7 @@ void parseArg(int argc, char *argv[], Params &params) {
                 params.alisim_simulation_thresh = convert_double(argv[cnt]);
                 if (params.alisim_simulation_thresh < 0 || params.alisim_simulation_thresh > 1)
                     throw "<threshold> must be between 0 and 1. Please check and try again!";
+                alisim_thresh_given = true;
                 continue;
             }
 			if (strcmp(argv[cnt], "-st") == 0 || strcmp(argv[cnt], "--seqtype") == 0) {
@@ -3014,6 +3025,8 @@ void parseArg(int argc, char *argv[], Params &params) {
                     params.aln_output_format = IN_NEXUS;
                 else if (strcmp(format.c_str(), "MAPLE") == 0)
                     params.aln_output_format = IN_MAPLE;
+                else if (strcmp(format.c_str(), "PACKED") == 0)
+                    params.aln_output_format = IN_PACKED;
 				else
 					throw "Unknown output format";
 				continue;
@@ -3633,7 +3646,6 @@ void parseArg(int argc, char *argv[], Params &params) {
                 continue;
             }
 
-#ifdef USE_BOOSTER
             if (strcmp(argv[cnt], "--tbe") == 0) {
                 params.transfer_bootstrap = 1;
                 continue;
@@ -3643,7 +3655,6 @@ void parseArg(int argc, char *argv[], Params &params) {
                 params.transfer_bootstrap = 2;
                 continue;
             }
-#endif
 
             if (strcmp(argv[cnt], "-bc") == 0 || strcmp(argv[cnt], "--bcon") == 0) {
 				params.multi_tree = true;
@@ -4130,6 +4141,15 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.u2c_nni5 = true;
 				continue;
 			}
+			if (strcmp(argv[cnt], "--bnni-trees") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use --bnni-trees <num_trees>";
+				params.u2c_parallel_trees = convert_int(argv[cnt]);
+				if (params.u2c_parallel_trees < 0)
+					throw "--bnni-trees must be non-negative";
+				continue;
+			}
 
 			if (strcmp(argv[cnt], "-nstep") == 0 || strcmp(argv[cnt], "--nstep") == 0) {
 				cnt++;
@@ -4689,6 +4709,11 @@ void parseArg(int argc, char *argv[], Params &params) {
                 continue;
             }
 
+            if (strcmp(argv[cnt], "--thread-hybrid") == 0) {
+                params.partition_hybrid_threads = true;
+                continue;
+            }
+
 //			if (strcmp(argv[cnt], "-rootstate") == 0) {
 //                cnt++;
 //                if (cnt >= argc)
@@ -5351,6 +5376,16 @@ void parseArg(int argc, char *argv[], Params &params) {
                 continue;
             }
             
+            if (strcmp(argv[cnt], "--counter-rng") == 0) {
+                params.alisim_counter_rng = true;
+                continue;
+            }
+            
+            if (strcmp(argv[cnt], "--parallel-alignments") == 0) {
+                params.alisim_parallel_alignments = true;
+                continue;
+            }
+            
             if (strcmp(argv[cnt], "--indel-rate-variation") == 0) {
                 params.indel_rate_variation = true;
                 continue;
@@ -5441,8 +5476,9 @@ void parseArg(int argc, char *argv[], Params &params) {
     if (params.do_au_test && params.topotest_replicates == 0)
         outError("For AU test please specify number of bootstrap replicates via -zb option");
     
-    if (params.lh_mem_save == LM_MEM_SAVE && params.partition_file)
-        outError("-mem option does not work with partition models yet");
+    if (params.lh_mem_save == LM_MEM_SAVE && params.partition_file && !params.alisim_active &&
+        params.partition_type != BRLEN_OPTIMIZE && params.partition_type != TOPO_UNLINKED)
+        outError("-mem option only works with edge-unlinked partition models (-M, -Q or -S)");
     
     if (params.gbo_replicates && params.num_bootstrap_samples)
         outError("UFBoot (-bb) and standard bootstrap (-b) must not be specified together");
@@ -5517,6 +5553,9 @@ void parseArg(int argc, char *argv[], Params &params) {
     // computeTransMatix has not yet implemented for ModelSet
     if (params.alisim_active && (params.tree_freq_file || params.site_freq_file))
         outError("Sorry! `-ft` (--site-freq) and `-fs` (--tree-freq) options are not fully supported in AliSim. However, AliSim can estimate posterior mean frequencies from the alignment. Please try again without `-ft` and `-fs` options!");
+    // the counter-based RNG draws per site from transition matrices on every branch
+    if (params.alisim_active && params.alisim_counter_rng && alisim_thresh_given)
+        outWarning("--simulation-thresh is ignored with --counter-rng, transition matrices are used on all branches");
     
     // set default filename for the random tree if AliSim is running in Random mode
     if (params.alisim_active && !params.user_file && params.tree_gen != NONE)
@@ -5631,6 +5670,7 @@ void usage_alisim(){
     << "  -t TREE_FILE              Set the input tree file name" << endl
     << "  --length LENGTH           Set the length of the root sequence" << endl
     << "  --num-alignments NUMBER   Set the number of output datasets" << endl
+    << "  --parallel-alignments     Simulate the datasets concurrently, one per thread" << endl
     << "  --seqtype STRING          BIN, DNA, AA, CODON, MORPH{NUM_STATES} (default: auto-detect)" << endl
     << "                            For morphological data, 0<NUM_STATES<=32" << endl
     << "  --m MODEL_STRING          Specify the evolutionary model. See Manual for more detail" << endl
@@ -5668,8 +5708,16 @@ void usage_alisim(){
     << "  --seed NUM                Random seed number (default: CPU clock)" << endl
     << "                            Be careful to make the AliSim reproducible," << endl
     << "                            users should specify the seed number" << endl
+    << "  --counter-rng             Use a counter-based random number generator to make" << endl
+    << "                            the simulation independent of the number of threads" << endl
+    << "                            and MPI processes" << endl
+    << "                            (always uses transition matrices, --simulation-thresh" << endl
+    << "                            is ignored)" << endl
     << "  -gz                       Enable output compression but taking longer running time" << endl
-    << "  -af phy|fasta             Set the output format (default: phylip)" << endl
+    << "  --mem NUM[G|M|%]          Maximal RAM to cache sequences during the simulation" << endl
+    << "                            (default: all RAM), sequences are spilled to disk if needed" << endl
+    << "  -af phy|fasta|packed      Set the output format (default: phylip)" << endl
+    << "                            packed: a binary format with bit-packed states" << endl
     << "  User Manual is available at http://www.iqtree.org/doc/alisim" << endl;
 }
 
@@ -5696,6 +5744,7 @@ void usage_iqtree(char* argv[], bool full_command) {
 #ifdef _OPENMP
     << "  -T NUM|AUTO          No. cores/threads or AUTO-detect (default: 1)" << endl
     << "  --threads-max NUM    Max number of threads for -T AUTO (default: all cores)" << endl
+    << "  --thread-hybrid      Thread teams over partitions proportional to their cost" << endl
 #endif
     << endl << "CHECKPOINT:" << endl
     << "  --redo               Redo both ModelFinder and tree search" << endl
@@ -5748,15 +5797,14 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  --bcor NUM           Minimum correlation coefficient (default: 0.99)" << endl
     << "  --beps NUM           RELL epsilon to break tie (default: 0.5)" << endl
     << "  --bnni               Optimize UFBoot trees by NNI on bootstrap alignment" << endl
+    << "  --bnni-trees NUM     Max. UFBoot trees optimized at once (default: #threads)" << endl
     << endl << "NON-PARAMETRIC BOOTSTRAP/JACKKNIFE:" << endl
     << "  -b, --boot NUM       Replicates for bootstrap + ML tree + consensus tree" << endl
     << "  -j, --jack NUM       Replicates for jackknife + ML tree + consensus tree" << endl
     << "  --jack-prop NUM      Subsampling proportion for jackknife (default: 0.5)" << endl
     << "  --bcon NUM           Replicates for bootstrap + consensus tree" << endl
     << "  --bonly NUM          Replicates for bootstrap only" << endl
-#ifdef USE_BOOSTER
     << "  --tbe                Transfer bootstrap expectation" << endl
-#endif
 //            << "  -t <threshold>       Minimum bootstrap support [0...1) for consensus tree" << endl
     << endl << "SINGLE BRANCH TEST:" << endl
     << "  --alrt NUM           Replicates for SH approximate likelihood ratio test" << endl
@@ -5964,6 +6012,8 @@ void usage_iqtree(char* argv[], bool full_command) {
         << "  --con-tree           Compute consensus tree to .contree file" << endl
         << "  --con-net            Computing consensus network to .nex file" << endl
         << "  --support FILE       Assign support values into this tree from -t trees" << endl
+        << "  --con-stream         Count splits while reading -t trees (plain or gzipped)" << endl
+        << "                       one at a time, for very large tree sets" << endl
         //<< "  -sup2 FILE           Like -sup but -t trees can have unequal taxon sets" << endl
         << "  --suptag STRING      Node name (or ALL) to assign tree IDs where node occurs" << endl
         << endl << "TREE DISTANCE BY ROBINSON-FOULDS (RF) METRIC:" << endl
@@ -6071,6 +6121,7 @@ InputType detectInputFile(const char *input_file) {
                       else if (ch2 == 'O') return IN_COUNTS;
                       else return IN_OTHER;
             case '!': if (ch2 == '!') return IN_MSF; else return IN_OTHER;
+            case 0x89: if (ch2 == 'I') return IN_PACKED; else return IN_OTHER;
             default:
                 if (isdigit(ch)) return IN_PHYLIP;
                 return IN_OTHER;
@@ -6319,6 +6370,19 @@ int init_random(int seed, bool write_info, int** rstream) {
     return (seed);
 } /* initrandom */
 
+int init_random_stream(int seed, int stream_id, int** rstream) {
+    if (seed < 0)
+        seed = make_sprng_seed();
+    // the main streams are the SPRNG streams 0 ... (number of processes - 1)
+#ifndef PARALLEL
+    int first_stream = 1;
+#else
+    int first_stream = PP_NumProcs;
+#endif
+    *rstream = init_sprng(first_stream + stream_id, first_stream + stream_id + 1, seed, SPRNG_DEFAULT);
+    return (seed);
+}
+
 int finish_random(int *rstream) {
     if (rstream)
         return free_sprng(rstream);
@@ -6328,6 +6392,8 @@ int finish_random(int *rstream) {
 
 #endif /* USE_SPRNG */
 
+int *thread_randstream = NULL;
+
 /******************/
 
 /* returns a random integer in the range [0; n - 1] */
@@ -6350,6 +6416,8 @@ double random_double(int *rstream) {
 #elif RAN_TYPE == RAN_SPRNG
     if (rstream)
         return sprng(rstream);
+    else if (thread_randstream)
+        return sprng(thread_randstream);
     else
         return sprng(randstream);
 #else /* NO_SPRNG */
@@ -6359,6 +6427,8 @@ double random_double(int *rstream) {
 #if RAN_TYPE == RAN_SPRNG
     if (rstream)
         return sprng(rstream);
+    else if (thread_randstream)
+        return sprng(thread_randstream);
     else
         return sprng(randstream);
 #else /* NO_SPRNG */
@@ -7589,6 +7659,8 @@ string getOutputNameWithExt(const InputType& format, const string& output_filepa
     {
         case IN_MAPLE:
             return output_filepath + ".maple";
+        case IN_PACKED:
+            return output_filepath + ".packed";
         case IN_FASTA:
             return output_filepath + ".fa";
         case IN_PHYLIP:
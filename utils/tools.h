@@ -404,7 +404,7 @@ const int SW_AVG_PRESENT = 4; // take the split weight average over all trees th
         input type, tree or splits graph
  */
 enum InputType {
-    IN_NEWICK, IN_NEXUS, IN_FASTA, IN_PHYLIP, IN_COUNTS, IN_CLUSTAL, IN_MSF, IN_MAPLE, IN_OTHER
+    IN_NEWICK, IN_NEXUS, IN_FASTA, IN_PHYLIP, IN_COUNTS, IN_CLUSTAL, IN_MSF, IN_MAPLE, IN_PACKED, IN_OTHER
 };
 
   // TODO DS: SAMPLING_SAMPLED is DEPRECATED and it is not possible to run PoMo with SAMPLING_SAMPLED.
@@ -1474,6 +1474,11 @@ public:
      */
     int tree_max_count;
 
+    /**
+            TRUE to count splits while reading trees one at a time, without keeping all trees in memory
+     */
+    bool stream_trees;
+
     /**
         threshold of split frequency, splits appear less than threshold will be discarded
      */
@@ -2194,6 +2199,9 @@ public:
     /** true to parallel ModelFinder by models instead of sites */
     bool openmp_by_model;
 
+    /** true to assign thread teams to partitions proportional to their cost (hybrid scheduler) */
+    bool partition_hybrid_threads;
+
     /** either MTC_AIC, MTC_AICc, MTC_BIC */
     ModelTestCriterion model_test_criterion;
 
@@ -2323,6 +2331,7 @@ public:
      */
 	bool ufboot2corr; // to turn on the correction mode for UFBoot under model violations, enable by "-bb <nrep> -correct
 	bool u2c_nni5; // to use NNI5 during Refinement Step of UFBoot2-Corr
+	int u2c_parallel_trees; // max. number of UFBoot trees refined at the same time (0: number of threads)
 
     /** method for phylogenetic dating, currently only LSD is supported */
     string dating_method;
@@ -2586,6 +2595,17 @@ public:
     */
     bool no_merge;
     
+    /**
+    *  TRUE to draw the random numbers of AliSim from a counter-based RNG keyed by the node and the site,
+    *  which makes the simulated alignments independent of the number of threads
+    */
+    bool alisim_counter_rng;
+    
+    /**
+    *  TRUE to simulate multiple alignments concurrently, each by a single thread, instead of parallelizing within each alignment
+    */
+    bool alisim_parallel_alignments;
+    
     /**
     *  Alignment index, which was used to generate different random seed for each alignment when simulating multiple alignments
     */
@@ -3084,6 +3104,7 @@ void parseArg(int argc, char *argv[], Params &params);
                 IN_NEXUS if in nexus format,
                 IN_FASTA if in fasta format,
                 IN_PHYLIP if in phylip format,
+                IN_PACKED if in packed format,
 		IN_COUNTSFILE if in counts format (PoMo),
                 IN_OTHER if file format unknown.
  */
@@ -3162,6 +3183,15 @@ double computePValueChiSquare(double x, int df);
 
 extern int *randstream;
 
+/**
+ * random stream of the current thread, which replaces randstream if not NULL
+ * (e.g., to give each alignment simulated in parallel its own stream)
+ */
+extern int *thread_randstream;
+#ifdef _OPENMP
+#pragma omp threadprivate(thread_randstream)
+#endif
+
 /**
  * initialize the random number generator
  * @param seed seed for generator
@@ -3169,6 +3199,15 @@ extern int *randstream;
  */
 int init_random(int seed, bool write_info = false, int** rstream = NULL);
 
+/**
+ * initialize a random stream of a task (e.g., a branch) that does not depend on the thread running
+ * the task. The streams of different tasks and the main stream of the same seed never coincide
+ * @param seed seed for generator
+ * @param stream_id ID of the task, from 0
+ * @param rstream (OUT) the random stream, to be freed by finish_random()
+ */
+int init_random_stream(int seed, int stream_id, int** rstream);
+
 /**
  * finalize random number generator (e.g. free memory
  */